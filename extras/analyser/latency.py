@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+#
+# Summarize the per frame latency traces of VLC
+#
+# Copyright (C) 2024 VLC authors and VideoLAN
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation; either version 2.1 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this program; if not, write to the Free Software Foundation,
+# Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+
+"""
+Print histograms of the time spent in each stage of the pipeline, from the
+"LATENCY" traces of a JSON tracer output:
+
+    vlc --tracer=json_tracer --json-tracer-file=trace.json <mrl>
+    extras/analyser/latency.py trace.json
+"""
+
+import argparse
+import json
+import sys
+from collections import OrderedDict, defaultdict
+
+STAGES = ["demux", "queue", "packetizer", "decode", "filter", "prepare",
+          "display", "play"]
+BAR_WIDTH = 40
+
+
+def read_traces(stream):
+    for line in stream:
+        try:
+            body = json.loads(line)["Body"]
+        except (ValueError, KeyError):
+            continue
+        if body.get("type") == "LATENCY":
+            yield body
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def print_histogram(name, values):
+    """Print a log2 histogram of delays in microseconds"""
+    values.sort()
+    print("  %-12s %6d frames, min %8.3f ms, median %8.3f ms, "
+          "p99 %8.3f ms, max %8.3f ms" % (
+              name, len(values), values[0] / 1e6,
+              percentile(values, 50) / 1e6, percentile(values, 99) / 1e6,
+              values[-1] / 1e6))
+
+    buckets = defaultdict(int)
+    for value in values:
+        buckets[max(0, value // 1000).bit_length()] += 1
+    peak = max(buckets.values())
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        low = 0 if bucket == 0 else 1 << (bucket - 1)
+        print("    %8d us %-*s %d" % (
+            low, BAR_WIDTH, "#" * (count * BAR_WIDTH // peak), count))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", nargs="?", type=argparse.FileType("r"),
+                        default=sys.stdin, help="JSON tracer output")
+    parser.add_argument("--es", help="only summarize this ES id")
+    args = parser.parse_args()
+
+    # es id -> stage -> delays (ns)
+    delays = defaultdict(lambda: defaultdict(list))
+    totals = defaultdict(list)
+    last_stage = {}
+
+    for trace in read_traces(args.trace):
+        es = trace["id"]
+        if args.es is not None and es != args.es:
+            continue
+        stage = trace["stage"]
+        delays[es][stage].append(int(trace["delay"]))
+        # the end to end latency is the one of the last stage of a frame
+        last_stage[(es, trace["frame"])] = int(trace["total"])
+
+    for (es, _), total in last_stage.items():
+        totals[es].append(total)
+
+    if not delays:
+        print("no latency traces found", file=sys.stderr)
+        return 1
+
+    for es, stages in sorted(delays.items()):
+        print("%s:" % es)
+        ordered = OrderedDict((s, stages[s]) for s in STAGES if s in stages)
+        for stage, values in ordered.items():
+            if stage != "demux":
+                print_histogram(stage, values)
+        print_histogram("total", totals[es])
+        print()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
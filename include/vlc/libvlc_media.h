@@ -126,6 +126,57 @@ typedef struct libvlc_media_stats_t
     uint64_t     i_lost_abuffers;
 } libvlc_media_stats_t;
 
+/**
+ * Latency histogram type
+ *
+ * \see libvlc_media_get_histogram
+ */
+typedef enum libvlc_media_histogram_type_t
+{
+    libvlc_media_histogram_decode_time,   /**< time spent decoding a frame */
+    libvlc_media_histogram_render_time,   /**< time spent rendering a picture */
+    libvlc_media_histogram_display_late,  /**< delay of the displayed pictures */
+    libvlc_media_histogram_aout_latency,  /**< audio output latency */
+    libvlc_media_histogram_aout_drift,    /**< audio drift, in absolute value */
+    libvlc_media_histogram_static_filter_time,      /**< time spent in static
+                                                         filters */
+    libvlc_media_histogram_interactive_filter_time, /**< time spent in user
+                                                         filters */
+    libvlc_media_histogram_blend_time,    /**< time spent blending the
+                                               subpictures */
+    libvlc_media_histogram_prepare_time,  /**< time spent preparing the
+                                               display */
+    libvlc_media_histogram_display_time,  /**< time spent displaying a
+                                               picture */
+} libvlc_media_histogram_type_t;
+
+#define LIBVLC_MEDIA_HISTOGRAM_BUCKETS 24
+
+/**
+ * Log2 histogram of durations, in microseconds
+ *
+ * The bucket 0 counts the durations below 1 us, the bucket i the durations
+ * in [2^(i-1), 2^i) us, and the last bucket all the longer ones.
+ */
+typedef struct libvlc_media_histogram_t
+{
+    uint64_t     i_count;
+    int64_t      i_total_us;
+    int64_t      i_max_us;
+    uint64_t     p_buckets[LIBVLC_MEDIA_HISTOGRAM_BUCKETS];
+} libvlc_media_histogram_t;
+
+/**
+ * Trick-play statistics
+ *
+ * \see libvlc_media_get_trickplay_stats
+ */
+typedef struct libvlc_media_trickplay_stats_t
+{
+    uint64_t     i_keyframes;  /**< keyframes decoded during trick-play */
+    uint64_t     i_skipped;    /**< frames skipped during trick-play */
+} libvlc_media_trickplay_stats_t;
+
 /**
  * Media type
  *
@@ -545,6 +596,35 @@ LIBVLC_API int libvlc_media_save_meta( libvlc_instance_t *inst,
 LIBVLC_API bool libvlc_media_get_stats(libvlc_media_t *p_md,
                                        libvlc_media_stats_t *p_stats);
 
+/**
+ * Get a latency histogram of the media, since the start of its playback
+ *
+ * \param p_md media descriptor object
+ * \param type histogram to get
+ * \param p_histogram histogram (this structure must be allocated by the
+ *                    caller)
+ * \retval true the histogram is available
+ * \retval false otherwise
+ * \version LibVLC 4.0.0 and later.
+ */
+LIBVLC_API bool
+libvlc_media_get_histogram(libvlc_media_t *p_md,
+                           libvlc_media_histogram_type_t type,
+                           libvlc_media_histogram_t *p_histogram);
+
+/**
+ * Get the trick-play statistics of the media, since the start of its playback
+ *
+ * \param p_md media descriptor object
+ * \param p_stats statistics (this structure must be allocated by the caller)
+ * \retval true the statistics are available
+ * \retval false otherwise
+ * \version LibVLC 4.0.0 and later.
+ */
+LIBVLC_API bool
+libvlc_media_get_trickplay_stats(libvlc_media_t *p_md,
+                                 libvlc_media_trickplay_stats_t *p_stats);
+
 /* The following method uses libvlc_media_list_t, however, media_list usage is optional
  * and this is here for convenience */
 #define VLC_FORWARD_DECLARE_OBJECT(a) struct a
@@ -1403,6 +1403,18 @@ LIBVLC_API bool libvlc_media_player_program_scrambled( libvlc_media_player_t *p_
  */
 LIBVLC_API void libvlc_media_player_next_frame( libvlc_media_player_t *p_mi );
 
+/**
+ * Display the previous frame (if supported)
+ *
+ * The frame is displayed immediately if it is still cached by the video
+ * output (cf. the "vout-frame-cache" option), otherwise the media player
+ * seeks precisely to it.
+ *
+ * \param p_mi the media player
+ * \version LibVLC 4.0.0 or later
+ */
+LIBVLC_API void libvlc_media_player_previous_frame( libvlc_media_player_t *p_mi );
+
 /**
  * Navigate through DVD Menu
  *
@@ -546,6 +546,59 @@ VLC_API void libvlc_MetadataCancel( libvlc_int_t *, void * );
 /******************
  * Input stats
  ******************/
+enum input_stats_histogram_type
+{
+    INPUT_STATS_DECODE_TIME,  /**< time spent decoding a frame */
+    INPUT_STATS_RENDER_TIME,  /**< time spent rendering a picture */
+    INPUT_STATS_DISPLAY_LATE, /**< delay of the displayed pictures */
+    INPUT_STATS_AOUT_LATENCY, /**< audio output latency */
+    INPUT_STATS_AOUT_DRIFT,   /**< audio drift, in absolute value */
+    INPUT_STATS_STATIC_FILTER_TIME,      /**< time spent in static filters */
+    INPUT_STATS_INTERACTIVE_FILTER_TIME, /**< time spent in user filters */
+    INPUT_STATS_BLEND_TIME,   /**< time spent blending the subpictures */
+    INPUT_STATS_PREPARE_TIME, /**< time spent preparing the display */
+    INPUT_STATS_DISPLAY_TIME, /**< time spent displaying a picture */
+};
+#define INPUT_STATS_HISTOGRAM_COUNT (INPUT_STATS_DISPLAY_TIME + 1)
+
+#define INPUT_STATS_HISTOGRAM_BUCKETS 24
+
+/**
+ * Log2 histogram of durations
+ *
+ * The bucket 0 counts the durations below 1 us, the bucket i the durations
+ * in [2^(i-1), 2^i) us, and the last bucket all the longer ones.
+ */
+struct input_stats_histogram
+{
+    uint64_t i_count;
+    vlc_tick_t i_total;
+    vlc_tick_t i_max;
+    uint64_t buckets[INPUT_STATS_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Get an upper bound of a percentile of a histogram
+ *
+ * \param percent percentile, from 0 to 100
+ * \return the upper bound of the bucket holding the percentile, or 0 if the
+ * histogram is empty
+ */
+static inline vlc_tick_t
+input_stats_histogram_Percentile(const struct input_stats_histogram *h,
+                                 unsigned percent)
+{
+    uint64_t rank = h->i_count * percent / 100;
+    uint64_t count = 0;
+    for (unsigned i = 0; i < INPUT_STATS_HISTOGRAM_BUCKETS - 1; i++)
+    {
+        count += h->buckets[i];
+        if (count > rank)
+            return VLC_TICK_FROM_US(UINT64_C(1) << i);
+    }
+    return h->i_count > 0 ? h->i_max : 0;
+}
+
 struct input_stats_t
 {
     /* Input */
@@ -572,6 +625,17 @@ struct input_stats_t
     /* Aout */
     uint64_t i_played_abuffers;
     uint64_t i_lost_abuffers;
+
+    /* Trick-play */
+    uint64_t i_trickplay_keyframes; /**< keyframes decoded */
+    uint64_t i_trickplay_skipped;   /**< frames demuxed but not decoded */
+
+    /* Previous frame */
+    uint64_t i_frame_cache_hits;    /**< frames stepped back from the cache */
+    uint64_t i_frame_cache_misses;  /**< frames stepped back by seeking */
+
+    /* Latency histograms, since the start */
+    struct input_stats_histogram histograms[INPUT_STATS_HISTOGRAM_COUNT];
 };
 
 /**
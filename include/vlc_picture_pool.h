@@ -69,8 +69,24 @@ VLC_API picture_pool_t * picture_pool_NewFromFormat(const video_format_t *fmt,
                                                     unsigned count) VLC_USED;
 
 /**
- * Releases a pool created by picture_pool_New()
- * or picture_pool_NewFromFormat().
+ * Creates a picture pool allocating its pictures from the heap on demand.
+ *
+ * Unlike picture_pool_NewFromFormat(), pictures are only allocated the first
+ * time the pool runs out of already allocated free pictures, so that a pool
+ * can be sized for the worst case without paying for it upfront. Allocated
+ * pictures are kept and recycled until the pool is released.
+ *
+ * @param fmt video format of pictures to allocate from the heap
+ * @param count maximum number of pictures in the pool
+ *
+ * @return a pointer to the new pool on success, NULL on error
+ */
+VLC_API picture_pool_t * picture_pool_NewLazy(const video_format_t *fmt,
+                                              unsigned count) VLC_USED;
+
+/**
+ * Releases a pool created by picture_pool_New(),
+ * picture_pool_NewFromFormat() or picture_pool_NewLazy().
  *
  * @note If there are no pending references to the pooled pictures, and the
  * picture_resource_t.pf_destroy callback was not NULL, it will be invoked.
@@ -88,6 +104,7 @@ VLC_API void picture_pool_Release( picture_pool_t * );
  * The picture must be released with picture_Release().
  *
  * @return a picture, or NULL if all pictures in the pool are allocated
+ * (or if a lazily allocated picture could not be created)
  *
  * @note This function is thread-safe.
  */
@@ -104,4 +121,22 @@ VLC_API picture_t * picture_pool_Get( picture_pool_t * ) VLC_USED;
  */
 VLC_API picture_t *picture_pool_Wait(picture_pool_t *) VLC_USED;
 
+/**
+ * Picture pool usage statistics
+ */
+struct picture_pool_stats {
+    unsigned count; /**< number of pictures of the pool */
+    unsigned high_water; /**< maximum number of pictures in use at once */
+    uint64_t waits; /**< number of times picture_pool_Wait() blocked */
+    vlc_tick_t wait_time; /**< total time blocked in picture_pool_Wait() */
+};
+
+/**
+ * Gets the usage statistics of a pool since its creation.
+ *
+ * @note This function is thread-safe.
+ */
+VLC_API void picture_pool_GetStats(picture_pool_t *,
+                                   struct picture_pool_stats *);
+
 #endif /* VLC_PICTURE_POOL_H */
@@ -451,6 +451,18 @@ vlc_player_Resume(vlc_player_t *player);
 VLC_API void
 vlc_player_NextVideoFrame(vlc_player_t *player);
 
+/**
+ * Pause and display the previous video frame
+ *
+ * The previous frame is displayed immediately if it is still in the cache of
+ * the video output (cf. "vout-frame-cache"), otherwise the player seeks
+ * precisely to it.
+ *
+ * @param player locked player instance
+ */
+VLC_API void
+vlc_player_PreviousVideoFrame(vlc_player_t *player);
+
 /**
  * Get the state of the player
  *
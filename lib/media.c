@@ -88,6 +88,22 @@ static_assert(
     ORIENT_RIGHT_BOTTOM == (int) libvlc_video_orient_right_bottom,
     "Mismatch between libvlc_video_orient_t and video_orientation_t" );
 
+static_assert(
+    INPUT_STATS_DECODE_TIME  == (int) libvlc_media_histogram_decode_time &&
+    INPUT_STATS_RENDER_TIME  == (int) libvlc_media_histogram_render_time &&
+    INPUT_STATS_DISPLAY_LATE == (int) libvlc_media_histogram_display_late &&
+    INPUT_STATS_AOUT_LATENCY == (int) libvlc_media_histogram_aout_latency &&
+    INPUT_STATS_AOUT_DRIFT   == (int) libvlc_media_histogram_aout_drift &&
+    INPUT_STATS_STATIC_FILTER_TIME ==
+        (int) libvlc_media_histogram_static_filter_time &&
+    INPUT_STATS_INTERACTIVE_FILTER_TIME ==
+        (int) libvlc_media_histogram_interactive_filter_time &&
+    INPUT_STATS_BLEND_TIME   == (int) libvlc_media_histogram_blend_time &&
+    INPUT_STATS_PREPARE_TIME == (int) libvlc_media_histogram_prepare_time &&
+    INPUT_STATS_DISPLAY_TIME == (int) libvlc_media_histogram_display_time &&
+    INPUT_STATS_HISTOGRAM_BUCKETS == LIBVLC_MEDIA_HISTOGRAM_BUCKETS,
+    "Mismatch between libvlc_media_histogram_t and input_stats_histogram" );
+
 static_assert(
     PROJECTION_MODE_RECTANGULAR             == (int) libvlc_video_projection_rectangular &&
     PROJECTION_MODE_EQUIRECTANGULAR         == (int) libvlc_video_projection_equirectangular &&
@@ -654,6 +670,59 @@ bool libvlc_media_get_stats(libvlc_media_t *p_md,
     return true;
 }
 
+bool libvlc_media_get_histogram(libvlc_media_t *p_md,
+                                libvlc_media_histogram_type_t type,
+                                libvlc_media_histogram_t *p_histogram)
+{
+    input_item_t *item = p_md->p_input_item;
+
+    if( item == NULL || (unsigned)type >= INPUT_STATS_HISTOGRAM_COUNT )
+        return false;
+
+    vlc_mutex_lock( &item->lock );
+
+    input_stats_t *p_itm_stats = item->p_stats;
+    if( p_itm_stats == NULL )
+    {
+        vlc_mutex_unlock( &item->lock );
+        return false;
+    }
+
+    const struct input_stats_histogram *h = &p_itm_stats->histograms[type];
+    p_histogram->i_count = h->i_count;
+    p_histogram->i_total_us = US_FROM_VLC_TICK( h->i_total );
+    p_histogram->i_max_us = US_FROM_VLC_TICK( h->i_max );
+    for( size_t i = 0; i < LIBVLC_MEDIA_HISTOGRAM_BUCKETS; i++ )
+        p_histogram->p_buckets[i] = h->buckets[i];
+
+    vlc_mutex_unlock( &item->lock );
+    return true;
+}
+
+bool libvlc_media_get_trickplay_stats(libvlc_media_t *p_md,
+                                      libvlc_media_trickplay_stats_t *p_stats)
+{
+    input_item_t *item = p_md->p_input_item;
+
+    if( item == NULL )
+        return false;
+
+    vlc_mutex_lock( &item->lock );
+
+    input_stats_t *p_itm_stats = item->p_stats;
+    if( p_itm_stats == NULL )
+    {
+        vlc_mutex_unlock( &item->lock );
+        return false;
+    }
+
+    p_stats->i_keyframes = p_itm_stats->i_trickplay_keyframes;
+    p_stats->i_skipped = p_itm_stats->i_trickplay_skipped;
+
+    vlc_mutex_unlock( &item->lock );
+    return true;
+}
+
 // Get event manager from a media descriptor object
 libvlc_event_manager_t *
 libvlc_media_event_manager( libvlc_media_t * p_md )
@@ -1768,6 +1768,16 @@ void libvlc_media_player_next_frame( libvlc_media_player_t *p_mi )
     vlc_player_Unlock(player);
 }
 
+void libvlc_media_player_previous_frame( libvlc_media_player_t *p_mi )
+{
+    vlc_player_t *player = p_mi->player;
+    vlc_player_Lock(player);
+
+    vlc_player_PreviousVideoFrame(player);
+
+    vlc_player_Unlock(player);
+}
+
 /**
  * Private lookup table to get subpicture alignment flag values corresponding
  * to a libvlc_position_t enumerated value.
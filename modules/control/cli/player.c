@@ -882,6 +882,19 @@ out:
     return ret;
 }
 
+static void PrintHistogram(struct cli_client *cl, const char *name,
+                           const struct input_stats_histogram *h)
+{
+    if (h->i_count == 0)
+        return;
+
+    cli_printf(cl, "| %-17s: %5"PRIu64", %8.3f, %8.3f, %8.3f, %8.3f", name,
+               h->i_count, secf_from_vlc_tick(h->i_total) * 1000.f / h->i_count,
+               secf_from_vlc_tick(input_stats_histogram_Percentile(h, 50)) * 1000.f,
+               secf_from_vlc_tick(input_stats_histogram_Percentile(h, 99)) * 1000.f,
+               secf_from_vlc_tick(h->i_max) * 1000.f);
+}
+
 static int Statistics(struct cli_client *cl, const char *const *args,
                       size_t count, void *data)
 {
@@ -922,6 +935,13 @@ static int Statistics(struct cli_client *cl, const char *const *args,
                    item->p_stats->i_late_pictures);
         cli_printf(cl, _("| frames lost      :    %5"PRIi64),
                    item->p_stats->i_lost_pictures);
+        cli_printf(cl, _("| keyframes scanned:    %5"PRIi64),
+                   item->p_stats->i_trickplay_keyframes);
+        cli_printf(cl, _("| frames skipped   :    %5"PRIi64),
+                   item->p_stats->i_trickplay_skipped);
+        cli_printf(cl, _("| frames stepped back:  %5"PRIi64" cached, %"PRIi64" decoded"),
+                   item->p_stats->i_frame_cache_hits,
+                   item->p_stats->i_frame_cache_misses);
         cli_printf(cl, "|");
 
         /* Audio*/
@@ -934,6 +954,30 @@ static int Statistics(struct cli_client *cl, const char *const *args,
                    item->p_stats->i_lost_abuffers);
         cli_printf(cl, "|");
 
+        /* Latencies */
+        cli_printf(cl, "%s", _("+-[Latencies (ms): count, mean, p50, p99, max]"));
+        PrintHistogram(cl, _("decode time"),
+            &item->p_stats->histograms[INPUT_STATS_DECODE_TIME]);
+        PrintHistogram(cl, _("render time"),
+            &item->p_stats->histograms[INPUT_STATS_RENDER_TIME]);
+        PrintHistogram(cl, _("display late"),
+            &item->p_stats->histograms[INPUT_STATS_DISPLAY_LATE]);
+        PrintHistogram(cl, _("audio latency"),
+            &item->p_stats->histograms[INPUT_STATS_AOUT_LATENCY]);
+        PrintHistogram(cl, _("audio drift"),
+            &item->p_stats->histograms[INPUT_STATS_AOUT_DRIFT]);
+        PrintHistogram(cl, _("static filters"),
+            &item->p_stats->histograms[INPUT_STATS_STATIC_FILTER_TIME]);
+        PrintHistogram(cl, _("user filters"),
+            &item->p_stats->histograms[INPUT_STATS_INTERACTIVE_FILTER_TIME]);
+        PrintHistogram(cl, _("blending"),
+            &item->p_stats->histograms[INPUT_STATS_BLEND_TIME]);
+        PrintHistogram(cl, _("prepare"),
+            &item->p_stats->histograms[INPUT_STATS_PREPARE_TIME]);
+        PrintHistogram(cl, _("display"),
+            &item->p_stats->histograms[INPUT_STATS_DISPLAY_TIME]);
+        cli_printf(cl, "|");
+
         vlc_mutex_unlock(&item->lock);
         cli_printf(cl,  "+----[ end of statistical info ]" );
     }
@@ -104,6 +104,8 @@ static char *FromACP( const char *str )
 #define IGNORE_ES DATA_ES
 #define READ_LENGTH                VLC_TICK_FROM_MS(25)
 #define READ_LENGTH_NONINTERLEAVED VLC_TICK_FROM_MS(1500)
+#define INDEX_CREATE_STEP          4096 /* chunks indexed per step */
+#define INDEX_CREATE_PERIOD        VLC_TICK_FROM_MS(100) /* between steps */
 
 //#define AVI_DEBUG
 
@@ -204,6 +206,17 @@ typedef struct
     uint64_t i_movi_begin;
     uint64_t i_movi_lastchunk_pos;   /* XXX position of last valid chunk */
 
+    /* index created in steps while playing (avi-index) */
+    struct
+    {
+        bool       b_running;
+        uint64_t   i_pos;       /* next chunk to index */
+        uint64_t   i_movi_end;
+        vlc_tick_t i_start;
+        vlc_tick_t i_next_step;
+        unsigned   i_progress;  /* last logged progress, in tenths */
+    } idxcreate;
+
     /* number of streams and information */
     unsigned int i_track;
     avi_track_t  **track;
@@ -236,7 +249,9 @@ static int AVI_PacketNext     ( demux_t * );
 static int AVI_PacketSearch   ( demux_t * );
 
 static void AVI_IndexLoad    ( demux_t * );
-static void AVI_IndexCreate  ( demux_t * );
+static void AVI_IndexCreateStart( demux_t * );
+static int  AVI_IndexCreateStep ( demux_t *, unsigned );
+static void AVI_IndexCreateEnd  ( demux_t * );
 
 static void AVI_ExtractSubtitle( demux_t *, unsigned int i_stream, avi_chunk_list_t *, avi_chunk_STRING_t * );
 static avi_track_t * AVI_GetVideoTrackForXsub( demux_sys_t * );
@@ -245,6 +260,7 @@ static int AVI_SeekSubtitleTrack( demux_sys_t *, avi_track_t * );
 static void AVI_DvHandleAudio( demux_t *, avi_track_t *, block_t * );
 
 static vlc_tick_t  AVI_MovieGetLength( demux_t * );
+static vlc_tick_t  AVI_IndexGetLength( demux_t * );
 
 static void AVI_MetaLoad( demux_t *, avi_chunk_list_t *p_riff, avi_chunk_avih_t *p_avih );
 
@@ -331,6 +347,9 @@ static void Close ( vlc_object_t * p_this )
     demux_t *    p_demux = (demux_t *)p_this;
     demux_sys_t *p_sys = p_demux->p_sys  ;
 
+    if( p_sys->idxcreate.b_running )
+        AVI_IndexCreateEnd( p_demux );
+
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
         if( p_sys->track[i] )
@@ -775,7 +794,7 @@ static int Open( vlc_object_t * p_this )
 aviindex:
         if( p_sys->b_fastseekable )
         {
-            AVI_IndexCreate( p_demux );
+            AVI_IndexCreateStart( p_demux );
         }
         else if( p_sys->b_seekable )
         {
@@ -793,6 +812,12 @@ aviindex:
 
     /* *** movie length in vlc_tick_t *** */
     p_sys->i_length = AVI_MovieGetLength( p_demux );
+    if( p_sys->idxcreate.b_running && p_sys->i_length == 0 )
+    {
+        /* use the header until the index is complete */
+        p_sys->i_length = VLC_TICK_FROM_US( (vlc_tick_t)p_avih->i_totalframes *
+                                            p_avih->i_microsecperframe );
+    }
 
     /* Check the index completeness */
     unsigned int i_idx_totalframes = 0;
@@ -1082,6 +1107,19 @@ static int Demux_Seekable( demux_t *p_demux )
 
     unsigned int i_track_count = 0;
 
+    /* Index in steps, not on every call, as each one seeks away from the
+     * playback position and back */
+    if( p_sys->idxcreate.b_running &&
+        vlc_tick_now() >= p_sys->idxcreate.i_next_step )
+    {
+        if( AVI_IndexCreateStep( p_demux, INDEX_CREATE_STEP ) )
+        {
+            msg_Err( p_demux, "cannot go back to the playback position" );
+            return VLC_DEMUXER_EOF;
+        }
+        p_sys->idxcreate.i_next_step = vlc_tick_now() + INDEX_CREATE_PERIOD;
+    }
+
     /* detect new selected/unselected streams */
     for( unsigned int i = 0; i < p_sys->i_track; i++ )
     {
@@ -1673,6 +1711,18 @@ static int Seek( demux_t *p_demux, vlc_tick_t i_date, double f_ratio, bool b_acc
             msg_Dbg( p_demux, "estimate date %"PRId64, i_date );
         }
 
+        if( p_sys->idxcreate.b_running )
+        {
+            /* stay within the part already indexed */
+            vlc_tick_t i_indexed = AVI_IndexGetLength( p_demux );
+            if( i_date > i_indexed )
+            {
+                msg_Dbg( p_demux, "seek limited to indexed %"PRId64" seconds",
+                         SEC_FROM_VLC_TICK(i_indexed) );
+                i_date = i_indexed;
+            }
+        }
+
         /* */
         vlc_tick_t i_wanted = i_date;
         vlc_tick_t i_start = i_date;
@@ -2443,8 +2493,10 @@ static int64_t avi_index_Append( avi_index_t *p_index, uint64_t *pi_last_pos,
     /* add the entry */
     if( p_index->i_size >= p_index->i_max )
     {
-        if( MAX_INDEX_ENTRIES - INDEX_EXTENT > p_index->i_max )
-            p_index->i_max += INDEX_EXTENT;
+        /* grow geometrically, as entries keep coming while playing */
+        size_t i_extent = __MAX( INDEX_EXTENT, p_index->i_max / 2 );
+        if( MAX_INDEX_ENTRIES - i_extent > p_index->i_max )
+            p_index->i_max += i_extent;
         else
             p_index->i_max = MAX_INDEX_ENTRIES;
         p_index->p_entry = realloc_or_free( p_index->p_entry,
@@ -2749,19 +2801,13 @@ static void AVI_IndexLoad( demux_t *p_demux )
     }
 }
 
-static void AVI_IndexCreate( demux_t *p_demux )
+static void AVI_IndexCreateStart( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
     avi_chunk_list_t *p_riff;
     avi_chunk_list_t *p_movi;
 
-    unsigned int i_stream;
-    uint32_t i_movi_end;
-
-    vlc_tick_t i_dialog_update;
-    vlc_dialog_id *p_dialog_id = NULL;
-
     p_riff = AVI_ChunkFind( &p_sys->ck_root, AVIFOURCC_RIFF, 0, true );
     p_movi = AVI_ChunkFind( p_riff, AVIFOURCC_movi, 0, true );
 
@@ -2771,46 +2817,89 @@ static void AVI_IndexCreate( demux_t *p_demux )
         return;
     }
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-        avi_index_Init( &p_sys->track[i_stream]->idx );
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_index_Clean( &p_sys->track[i]->idx );
+        avi_index_Init( &p_sys->track[i]->idx );
+    }
+    /* Everything up to i_movi_lastchunk_pos is indexed, both by the
+     * creation steps and by the playback when it runs out of index */
+    p_sys->i_movi_lastchunk_pos = 0;
+    /* Don't let a lazy index load replace the one being created */
+    p_sys->b_indexloaded = true;
+
+    p_sys->idxcreate.i_pos = p_movi->i_chunk_pos + 12;
+    p_sys->idxcreate.i_movi_end =
+        __MIN( (uint32_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
+               stream_Size( p_demux->s ) );
+    p_sys->idxcreate.i_start = vlc_tick_now();
+    p_sys->idxcreate.i_next_step = p_sys->idxcreate.i_start;
+    p_sys->idxcreate.b_running = true;
 
-    i_movi_end = __MIN( (uint32_t)(p_movi->i_chunk_pos + p_movi->i_chunk_size),
-                        stream_Size( p_demux->s ) );
+    p_sys->idxcreate.i_progress = 0;
 
-    vlc_stream_Seek( p_demux->s, p_movi->i_chunk_pos + 12 );
-    msg_Warn( p_demux, "creating index from LIST-movi, will take time !" );
+    msg_Warn( p_demux, "creating index from LIST-movi while playing" );
+}
 
+static void AVI_IndexCreateEnd( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
 
-    /* Only show dialog if AVI is > 10MB */
-    i_dialog_update = vlc_tick_now();
-    if( stream_Size( p_demux->s ) > 10000000 )
+    p_sys->idxcreate.b_running = false;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
     {
-        p_dialog_id =
-            vlc_dialog_display_progress( p_demux, false, 0.0, _("Cancel"),
-                                         _("Broken or missing AVI Index"),
-                                         _("Fixing AVI Index...") );
+        msg_Dbg( p_demux, "stream[%u] created %"PRIu32" index entries",
+                 i, p_sys->track[i]->idx.i_size );
     }
+    msg_Dbg( p_demux, "index created in %"PRId64" ms",
+             MS_FROM_VLC_TICK( vlc_tick_now() - p_sys->idxcreate.i_start ) );
 
-    for( ;; )
-    {
-        avi_packet_t pk;
+    vlc_tick_t i_length = AVI_MovieGetLength( p_demux );
+    if( i_length > 0 )
+        p_sys->i_length = i_length;
+}
 
-        /* Don't update/check dialog too often */
-        if( p_dialog_id != NULL && vlc_tick_now() - i_dialog_update > VLC_TICK_FROM_MS(100) )
-        {
-            if( vlc_dialog_is_cancelled( p_demux, p_dialog_id ) )
-                break;
+/* Index at most i_max_chunks chunks from where the previous step stopped,
+ * or from where the playback stopped if it went further.
+ * Returns an error if the stream cannot be seeked back to the playback
+ * position */
+static int AVI_IndexCreateStep( demux_t *p_demux, unsigned i_max_chunks )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
 
-            double f_current = vlc_stream_Tell( p_demux->s );
-            double f_size    = stream_Size( p_demux->s );
-            double f_pos     = f_current / f_size;
-            vlc_dialog_update_progress( p_demux, p_dialog_id, f_pos );
+    const uint64_t i_pos_backup = vlc_stream_Tell( p_demux->s );
+    uint64_t i_pos = p_sys->idxcreate.i_pos;
+    bool b_skip = false;
 
-            i_dialog_update = vlc_tick_now();
+    /* Playback goes on while indexing, so there is no modal progress
+     * dialog: only log every tenth of the movi list */
+    if( p_sys->idxcreate.i_movi_end > 0 )
+    {
+        unsigned i_progress = i_pos * 10 / p_sys->idxcreate.i_movi_end;
+        if( i_progress > p_sys->idxcreate.i_progress )
+        {
+            p_sys->idxcreate.i_progress = i_progress;
+            msg_Dbg( p_demux, "index creation: %u%%", 10 * i_progress );
         }
+    }
+
+    if( p_sys->i_movi_lastchunk_pos >= i_pos )
+    {
+        i_pos = p_sys->i_movi_lastchunk_pos;
+        b_skip = true;
+    }
+
+    if( vlc_stream_Seek( p_demux->s, i_pos ) ||
+        ( b_skip && AVI_PacketNext( p_demux ) ) )
+        goto end;
+
+    for( unsigned i_chunk = 0; i_chunk < i_max_chunks; i_chunk++ )
+    {
+        avi_packet_t pk;
 
         if( AVI_PacketGetHeader( p_demux, &pk ) )
-            break;
+            goto end;
 
         if( pk.i_stream < p_sys->i_track &&
             pk.i_cat == p_sys->track[pk.i_stream]->fmt.i_cat )
@@ -2838,10 +2927,10 @@ static void AVI_IndexCreate( demux_t *p_demux )
                     msg_Dbg( p_demux, "looking for new RIFF chunk" );
                     if( !p_sysx || vlc_stream_Seek( p_demux->s,
                                          p_sysx->i_chunk_pos + 24 ) )
-                        goto print_stat;
+                        goto end;
                     break;
                 }
-                goto print_stat;
+                goto end;
 
             case AVIFOURCC_RIFF:
                     msg_Dbg( p_demux, "new RIFF chunk found" );
@@ -2856,27 +2945,24 @@ static void AVI_IndexCreate( demux_t *p_demux )
                 if( AVI_PacketSearch( p_demux ) )
                 {
                     msg_Warn( p_demux, "lost sync, abord index creation" );
-                    goto print_stat;
+                    goto end;
                 }
             }
         }
 
-        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= i_movi_end ) ||
+        if( ( !p_sys->b_odml && pk.i_pos + pk.i_size >= p_sys->idxcreate.i_movi_end ) ||
             AVI_PacketNext( p_demux ) )
         {
-            break;
+            goto end;
         }
     }
 
-print_stat:
-    if( p_dialog_id != NULL )
-        vlc_dialog_release( p_demux, p_dialog_id );
+    p_sys->idxcreate.i_pos = vlc_stream_Tell( p_demux->s );
+    return vlc_stream_Seek( p_demux->s, i_pos_backup );
 
-    for( i_stream = 0; i_stream < p_sys->i_track; i_stream++ )
-    {
-        msg_Dbg( p_demux, "stream[%d] creating %d index entries",
-                i_stream, p_sys->track[i_stream]->idx.i_size );
-    }
+end:
+    AVI_IndexCreateEnd( p_demux );
+    return vlc_stream_Seek( p_demux->s, i_pos_backup );
 }
 
 /* */
@@ -3221,6 +3307,40 @@ static int AVI_TrackStopFinishedStreams( demux_t *p_demux )
 /****************************************************************************
  * AVI_MovieGetLength give max streams length in ticks
  ****************************************************************************/
+static vlc_tick_t AVI_TrackGetIndexLength( avi_track_t *tk )
+{
+    if( tk->idx.i_size < 1 )
+        return 0;
+
+    if( tk->i_samplesize )
+    {
+        return AVI_GetDPTS( tk,
+                            tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal +
+                                tk->idx.p_entry[tk->idx.i_size-1].i_length );
+    }
+    return AVI_GetDPTS( tk, tk->idx.i_size );
+}
+
+/* duration covered by the index of every selected track */
+static vlc_tick_t AVI_IndexGetLength( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    vlc_tick_t i_length = VLC_TICK_MAX;
+
+    for( unsigned i = 0; i < p_sys->i_track; i++ )
+    {
+        avi_track_t *tk = p_sys->track[i];
+
+        if( !tk->b_activated ||
+            ( tk->fmt.i_cat != AUDIO_ES && tk->fmt.i_cat != VIDEO_ES ) )
+            continue;
+
+        i_length = __MIN( i_length, AVI_TrackGetIndexLength( tk ) );
+    }
+
+    return i_length == VLC_TICK_MAX ? 0 : i_length;
+}
+
 static vlc_tick_t  AVI_MovieGetLength( demux_t *p_demux )
 {
     demux_sys_t  *p_sys = p_demux->p_sys;
@@ -3238,16 +3358,7 @@ static vlc_tick_t  AVI_MovieGetLength( demux_t *p_demux )
             continue;
         }
 
-        if( tk->i_samplesize )
-        {
-            i_length = AVI_GetDPTS( tk,
-                                    tk->idx.p_entry[tk->idx.i_size-1].i_lengthtotal +
-                                        tk->idx.p_entry[tk->idx.i_size-1].i_length );
-        }
-        else
-        {
-            i_length = AVI_GetDPTS( tk, tk->idx.i_size );
-        }
+        i_length = AVI_TrackGetIndexLength( tk );
 
         msg_Dbg( p_demux,
                  "stream[%d] length:%"PRId64" (based on index)",
@@ -633,6 +633,17 @@ bool matroska_segment_c::Preload( )
                 PreloadClusters        ( cluster_->GetElementPosition() );
                 es.I_O().setFilePointer( cluster_->GetElementPosition() );
             }
+            else if( !b_cues && sys.b_seekable && es.I_O().GetStream()->psz_url &&
+                     var_InheritBool( &sys.demuxer, "mkv-background-index" ) )
+            {
+                stream_t *s = es.I_O().GetStream();
+                _indexer.reset( new ClusterIndexer( &sys.demuxer, s, i_timescale,
+                        cluster_->GetElementPosition(),
+                        segment->IsFiniteSize() ? segment->GetEndPosition()
+                                                : std::numeric_limits<uint64_t>::max() ) );
+                if( !_indexer->Start() )
+                    _indexer.reset();
+            }
             msg_Dbg( &sys.demuxer, "|   + Cluster" );
 
 
@@ -837,6 +848,9 @@ bool matroska_segment_c::Seek( demux_t &demuxer, vlc_tick_t i_absolute_mk_date,
 
     // find appropriate seekpoints //
 
+    if( _indexer )
+        _indexer->Collect( _seeker );
+
     try {
         seekpoints = _seeker.get_seekpoints( *this, i_mk_date, priority, selected_tracks );
     }
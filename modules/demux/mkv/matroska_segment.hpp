@@ -27,6 +27,7 @@
 #include "demux.hpp"
 #include "mkv.hpp"
 #include "matroska_segment_seeker.hpp"
+#include "matroska_segment_indexer.hpp"
 #include <vector>
 #include <string>
 
@@ -176,6 +177,7 @@ private:
     void EnsureDuration();
 
     SegmentSeeker _seeker;
+    std::unique_ptr<ClusterIndexer> _indexer;
 
     friend SegmentSeeker;
 };
@@ -0,0 +1,302 @@
+/*****************************************************************************
+ * matroska_segment_indexer.cpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "matroska_segment_indexer.hpp"
+
+#include <vlc_access.h>
+#include <vlc_stream.h>
+
+/* Pause after each batch of clusters, so that the indexer does not
+ * compete with the playback reads */
+#define INDEX_BATCH_CLUSTERS 32
+#define INDEX_BATCH_DELAY    VLC_TICK_FROM_MS(20)
+
+namespace {
+    /* The indexer only reads element headers, without libebml, so that it
+     * does not share any parsing state with the demuxer thread. */
+    enum {
+        ID_CLUSTER           = 0x1F43B675,
+        ID_CLUSTER_TIMESTAMP = 0xE7,
+        ID_CRC32             = 0xBF,
+        ID_VOID              = 0xEC,
+        ID_SEEKHEAD          = 0x114D9B74,
+        ID_INFO              = 0x1549A966,
+        ID_TRACKS            = 0x1654AE6B,
+        ID_CUES              = 0x1C53BB6B,
+        ID_CHAPTERS          = 0x1043A770,
+        ID_ATTACHMENTS       = 0x1941A469,
+        ID_TAGS              = 0x1254C367,
+    };
+
+    /* Reads an EBML variable size integer, keeping the length marker for
+     * element IDs */
+    bool ReadVint( stream_t *s, uint64_t *pi_value, bool b_id,
+                   bool *pb_unknown = NULL )
+    {
+        uint8_t p_buf[8];
+        if( vlc_stream_Read( s, p_buf, 1 ) != 1 )
+            return false;
+
+        unsigned i_len = 1;
+        uint8_t i_mask = 0x80;
+        while( i_len <= 8 && !( p_buf[0] & i_mask ) )
+        {
+            i_mask >>= 1;
+            i_len++;
+        }
+        if( i_len > ( b_id ? 4 : 8 ) )
+            return false;
+
+        if( i_len > 1 &&
+            vlc_stream_Read( s, &p_buf[1], i_len - 1 ) != (ssize_t)( i_len - 1 ) )
+            return false;
+
+        const uint8_t i_first = p_buf[0] & ( i_mask - 1 );
+        uint64_t i_value = b_id ? p_buf[0] : i_first;
+        bool b_all_ones = i_first == i_mask - 1;
+        for( unsigned i = 1; i < i_len; i++ )
+        {
+            i_value = ( i_value << 8 ) | p_buf[i];
+            b_all_ones &= p_buf[i] == 0xFF;
+        }
+
+        if( pb_unknown )
+            *pb_unknown = !b_id && b_all_ones;
+        *pi_value = i_value;
+        return true;
+    }
+
+    bool IsSkippable( uint64_t i_id )
+    {
+        switch( i_id )
+        {
+            case ID_CRC32:
+            case ID_VOID:
+            case ID_SEEKHEAD:
+            case ID_INFO:
+            case ID_TRACKS:
+            case ID_CUES:
+            case ID_CHAPTERS:
+            case ID_ATTACHMENTS:
+            case ID_TAGS:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+namespace mkv {
+
+ClusterIndexer::ClusterIndexer( demux_t *p_demux_, stream_t *source,
+                                uint64_t i_timescale_, fptr_t i_start_, fptr_t i_end_ )
+    : p_demux( p_demux_ )
+    , psz_url( NULL )
+    , i_source_size( 0 )
+    , i_timescale( i_timescale_ )
+    , i_start( i_start_ )
+    , i_end( i_end_ )
+    , p_interrupt( NULL )
+    , b_running( false )
+    , b_abort( false )
+    , i_total( 0 )
+{
+    vlc_mutex_init( &lock );
+
+    /* the size is compared with the file, to detect stream filters changing
+     * the content, like decompressors */
+    if( source->psz_url != NULL &&
+        !strncasecmp( source->psz_url, "file://", 7 ) &&
+        vlc_stream_GetSize( source, &i_source_size ) == VLC_SUCCESS )
+        psz_url = strdup( source->psz_url );
+}
+
+ClusterIndexer::~ClusterIndexer()
+{
+    Stop();
+    free( psz_url );
+}
+
+bool ClusterIndexer::Start()
+{
+    if( b_running || psz_url == NULL )
+        return b_running;
+
+    p_interrupt = vlc_interrupt_create();
+    if( unlikely(p_interrupt == NULL) )
+        return false;
+
+    b_abort = false;
+    b_running = !vlc_clone( &thread, Run, this );
+    if( !b_running )
+    {
+        vlc_interrupt_destroy( p_interrupt );
+        p_interrupt = NULL;
+    }
+    return b_running;
+}
+
+void ClusterIndexer::Stop()
+{
+    if( !b_running )
+        return;
+
+    vlc_mutex_lock( &lock );
+    b_abort = true;
+    vlc_mutex_unlock( &lock );
+    vlc_interrupt_kill( p_interrupt );
+
+    vlc_join( thread, NULL );
+    vlc_interrupt_destroy( p_interrupt );
+    p_interrupt = NULL;
+    b_running = false;
+}
+
+void ClusterIndexer::Collect( SegmentSeeker & seeker )
+{
+    std::vector<SegmentSeeker::Cluster> clusters;
+    {
+        vlc_mutex_locker guard( &lock );
+        clusters.swap( found );
+    }
+
+    for( std::vector<SegmentSeeker::Cluster>::const_iterator it = clusters.begin();
+         it != clusters.end(); ++it )
+        seeker.add_cluster( *it );
+}
+
+void *ClusterIndexer::Run( void *data )
+{
+    static_cast<ClusterIndexer*>( data )->Run();
+    return NULL;
+}
+
+void ClusterIndexer::Run()
+{
+    vlc_thread_set_name( "vlc-mkv-index" );
+    vlc_interrupt_set( p_interrupt );
+
+    stream_t *s = vlc_access_NewMRL( VLC_OBJECT(p_demux), psz_url );
+    if( s == NULL )
+    {
+        msg_Warn( p_demux, "cannot open %s for background indexing", psz_url );
+        return;
+    }
+
+    uint64_t i_size;
+    if( vlc_stream_GetSize( s, &i_size ) != VLC_SUCCESS || i_size != i_source_size )
+    {
+        msg_Dbg( p_demux, "filtered stream, no background indexing" );
+        vlc_stream_Delete( s );
+        return;
+    }
+
+    fptr_t i_pos = i_start;
+    size_t i_batch = 0;
+    while( i_pos < i_end && vlc_stream_Seek( s, i_pos ) == VLC_SUCCESS )
+    {
+        {
+            vlc_mutex_locker guard( &lock );
+            if( b_abort )
+                break;
+        }
+
+        if( i_batch == INDEX_BATCH_CLUSTERS )
+        {
+            i_batch = 0;
+            if( vlc_msleep_i11e( INDEX_BATCH_DELAY ) )
+                break; /* stopped */
+        }
+
+        uint64_t i_id, i_size;
+        bool b_unknown_size;
+        if( !ReadVint( s, &i_id, true ) ||
+            !ReadVint( s, &i_size, false, &b_unknown_size ) ||
+            b_unknown_size /* cannot skip it */ )
+            break;
+
+        const fptr_t i_data = vlc_stream_Tell( s );
+        if( i_id == ID_CLUSTER )
+        {
+            if( !IndexCluster( s, i_pos, i_data - i_pos + i_size ) )
+                break;
+            i_batch++;
+        }
+        else if( !IsSkippable( i_id ) )
+            break;
+
+        i_pos = i_data + i_size;
+    }
+
+    vlc_stream_Delete( s );
+
+    msg_Dbg( p_demux, "background indexing found %zu clusters, stopped at %" PRIu64,
+             i_total, i_pos );
+}
+
+bool ClusterIndexer::IndexCluster( stream_t *s, fptr_t i_pos, uint64_t i_size )
+{
+    const fptr_t i_cluster_end = i_pos + i_size;
+
+    /* the timestamp is expected before any block */
+    while( vlc_stream_Tell( s ) < i_cluster_end )
+    {
+        uint64_t i_id, i_child_size;
+        bool b_unknown_size;
+        if( !ReadVint( s, &i_id, true ) ||
+            !ReadVint( s, &i_child_size, false, &b_unknown_size ) ||
+            b_unknown_size )
+            return false;
+
+        if( i_id == ID_CLUSTER_TIMESTAMP )
+        {
+            uint8_t p_buf[8];
+            if( i_child_size > sizeof(p_buf) ||
+                vlc_stream_Read( s, p_buf, i_child_size ) != (ssize_t) i_child_size )
+                return false;
+
+            uint64_t i_timestamp = 0;
+            for( uint64_t i = 0; i < i_child_size; i++ )
+                i_timestamp = ( i_timestamp << 8 ) | p_buf[i];
+
+            SegmentSeeker::Cluster cinfo = {
+                /* fpos     */ i_pos,
+                /* pts      */ vlc_tick_t( VLC_TICK_FROM_NS( i_timestamp * i_timescale ) ),
+                /* duration */ vlc_tick_t( -1 ),
+                /* size     */ i_size,
+            };
+
+            vlc_mutex_locker guard( &lock );
+            found.push_back( cinfo );
+            i_total++;
+            return true;
+        }
+
+        if( i_id != ID_CRC32 && i_id != ID_VOID )
+            return true; /* no usable timestamp, leave it to the demuxer */
+
+        if( vlc_stream_Seek( s, vlc_stream_Tell( s ) + i_child_size ) != VLC_SUCCESS )
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
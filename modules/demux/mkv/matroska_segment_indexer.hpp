@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * matroska_segment_indexer.hpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef MKV_MATROSKA_SEGMENT_INDEXER_HPP_
+#define MKV_MATROSKA_SEGMENT_INDEXER_HPP_
+
+#include "mkv.hpp"
+#include "matroska_segment_seeker.hpp"
+
+#include <vlc_threads.h>
+#include <vlc_interrupt.h>
+
+#include <vector>
+
+namespace mkv {
+
+/* Walks the clusters of a segment from a separate stream and thread,
+ * ahead of playback, so that seeking in files without cues only needs
+ * to scan the cluster containing the target.
+ * Only local files are indexed, read directly from the file access, as
+ * a second connection or another pass through the stream filters of the
+ * demuxer would compete with playback. */
+class ClusterIndexer
+{
+    public:
+        typedef SegmentSeeker::fptr_t fptr_t;
+
+        ClusterIndexer( demux_t *, stream_t *source, uint64_t i_timescale,
+                        fptr_t i_start, fptr_t i_end );
+        ~ClusterIndexer();
+
+        bool Start();
+        void Stop();
+
+        /* move the clusters found so far into the seeker */
+        void Collect( SegmentSeeker & );
+
+    private:
+        static void *Run( void * );
+        void Run();
+        bool IndexCluster( stream_t *, fptr_t i_pos, uint64_t i_size );
+
+        demux_t           *p_demux;
+        char              *psz_url; /* NULL if not a local file */
+        uint64_t           i_source_size;
+        const uint64_t     i_timescale;
+        const fptr_t       i_start;
+        const fptr_t       i_end;
+
+        vlc_thread_t       thread;
+        vlc_interrupt_t   *p_interrupt;
+        bool               b_running;
+
+        vlc_mutex_t        lock;
+        bool               b_abort;
+        std::vector<SegmentSeeker::Cluster> found;
+        size_t             i_total;
+};
+
+} // namespace
+
+#endif /* include-guard */
@@ -82,6 +82,11 @@ vlc_module_begin ()
             N_("Preload clusters"),
             N_("Find all cluster positions by jumping cluster-to-cluster before playback") )
 
+    add_bool( "mkv-background-index", false,
+            N_("Index clusters in the background"),
+            N_("Find all cluster positions from a separate thread during playback, "
+               "to seek faster in local files without cues") )
+
     add_shortcut( "mka", "mkv" )
     add_file_extension("mka")
     add_file_extension("mks")
@@ -100,6 +100,19 @@ static int   DemuxRef( demux_t *p_demux ){ (void)p_demux; return 0;}
 static int   DemuxFrag( demux_t * );
 static int   Control ( demux_t *, int, va_list );
 
+#define MP4_READAHEAD_SLOTS 4                /* windows kept, ie. tracks areas */
+#define MP4_READAHEAD_MAX   (2 * 1024 * 1024) /* largest coalesced read */
+#define MP4_READAHEAD_GAP   (64 * 1024)       /* largest hole read through */
+
+typedef struct
+{
+    uint64_t i_pos;
+    size_t   i_size;
+    size_t   i_alloc;
+    uint8_t *p_buffer;
+    uint64_t i_last_use;
+} mp4_readahead_slot_t;
+
 typedef struct
 {
     MP4_Box_t    *p_root;      /* container for the whole file */
@@ -162,6 +175,19 @@ typedef struct
 
     ssize_t i_attachments;
     input_attachment_t **pp_attachments;
+
+    /* Coalesced reads of the upcoming samples of all tracks,
+     * for slow seeking streams and badly interleaved files */
+    struct
+    {
+        bool     b_enabled;
+        uint64_t i_clock;
+        mp4_readahead_slot_t slot[MP4_READAHEAD_SLOTS];
+        /* stats */
+        unsigned i_reads;
+        unsigned i_seeks;
+        unsigned i_hits;
+    } readahead;
 } demux_sys_t;
 
 #define DEMUX_INCREMENT VLC_TICK_FROM_MS(250) /* How far the pcr will go, each round */
@@ -187,6 +213,7 @@ static void MP4_TrackSelect  ( demux_t *, mp4_track_t *, bool );
 static int  MP4_TrackSeek   ( demux_t *, mp4_track_t *, vlc_tick_t );
 
 static uint64_t MP4_TrackGetPos    ( mp4_track_t * );
+static uint64_t MP4_ChunkGetSamplePos( const mp4_track_t *, uint32_t, uint32_t );
 static uint32_t MP4_TrackGetReadSize( mp4_track_t *, uint32_t * );
 static int      MP4_TrackNextSample( demux_t *, mp4_track_t *, uint32_t );
 static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, vlc_tick_t );
@@ -469,31 +496,14 @@ static es_out_id_t * MP4_CreateES( es_out_t *out, const es_format_t *p_fmt,
     return p_es;
 }
 
-static int MP4_ChunkAllocEntries( size_t entries, uint32_t *smallbuf,
-                                  uint32_t **dst0, uint32_t **dst1 )
-{
-    uint32_t *buf;
-
-    if( entries > MP4_CHUNK_SMALLBUF_ENTRIES )
-    {
-        buf = calloc( entries, sizeof( buf[0] ) * 2 );
-        if( unlikely(buf == NULL) )
-            return VLC_ENOMEM;
-    }
-    else buf = smallbuf;
-
-    *dst0 = buf;
-    *dst1 = &buf[entries];
-
-    return VLC_SUCCESS;
-}
-
-static void MP4_ChunkDestroy( mp4_chunk_t *ck )
+/* Samples of the stts/ctts run i_run that belong to a chunk, i_skip being
+ * the run samples already used by previous chunks and i_left the chunk
+ * samples not yet accounted for */
+static inline uint32_t MP4_ChunkRunSamples( const uint32_t *pi_run_count,
+                                            uint32_t i_run, uint32_t i_skip,
+                                            uint32_t i_left )
 {
-    if( ck->p_sample_count_dts != ck->small_dts_buf )
-        free( ck->p_sample_count_dts );
-    if( ck->p_sample_count_pts != ck->small_pts_buf )
-        free( ck->p_sample_count_pts );
+    return __MIN( pi_run_count[i_run] - i_skip, i_left );
 }
 
 static stime_t MP4_MapTrackTimeIntoTimeline( const mp4_track_t *p_track,
@@ -542,42 +552,57 @@ static stime_t MP4_MapMediaTimelineToTrackTime( const mp4_track_t *p_track,
     return i_time;
 }
 
-static stime_t MP4_ChunkGetSampleDTS( const mp4_chunk_t *p_chunk,
+static stime_t MP4_ChunkGetSampleDTS( const mp4_track_t *p_track,
+                                      const mp4_chunk_t *p_chunk,
                                       uint32_t i_sample )
 {
-    uint32_t i_index = 0;
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
     stime_t sdts = p_chunk->i_first_dts;
-    while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
+    uint32_t i_left = p_chunk->i_sample_count;
+    for( uint32_t i = 0; i_sample > 0 && i < p_chunk->i_entries_dts; i++ )
     {
-        if( i_sample > p_chunk->p_sample_count_dts[i_index] )
+        const uint32_t i_run = p_chunk->i_index_dts + i;
+        const uint32_t i_count =
+            MP4_ChunkRunSamples( stts->pi_sample_count, i_run,
+                                 i ? 0 : p_chunk->i_skip_dts, i_left );
+        if( i_sample > i_count )
         {
-            sdts += (stime_t)p_chunk->p_sample_count_dts[i_index] *
-                p_chunk->p_sample_delta_dts[i_index];
-            i_sample -= p_chunk->p_sample_count_dts[i_index++];
+            sdts += (stime_t)i_count * stts->pi_sample_delta[i_run];
+            i_sample -= i_count;
+            i_left -= i_count;
         }
         else
         {
-            sdts += (stime_t)i_sample * p_chunk->p_sample_delta_dts[i_index];
+            sdts += (stime_t)i_sample * stts->pi_sample_delta[i_run];
             break;
         }
     }
     return sdts;
 }
 
-static bool MP4_ChunkGetSampleCTSDelta( const mp4_chunk_t *p_chunk,
+static bool MP4_ChunkGetSampleCTSDelta( const mp4_track_t *p_track,
+                                        const mp4_chunk_t *p_chunk,
                                         uint32_t i_sample, stime_t *pi_delta )
 {
-    if( p_chunk->p_sample_count_pts && p_chunk->p_sample_offset_pts )
+    const MP4_Box_data_ctts_t *ctts = p_track->p_ctts;
+    if( ctts == NULL )
+        return false;
+
+    uint32_t i_left = p_chunk->i_sample_count;
+    for( uint32_t i = 0; i < p_chunk->i_entries_pts; i++ )
     {
-        for( uint32_t i_index = 0; i_index < p_chunk->i_entries_pts ; i_index++ )
+        const uint32_t i_run = p_chunk->i_index_pts + i;
+        const uint32_t i_count =
+            MP4_ChunkRunSamples( ctts->pi_sample_count, i_run,
+                                 i ? 0 : p_chunk->i_skip_pts, i_left );
+        if( i_sample < i_count )
         {
-            if( i_sample < p_chunk->p_sample_count_pts[i_index] )
-            {
-                *pi_delta = p_chunk->p_sample_offset_pts[i_index];
-                return true;
-            }
-            i_sample -= p_chunk->p_sample_count_pts[i_index];
+            stime_t i_ctsdelta = ctts->pi_sample_offset[i_run] + p_track->i_cts_shift;
+            *pi_delta = i_ctsdelta < 0 ? 0 : i_ctsdelta; /* should not be < 0 */
+            return true;
         }
+        i_sample -= i_count;
+        i_left -= i_count;
     }
     return false;
 }
@@ -618,21 +643,28 @@ static vlc_tick_t MP4_TrackGetDTSPTS( demux_t *p_demux, const mp4_track_t *p_tra
     return i_dts;
 }
 
-static stime_t MP4_GetChunkSamplesDuration( const mp4_chunk_t *p_chunk,
+static stime_t MP4_GetChunkSamplesDuration( const mp4_track_t *p_track,
+                                            const mp4_chunk_t *p_chunk,
                                             uint32_t i_start_sample,
                                             uint32_t i_nb_samples )
 {
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
     stime_t i_duration = 0;
 
     /* Forward to right index, and set remaining count in that index */
     uint32_t i_index = 0;
     uint32_t i_remain = 0;
+    uint32_t i_left = p_chunk->i_sample_count;
     for( uint32_t i = p_chunk->i_sample_first;
          i<i_start_sample && i_index < p_chunk->i_entries_dts; )
     {
-        if( i_start_sample - i >= p_chunk->p_sample_count_dts[i_index] )
+        const uint32_t i_count =
+            MP4_ChunkRunSamples( stts->pi_sample_count, p_chunk->i_index_dts + i_index,
+                                 i_index ? 0 : p_chunk->i_skip_dts, i_left );
+        if( i_start_sample - i >= i_count )
         {
-            i += p_chunk->p_sample_count_dts[i_index];
+            i += i_count;
+            i_left -= i_count;
             i_index++;
         }
         else
@@ -645,17 +677,22 @@ static stime_t MP4_GetChunkSamplesDuration( const mp4_chunk_t *p_chunk,
     /* Compute total duration from all samples from index */
     while( i_nb_samples > 0 && i_index < p_chunk->i_entries_dts )
     {
-        if( i_nb_samples >= p_chunk->p_sample_count_dts[i_index] - i_remain )
+        const uint32_t i_run = p_chunk->i_index_dts + i_index;
+        const uint32_t i_count =
+            MP4_ChunkRunSamples( stts->pi_sample_count, i_run,
+                                 i_index ? 0 : p_chunk->i_skip_dts, i_left );
+        if( i_nb_samples >= i_count - i_remain )
         {
-            i_duration += (p_chunk->p_sample_count_dts[i_index] - i_remain) *
-                          (int64_t) p_chunk->p_sample_delta_dts[i_index];
-            i_nb_samples -= (p_chunk->p_sample_count_dts[i_index] - i_remain);
+            i_duration += (i_count - i_remain) *
+                          (int64_t) stts->pi_sample_delta[i_run];
+            i_nb_samples -= (i_count - i_remain);
+            i_left -= i_count;
             i_index++;
             i_remain = 0;
         }
         else
         {
-            i_duration += (stime_t)i_nb_samples * p_chunk->p_sample_delta_dts[i_index];
+            i_duration += (stime_t)i_nb_samples * stts->pi_sample_delta[i_run];
             break;
         }
     }
@@ -666,7 +703,8 @@ static stime_t MP4_GetChunkSamplesDuration( const mp4_chunk_t *p_chunk,
 static inline vlc_tick_t MP4_GetSamplesDuration( const mp4_track_t *p_track,
                                                  uint32_t i_nb_samples )
 {
-    stime_t i_duration = MP4_GetChunkSamplesDuration( &p_track->chunk[p_track->i_chunk],
+    stime_t i_duration = MP4_GetChunkSamplesDuration( p_track,
+                                                      &p_track->chunk[p_track->i_chunk],
                                                       p_track->i_sample,
                                                       i_nb_samples );
     return MP4_rescale_mtime( i_duration, p_track->i_timescale );
@@ -1012,6 +1050,7 @@ static int Open( vlc_object_t * p_this )
     vlc_stream_Control( p_demux->s, STREAM_CAN_SEEK, &p_sys->b_seekable );
     if( p_sys->b_seekable )
         vlc_stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &p_sys->b_fastseekable );
+    p_sys->readahead.b_enabled = p_sys->b_seekable && !p_sys->b_fastseekable;
 
     /*Set exported functions */
     p_demux->pf_demux = Demux;
@@ -1581,6 +1620,126 @@ static uint64_t OverflowCheck( demux_t *p_demux, mp4_track_t *tk,
     return i_samplessize;
 }
 
+/*****************************************************************************
+ * Read ahead: on slow seeking streams, instead of reading one sample at a
+ * time and seeking back and forth between the tracks areas, read at once the
+ * byte range covering the next chunks of all selected tracks, and serve the
+ * following samples from memory. A few windows are kept so that badly
+ * interleaved files (one area per track) do not evict each other.
+ *****************************************************************************/
+static uint64_t ReadAheadPlan( demux_t *p_demux, uint64_t i_pos, uint64_t i_end )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint64_t i_max = i_pos + MP4_READAHEAD_MAX;
+    bool b_extended;
+
+    do
+    {
+        b_extended = false;
+        for( unsigned i_track = 0; i_track < p_sys->i_tracks; i_track++ )
+        {
+            mp4_track_t *tk = &p_sys->track[i_track];
+            if( !tk->b_ok || !tk->b_selected || MP4_isMetadata( tk ) ||
+                (tk->i_use_flags & USEAS_CHAPTERS) ||
+                tk->i_sample >= tk->i_sample_count )
+                continue;
+
+            /* chunks of a track are expected to be in file order */
+            for( uint32_t i_chunk = tk->i_chunk; i_chunk < tk->i_chunk_count; i_chunk++ )
+            {
+                const mp4_chunk_t *ck = &tk->chunk[i_chunk];
+                const uint64_t i_start = ( i_chunk == tk->i_chunk )
+                                       ? MP4_TrackGetPos( tk ) : ck->i_offset;
+                if( i_start < i_pos || i_start > i_end + MP4_READAHEAD_GAP )
+                    break;
+
+                uint32_t i_next = ck->i_sample_first + ck->i_sample_count;
+                if( i_next > tk->i_sample_count )
+                    i_next = tk->i_sample_count;
+                uint64_t i_chunk_end = MP4_ChunkGetSamplePos( tk, i_chunk, i_next );
+                if( i_chunk_end > i_max )
+                    i_chunk_end = i_max;
+                if( i_chunk_end > i_end )
+                {
+                    i_end = i_chunk_end;
+                    b_extended = true;
+                }
+                if( i_end == i_max )
+                    return i_end;
+            }
+        }
+    } while( b_extended );
+
+    return i_end;
+}
+
+static block_t * ReadAheadGet( demux_t *p_demux, uint64_t i_pos, uint32_t i_size )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->readahead.b_enabled || i_size > MP4_READAHEAD_MAX )
+        return NULL;
+
+    /* look for a window containing the sample, else pick the oldest one */
+    unsigned i_slot = 0;
+    bool b_hit = false;
+    for( unsigned i = 0; i < MP4_READAHEAD_SLOTS; i++ )
+    {
+        const uint64_t i_slot_pos = p_sys->readahead.slot[i].i_pos;
+        if( i_pos >= i_slot_pos &&
+            i_pos + i_size <= i_slot_pos + p_sys->readahead.slot[i].i_size )
+        {
+            i_slot = i;
+            b_hit = true;
+            break;
+        }
+        if( p_sys->readahead.slot[i].i_last_use <
+            p_sys->readahead.slot[i_slot].i_last_use )
+            i_slot = i;
+    }
+
+    mp4_readahead_slot_t *slot = &p_sys->readahead.slot[i_slot];
+
+    if( !b_hit )
+    {
+        const uint64_t i_end = ReadAheadPlan( p_demux, i_pos, i_pos + i_size );
+        const size_t i_toread = i_end - i_pos;
+
+        if( slot->i_alloc < i_toread )
+        {
+            uint8_t *p_buffer = realloc( slot->p_buffer, i_toread );
+            if( p_buffer == NULL )
+                return NULL;
+            slot->p_buffer = p_buffer;
+            slot->i_alloc = i_toread;
+        }
+        slot->i_size = 0;
+
+        if( vlc_stream_Tell( p_demux->s ) != i_pos )
+        {
+            if( MP4_Seek( p_demux->s, i_pos ) != VLC_SUCCESS )
+                return NULL;
+            p_sys->readahead.i_seeks++;
+        }
+
+        ssize_t i_read = vlc_stream_Read( p_demux->s, slot->p_buffer, i_toread );
+        p_sys->readahead.i_reads++;
+        if( i_read < 0 || (size_t)i_read < i_size )
+            return NULL;
+        slot->i_pos = i_pos;
+        slot->i_size = i_read;
+    }
+
+    block_t *p_block = block_Alloc( i_size );
+    if( p_block == NULL )
+        return NULL;
+    memcpy( p_block->p_buffer, &slot->p_buffer[i_pos - slot->i_pos], i_size );
+    slot->i_last_use = ++p_sys->readahead.i_clock;
+    p_sys->readahead.i_hits++;
+
+    return p_block;
+}
+
 /*****************************************************************************
  * Demux: read packet and send them to decoders
  *****************************************************************************
@@ -1620,9 +1779,9 @@ static int DemuxTrack( demux_t *p_demux, mp4_track_t *tk, uint64_t i_readpos,
         i_samplessize = MP4_TrackGetReadSize( tk, &i_nb_samples );
         if( i_samplessize > 0 )
         {
-            block_t *p_block;
+            block_t *p_block = ReadAheadGet( p_demux, i_readpos, i_samplessize );
 
-            if( vlc_stream_Tell( p_demux->s ) != i_readpos )
+            if( p_block == NULL && vlc_stream_Tell( p_demux->s ) != i_readpos )
             {
                 if( MP4_Seek( p_demux->s, i_readpos ) != VLC_SUCCESS )
                 {
@@ -1637,7 +1796,8 @@ static int DemuxTrack( demux_t *p_demux, mp4_track_t *tk, uint64_t i_readpos,
             i_samplessize = OverflowCheck( p_demux, tk, i_readpos, i_samplessize );
 
             /* now read pes */
-            if( !(p_block = vlc_stream_Block( p_demux->s, i_samplessize )) )
+            if( p_block == NULL &&
+                !(p_block = vlc_stream_Block( p_demux->s, i_samplessize )) )
             {
                 msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)"
                                    ": Failed to read %d bytes sample at %"PRIu64,
@@ -2449,6 +2609,13 @@ static void Close ( vlc_object_t * p_this )
         vlc_input_attachment_Release( p_sys->pp_attachments[i] );
     free( p_sys->pp_attachments );
 
+    if( p_sys->readahead.i_reads )
+        msg_Dbg( p_demux, "readahead: %u reads, %u seeks, %u samples served",
+                 p_sys->readahead.i_reads, p_sys->readahead.i_seeks,
+                 p_sys->readahead.i_hits );
+    for( unsigned i = 0; i < MP4_READAHEAD_SLOTS; i++ )
+        free( p_sys->readahead.slot[i].p_buffer );
+
     free( p_sys );
 }
 
@@ -2642,11 +2809,7 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
 
         ck->i_first_dts = 0;
         ck->i_entries_dts = 0;
-        ck->p_sample_count_dts = NULL;
-        ck->p_sample_delta_dts = NULL;
         ck->i_entries_pts = 0;
-        ck->p_sample_count_pts = NULL;
-        ck->p_sample_offset_pts = NULL;
     }
 
     /* now we read index for SampleEntry( soun vide mp4a mp4v ...)
@@ -2793,18 +2956,10 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     else
     {
-        /* 2: each sample can have a different size */
+        /* 2: each sample can have a different size, the stsz table
+         * lives as long as the moov and is used in place */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
     if ( p_demux_track->i_chunk_count && p_demux_track->i_sample_size == 0 )
@@ -2819,43 +2974,39 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
     /* Use stts table to create a sample number -> dts table.
      * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
-
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
+     *  the box! so each chunk will only refer to the runs of this table
+     *  covering its samples (problem with raw stream where a sample is
+     *  sometime just channels*bits_per_sample/8) */
 
     int64_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
      */
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "stts" );
-    if( !p_box )
+    if( !p_box || !p_box->data.p_stts )
     {
         msg_Warn( p_demux, "cannot find STTS box" );
         return VLC_EGENERIC;
     }
     else
     {
-        MP4_Box_data_stts_t *stts = p_box->data.p_stts;
+        const MP4_Box_data_stts_t *stts = p_box->data.p_stts;
+        p_demux_track->p_stts = stts;
 
         msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
-        /* Create sample -> dts table per chunk */
+        /* Locate the runs of each chunk, and the chunk first dts */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
 
             /* save first dts */
             ck->i_first_dts = i_next_dts;
 
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
+            /* count how many runs are spanned by this chunk */
             ck->i_entries_dts = 0;
 
             int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
@@ -2866,71 +3017,32 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
             if ( i_ret == VLC_EGENERIC )
                 return i_ret;
 
-            /* allocate them */
-            i_ret = MP4_ChunkAllocEntries( ck->i_entries_dts,
-                                           ck->small_dts_buf,
-                                           &ck->p_sample_count_dts,
-                                           &ck->p_sample_delta_dts );
-            if( i_ret )
-            {
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return i_ret;
-            }
+            ck->i_index_dts = i_index;
+            ck->i_skip_dts = i_current_index_samples_left ?
+                stts->pi_sample_count[i_index] - i_current_index_samples_left : 0;
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
+            /* now walk them */
+            uint32_t i_sample_count = ck->i_sample_count;
 
             for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
             {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += (int64_t)ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += (int64_t)ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_current_index_samples_left ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
+                const uint32_t i_run = i_current_index_samples_left ?
+                    i_current_index_samples_left : stts->pi_sample_count[i_index];
+                const uint32_t i_count = __MIN( i_run, i_sample_count );
+
+                i_next_dts += (int64_t)i_count * stts->pi_sample_delta[i_index];
+                if ( i_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
+                i_sample_count -= i_count;
+
+                if ( i_count < i_run )
                 {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += (int64_t)ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += (int64_t)ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( stts->pi_sample_count[i_index] ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
+                    /* keep building next chunk from same index */
+                    i_current_index_samples_left = i_run - i_count;
+                    assert( i == ck->i_entries_dts - 1 );
+                    break;
                 }
-
+                i_current_index_samples_left = 0;
+                i_index++;
             }
         }
     }
@@ -2942,7 +3054,8 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "ctts" );
     if( p_box && p_box->data.p_ctts )
     {
-        MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
+        const MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
+        p_demux_track->p_ctts = ctts;
 
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
 
@@ -2962,17 +3075,15 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         }
         p_demux_track->i_cts_shift = i_cts_shift;
 
-        /* Create pts-dts table per chunk */
+        /* Locate the pts-dts runs of each chunk */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
 
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
+            /* count how many runs are spanned by this chunk */
             ck->i_entries_pts = 0;
             int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
                                            i_current_index_samples_left,
@@ -2982,67 +3093,30 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
             if ( i_ret == VLC_EGENERIC )
                 return i_ret;
 
-            /* allocate them */
-            i_ret = MP4_ChunkAllocEntries( ck->i_entries_pts,
-                                           ck->small_pts_buf,
-                                           &ck->p_sample_count_pts,
-                                           &ck->p_sample_offset_pts );
-            if( i_ret )
-            {
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return i_ret;
-            }
+            ck->i_index_pts = i_index;
+            ck->i_skip_pts = i_current_index_samples_left ?
+                ctts->pi_sample_count[i_index] - i_current_index_samples_left : 0;
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
+            /* now walk them */
+            uint32_t i_sample_count = ck->i_sample_count;
 
             for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
             {
-                int64_t i_ctsdelta = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                if( i_ctsdelta < 0 ) /* should not */
-                    i_ctsdelta = 0;
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = i_ctsdelta;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = i_ctsdelta;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = i_ctsdelta;
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = i_ctsdelta;
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
+                const uint32_t i_run = i_current_index_samples_left ?
+                    i_current_index_samples_left : ctts->pi_sample_count[i_index];
+                const uint32_t i_count = __MIN( i_run, i_sample_count );
 
+                i_sample_count -= i_count;
 
+                if ( i_count < i_run )
+                {
+                    /* keep building next chunk from same index */
+                    i_current_index_samples_left = i_run - i_count;
+                    assert( i == ck->i_entries_pts - 1 );
+                    break;
+                }
+                i_current_index_samples_left = 0;
+                i_index++;
             }
         }
     }
@@ -3436,24 +3510,31 @@ static int STTSToSampleChunk(const mp4_track_t *p_track, uint64_t i_dts,
     }
 
     /* *** find sample in the chunk *** */
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
     uint32_t i_sample = ck->i_sample_first;
+    uint32_t i_left = ck->i_sample_count;
     uint64_t i_entrydts = ck->i_first_dts;
 
     for( uint_fast32_t i = 0;
          i < ck->i_entries_dts && i_sample < ck->i_sample_count;
          i++ )
     {
-        uint64_t i_entry_duration = ck->p_sample_count_dts[i] * (uint64_t)
-                                    ck->p_sample_delta_dts[i];
+        const uint32_t i_run = ck->i_index_dts + i;
+        const uint32_t i_count =
+            MP4_ChunkRunSamples( stts->pi_sample_count, i_run,
+                                 i ? 0 : ck->i_skip_dts, i_left );
+        uint64_t i_entry_duration = i_count * (uint64_t)
+                                    stts->pi_sample_delta[i_run];
         if( i_entrydts + i_entry_duration < i_dts )
         {
             i_entrydts += i_entry_duration;
-            i_sample += ck->p_sample_count_dts[i];
+            i_sample += i_count;
+            i_left -= i_count;
         }
         else
         {
-            if( ck->p_sample_delta_dts[i] > 0 )
-                i_sample += ( i_dts - i_entrydts ) / ck->p_sample_delta_dts[i];
+            if( stts->pi_sample_delta[i_run] > 0 )
+                i_sample += ( i_dts - i_entrydts ) / stts->pi_sample_delta[i_run];
             break;
         }
     }
@@ -3720,9 +3801,9 @@ static void TrackUpdateStarttimes( mp4_track_t *p_track )
             break;
         assert(i_nextsample >= ck->i_sample_first);
         stime_t pts;
-        stime_t dts = pts = MP4_ChunkGetSampleDTS( ck, i_nextsample - ck->i_sample_first );
+        stime_t dts = pts = MP4_ChunkGetSampleDTS( p_track, ck, i_nextsample - ck->i_sample_first );
         stime_t delta = UNKNOWN_DELTA;
-        if( MP4_ChunkGetSampleCTSDelta( ck, i_nextsample - ck->i_sample_first, &delta ) )
+        if( MP4_ChunkGetSampleCTSDelta( p_track, ck, i_nextsample - ck->i_sample_first, &delta ) )
             pts += delta;
         if( pts < lowest )
         {
@@ -3738,9 +3819,9 @@ static void TrackUpdateSampleAndTimes( mp4_track_t *p_track )
     uint32_t i_chunk_sample = p_track->i_sample - p_chunk->i_sample_first;
     if( i_chunk_sample > p_chunk->i_sample_count && p_chunk->i_sample_count )
         i_chunk_sample = p_chunk->i_sample_count - 1;
-    p_track->i_next_dts = MP4_ChunkGetSampleDTS( p_chunk, i_chunk_sample );
+    p_track->i_next_dts = MP4_ChunkGetSampleDTS( p_track, p_chunk, i_chunk_sample );
     stime_t i_next_delta;
-    if( !MP4_ChunkGetSampleCTSDelta( p_chunk, i_chunk_sample, &i_next_delta ) )
+    if( !MP4_ChunkGetSampleCTSDelta( p_track, p_chunk, i_chunk_sample, &i_next_delta ) )
         p_track->i_next_delta = UNKNOWN_DELTA;
     else
         p_track->i_next_delta = i_next_delta;
@@ -4037,16 +4118,8 @@ static void MP4_TrackClean( es_out_t *out, mp4_track_t *p_track )
     if( p_track->p_es )
         es_out_Del( out, p_track->p_es );
 
-    if( p_track->chunk )
-    {
-        for( unsigned int i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-            MP4_ChunkDestroy( &p_track->chunk[i_chunk] );
-    }
     free( p_track->chunk );
 
-    if( !p_track->i_sample_size )
-        free( p_track->p_sample_size );
-
     ASFPacketTrackReset( &p_track->asfinfo );
 
     free( p_track->context.runs.p_array );
@@ -4366,22 +4439,22 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
     return i_size;
 }
 
-static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+/* Position of a sample belonging to a chunk, or of the chunk end when
+ * i_sample is the first sample of the next chunk */
+static uint64_t MP4_ChunkGetSamplePos( const mp4_track_t *p_track,
+                                       uint32_t i_chunk, uint32_t i_sample )
 {
-    unsigned int i_sample;
-    uint64_t i_pos;
-
-    i_pos = p_track->chunk[p_track->i_chunk].i_offset;
+    const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+    uint64_t i_pos = ck->i_offset;
 
     if( p_track->i_sample_size )
     {
         /* chunk offset in samples */
-        uint32_t i_samples = p_track->i_sample -
-                             p_track->chunk[p_track->i_chunk].i_sample_first;
+        uint32_t i_samples = i_sample - ck->i_sample_first;
 
         if( p_track->fmt.i_cat == AUDIO_ES )
         {
-            MP4_Box_data_sample_soun_t *p_soun =
+            const MP4_Box_data_sample_soun_t *p_soun =
                 p_track->p_sample->data.p_sample_soun;
 
             if( p_soun->i_compressionid != 0xFFFE )
@@ -4401,16 +4474,18 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
     }
     else
     {
-        for( i_sample = p_track->chunk[p_track->i_chunk].i_sample_first;
-             i_sample < p_track->i_sample; i_sample++ )
-        {
-            i_pos += p_track->p_sample_size[i_sample];
-        }
+        for( uint32_t i = ck->i_sample_first; i < i_sample; i++ )
+            i_pos += p_track->p_sample_size[i];
     }
 
     return i_pos;
 }
 
+static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+{
+    return MP4_ChunkGetSamplePos( p_track, p_track->i_chunk, p_track->i_sample );
+}
+
 
 static int MP4_TrackSetNextELST( mp4_track_t *tk )
 {
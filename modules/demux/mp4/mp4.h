@@ -30,8 +30,6 @@
 #include "fragments.h"
 #include "../asf/asfpacket.h"
 
-#define MP4_CHUNK_SMALLBUF_ENTRIES 2
-
 /* Contain all information about a chunk */
 typedef struct
 {
@@ -48,15 +46,16 @@ typedef struct
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_duration;    /* total duration of all samples */
 
-    uint32_t     i_entries_dts;
-    uint32_t     *p_sample_count_dts;
-    uint32_t     *p_sample_delta_dts;   /* dts delta */
-    uint32_t     small_dts_buf[MP4_CHUNK_SMALLBUF_ENTRIES * 2];
+    /* The stts/ctts runs covering this chunk are not copied: the chunk
+     * only refers to the run of its first sample in the track tables,
+     * and how many of that run samples belong to previous chunks. */
+    uint32_t     i_entries_dts; /* stts runs spanned */
+    uint32_t     i_index_dts;   /* stts run of the first sample */
+    uint32_t     i_skip_dts;    /* samples of that run in previous chunks */
 
-    uint32_t     i_entries_pts;
-    uint32_t     *p_sample_count_pts;
-    uint32_t     *p_sample_offset_pts;  /* pts-dts */
-    uint32_t     small_pts_buf[MP4_CHUNK_SMALLBUF_ENTRIES * 2];
+    uint32_t     i_entries_pts; /* ctts runs spanned */
+    uint32_t     i_index_pts;   /* ctts run of the first sample */
+    uint32_t     i_skip_pts;    /* samples of that run in previous chunks */
 
     /* TODO if needed add pts
         but quickly *add* support for edts and seeking */
@@ -151,9 +150,13 @@ typedef struct
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
+    const uint32_t   *p_sample_size; /* XXX perhaps add file offset if take
 //                                    too much time to do sumations each time*/
 
+    /* decoding and composition time tables, owned by the stbl boxes */
+    const MP4_Box_data_stts_t *p_stts;
+    const MP4_Box_data_ctts_t *p_ctts; /* could be NULL */
+
     const MP4_Box_t *p_track;
     const MP4_Box_t *p_stbl;  /* will contain all timing information */
     const MP4_Box_t *p_stsd;  /* will contain all data to initialize decoder */
@@ -29,6 +29,7 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_plugin.h>
 #include <vlc_demux.h>
 
@@ -49,6 +50,7 @@
 #define CDXA_HEADER_SIZE 44
 #define CDXA_SECTOR_SIZE 2352
 #define CDXA_SECTOR_HEADER_SIZE 24
+#define PS_CHUNK_SIZE (32 * 2048) /* DVD sectors */
 
 /*****************************************************************************
  * Module descriptor
@@ -80,8 +82,30 @@ vlc_module_end ()
  * Local prototypes
  *****************************************************************************/
 
+/* The stream is read by large chunks, and packets are blocks referencing
+ * their part of the chunk, instead of being copied one by one. */
 typedef struct
 {
+    vlc_atomic_rc_t rc;
+    block_t        *p_data;
+} ps_chunk_t;
+
+typedef struct
+{
+    block_t     self;
+    ps_chunk_t *p_chunk;
+} ps_chunk_view_t;
+
+typedef struct
+{
+    stream_t   *s;
+    ps_chunk_t *p_chunk;
+    size_t      i_pos;  /* read offset in the chunk */
+} ps_reader_t;
+
+typedef struct
+{
+    ps_reader_t reader;
     ps_psm_t    psm;
     ps_track_t  tk[PS_TK_COUNT];
 
@@ -118,8 +142,11 @@ typedef struct
 static int Demux  ( demux_t *p_demux );
 static int Control( demux_t *p_demux, int i_query, va_list args );
 
-static int      ps_pkt_resynch( stream_t *, int, bool );
-static block_t *ps_pkt_read   ( stream_t * );
+static int      ps_pkt_resynch( ps_reader_t *, int, bool );
+static block_t *ps_pkt_read   ( ps_reader_t * );
+
+static void     ps_reader_Reset( ps_reader_t * );
+static uint64_t ps_reader_Tell ( const ps_reader_t * );
 
 static void CreateOrUpdateES( demux_t*p_demux )
 {
@@ -232,6 +259,9 @@ static int OpenCommon( vlc_object_t *p_this, bool b_force )
     p_demux->pf_control = Control;
 
     /* Init p_sys */
+    p_sys->reader.s = p_demux->s;
+    p_sys->reader.p_chunk = NULL;
+    p_sys->reader.i_pos = 0;
     p_sys->i_mux_rate = i_mux_rate;
     p_sys->i_pack_scr  = VLC_TICK_INVALID;
     p_sys->i_first_scr = VLC_TICK_INVALID;
@@ -293,6 +323,7 @@ static void Close( vlc_object_t *p_this )
     }
 
     ps_psm_destroy( &p_sys->psm );
+    ps_reader_Reset( &p_sys->reader );
 
     free( p_sys );
 }
@@ -303,7 +334,7 @@ static int Probe( demux_t *p_demux, bool b_end )
     int i_ret, i_id;
     block_t *p_pkt;
 
-    i_ret = ps_pkt_resynch( p_demux->s, p_sys->format, p_sys->b_have_pack );
+    i_ret = ps_pkt_resynch( &p_sys->reader, p_sys->format, p_sys->b_have_pack );
     if( i_ret < 0 )
     {
         return VLC_DEMUXER_EOF;
@@ -320,7 +351,7 @@ static int Probe( demux_t *p_demux, bool b_end )
     if( p_sys->b_lost_sync ) msg_Warn( p_demux, "found sync code" );
     p_sys->b_lost_sync = false;
 
-    if( ( p_pkt = ps_pkt_read( p_demux->s ) ) == NULL )
+    if( ( p_pkt = ps_pkt_read( &p_sys->reader ) ) == NULL )
     {
         return VLC_DEMUXER_EOF;
     }
@@ -371,7 +402,7 @@ static bool FindLength( demux_t *p_demux )
         p_sys->i_length = VLC_TICK_0;
         /* Check beginning */
         int i = 0;
-        i_current_pos = vlc_stream_Tell( p_demux->s );
+        i_current_pos = ps_reader_Tell( &p_sys->reader );
         while( i < 40 && Probe( p_demux, false ) > 0 ) i++;
 
         /* Check end */
@@ -379,11 +410,13 @@ static bool FindLength( demux_t *p_demux )
         i_end = VLC_CLIP( i_size, 0, 200000 );
         if( vlc_stream_Seek( p_demux->s, i_size - i_end ) == VLC_SUCCESS )
         {
+            ps_reader_Reset( &p_sys->reader );
             i = 0;
             while( i < 400 && Probe( p_demux, true ) > 0 ) i++;
             if( i_current_pos >= 0 &&
                 vlc_stream_Seek( p_demux->s, i_current_pos ) != VLC_SUCCESS )
                     return false;
+            ps_reader_Reset( &p_sys->reader );
         }
         else return false;
     }
@@ -438,7 +471,7 @@ static int Demux( demux_t *p_demux )
     int i_ret, i_mux_rate;
     block_t *p_pkt;
 
-    i_ret = ps_pkt_resynch( p_demux->s, p_sys->format, p_sys->b_have_pack );
+    i_ret = ps_pkt_resynch( &p_sys->reader, p_sys->format, p_sys->b_have_pack );
     if( i_ret < 0 )
     {
         return VLC_DEMUXER_EOF;
@@ -448,7 +481,7 @@ static int Demux( demux_t *p_demux )
         if( !p_sys->b_lost_sync )
         {
             msg_Warn( p_demux, "garbage at input from %"PRIu64", trying to resync...",
-                                vlc_stream_Tell(p_demux->s) );
+                                ps_reader_Tell( &p_sys->reader ) );
             NotifyDiscontinuity( p_sys->tk, p_demux->out );
         }
 
@@ -465,7 +498,7 @@ static int Demux( demux_t *p_demux )
             return VLC_DEMUXER_EGENERIC;
     }
 
-    if( ( p_pkt = ps_pkt_read( p_demux->s ) ) == NULL )
+    if( ( p_pkt = ps_pkt_read( &p_sys->reader ) ) == NULL )
     {
         return VLC_DEMUXER_EOF;
     }
@@ -492,7 +525,7 @@ static int Demux( demux_t *p_demux )
                 p_sys->i_first_scr = p_sys->i_pack_scr;
             CheckPCR( p_sys, p_demux->out, p_sys->i_pack_scr );
             p_sys->i_scr = p_sys->i_pack_scr;
-            p_sys->i_lastpack_byte = vlc_stream_Tell( p_demux->s );
+            p_sys->i_lastpack_byte = ps_reader_Tell( &p_sys->reader );
             if( !p_sys->b_have_pack ) p_sys->b_have_pack = true;
             /* done later on to work around bad vcd/svcd streams */
             /* es_out_SetPCR( p_demux->out, p_sys->i_scr ); */
@@ -728,7 +761,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             i64 = stream_Size( p_demux->s ) - p_sys->i_start_byte;
             if( i64 > 0 )
             {
-                double current = vlc_stream_Tell( p_demux->s ) - p_sys->i_start_byte;
+                double current = ps_reader_Tell( &p_sys->reader ) - p_sys->i_start_byte;
                 *pf = current / (double)i64;
             }
             else
@@ -756,6 +789,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             i_ret = vlc_stream_Seek( p_demux->s, i64 );
             if( i_ret == VLC_SUCCESS )
             {
+                ps_reader_Reset( &p_sys->reader );
                 NotifyDiscontinuity( p_sys->tk, p_demux->out );
                 return i_ret;
             }
@@ -773,7 +807,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
                 /* H.222 2.5.2.2 */
                 if( p_sys->i_mux_rate > 0 && p_sys->b_have_pack )
                 {
-                    uint64_t i_offset = vlc_stream_Tell( p_demux->s ) - p_sys->i_lastpack_byte;
+                    uint64_t i_offset = ps_reader_Tell( &p_sys->reader ) - p_sys->i_lastpack_byte;
                     i_time += vlc_tick_from_samples(i_offset, p_sys->i_mux_rate * 50);
                 }
                 *va_arg( args, vlc_tick_t * ) = i_time;
@@ -821,11 +855,17 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         }
 
         case DEMUX_SET_TITLE:
-            return vlc_stream_vaControl( p_demux->s, STREAM_SET_TITLE, args );
+            i_ret = vlc_stream_vaControl( p_demux->s, STREAM_SET_TITLE, args );
+            if( i_ret == VLC_SUCCESS )
+                ps_reader_Reset( &p_sys->reader );
+            return i_ret;
 
         case DEMUX_SET_SEEKPOINT:
-            return vlc_stream_vaControl( p_demux->s, STREAM_SET_SEEKPOINT,
-                                         args );
+            i_ret = vlc_stream_vaControl( p_demux->s, STREAM_SET_SEEKPOINT,
+                                          args );
+            if( i_ret == VLC_SUCCESS )
+                ps_reader_Reset( &p_sys->reader );
+            return i_ret;
 
         case DEMUX_TEST_AND_CLEAR_FLAGS:
         {
@@ -862,13 +902,134 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
  *  It doesn't skip more than 512 bytes
  *  -1 -> error, 0 -> not synch, 1 -> ok
  */
-static int ps_pkt_resynch( stream_t *s, int format, bool b_pack )
+static void ps_chunk_Release( ps_chunk_t *p_chunk )
+{
+    if( vlc_atomic_rc_dec( &p_chunk->rc ) )
+    {
+        block_Release( p_chunk->p_data );
+        free( p_chunk );
+    }
+}
+
+static void ps_chunk_view_Release( block_t *p_block )
+{
+    ps_chunk_view_t *p_view = container_of( p_block, ps_chunk_view_t, self );
+
+    ps_chunk_Release( p_view->p_chunk );
+    free( p_view );
+}
+
+static const struct vlc_block_callbacks ps_chunk_view_cbs =
+{
+    ps_chunk_view_Release,
+};
+
+static size_t ps_reader_Available( const ps_reader_t *r )
+{
+    return r->p_chunk ? r->p_chunk->p_data->i_buffer - r->i_pos : 0;
+}
+
+/* Drops the data read ahead, to be called when the stream position changed */
+static void ps_reader_Reset( ps_reader_t *r )
+{
+    if( r->p_chunk )
+        ps_chunk_Release( r->p_chunk );
+    r->p_chunk = NULL;
+    r->i_pos = 0;
+}
+
+static uint64_t ps_reader_Tell( const ps_reader_t *r )
+{
+    return vlc_stream_Tell( r->s ) - ps_reader_Available( r );
+}
+
+/* Same as vlc_stream_Peek, refilling a new chunk when needed */
+static ssize_t ps_reader_Peek( ps_reader_t *r, const uint8_t **pp_peek,
+                               size_t i_size )
+{
+    size_t i_avail = ps_reader_Available( r );
+
+    if( i_avail < i_size )
+    {
+        ps_chunk_t *p_chunk = malloc( sizeof(*p_chunk) );
+        if( unlikely(p_chunk == NULL) )
+            return -1;
+        p_chunk->p_data = block_Alloc( __MAX( i_size, PS_CHUNK_SIZE ) );
+        if( unlikely(p_chunk->p_data == NULL) )
+        {
+            free( p_chunk );
+            return -1;
+        }
+        vlc_atomic_rc_init( &p_chunk->rc );
+
+        /* keep the data not read yet, less than a packet */
+        uint8_t *p_buf = p_chunk->p_data->p_buffer;
+        if( i_avail > 0 )
+            memcpy( p_buf, &r->p_chunk->p_data->p_buffer[r->i_pos], i_avail );
+
+        const size_t i_max = p_chunk->p_data->i_buffer;
+        while( i_avail < i_size )
+        {
+            ssize_t i_read = vlc_stream_ReadPartial( r->s, &p_buf[i_avail],
+                                                     i_max - i_avail );
+            if( i_read <= 0 )
+                break;
+            i_avail += i_read;
+        }
+        p_chunk->p_data->i_buffer = i_avail;
+
+        ps_reader_Reset( r );
+        r->p_chunk = p_chunk;
+    }
+
+    *pp_peek = &r->p_chunk->p_data->p_buffer[r->i_pos];
+    return i_avail;
+}
+
+static int ps_reader_Skip( ps_reader_t *r, size_t i_size )
+{
+    size_t i_avail = ps_reader_Available( r );
+
+    if( i_size <= i_avail )
+    {
+        r->i_pos += i_size;
+        return VLC_SUCCESS;
+    }
+
+    ps_reader_Reset( r );
+    i_size -= i_avail;
+    return vlc_stream_Read( r->s, NULL, i_size ) == (ssize_t)i_size
+           ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+/* Same as vlc_stream_Block, without copying the data */
+static block_t *ps_reader_Block( ps_reader_t *r, size_t i_size )
+{
+    const uint8_t *p_peek;
+    ssize_t i_peek = ps_reader_Peek( r, &p_peek, i_size );
+    if( i_peek <= 0 )
+        return NULL;
+    if( (size_t)i_peek < i_size )
+        i_size = i_peek;
+
+    ps_chunk_view_t *p_view = malloc( sizeof(*p_view) );
+    if( unlikely(p_view == NULL) )
+        return NULL;
+
+    block_Init( &p_view->self, &ps_chunk_view_cbs, (uint8_t *)p_peek, i_size );
+    p_view->p_chunk = r->p_chunk;
+    vlc_atomic_rc_inc( &r->p_chunk->rc );
+    r->i_pos += i_size;
+    return &p_view->self;
+}
+
+static int ps_pkt_resynch( ps_reader_t *r, int format, bool b_pack )
 {
     const uint8_t *p_peek;
     ssize_t      i_peek;
     unsigned int i_skip;
 
-    if( vlc_stream_Peek( s, &p_peek, 4 ) < 4 )
+    if( ps_reader_Peek( r, &p_peek, 4 ) < 4 )
     {
         return -1;
     }
@@ -878,7 +1039,7 @@ static int ps_pkt_resynch( stream_t *s, int format, bool b_pack )
         return 1;
     }
 
-    if( ( i_peek = vlc_stream_Peek( s, &p_peek, 512 ) ) < 4 )
+    if( ( i_peek = ps_reader_Peek( r, &p_peek, 512 ) ) < 4 )
     {
         return -1;
     }
@@ -909,20 +1070,20 @@ static int ps_pkt_resynch( stream_t *s, int format, bool b_pack )
             p_peek[3] >= PS_STREAM_ID_END_STREAM &&
             ( !b_pack || p_peek[3] == PS_STREAM_ID_PACK_HEADER ) )
         {
-            return vlc_stream_Read( s, NULL, i_skip ) != i_skip ? -1 : 1;
+            return ps_reader_Skip( r, i_skip ) != VLC_SUCCESS ? -1 : 1;
         }
 
         p_peek++;
         i_peek--;
         i_skip++;
     }
-    return vlc_stream_Read( s, NULL, i_skip ) != i_skip ? -1 : 0;
+    return ps_reader_Skip( r, i_skip ) != VLC_SUCCESS ? -1 : 0;
 }
 
-static block_t *ps_pkt_read( stream_t *s )
+static block_t *ps_pkt_read( ps_reader_t *r )
 {
     const uint8_t *p_peek;
-    int i_peek = vlc_stream_Peek( s, &p_peek, 14 );
+    int i_peek = ps_reader_Peek( r, &p_peek, 14 );
     if( i_peek < 4 )
         return NULL;
 
@@ -933,7 +1094,7 @@ static block_t *ps_pkt_read( stream_t *s )
         i_size = 6;
         for( ;; )
         {
-            i_peek = vlc_stream_Peek( s, &p_peek, i_size + 1024 );
+            i_peek = ps_reader_Peek( r, &p_peek, i_size + 1024 );
             if( i_peek <= i_size + 4 )
             {
                 return NULL;
@@ -943,7 +1104,7 @@ static block_t *ps_pkt_read( stream_t *s )
                 if( p_peek[i_size] == 0x00 && p_peek[i_size+1] == 0x00 &&
                     p_peek[i_size+2] == 0x01 && p_peek[i_size+3] >= PS_STREAM_ID_END_STREAM )
                 {
-                    return vlc_stream_Block( s, i_size );
+                    return ps_reader_Block( r, i_size );
                 }
                 i_size++;
             }
@@ -952,7 +1113,7 @@ static block_t *ps_pkt_read( stream_t *s )
     else
     {
         /* Normal case */
-        return vlc_stream_Block( s, i_size );
+        return ps_reader_Block( r, i_size );
     }
 
     return NULL;
@@ -194,8 +194,12 @@ static bool GatherPESData( demux_t *p_demux, ts_pid_t *, block_t *, size_t );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, stime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static block_t* ReadTSPacketBatch( demux_t *p_demux );
+static void FlushTSPacketBatch( demux_sys_t *p_sys );
+static uint64_t GetStreamPosition( demux_sys_t *p_sys );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, stime_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
+static void IndexRandomAccessPoint( demux_t *p_demux, ts_pid_t *, const block_t * );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, stime_t );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 
@@ -511,6 +515,24 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_ignore_time_for_positions = var_InheritBool( p_demux, "ts-seek-percent" );
     p_sys->b_cc_check = var_InheritBool( p_demux, "ts-cc-check" );
 
+    /* Descramble by batches, unless reading ahead would add latency */
+    if( p_sys->csa && !p_sys->b_lowdelay )
+    {
+        unsigned i_size = __MIN( csa_GetBatchSize( p_sys->csa ), p_sys->i_ts_read );
+        if( i_size > 1 )
+        {
+            p_sys->csa_batch.pp_pkts = vlc_alloc( i_size, sizeof(block_t *) );
+            p_sys->csa_batch.pp_scrambled = vlc_alloc( i_size, sizeof(uint8_t *) );
+            p_sys->csa_batch.pi_pos = vlc_alloc( i_size, sizeof(uint64_t) );
+            if( p_sys->csa_batch.pp_pkts && p_sys->csa_batch.pp_scrambled &&
+                p_sys->csa_batch.pi_pos )
+            {
+                p_sys->csa_batch.i_size = i_size;
+                msg_Dbg( p_demux, "descrambling by batches of %u packets", i_size );
+            }
+        }
+    }
+
     p_sys->standard = TS_STANDARD_AUTO;
     char *psz_standard = var_InheritString( p_demux, "ts-standard" );
     if( psz_standard )
@@ -569,6 +591,11 @@ static void Close( vlc_object_t *p_this )
 
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
+    FlushTSPacketBatch( p_sys );
+    free( p_sys->csa_batch.pp_pkts );
+    free( p_sys->csa_batch.pp_scrambled );
+    free( p_sys->csa_batch.pi_pos );
+
     vlc_mutex_lock( &p_sys->csa_lock );
     if( p_sys->csa )
     {
@@ -646,7 +673,7 @@ static int Demux( demux_t *p_demux )
         bool         b_frame = false;
         int          i_header = 0;
         block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        if( !(p_pkt = ReadTSPacketBatch( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
         }
@@ -740,6 +767,7 @@ static int Demux( demux_t *p_demux )
 
             if( p_pid->u.p_stream->transport == TS_TRANSPORT_PES )
             {
+                IndexRandomAccessPoint( p_demux, p_pid, p_pkt );
                 b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_header );
             }
             else if( p_pid->u.p_stream->transport == TS_TRANSPORT_SECTIONS )
@@ -966,7 +994,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            uint64_t offset = vlc_stream_Tell( p_sys->stream );
+            uint64_t offset = GetStreamPosition( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -1882,6 +1910,67 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+/* Reads the next packet to demux. When descrambling, packets are read ahead
+ * and descrambled by batches, which is much faster than one by one. */
+static block_t* ReadTSPacketBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->csa_batch.i_size == 0 )
+        return ReadTSPacket( p_demux );
+
+    if( p_sys->csa_batch.i_next == p_sys->csa_batch.i_count )
+    {
+        unsigned i_scrambled = 0;
+
+        p_sys->csa_batch.i_next = p_sys->csa_batch.i_count = 0;
+        while( p_sys->csa_batch.i_count < p_sys->csa_batch.i_size )
+        {
+            block_t *p_pkt = ReadTSPacket( p_demux );
+            if( !p_pkt )
+                break;
+            p_sys->csa_batch.pi_pos[p_sys->csa_batch.i_count] =
+                vlc_stream_Tell( p_sys->stream );
+            p_sys->csa_batch.pp_pkts[p_sys->csa_batch.i_count++] = p_pkt;
+
+            /* same checks as the demuxer before descrambling */
+            if( p_pkt->i_buffer >= TS_PACKET_SIZE_188 &&
+                !(p_pkt->p_buffer[1]&0x80) && (p_pkt->p_buffer[3]&0x80) &&
+                PIDGet( p_pkt ) != 0x1FFF )
+                p_sys->csa_batch.pp_scrambled[i_scrambled++] = p_pkt->p_buffer;
+        }
+
+        if( i_scrambled > 0 )
+        {
+            vlc_mutex_lock( &p_sys->csa_lock );
+            csa_DecryptBatch( p_sys->csa, p_sys->csa_batch.pp_scrambled,
+                              i_scrambled, p_sys->i_csa_pkt_size );
+            vlc_mutex_unlock( &p_sys->csa_lock );
+        }
+
+        if( p_sys->csa_batch.i_count == 0 )
+            return NULL;
+    }
+
+    return p_sys->csa_batch.pp_pkts[p_sys->csa_batch.i_next++];
+}
+
+static void FlushTSPacketBatch( demux_sys_t *p_sys )
+{
+    while( p_sys->csa_batch.i_next < p_sys->csa_batch.i_count )
+        block_Release( p_sys->csa_batch.pp_pkts[p_sys->csa_batch.i_next++] );
+}
+
+/* Position following the last packet handed to the demuxer, as the stream
+ * is read ahead when descrambling by batches */
+static uint64_t GetStreamPosition( demux_sys_t *p_sys )
+{
+    if( p_sys->csa_batch.i_next > 0 &&
+        p_sys->csa_batch.i_next < p_sys->csa_batch.i_count )
+        return p_sys->csa_batch.pi_pos[p_sys->csa_batch.i_next - 1];
+    return vlc_stream_Tell( p_sys->stream );
+}
+
 static stime_t GetPCR( const block_t *p_pkt )
 {
     const uint8_t *p = p_pkt->p_buffer;
@@ -1966,10 +2055,14 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* packets read ahead are from before the seek */
+    FlushTSPacketBatch( p_sys );
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
         ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+        ts_index_Discontinuity( &p_pmt->rap_index );
         for( int j=0; j<p_pmt->e_streams.i_size; j++ )
         {
             ts_pid_t *pid = p_pmt->e_streams.p_elems[j];
@@ -2004,6 +2097,48 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
     }
 }
 
+static void IndexRandomAccessPoint( demux_t *p_demux, ts_pid_t *p_pid,
+                                    const block_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint8_t *p = p_pkt->p_buffer;
+
+    /* Unscrambled payload start, with an adaptation field flagging
+     * a random access point */
+    if( !p_sys->b_canseek ||
+        (p[1] & 0xC0) != 0x40 || (p[3] & 0xF0) != 0x30 ||
+        p[4] == 0 || p[4] > 182 || !(p[5] & 0x40) )
+        return;
+
+    const ts_es_t *p_es = p_pid->u.p_stream->p_es;
+    if( p_es == NULL || p_es->fmt.i_cat != VIDEO_ES )
+        return;
+
+    ts_pmt_t *p_pmt = p_es->p_program;
+    if( p_pmt->pcr.i_first < 0 )
+        return;
+
+    unsigned i_skip = TS_HEADER_SIZE + 1 + p[4];
+    stime_t i_dts = -1, i_pts = -1;
+    uint8_t i_stream_id;
+    if( i_skip >= p_pkt->i_buffer ||
+        ParsePESHeader( VLC_OBJECT(p_demux), &p[i_skip], p_pkt->i_buffer - i_skip,
+                        &i_skip, &i_dts, &i_pts, &i_stream_id, NULL ) != VLC_SUCCESS )
+        return;
+
+    stime_t i_time = i_dts != -1 ? i_dts : i_pts;
+    if( i_time == -1 )
+        return;
+
+    const uint64_t i_pos = GetStreamPosition( p_sys );
+    if( i_pos < p_sys->i_packet_size )
+        return;
+
+    ts_index_Add( &p_pmt->rap_index,
+                  TimeStampWrapAround( p_pmt->pcr.i_first, i_time ),
+                  i_pos - p_sys->i_packet_size );
+}
+
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, stime_t i_scaledtime )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -2012,6 +2147,17 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, stime_t i_scaled
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
         return vlc_stream_Seek( p_sys->stream, 0 );
 
+    /* Land directly on the closest preceding keyframe when playback
+     * went through that part already */
+    uint64_t i_index_pos;
+    if( p_sys->b_canseek &&
+        ts_index_Lookup( &p_pmt->rap_index, i_scaledtime, &i_index_pos ) )
+    {
+        msg_Dbg( p_demux, "Seek(): using index position %" PRIu64, i_index_pos );
+        if( vlc_stream_Seek( p_sys->stream, i_index_pos ) == VLC_SUCCESS )
+            return VLC_SUCCESS;
+    }
+
     const int64_t i_stream_size = stream_Size( p_sys->stream );
     if( !p_sys->b_canfastseek || i_stream_size < p_sys->i_packet_size )
         return VLC_EGENERIC;
@@ -2329,14 +2475,14 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, stime_t i_pcr )
         es_out_Control( p_demux->out, ES_OUT_SET_GROUP_PCR, p_pmt->i_number, FROM_SCALE(i_pcr) );
         /* growing files/named fifo handling */
         if( p_sys->b_access_control == false &&
-            vlc_stream_Tell( p_sys->stream ) > p_pmt->i_last_dts_byte )
+            GetStreamPosition( p_sys ) > p_pmt->i_last_dts_byte )
         {
             if( p_pmt->i_last_dts_byte == 0 ) /* first run */
                 p_pmt->i_last_dts_byte = stream_Size( p_sys->stream );
             else
             {
                 p_pmt->i_last_dts = i_pcr;
-                p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+                p_pmt->i_last_dts_byte = GetStreamPosition( p_sys );
             }
         }
     }
@@ -102,6 +102,16 @@ struct demux_sys_t
 
     csa_t       *csa;
     int         i_csa_pkt_size;
+    /* packets read ahead, to be descrambled together */
+    struct
+    {
+        block_t   **pp_pkts;
+        uint8_t   **pp_scrambled;
+        uint64_t   *pi_pos;   /* stream position after each packet */
+        unsigned    i_size;
+        unsigned    i_count;
+        unsigned    i_next;
+    } csa_batch;
     bool        b_split_es;
     bool        b_valid_scrambling;
 
@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * ts_index.c : MPEG TS random access points index
+ *****************************************************************************
+ * Copyright (C) 2024 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include "ts_index.h"
+
+/* 24 hours of 2 keyframes per second */
+#define TS_INDEX_MAX_ENTRIES (24 * 3600 * 2)
+
+void ts_index_Init( ts_index_t *p_index )
+{
+    p_index->p_entries = NULL;
+    p_index->i_count = 0;
+    p_index->i_alloc = 0;
+    p_index->i_last = SIZE_MAX;
+}
+
+void ts_index_Clean( ts_index_t *p_index )
+{
+    free( p_index->p_entries );
+    ts_index_Init( p_index );
+}
+
+void ts_index_Discontinuity( ts_index_t *p_index )
+{
+    p_index->i_last = SIZE_MAX;
+}
+
+/* Returns the first entry at or after i_pos */
+static size_t ts_index_FindPos( const ts_index_t *p_index, uint64_t i_pos )
+{
+    size_t i_low = 0, i_high = p_index->i_count;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_index->p_entries[i_mid].i_pos < i_pos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+void ts_index_Add( ts_index_t *p_index, stime_t i_time, uint64_t i_pos )
+{
+    const size_t i = ts_index_FindPos( p_index, i_pos );
+    const bool b_continuous = p_index->i_last != SIZE_MAX &&
+                              p_index->i_last + 1 == i;
+
+    if( i < p_index->i_count && p_index->p_entries[i].i_pos == i_pos )
+    {
+        /* Already indexed, but we now know nothing was missed in between */
+        if( b_continuous )
+            p_index->p_entries[i].b_continuous = true;
+        p_index->i_last = i;
+        return;
+    }
+
+    /* Timestamps must grow along with positions. Otherwise there's
+     * a discontinuity and time based lookups can't be trusted. */
+    if( ( i > 0 && p_index->p_entries[i - 1].i_time >= i_time ) ||
+        ( i < p_index->i_count && p_index->p_entries[i].i_time <= i_time ) )
+    {
+        p_index->i_last = SIZE_MAX;
+        return;
+    }
+
+    if( p_index->i_count == p_index->i_alloc )
+    {
+        if( p_index->i_alloc >= TS_INDEX_MAX_ENTRIES )
+        {
+            p_index->i_last = SIZE_MAX;
+            return;
+        }
+        size_t i_alloc = p_index->i_alloc ? p_index->i_alloc * 2 : 256;
+        ts_index_entry_t *p_realloc =
+            realloc( p_index->p_entries, i_alloc * sizeof(*p_realloc) );
+        if( unlikely(p_realloc == NULL) )
+        {
+            p_index->i_last = SIZE_MAX;
+            return;
+        }
+        p_index->p_entries = p_realloc;
+        p_index->i_alloc = i_alloc;
+    }
+
+    memmove( &p_index->p_entries[i + 1], &p_index->p_entries[i],
+             (p_index->i_count - i) * sizeof(*p_index->p_entries) );
+    p_index->p_entries[i].i_time = i_time;
+    p_index->p_entries[i].i_pos = i_pos;
+    p_index->p_entries[i].b_continuous = b_continuous;
+    p_index->i_count++;
+    p_index->i_last = i;
+}
+
+bool ts_index_Lookup( const ts_index_t *p_index, stime_t i_time, uint64_t *pi_pos )
+{
+    /* Positions and timestamps have the same order, so we can search the
+     * last entry at or before the requested time. */
+    size_t i_low = 0, i_high = p_index->i_count;
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_index->p_entries[i_mid].i_time <= i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+
+    /* The next random access point must have been read right after, so that
+     * there's no closer unindexed one. */
+    if( i_low == 0 || i_low == p_index->i_count ||
+        !p_index->p_entries[i_low].b_continuous )
+        return false;
+
+    *pi_pos = p_index->p_entries[i_low - 1].i_pos;
+    return true;
+}
@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * ts_index.h : MPEG TS random access points index
+ *****************************************************************************
+ * Copyright (C) 2024 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+#include "timestamps.h"
+
+typedef struct
+{
+    stime_t  i_time; /* unwrapped timestamp of the access unit */
+    uint64_t i_pos;  /* offset of the TS packet starting it */
+    bool     b_continuous; /* read right after the previous entry */
+} ts_index_entry_t;
+
+/* Random access points seen during playback, sorted by position. Entries
+ * are only trusted for seeking between two continuously read ones, as
+ * there might be unindexed keyframes in the gaps left by seeks. */
+typedef struct
+{
+    ts_index_entry_t *p_entries;
+    size_t i_count;
+    size_t i_alloc;
+    size_t i_last; /* last added entry, SIZE_MAX after a discontinuity */
+} ts_index_t;
+
+void ts_index_Init( ts_index_t * );
+void ts_index_Clean( ts_index_t * );
+void ts_index_Add( ts_index_t *, stime_t i_time, uint64_t i_pos );
+void ts_index_Discontinuity( ts_index_t * );
+bool ts_index_Lookup( const ts_index_t *, stime_t i_time, uint64_t *pi_pos );
+
+#endif
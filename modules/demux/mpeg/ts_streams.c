@@ -107,6 +107,8 @@ ts_pmt_t *ts_pmt_New( demux_t *p_demux )
     pmt->i_last_dts = TS_TICK_UNKNOWN;
     pmt->i_last_dts_byte = 0;
 
+    ts_index_Init( &pmt->rap_index );
+
     pmt->p_atsc_si_basepid      = NULL;
     pmt->p_si_sdt_pid = NULL;
 
@@ -142,6 +144,7 @@ void ts_pmt_Del( demux_t *p_demux, ts_pmt_t *pmt )
     for( int i=0; i<pmt->od.objects.i_size; i++ )
         ODFree( pmt->od.objects.p_elems[i] );
     ARRAY_RESET( pmt->od.objects );
+    ts_index_Clean( &pmt->rap_index );
     if( pmt->i_number > -1 )
         es_out_Control( p_demux->out, ES_OUT_DEL_GROUP, pmt->i_number );
 
@@ -24,6 +24,7 @@ typedef struct ts_sections_processor_t ts_sections_processor_t;
 
 #include "mpeg4_iod.h"
 #include "timestamps.h"
+#include "ts_index.h"
 
 #include <vlc_common.h>
 #include <vlc_arrays.h>
@@ -77,6 +78,9 @@ struct ts_pmt_t
     stime_t i_last_dts;
     uint64_t i_last_dts_byte;
 
+    /* Video keyframes positions, for seeking */
+    ts_index_t rap_index;
+
     /* CA */
     //en50221_capmt_info_t *capmt;
 
@@ -132,6 +132,7 @@ static int  Control( demux_t *, int, va_list );
 
 /* Bitstream manipulation */
 static int  Ogg_ReadPage     ( demux_t *, ogg_page * );
+static int64_t Ogg_GetPagePosition( demux_t *, const ogg_page * );
 static void Ogg_DecodePacket ( demux_t *, logical_stream_t *, ogg_packet *, bool );
 static unsigned Ogg_OpusPacketDuration( ogg_packet * );
 static void Ogg_QueueBlocks( demux_t *, logical_stream_t *, block_t *, vlc_tick_t, bool );
@@ -394,6 +395,7 @@ static int Demux( demux_t * p_demux )
     ogg_packet  oggpacket;
     int         i_stream;
     bool b_canseek;
+    int64_t     i_pagepos = -1;
 
     int i_active_streams = p_sys->i_streams;
     for ( int i=0; i < p_sys->i_streams; i++ )
@@ -476,6 +478,7 @@ static int Demux( demux_t * p_demux )
          */
         if( Ogg_ReadPage( p_demux, &p_sys->current_page ) != VLC_SUCCESS )
             return VLC_DEMUXER_EOF; /* EOF */
+        i_pagepos = Ogg_GetPagePosition( p_demux, &p_sys->current_page );
         /* Test for End of Stream */
         if( ogg_page_eos( &p_sys->current_page ) )
         {
@@ -528,6 +531,11 @@ static int Demux( demux_t * p_demux )
             {
                 continue;
             }
+
+            if( i_pagepos >= 0 )
+                OggSeek_PageIndexAdd( p_stream,
+                                      ogg_page_granulepos( &p_sys->current_page ),
+                                      i_pagepos );
         }
 
 
@@ -979,6 +987,19 @@ static int Ogg_ReadPage( demux_t *p_demux, ogg_page *p_oggpage )
     return VLC_SUCCESS;
 }
 
+/* Position of the page last returned by Ogg_ReadPage */
+static int64_t Ogg_GetPagePosition( demux_t *p_demux, const ogg_page *p_oggpage )
+{
+    demux_sys_t *p_ogg = p_demux->p_sys;
+    uint64_t i_pos;
+
+    /* The page ends where the unparsed bytes in the sync buffer start */
+    i_pos = vlc_stream_Tell( p_demux->s ) - ( p_ogg->oy.fill - p_ogg->oy.returned );
+    if( i_pos < (uint64_t)( p_oggpage->header_len + p_oggpage->body_len ) )
+        return -1;
+    return i_pos - p_oggpage->header_len - p_oggpage->body_len;
+}
+
 static void Ogg_SetNextFrame( demux_t *p_demux, logical_stream_t *p_stream,
                               ogg_packet *p_oggpacket )
 {
@@ -2304,7 +2325,8 @@ static int Ogg_BeginningOfStream( demux_t *p_demux )
         p_stream->p_es = NULL;
 
         /* initialise kframe index */
-        p_stream->idx=NULL;
+        oggseek_index_entries_free( &p_stream->idx );
+        oggseek_index_entries_free( &p_stream->pages );
 
         if ( p_stream->fmt.i_bitrate == 0  &&
              ( p_stream->fmt.i_cat == VIDEO_ES ||
@@ -2410,10 +2432,8 @@ static void Ogg_LogicalStreamDelete( demux_t *p_demux, logical_stream_t *p_strea
     es_format_Clean( &p_stream->fmt_old );
     es_format_Clean( &p_stream->fmt );
 
-    if ( p_stream->idx != NULL)
-    {
-        oggseek_index_entries_free( p_stream->idx );
-    }
+    oggseek_index_entries_free( &p_stream->idx );
+    oggseek_index_entries_free( &p_stream->pages );
 
     Ogg_FreeSkeleton( p_stream->p_skel );
     p_stream->p_skel = NULL;
@@ -45,6 +45,12 @@
 #define OGGDS_RESOLUTION     10000000
 
 typedef struct oggseek_index_entry demux_index_entry_t;
+typedef struct
+{
+    demux_index_entry_t *p_entries; /* sorted by page position */
+    size_t i_count;
+    size_t i_max;
+} demux_index_t;
 typedef struct ogg_skeleton_t ogg_skeleton_t;
 
 typedef struct backup_queue
@@ -100,7 +106,10 @@ typedef struct logical_stream_s
     int8_t i_first_frame_index;
 
     /* keyframe index for seeking, created as we discover keyframes */
-    demux_index_entry_t *idx;
+    demux_index_t idx;
+    /* pages with a known time, seen while demuxing or bisecting, used to
+     * narrow down the following searches */
+    demux_index_t pages;
 
     /* Skeleton data */
     ogg_skeleton_t *p_skel;
@@ -50,6 +50,8 @@
 
 #define MAX_PAGE_SIZE 65307
 #define MIN_PAGE_SIZE 27
+
+#define OGGSEEK_PAGE_INDEX_INTERVAL VLC_TICK_FROM_SEC(1)
 typedef struct packetStartCoordinates
 {
     int64_t i_pos;
@@ -61,94 +63,142 @@ typedef struct packetStartCoordinates
 * index entries
 *************************************************************/
 
-/* free all entries in index list */
+/* free all entries in index */
 
-void oggseek_index_entries_free ( demux_index_entry_t *idx )
+void oggseek_index_entries_free ( demux_index_t *idx )
 {
-    demux_index_entry_t *idx_next;
-
-    while ( idx != NULL )
-    {
-        idx_next = idx->p_next;
-        free( idx );
-        idx = idx_next;
-    }
+    free( idx->p_entries );
+    idx->p_entries = NULL;
+    idx->i_count = idx->i_max = 0;
 }
 
 
-/* internal function to create a new list member */
+/* internal function returning the first entry at or after i_pagepos */
 
-static demux_index_entry_t *index_entry_new( vlc_tick_t i_timestamp, int64_t i_pagepos )
+static size_t index_entry_lookup( const demux_index_t *idx, int64_t i_pagepos )
 {
-    if ( i_timestamp == VLC_TICK_INVALID || i_pagepos < 1 )
-        return NULL;
+    size_t i_low = 0, i_high = idx->i_count;
 
-    demux_index_entry_t *idx = malloc( sizeof(*idx) );
-    if ( idx )
+    /* pages are mostly added in order while demuxing */
+    if ( i_high > 0 && idx->p_entries[i_high - 1].i_pagepos < i_pagepos )
+        return i_high;
+
+    while ( i_low < i_high )
     {
-        idx->i_value = i_timestamp;
-        idx->i_pagepos = i_pagepos;
-        idx->p_next = NULL;
+        size_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if ( idx->p_entries[i_mid].i_pagepos < i_pagepos )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
     }
-    return idx;
+    return i_low;
 }
 
 /* We insert into index, sorting by pagepos (as a page can match multiple
    time stamps) */
-const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *p_stream,
+const demux_index_entry_t *OggSeek_IndexAdd ( demux_index_t *idx,
                                              vlc_tick_t i_timestamp,
                                              int64_t i_pagepos )
 {
-    demux_index_entry_t **pp_next = &p_stream->idx;
-    for( ; *pp_next; )
-    {
-        if( (*pp_next)->i_pagepos >= i_pagepos )
-        {
-            if( (*pp_next)->i_pagepos == i_pagepos )
-                return NULL;
-            break;
-        }
-        pp_next = &((*pp_next)->p_next);
-    }
+    if ( i_timestamp == VLC_TICK_INVALID || i_pagepos < 1 )
+        return NULL;
 
-    demux_index_entry_t *ie = index_entry_new( i_timestamp, i_pagepos );
-    if ( ie )
+    size_t i_pos = index_entry_lookup( idx, i_pagepos );
+    if ( i_pos < idx->i_count && idx->p_entries[i_pos].i_pagepos == i_pagepos )
+        return NULL;
+
+    if ( idx->i_count == idx->i_max )
     {
-        ie->p_next = *pp_next;
-        *pp_next = ie;
+        size_t i_max = idx->i_max ? idx->i_max * 2 : 64;
+        demux_index_entry_t *p_entries =
+            vlc_reallocarray( idx->p_entries, i_max, sizeof(*p_entries) );
+        if ( !p_entries )
+            return NULL;
+        idx->p_entries = p_entries;
+        idx->i_max = i_max;
     }
 
+    demux_index_entry_t *ie = &idx->p_entries[i_pos];
+    memmove( ie + 1, ie, ( idx->i_count - i_pos ) * sizeof(*ie) );
+    idx->i_count++;
+
+    ie->i_value = i_timestamp;
+    ie->i_pagepos = i_pagepos;
+
     return ie;
 }
 
-static bool OggSeekIndexFind ( logical_stream_t *p_stream, vlc_tick_t i_timestamp,
+/* Remember where a page with a known granule is, so that the next
+   searches can start from closer bounds */
+void OggSeek_PageIndexAdd( logical_stream_t *p_stream, int64_t i_granule,
+                           int64_t i_pagepos )
+{
+    if ( i_granule <= 0 || i_pagepos < p_stream->i_data_start )
+        return;
+
+    vlc_tick_t i_time = Ogg_GranuleToTime( p_stream, i_granule,
+                                           !p_stream->b_contiguous, false );
+    if ( i_time == VLC_TICK_INVALID )
+        return;
+
+    /* keep the index sparse, one page per interval is enough as bound */
+    demux_index_t *idx = &p_stream->pages;
+    size_t i_pos = index_entry_lookup( idx, i_pagepos );
+    if ( i_pos > 0 &&
+         i_time - idx->p_entries[i_pos - 1].i_value < OGGSEEK_PAGE_INDEX_INTERVAL )
+        return;
+    if ( i_pos < idx->i_count &&
+         idx->p_entries[i_pos].i_value - i_time < OGGSEEK_PAGE_INDEX_INTERVAL )
+        return;
+
+    OggSeek_IndexAdd( idx, i_time, i_pagepos );
+}
+
+static bool OggSeekIndexFind ( const demux_index_t *idx, vlc_tick_t i_timestamp,
                                int64_t *pi_pos_lower, int64_t *pi_pos_upper,
                                vlc_tick_t *pi_lower_timestamp )
 {
-    demux_index_entry_t *idx = p_stream->idx;
+    /* timestamps grow along with the page positions */
+    size_t i_low = 0, i_high = idx->i_count;
+    while ( i_low < i_high )
+    {
+        size_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if ( idx->p_entries[i_mid].i_value <= i_timestamp )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+
+    if ( i_low == 0 ) /* before first index */
+        return false;
+
+    const demux_index_entry_t *ie = &idx->p_entries[i_low - 1];
+    *pi_pos_lower = ie->i_pagepos;
+    *pi_lower_timestamp = ie->i_value;
+    if ( i_low < idx->i_count )
+        *pi_pos_upper = idx->p_entries[i_low].i_pagepos;
+    return true;
+}
+
+/* Narrow down the search bounds using the pages seen so far */
+static void OggSeekPageIndexBounds( logical_stream_t *p_stream, vlc_tick_t i_timestamp,
+                                    int64_t *pi_pos_lower, int64_t *pi_pos_upper )
+{
+    int64_t i_lower = -1, i_upper = -1;
+    vlc_tick_t i_lower_timestamp;
 
-    while ( idx != NULL )
+    if ( !OggSeekIndexFind( &p_stream->pages, i_timestamp,
+                            &i_lower, &i_upper, &i_lower_timestamp ) )
     {
-        if ( idx->i_value <= i_timestamp )
-        {
-            if ( !idx->p_next ) /* found on last index */
-            {
-                *pi_pos_lower = idx->i_pagepos;
-                *pi_lower_timestamp = idx->i_value;
-                return true;
-            }
-            if ( idx->p_next->i_value > i_timestamp )
-            {
-                *pi_pos_lower = idx->i_pagepos;
-                *pi_lower_timestamp = idx->i_value;
-                *pi_pos_upper = idx->p_next->i_pagepos;
-                return true;
-            }
-        }
-        idx = idx->p_next;
+        /* the target is before the first page seen */
+        if ( p_stream->pages.i_count > 0 )
+            i_upper = p_stream->pages.p_entries[0].i_pagepos;
     }
 
-    return false;
+    if ( i_lower > *pi_pos_lower )
+        *pi_pos_lower = i_lower;
+    if ( i_upper != -1 && ( *pi_pos_upper < 0 || i_upper < *pi_pos_upper ) )
+        *pi_pos_upper = i_upper;
 }
 
 /*********************************************************************
@@ -667,6 +717,7 @@ static int64_t OggBisectSearchByTime( demux_t *p_demux, logical_stream_t *p_stre
                                              &current.i_granule );
     if( current.i_granule != -1 )
     {
+        OggSeek_PageIndexAdd( p_stream, current.i_granule, current.i_pos );
         current.i_timestamp = Ogg_GranuleToTime( p_stream, current.i_granule,
                                                  !p_stream->b_contiguous, false );
         if( current.i_timestamp <= i_targettime )
@@ -712,6 +763,7 @@ static int64_t OggBisectSearchByTime( demux_t *p_demux, logical_stream_t *p_stre
         if ( current.i_pos != -1 && current.i_granule != -1 )
         {
             /* found a page */
+            OggSeek_PageIndexAdd( p_stream, current.i_granule, current.i_pos );
 
             if ( current.i_timestamp <= i_targettime )
             {
@@ -807,21 +859,30 @@ int Oggseek_BlindSeektoAbsoluteTime( demux_t *p_demux, logical_stream_t *p_strea
 
     /* And also search in our own index */
     vlc_tick_t foo;
-    if ( !b_found && OggSeekIndexFind( p_stream, i_time, &i_lowerpos, &i_upperpos, &foo ) )
+    if ( !b_found && OggSeekIndexFind( &p_stream->idx, i_time, &i_lowerpos, &i_upperpos, &foo ) )
     {
         b_found = true;
     }
 
     /* FIXME: add function to get preload time by codec, ex: opus */
 
-    /* or search */
-    if ( !b_found && b_fastseek )
+    /* or search, between the closest pages already seen */
+    if ( !b_found )
     {
-        int64_t i_sync_time;
-        i_lowerpos = OggBisectSearchByTime( p_demux, p_stream, i_time,
-                                            p_stream->i_data_start, p_sys->i_total_bytes,
-                                            &i_sync_time );
-        b_found = ( i_lowerpos != -1 );
+        int64_t i_pos_lower = p_stream->i_data_start;
+        int64_t i_pos_upper = p_sys->i_total_bytes;
+        OggSeekPageIndexBounds( p_stream, i_time, &i_pos_lower, &i_pos_upper );
+
+        /* bisecting a small enough range is cheap even on slow seeking streams */
+        if ( b_fastseek || ( i_pos_upper > i_pos_lower &&
+             i_pos_upper - i_pos_lower <= OGGSEEK_SERIALNO_MAX_LOOKUP_BYTES ) )
+        {
+            int64_t i_sync_time;
+            i_lowerpos = OggBisectSearchByTime( p_demux, p_stream, i_time,
+                                                i_pos_lower, i_pos_upper,
+                                                &i_sync_time );
+            b_found = ( i_lowerpos != -1 );
+        }
     }
 
     if ( !b_found ) return -1;
@@ -908,8 +969,9 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
 
 
     vlc_tick_t i_lower_index;
-    if(!OggSeekIndexFind( p_stream, i_time, &i_offset_lower, &i_offset_upper, &i_lower_index ))
+    if(!OggSeekIndexFind( &p_stream->idx, i_time, &i_offset_lower, &i_offset_upper, &i_lower_index ))
         i_lower_index = 0;
+    OggSeekPageIndexBounds( p_stream, i_time, &i_offset_lower, &i_offset_upper );
 
     i_offset_lower = __MAX( i_offset_lower, p_stream->i_data_start );
     i_offset_upper = __MIN( i_offset_upper, p_sys->i_total_bytes );
@@ -930,7 +992,7 @@ int Oggseek_SeektoAbsolutetime( demux_t *p_demux, logical_stream_t *p_stream,
               ? vlc_tick_from_sec( ceil( sqrt( SEC_FROM_VLC_TICK( p_sys->i_length ) ) / 2 ) )
               : vlc_tick_from_sec( 5 );
     if ( i_pagepos >= p_stream->i_data_start && ( i_sync_time - i_lower_index >= index_interval ) )
-        OggSeek_IndexAdd( p_stream, i_sync_time, i_pagepos );
+        OggSeek_IndexAdd( &p_stream->idx, i_sync_time, i_pagepos );
 
     OggDebug( msg_Dbg( p_demux, "=================== Seeked To %"PRId64" time %"PRId64, i_pagepos, i_time ) );
     return i_pagepos;
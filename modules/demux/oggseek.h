@@ -43,7 +43,6 @@
 /* this is typedefed to demux_index_entry_t in ogg.h */
 struct oggseek_index_entry
 {
-    demux_index_entry_t *p_next;
     /* value is highest granulepos for theora, sync frame for dirac */
     vlc_tick_t i_value;
     int64_t i_pagepos;
@@ -52,9 +51,10 @@ struct oggseek_index_entry
 int     Oggseek_BlindSeektoAbsoluteTime ( demux_t *, logical_stream_t *, vlc_tick_t, bool );
 int     Oggseek_BlindSeektoPosition ( demux_t *, logical_stream_t *, double f, bool );
 int     Oggseek_SeektoAbsolutetime ( demux_t *, logical_stream_t *, vlc_tick_t );
-const demux_index_entry_t *OggSeek_IndexAdd ( logical_stream_t *, vlc_tick_t, int64_t );
+const demux_index_entry_t *OggSeek_IndexAdd ( demux_index_t *, vlc_tick_t, int64_t );
+void    OggSeek_PageIndexAdd( logical_stream_t *, int64_t i_granule, int64_t i_pagepos );
 void    Oggseek_ProbeEnd( demux_t * );
 
-void oggseek_index_entries_free ( demux_index_entry_t * );
+void oggseek_index_entries_free ( demux_index_t * );
 
 int64_t oggseek_read_page ( demux_t * );
@@ -0,0 +1,900 @@
+/*****************************************************************************
+ * ring.c: binary ring buffer tracer plugin
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_configuration.h>
+#include <vlc_plugin.h>
+#include <vlc_fs.h>
+#include <vlc_threads.h>
+#include <vlc_tracer.h>
+
+#include <stdatomic.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+
+/*
+ * Traces are serialized as is, without any formatting, into a buffer owned
+ * by the tracing thread, so that tracing only costs a few copies and two
+ * atomic operations. A background thread drains the buffers periodically
+ * and writes them in a format readable by trace analysis tools:
+ *  - Perfetto protobuf traces (ui.perfetto.dev, trace_processor),
+ *  - CTF 1.8 traces (babeltrace, Trace Compass).
+ * Traces are dropped, and counted, when a buffer is full. The buffer of a
+ * thread is released when the thread exits, and freed once drained.
+ */
+
+#define RING_FILENAME "vlc-trace"
+#define RING_FLUSH_PERIOD VLC_TICK_FROM_MS(100)
+#define RING_ALIGN 8
+#define RING_ENTRIES_MAX 32
+#define RING_KEY_MAX 255
+#define RING_STRING_MAX 1024
+#define RING_WRAP 0xffff /* record count of the padding up to the end */
+
+/* Record header, followed by its entries */
+struct ring_record
+{
+    uint32_t size; /* including the header and padding */
+    uint16_t count;
+    uint16_t reserved;
+    int64_t ts;
+};
+
+/* Entry header, followed by the key and the value, strings being stored
+ * with their nul terminator */
+struct ring_entry
+{
+    uint8_t type;
+    uint8_t key_len;
+    uint16_t string_len;
+};
+
+/* Largest record: RING_ENTRIES_MAX entries with the longest key and string */
+#define RING_RECORD_MAX (sizeof (struct ring_record) + RING_ENTRIES_MAX * \
+    (sizeof (struct ring_entry) + RING_KEY_MAX + 1 + RING_STRING_MAX + 1))
+#define RING_SIZE_MIN (128 * 1024)
+static_assert(RING_SIZE_MIN >= 2 * RING_RECORD_MAX,
+              "the ring must hold twice the largest record");
+
+struct ring_buffer
+{
+    struct ring_buffer *next; /* immutable once published */
+    unsigned long tid;
+    bool described; /* flusher only */
+    atomic_bool exited; /* set once the tracing thread is gone */
+
+    /* byte counters, the written data is in [tail, head) */
+    _Atomic uint64_t head; /* written by the tracing thread */
+    _Atomic uint64_t tail; /* written by the flusher */
+    atomic_uint_least64_t dropped;
+
+    size_t size; /* power of 2 */
+    uint8_t data[];
+};
+
+static_assert(offsetof(struct ring_buffer, data) % RING_ALIGN == 0,
+              "misaligned records");
+
+struct pb_buffer
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    bool error;
+};
+
+enum ring_format
+{
+    RING_FORMAT_PERFETTO,
+    RING_FORMAT_CTF,
+};
+
+typedef struct
+{
+    vlc_object_t *obj;
+    uint64_t id;
+    enum ring_format format;
+    size_t ring_size;
+    FILE *stream;
+    uint32_t pid;
+
+    vlc_threadvar_t key; /* buffer of the current thread */
+
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    struct ring_buffer *rings;
+    uint64_t dropped; /* by the freed buffers */
+    bool stop;
+
+    vlc_thread_t thread;
+    struct pb_buffer pb;
+    bool first_packet;
+} vlc_tracer_sys_t;
+
+/* Last buffer used by the current thread, checked against the tracer id as
+ * tracers can be created and destroyed at the same address. */
+static thread_local struct
+{
+    uint64_t tracer_id;
+    struct ring_buffer *ring;
+} ring_current;
+
+static atomic_uint_least64_t ring_tracer_ids = 1;
+
+static struct ring_buffer *RingGet(vlc_tracer_sys_t *sys)
+{
+    if (likely(ring_current.tracer_id == sys->id))
+        return ring_current.ring;
+
+    struct ring_buffer *ring = vlc_threadvar_get(sys->key);
+    if (ring == NULL)
+    {
+        ring = malloc(sizeof (*ring) + sys->ring_size);
+        if (unlikely(ring == NULL))
+            return NULL;
+        if (unlikely(vlc_threadvar_set(sys->key, ring)))
+        {
+            free(ring);
+            return NULL;
+        }
+        ring->tid = vlc_thread_id();
+        ring->described = false;
+        atomic_init(&ring->exited, false);
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->dropped, 0);
+        ring->size = sys->ring_size;
+
+        vlc_mutex_lock(&sys->lock);
+        ring->next = sys->rings;
+        sys->rings = ring;
+        vlc_mutex_unlock(&sys->lock);
+    }
+
+    ring_current.tracer_id = sys->id;
+    ring_current.ring = ring;
+    return ring;
+}
+
+/* Called when a tracing thread exits, the flusher frees the buffer */
+static void RingRelease(void *data)
+{
+    struct ring_buffer *ring = data;
+
+    atomic_store_explicit(&ring->exited, true, memory_order_release);
+}
+
+static size_t EntryLength(const struct vlc_tracer_entry *entry,
+                          size_t *key_len, size_t *string_len)
+{
+    *key_len = strnlen(entry->key, RING_KEY_MAX);
+    *string_len = 0;
+
+    size_t len = sizeof (struct ring_entry) + *key_len + 1;
+    if (entry->type == VLC_TRACER_STRING)
+    {
+        if (entry->value.string != NULL)
+            *string_len = strnlen(entry->value.string, RING_STRING_MAX);
+        len += *string_len + 1;
+    }
+    else
+        len += 8;
+    return len;
+}
+
+static void RingTrace(void *opaque, vlc_tick_t ts,
+                      const struct vlc_tracer_trace *trace)
+{
+    vlc_tracer_sys_t *sys = opaque;
+    struct ring_buffer *ring = RingGet(sys);
+    if (unlikely(ring == NULL))
+        return;
+
+    size_t key_len, string_len;
+    size_t count = 0;
+    size_t size = sizeof (struct ring_record);
+    for (const struct vlc_tracer_entry *entry = trace->entries;
+         entry->key != NULL && count < RING_ENTRIES_MAX; entry++, count++)
+        size += EntryLength(entry, &key_len, &string_len);
+    size = (size + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1);
+
+    const uint64_t head = atomic_load_explicit(&ring->head,
+                                               memory_order_relaxed);
+    const uint64_t tail = atomic_load_explicit(&ring->tail,
+                                               memory_order_acquire);
+    size_t offset = head & (ring->size - 1);
+    const size_t padding = ring->size - offset < size ? ring->size - offset
+                                                      : 0;
+    if (size + padding > ring->size - (head - tail))
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    if (padding > 0)
+    {
+        struct ring_record *wrap = (struct ring_record *)&ring->data[offset];
+        wrap->size = padding;
+        wrap->count = RING_WRAP;
+        offset = 0;
+    }
+
+    struct ring_record *record = (struct ring_record *)&ring->data[offset];
+    record->size = size;
+    record->count = count;
+    record->ts = ts;
+
+    uint8_t *p = (uint8_t *)(record + 1);
+    const struct vlc_tracer_entry *entry = trace->entries;
+    for (size_t i = 0; i < count; i++, entry++)
+    {
+        EntryLength(entry, &key_len, &string_len);
+
+        struct ring_entry header = {
+            .type = entry->type,
+            .key_len = key_len,
+            .string_len = string_len,
+        };
+        memcpy(p, &header, sizeof (header));
+        p += sizeof (header);
+        memcpy(p, entry->key, key_len);
+        p[key_len] = '\0';
+        p += key_len + 1;
+
+        switch (entry->type)
+        {
+            case VLC_TRACER_INT:
+                memcpy(p, &entry->value.integer, 8);
+                p += 8;
+                break;
+            case VLC_TRACER_DOUBLE:
+                memcpy(p, &entry->value.double_, 8);
+                p += 8;
+                break;
+            case VLC_TRACER_STRING:
+                if (string_len > 0)
+                    memcpy(p, entry->value.string, string_len);
+                p[string_len] = '\0';
+                p += string_len + 1;
+                break;
+            default:
+                vlc_assert_unreachable();
+        }
+    }
+
+    atomic_store_explicit(&ring->head, head + padding + size,
+                          memory_order_release);
+}
+
+/*
+ * Perfetto protobuf writer
+ *
+ * Nested messages lengths are written as 4 bytes varints, so that they can
+ * be patched once the message is complete, like the Perfetto SDK does.
+ */
+
+/* TracePacket fields */
+#define PB_TRACE_PACKET 1
+#define PB_PACKET_TIMESTAMP 8
+#define PB_PACKET_SEQUENCE_ID 10
+#define PB_PACKET_TRACK_EVENT 11
+#define PB_PACKET_SEQUENCE_FLAGS 13
+#define PB_PACKET_CLOCK_ID 58
+#define PB_PACKET_TRACK_DESCRIPTOR 60
+/* TrackEvent fields */
+#define PB_EVENT_ANNOTATION 4
+#define PB_EVENT_TYPE 9
+#define PB_EVENT_TRACK_UUID 11
+#define PB_EVENT_NAME 23
+/* DebugAnnotation fields */
+#define PB_ANNOTATION_INT 4
+#define PB_ANNOTATION_DOUBLE 5
+#define PB_ANNOTATION_STRING 6
+#define PB_ANNOTATION_NAME 10
+/* TrackDescriptor fields */
+#define PB_TRACK_UUID 1
+#define PB_TRACK_NAME 2
+#define PB_TRACK_THREAD 4
+#define PB_THREAD_PID 1
+#define PB_THREAD_TID 2
+
+#define PB_SEQUENCE_ID 1
+#define PB_SEQ_INCREMENTAL_STATE_CLEARED 1
+#define PB_TYPE_INSTANT 3
+#define PB_CLOCK_MONOTONIC 3
+
+static void PbWrite(struct pb_buffer *pb, const void *data, size_t len)
+{
+    if (pb->size + len > pb->capacity)
+    {
+        size_t capacity = __MAX(pb->capacity * 2, pb->size + len);
+        uint8_t *buf = realloc(pb->data, capacity);
+        if (unlikely(buf == NULL))
+        {
+            pb->error = true;
+            return;
+        }
+        pb->data = buf;
+        pb->capacity = capacity;
+    }
+    memcpy(&pb->data[pb->size], data, len);
+    pb->size += len;
+}
+
+static void PbVarint(struct pb_buffer *pb, uint64_t value)
+{
+    uint8_t buf[10];
+    size_t len = 0;
+
+    do
+    {
+        buf[len] = value & 0x7f;
+        value >>= 7;
+        if (value != 0)
+            buf[len] |= 0x80;
+        len++;
+    }
+    while (value != 0);
+    PbWrite(pb, buf, len);
+}
+
+static void PbUint(struct pb_buffer *pb, unsigned field, uint64_t value)
+{
+    PbVarint(pb, field << 3);
+    PbVarint(pb, value);
+}
+
+static void PbDouble(struct pb_buffer *pb, unsigned field, double value)
+{
+    uint64_t bits;
+    uint8_t buf[8];
+
+    memcpy(&bits, &value, sizeof (bits));
+    SetQWLE(buf, bits);
+    PbVarint(pb, (field << 3) | 1);
+    PbWrite(pb, buf, sizeof (buf));
+}
+
+static void PbString(struct pb_buffer *pb, unsigned field, const char *str)
+{
+    const size_t len = strlen(str);
+
+    PbVarint(pb, (field << 3) | 2);
+    PbVarint(pb, len);
+    PbWrite(pb, str, len);
+}
+
+static size_t PbBegin(struct pb_buffer *pb, unsigned field)
+{
+    static const uint8_t placeholder[4];
+
+    PbVarint(pb, (field << 3) | 2);
+    PbWrite(pb, placeholder, sizeof (placeholder));
+    return pb->size;
+}
+
+static void PbEnd(struct pb_buffer *pb, size_t start)
+{
+    if (pb->error)
+        return;
+
+    const size_t len = pb->size - start;
+    assert(len < (1 << 28));
+    for (unsigned i = 0; i < 4; i++)
+        pb->data[start - 4 + i] = ((len >> (7 * i)) & 0x7f) | (i < 3 ? 0x80 : 0);
+}
+
+static void PerfettoFlushPacket(vlc_tracer_sys_t *sys)
+{
+    if (!sys->pb.error)
+        fwrite(sys->pb.data, 1, sys->pb.size, sys->stream);
+    sys->pb.size = 0;
+    sys->pb.error = false;
+}
+
+static void PerfettoDescribe(vlc_tracer_sys_t *sys,
+                             const struct ring_buffer *ring)
+{
+    struct pb_buffer *pb = &sys->pb;
+    char name[32];
+
+    snprintf(name, sizeof (name), "thread %lu", ring->tid);
+
+    size_t packet = PbBegin(pb, PB_TRACE_PACKET);
+    PbUint(pb, PB_PACKET_SEQUENCE_ID, PB_SEQUENCE_ID);
+    if (sys->first_packet)
+    {
+        PbUint(pb, PB_PACKET_SEQUENCE_FLAGS, PB_SEQ_INCREMENTAL_STATE_CLEARED);
+        sys->first_packet = false;
+    }
+    size_t track = PbBegin(pb, PB_PACKET_TRACK_DESCRIPTOR);
+    PbUint(pb, PB_TRACK_UUID, ring->tid);
+    PbString(pb, PB_TRACK_NAME, name);
+    size_t thread = PbBegin(pb, PB_TRACK_THREAD);
+    PbUint(pb, PB_THREAD_PID, sys->pid);
+    PbUint(pb, PB_THREAD_TID, ring->tid);
+    PbEnd(pb, thread);
+    PbEnd(pb, track);
+    PbEnd(pb, packet);
+
+    PerfettoFlushPacket(sys);
+}
+
+static void PerfettoEvent(vlc_tracer_sys_t *sys, const struct ring_buffer *ring,
+                          vlc_tick_t ts, const struct vlc_tracer_entry *entries)
+{
+    struct pb_buffer *pb = &sys->pb;
+
+    /* Name the event after its type, as the JSON traces are filtered */
+    const char *name = "trace";
+    for (const struct vlc_tracer_entry *entry = entries; entry->key != NULL;
+         entry++)
+        if (entry->type == VLC_TRACER_STRING && !strcmp(entry->key, "type"))
+        {
+            name = entry->value.string;
+            break;
+        }
+
+    size_t packet = PbBegin(pb, PB_TRACE_PACKET);
+    PbUint(pb, PB_PACKET_TIMESTAMP, NS_FROM_VLC_TICK(ts));
+    PbUint(pb, PB_PACKET_CLOCK_ID, PB_CLOCK_MONOTONIC);
+    PbUint(pb, PB_PACKET_SEQUENCE_ID, PB_SEQUENCE_ID);
+
+    size_t event = PbBegin(pb, PB_PACKET_TRACK_EVENT);
+    PbUint(pb, PB_EVENT_TYPE, PB_TYPE_INSTANT);
+    PbUint(pb, PB_EVENT_TRACK_UUID, ring->tid);
+    PbString(pb, PB_EVENT_NAME, name);
+    for (const struct vlc_tracer_entry *entry = entries; entry->key != NULL;
+         entry++)
+    {
+        size_t annotation = PbBegin(pb, PB_EVENT_ANNOTATION);
+        PbString(pb, PB_ANNOTATION_NAME, entry->key);
+        switch (entry->type)
+        {
+            case VLC_TRACER_INT:
+                PbUint(pb, PB_ANNOTATION_INT, entry->value.integer);
+                break;
+            case VLC_TRACER_DOUBLE:
+                PbDouble(pb, PB_ANNOTATION_DOUBLE, entry->value.double_);
+                break;
+            case VLC_TRACER_STRING:
+                PbString(pb, PB_ANNOTATION_STRING, entry->value.string);
+                break;
+            default:
+                vlc_assert_unreachable();
+        }
+        PbEnd(pb, annotation);
+    }
+    PbEnd(pb, event);
+    PbEnd(pb, packet);
+
+    PerfettoFlushPacket(sys);
+}
+
+/*
+ * CTF writer
+ *
+ * The trace is a directory holding the TSDL metadata and a single stream
+ * file of native endian events.
+ */
+
+#define CTF_MAGIC 0xC1FC1FC1
+
+static const char ctf_metadata[] =
+    "/* CTF 1.8 */\n"
+    "\n"
+    "typealias integer { size = 8; align = 8; signed = false; } := uint8_t;\n"
+    "typealias integer { size = 16; align = 8; signed = false; } := uint16_t;\n"
+    "typealias integer { size = 32; align = 8; signed = false; } := uint32_t;\n"
+    "typealias integer { size = 64; align = 8; signed = false; } := uint64_t;\n"
+    "typealias integer { size = 64; align = 8; signed = true; } := int64_t;\n"
+    "typealias floating_point { exp_dig = 11; mant_dig = 53; align = 8; } := double;\n"
+    "\n"
+    "trace {\n"
+    "    major = 1;\n"
+    "    minor = 8;\n"
+#ifdef WORDS_BIGENDIAN
+    "    byte_order = be;\n"
+#else
+    "    byte_order = le;\n"
+#endif
+    "    packet.header := struct { uint32_t magic; };\n"
+    "};\n"
+    "\n"
+    "clock {\n"
+    "    name = monotonic;\n"
+    "    freq = 1000000000;\n"
+    "};\n"
+    "\n"
+    "typealias integer {\n"
+    "    size = 64; align = 8; signed = false;\n"
+    "    map = clock.monotonic.value;\n"
+    "} := clock_t;\n"
+    "\n"
+    "stream {\n"
+    "    event.header := struct { clock_t timestamp; };\n"
+    "    event.context := struct { uint64_t tid; };\n"
+    "};\n"
+    "\n"
+    "enum entry_type : uint8_t { INT = 0, DOUBLE = 1, STRING = 2 };\n"
+    "\n"
+    "struct entry {\n"
+    "    enum entry_type type;\n"
+    "    string key;\n"
+    "    variant <type> { int64_t INT; double DOUBLE; string STRING; } value;\n"
+    "};\n"
+    "\n"
+    "event {\n"
+    "    name = \"vlc_trace\";\n"
+    "    fields := struct {\n"
+    "        uint16_t count;\n"
+    "        struct entry entries[count];\n"
+    "    };\n"
+    "};\n";
+
+static_assert(VLC_TRACER_INT == 0 && VLC_TRACER_DOUBLE == 1 &&
+              VLC_TRACER_STRING == 2, "CTF entry types mismatch");
+
+static void CtfEvent(vlc_tracer_sys_t *sys, const struct ring_buffer *ring,
+                     vlc_tick_t ts, const struct vlc_tracer_entry *entries)
+{
+    FILE *stream = sys->stream;
+    const uint64_t timestamp = NS_FROM_VLC_TICK(ts);
+    const uint64_t tid = ring->tid;
+    uint16_t count = 0;
+
+    for (const struct vlc_tracer_entry *entry = entries; entry->key != NULL;
+         entry++)
+        count++;
+
+    fwrite(&timestamp, sizeof (timestamp), 1, stream);
+    fwrite(&tid, sizeof (tid), 1, stream);
+    fwrite(&count, sizeof (count), 1, stream);
+
+    for (const struct vlc_tracer_entry *entry = entries; entry->key != NULL;
+         entry++)
+    {
+        const uint8_t type = entry->type;
+        fwrite(&type, 1, 1, stream);
+        fwrite(entry->key, strlen(entry->key) + 1, 1, stream);
+        switch (entry->type)
+        {
+            case VLC_TRACER_INT:
+                fwrite(&entry->value.integer, 8, 1, stream);
+                break;
+            case VLC_TRACER_DOUBLE:
+                fwrite(&entry->value.double_, 8, 1, stream);
+                break;
+            case VLC_TRACER_STRING:
+                fwrite(entry->value.string, strlen(entry->value.string) + 1,
+                       1, stream);
+                break;
+            default:
+                vlc_assert_unreachable();
+        }
+    }
+}
+
+/*
+ * Flusher
+ */
+
+static void RecordEntries(const struct ring_record *record,
+                          struct vlc_tracer_entry *entries)
+{
+    const uint8_t *p = (const uint8_t *)(record + 1);
+
+    for (size_t i = 0; i < record->count; i++)
+    {
+        struct ring_entry header;
+        memcpy(&header, p, sizeof (header));
+        p += sizeof (header);
+
+        entries[i].key = (const char *)p;
+        entries[i].type = header.type;
+        p += header.key_len + 1;
+
+        switch (header.type)
+        {
+            case VLC_TRACER_INT:
+                memcpy(&entries[i].value.integer, p, 8);
+                p += 8;
+                break;
+            case VLC_TRACER_DOUBLE:
+                memcpy(&entries[i].value.double_, p, 8);
+                p += 8;
+                break;
+            case VLC_TRACER_STRING:
+                entries[i].value.string = (const char *)p;
+                p += header.string_len + 1;
+                break;
+            default:
+                vlc_assert_unreachable();
+        }
+    }
+    entries[record->count].key = NULL;
+}
+
+static void FlushRing(vlc_tracer_sys_t *sys, struct ring_buffer *ring)
+{
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const uint64_t head = atomic_load_explicit(&ring->head,
+                                               memory_order_acquire);
+    if (tail == head)
+        return;
+
+    if (sys->format == RING_FORMAT_PERFETTO && !ring->described)
+    {
+        PerfettoDescribe(sys, ring);
+        ring->described = true;
+    }
+
+    while (tail != head)
+    {
+        const struct ring_record *record =
+            (const struct ring_record *)&ring->data[tail & (ring->size - 1)];
+
+        if (record->count != RING_WRAP)
+        {
+            struct vlc_tracer_entry entries[RING_ENTRIES_MAX + 1];
+            RecordEntries(record, entries);
+
+            if (sys->format == RING_FORMAT_PERFETTO)
+                PerfettoEvent(sys, ring, record->ts, entries);
+            else
+                CtfEvent(sys, ring, record->ts, entries);
+        }
+        tail += record->size;
+    }
+
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+static void FlushRings(vlc_tracer_sys_t *sys)
+{
+    /* Buffers are only prepended by the tracing threads, and only removed
+     * below, by the flusher */
+    vlc_mutex_lock(&sys->lock);
+    struct ring_buffer *rings = sys->rings;
+    vlc_mutex_unlock(&sys->lock);
+
+    for (struct ring_buffer *ring = rings; ring != NULL; ring = ring->next)
+        FlushRing(sys, ring);
+    fflush(sys->stream);
+
+    /* Free the buffers of the exited threads, once drained */
+    vlc_mutex_lock(&sys->lock);
+    for (struct ring_buffer **pp = &sys->rings, *ring; (ring = *pp) != NULL;)
+    {
+        if (atomic_load_explicit(&ring->exited, memory_order_acquire)
+         && atomic_load_explicit(&ring->head, memory_order_relaxed)
+         == atomic_load_explicit(&ring->tail, memory_order_relaxed))
+        {
+            *pp = ring->next;
+            sys->dropped += atomic_load_explicit(&ring->dropped,
+                                                 memory_order_relaxed);
+            free(ring);
+        }
+        else
+            pp = &ring->next;
+    }
+    vlc_mutex_unlock(&sys->lock);
+}
+
+static void *Thread(void *opaque)
+{
+    vlc_tracer_sys_t *sys = opaque;
+
+    vlc_thread_set_name("vlc-tracer");
+
+    vlc_mutex_lock(&sys->lock);
+    while (!sys->stop)
+    {
+        vlc_cond_timedwait(&sys->wait, &sys->lock,
+                           vlc_tick_now() + RING_FLUSH_PERIOD);
+        vlc_mutex_unlock(&sys->lock);
+        FlushRings(sys);
+        vlc_mutex_lock(&sys->lock);
+    }
+    vlc_mutex_unlock(&sys->lock);
+    return NULL;
+}
+
+static void Close(void *opaque)
+{
+    vlc_tracer_sys_t *sys = opaque;
+
+    vlc_mutex_lock(&sys->lock);
+    sys->stop = true;
+    vlc_cond_signal(&sys->wait);
+    vlc_mutex_unlock(&sys->lock);
+    vlc_join(sys->thread, NULL);
+
+    /* Traces emitted while stopping */
+    FlushRings(sys);
+    vlc_threadvar_delete(&sys->key);
+
+    uint64_t dropped = sys->dropped;
+    for (struct ring_buffer *ring = sys->rings, *next; ring != NULL;
+         ring = next)
+    {
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        next = ring->next;
+        free(ring);
+    }
+    if (dropped > 0)
+        msg_Warn(sys->obj, "%" PRIu64 " traces dropped, the buffers are too "
+                 "small", dropped);
+
+    fclose(sys->stream);
+    free(sys->pb.data);
+    free(sys);
+}
+
+static const struct vlc_tracer_operations ring_ops =
+{
+    RingTrace,
+    Close
+};
+
+static FILE *OpenCtf(vlc_object_t *obj, const char *dirname)
+{
+    if (vlc_mkdir(dirname, 0755) != 0 && errno != EEXIST)
+    {
+        msg_Err(obj, "cannot create trace directory `%s': %s", dirname,
+                vlc_strerror_c(errno));
+        return NULL;
+    }
+
+    char *path;
+    if (asprintf(&path, "%s" DIR_SEP "metadata", dirname) == -1)
+        return NULL;
+    FILE *metadata = vlc_fopen(path, "wb");
+    free(path);
+    if (metadata == NULL)
+    {
+        msg_Err(obj, "cannot write trace metadata: %s", vlc_strerror_c(errno));
+        return NULL;
+    }
+    fputs(ctf_metadata, metadata);
+    fclose(metadata);
+
+    if (asprintf(&path, "%s" DIR_SEP "stream", dirname) == -1)
+        return NULL;
+    FILE *stream = vlc_fopen(path, "wb");
+    free(path);
+    if (stream == NULL)
+    {
+        msg_Err(obj, "cannot write trace stream: %s", vlc_strerror_c(errno));
+        return NULL;
+    }
+
+    const uint32_t magic = CTF_MAGIC;
+    fwrite(&magic, sizeof (magic), 1, stream);
+    return stream;
+}
+
+static const struct vlc_tracer_operations *Open(vlc_object_t *obj,
+                                               void **restrict sysp)
+{
+    vlc_tracer_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return NULL;
+
+    sys->obj = obj;
+    sys->id = atomic_fetch_add_explicit(&ring_tracer_ids, 1,
+                                        memory_order_relaxed);
+    sys->pid = getpid();
+
+    char *format = var_InheritString(obj, "ring-tracer-format");
+    sys->format = format != NULL && !strcmp(format, "ctf") ? RING_FORMAT_CTF
+                                                           : RING_FORMAT_PERFETTO;
+    free(format);
+
+    /* at least twice the largest record, so that it still fits after the
+     * padding up to the end of the ring */
+    size_t size = RING_SIZE_MIN;
+    const size_t kib = var_InheritInteger(obj, "ring-tracer-buffer");
+    while (size < kib * 1024 && size < SIZE_MAX / 2)
+        size *= 2;
+    sys->ring_size = size;
+
+    char *path = var_InheritString(obj, "ring-tracer-file");
+    const char *filename = path;
+    if (filename == NULL)
+        filename = sys->format == RING_FORMAT_CTF ? RING_FILENAME ".ctf"
+                                                  : RING_FILENAME ".perfetto-trace";
+
+    msg_Dbg(obj, "writing traces to `%s'", filename);
+    if (sys->format == RING_FORMAT_CTF)
+        sys->stream = OpenCtf(obj, filename);
+    else
+    {
+        sys->stream = vlc_fopen(filename, "wb");
+        if (sys->stream == NULL)
+            msg_Err(obj, "error opening trace file `%s': %s", filename,
+                    vlc_strerror_c(errno));
+    }
+    free(path);
+    if (sys->stream == NULL)
+    {
+        free(sys);
+        return NULL;
+    }
+
+    if (vlc_threadvar_create(&sys->key, RingRelease))
+    {
+        fclose(sys->stream);
+        free(sys);
+        return NULL;
+    }
+
+    vlc_mutex_init(&sys->lock);
+    vlc_cond_init(&sys->wait);
+    sys->rings = NULL;
+    sys->dropped = 0;
+    sys->stop = false;
+    sys->pb.data = NULL;
+    sys->pb.size = sys->pb.capacity = 0;
+    sys->pb.error = false;
+    sys->first_packet = true;
+
+    if (vlc_clone(&sys->thread, Thread, sys))
+    {
+        vlc_threadvar_delete(&sys->key);
+        fclose(sys->stream);
+        free(sys);
+        return NULL;
+    }
+
+    *sysp = sys;
+    return &ring_ops;
+}
+
+#define FILE_TEXT N_("Trace filename")
+#define FILE_LONGTEXT N_("Specify the trace filename, or directory for " \
+    "CTF traces.")
+#define FORMAT_TEXT N_("Trace format")
+#define FORMAT_LONGTEXT N_("Format of the written traces.")
+#define BUFFER_TEXT N_("Buffer size (KiB)")
+#define BUFFER_LONGTEXT N_("Size of the trace buffer of each thread. " \
+    "Traces are dropped when the buffer is full.")
+
+static const char *const ppsz_format_values[] = { "perfetto", "ctf" };
+static const char *const ppsz_format_descriptions[] = { "Perfetto", "CTF" };
+
+vlc_module_begin()
+    set_shortname(N_("Tracer"))
+    set_description(N_("Binary ring buffer tracer"))
+    set_subcategory(SUBCAT_ADVANCED_MISC)
+    set_capability("tracer", 0)
+    set_callback(Open)
+
+    add_savefile("ring-tracer-file", NULL, FILE_TEXT, FILE_LONGTEXT)
+    add_string("ring-tracer-format", "perfetto", FORMAT_TEXT, FORMAT_LONGTEXT)
+        change_string_list(ppsz_format_values, ppsz_format_descriptions)
+    add_integer_with_range("ring-tracer-buffer", 1024, RING_SIZE_MIN / 1024,
+                           1024 * 1024, BUFFER_TEXT, BUFFER_LONGTEXT)
+vlc_module_end()
@@ -33,15 +33,43 @@
 
 #define kBufferSize 0x500
 
+#include <stdbit.h>
+
 #define VLC_MODULE_LICENSE VLC_LICENSE_GPL_2_PLUS
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_codec.h>
 #include <vlc_demux.h>
+#include <vlc_input_item.h>
 
 /*** Decoder ***/
+typedef struct
+{
+    /* Delays between the encoder and the decoder */
+    struct input_stats_histogram offsets;
+} decoder_sys_t;
+
+static void AddOffset( decoder_sys_t *p_sys, vlc_tick_t offset )
+{
+    struct input_stats_histogram *h = &p_sys->offsets;
+
+    if( offset < 0 )
+        offset = 0;
+
+    unsigned bucket = stdc_bit_width( (unsigned long long)US_FROM_VLC_TICK(offset) );
+    if( bucket >= INPUT_STATS_HISTOGRAM_BUCKETS )
+        bucket = INPUT_STATS_HISTOGRAM_BUCKETS - 1;
+
+    h->buckets[bucket]++;
+    h->i_count++;
+    h->i_total += offset;
+    if( offset > h->i_max )
+        h->i_max = offset;
+}
+
 static int DecodeBlock( decoder_t *p_dec, block_t *p_block )
 {
+    decoder_sys_t *p_sys = p_dec->p_sys;
     picture_t * p_pic = NULL;
 
     if( p_block == NULL ) /* No Drain */
@@ -56,8 +84,10 @@ static int DecodeBlock( decoder_t *p_dec, block_t *p_block )
     {
         msg_Dbg( p_dec, "got %"PRIu64" ms",
                  MS_FROM_VLC_TICK(*(vlc_tick_t *)p_block->p_buffer) );
-        msg_Dbg( p_dec, "got %"PRIu64" ms offset",
-                 MS_FROM_VLC_TICK(vlc_tick_now() - *(vlc_tick_t *)p_block->p_buffer) );
+        const vlc_tick_t offset =
+            vlc_tick_now() - *(vlc_tick_t *)p_block->p_buffer;
+        msg_Dbg( p_dec, "got %"PRIu64" ms offset", MS_FROM_VLC_TICK(offset) );
+        AddOffset( p_sys, offset );
         *(vlc_tick_t *)(p_pic->p->p_pixels) = *(vlc_tick_t *)p_block->p_buffer;
     }
     else
@@ -81,6 +111,11 @@ static int OpenDecoder ( vlc_object_t *p_this )
 
     msg_Dbg( p_this, "opening stats decoder" );
 
+    decoder_sys_t *p_sys = vlc_obj_calloc( p_this, 1, sizeof (*p_sys) );
+    if( p_sys == NULL )
+        return VLC_ENOMEM;
+    p_dec->p_sys = p_sys;
+
     /* Set callbacks */
     p_dec->pf_decode = DecodeBlock;
 
@@ -94,6 +129,23 @@ static int OpenDecoder ( vlc_object_t *p_this )
     return VLC_SUCCESS;
 }
 
+static void CloseDecoder( vlc_object_t *p_this )
+{
+    decoder_t *p_dec = (decoder_t*)p_this;
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    const struct input_stats_histogram *h = &p_sys->offsets;
+
+    if( h->i_count == 0 )
+        return;
+
+    msg_Dbg( p_dec, "%"PRIu64" offsets: mean %"PRId64" us, p50 %"PRId64
+             " us, p99 %"PRId64" us, max %"PRId64" us", h->i_count,
+             US_FROM_VLC_TICK(h->i_total) / (int64_t)h->i_count,
+             US_FROM_VLC_TICK(input_stats_histogram_Percentile(h, 50)),
+             US_FROM_VLC_TICK(input_stats_histogram_Percentile(h, 99)),
+             US_FROM_VLC_TICK(h->i_max) );
+}
+
 /*** Encoder ***/
 #ifdef ENABLE_SOUT
 static block_t *EncodeVideo( encoder_t *p_enc, picture_t *p_pict )
@@ -242,19 +294,19 @@ vlc_module_begin ()
         set_description( N_("Stats decoder function") )
         set_capability( "video decoder", 0 )
         add_shortcut( "stats" )
-        set_callback( OpenDecoder )
+        set_callbacks( OpenDecoder, CloseDecoder )
     add_submodule()
         set_section( N_( "Stats decoder" ), NULL )
         set_description( N_("Stats decoder function") )
         set_capability( "audio decoder", 0 )
         add_shortcut( "stats" )
-        set_callback( OpenDecoder )
+        set_callbacks( OpenDecoder, CloseDecoder )
     add_submodule()
         set_section( N_( "Stats decoder" ), NULL )
         set_description( N_("Stats decoder function") )
         set_capability( "spu decoder", 0 )
         add_shortcut( "stats" )
-        set_callback( OpenDecoder )
+        set_callbacks( OpenDecoder, CloseDecoder )
     add_submodule ()
         set_section( N_( "Stats demux" ), NULL )
         set_description( N_("Stats demux function") )
@@ -57,6 +57,12 @@
     "Create \"Fast Start\" files. " \
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
+#define FASTSTART_DURATION_TEXT N_("Expected duration for \"Fast Start\"")
+#define FASTSTART_DURATION_LONGTEXT N_(\
+    "Expected duration of the recording, in seconds. When set, space for " \
+    "the index is reserved at the start of \"Fast Start\" files, so that " \
+    "the media data does not need to be moved when closing the file, " \
+    "unless the estimate was exceeded.")
 
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
@@ -64,6 +70,8 @@ static void CloseFrag  (vlc_object_t *);
 
 #define SOUT_CFG_PREFIX "sout-mp4-"
 
+#define FASTSTART_MOVE_SIZE (1024 * 1024)
+
 vlc_module_begin ()
     set_description(N_("MP4/MOV muxer"))
     set_subcategory(SUBCAT_SOUT_MUX)
@@ -71,6 +79,9 @@ vlc_module_begin ()
 
     add_bool(SOUT_CFG_PREFIX "faststart", false,
               FASTSTART_TEXT, FASTSTART_LONGTEXT)
+    add_integer(SOUT_CFG_PREFIX "faststart-duration", 0,
+                FASTSTART_DURATION_TEXT, FASTSTART_DURATION_LONGTEXT)
+        change_integer_range(0, INT_MAX)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -89,7 +100,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "faststart-duration", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -159,10 +170,13 @@ typedef struct
     mp4mux_handle_t *muxh;
     bool b_3gp;
     bool b_fast_start;
+    vlc_tick_t i_fast_start_duration;
 
     /* global */
     bool     b_header_sent;
 
+    uint64_t i_moov_space_pos; /* space reserved for the moov, if any */
+    uint64_t i_moov_space;
     uint64_t i_mdat_pos;
     uint64_t i_pos;
     vlc_tick_t  i_read_duration;
@@ -248,6 +262,40 @@ static void ReorderStreams(mp4_stream_t **pp_streams, unsigned int i_streams)
         mp4mux_track_ChangeID(pp_streams[i]->tinfo, i+1);
 }
 
+#define MOOV_BASE_SIZE 4096
+#define MOOV_BYTES_PER_SAMPLE 32 /* worst case stsz, stts, ctts, stsc, co64 */
+
+static uint64_t EstimateMoovSize(sout_mux_t *p_mux, vlc_tick_t i_duration)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    uint64_t i_samples = 0;
+
+    for (unsigned int i = 0; i < p_sys->i_nb_streams; i++)
+    {
+        const es_format_t *fmt = mp4mux_track_GetFmt(p_sys->pp_streams[i]->tinfo);
+        uint64_t i_rate; /* samples per second */
+        switch (fmt->i_cat)
+        {
+            case VIDEO_ES:
+                if (fmt->video.i_frame_rate && fmt->video.i_frame_rate_base)
+                    i_rate = 1 + fmt->video.i_frame_rate / fmt->video.i_frame_rate_base;
+                else
+                    i_rate = 60;
+                break;
+            case AUDIO_ES:
+                /* assume the smallest usual frames */
+                i_rate = fmt->audio.i_rate ? 1 + fmt->audio.i_rate / 1024 : 50;
+                break;
+            default:
+                i_rate = 10;
+                break;
+        }
+        i_samples += i_rate * SEC_FROM_VLC_TICK(i_duration);
+    }
+
+    return MOOV_BASE_SIZE + i_samples * MOOV_BYTES_PER_SAMPLE;
+}
+
 static int WriteSlowStartHeader(sout_mux_t *p_mux)
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
@@ -265,6 +313,28 @@ static int WriteSlowStartHeader(sout_mux_t *p_mux)
         box_send(p_mux, box);
     }
 
+    /* Reserve the moov space, as a free box */
+    if (p_sys->b_fast_start && p_sys->i_fast_start_duration > 0)
+    {
+        uint64_t i_space = EstimateMoovSize(p_mux, p_sys->i_fast_start_duration);
+        if (i_space > UINT32_MAX)
+            i_space = UINT32_MAX;
+
+        block_t *p_free = block_Alloc(i_space);
+        if (!p_free)
+            return VLC_ENOMEM;
+        SetDWBE(p_free->p_buffer, i_space);
+        memcpy(&p_free->p_buffer[4], "free", 4);
+        memset(&p_free->p_buffer[8], 0, i_space - 8);
+
+        msg_Dbg(p_mux, "reserving %"PRIu64" bytes for moov", i_space);
+        p_sys->i_moov_space_pos = p_sys->i_pos;
+        p_sys->i_moov_space = i_space;
+        p_sys->i_pos += i_space;
+        p_sys->i_mdat_pos = p_sys->i_pos;
+        sout_AccessOutWrite(p_mux->p_access, p_free);
+    }
+
     /* Now add mdat header */
     box = box_new("mdat");
     if(!box)
@@ -310,7 +380,12 @@ static int Open(vlc_object_t *p_this)
     p_sys->i_nb_streams = 0;
     p_sys->pp_streams   = NULL;
     p_sys->i_mdat_pos   = 0;
+    p_sys->i_moov_space_pos = 0;
+    p_sys->i_moov_space = 0;
     p_sys->b_header_sent = false;
+    p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+    p_sys->i_fast_start_duration = vlc_tick_from_sec(
+        var_GetInteger(p_this, SOUT_CFG_PREFIX "faststart-duration"));
 
     p_sys->i_read_duration   = 0;
     p_sys->i_written_duration= 0;
@@ -376,11 +451,11 @@ static void Close(vlc_object_t *p_this)
     bo_t *moov = mp4mux_GetMoov(p_sys->muxh, VLC_OBJECT(p_mux), 0);
 
     /* Check we need to create "fast start" files */
-    p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+    uint64_t i_moov_pad = 0;
     while (p_sys->b_fast_start && moov && moov->b)
     {
-        /* Move data to the end of the file so we can fit the moov header
-         * at the start */
+        /* Move data to the end of the file, if the moov header does not fit
+         * in the space reserved at the start */
         uint64_t i_mdatsize = p_sys->i_pos - p_sys->i_mdat_pos;
 
         /* moving samples will need new moov with 64bit atoms ? */
@@ -398,47 +473,81 @@ static void Close(vlc_object_t *p_this)
         }
         /* We now know our final MOOV size */
 
-        /* Fix-up samples to chunks table in MOOV header to they point to next MDAT location */
-        mp4mux_ShiftSamples(p_sys->muxh, bo_size(moov));
-        msg_Dbg(p_this,"Moving data by %"PRIu64, (uint64_t)bo_size(moov));
-        bo_t *shifted = mp4mux_GetMoov(p_sys->muxh, VLC_OBJECT(p_mux), 0);
-        if(!shifted)
-        {
-            /* fail */
-            p_sys->b_fast_start = false;
-            continue;
-        }
-        assert(bo_size(shifted) == bo_size(moov));
-        bo_free(moov);
-        moov = shifted;
+        /* Leave either no room or enough for a free box after the moov */
+        uint64_t i_shift = 0;
+        if (bo_size(moov) > p_sys->i_moov_space)
+            i_shift = bo_size(moov) - p_sys->i_moov_space;
+        else if (p_sys->i_moov_space - bo_size(moov) < 8 &&
+                 p_sys->i_moov_space != bo_size(moov))
+            i_shift = 8 - (p_sys->i_moov_space - bo_size(moov));
 
-        /* Make space, move MDAT data by moov size towards the end */
-        while (i_mdatsize > 0)
+        if (i_shift > 0)
         {
-            size_t i_chunk = __MIN(32768, i_mdatsize);
-            block_t *p_buf = block_Alloc(i_chunk);
-            sout_AccessOutSeek(p_mux->p_access,
-                                p_sys->i_mdat_pos + i_mdatsize - i_chunk);
-            ssize_t i_read = sout_AccessOutRead(p_mux->p_access, p_buf);
-            if (i_read < 0 || (size_t) i_read < i_chunk) {
-                msg_Warn(p_this, "read() not supported by access output, "
-                          "won't create a fast start file");
+            if (p_sys->i_moov_space)
+                msg_Warn(p_this, "reserved moov space exceeded by %"PRIu64" bytes",
+                         i_shift);
+
+            /* Fix-up samples to chunks table in MOOV header to they point to next MDAT location */
+            mp4mux_ShiftSamples(p_sys->muxh, i_shift);
+            msg_Dbg(p_this,"Moving data by %"PRIu64, i_shift);
+            bo_t *shifted = mp4mux_GetMoov(p_sys->muxh, VLC_OBJECT(p_mux), 0);
+            if(!shifted)
+            {
+                /* fail */
+                mp4mux_ShiftSamples(p_sys->muxh, -(int64_t)i_shift);
                 p_sys->b_fast_start = false;
-                block_Release(p_buf);
-                break;
+                continue;
             }
-            sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_mdatsize +
-                               bo_size(moov) - i_chunk);
-            sout_AccessOutWrite(p_mux->p_access, p_buf);
-            i_mdatsize -= i_chunk;
-        }
+            assert(bo_size(shifted) == bo_size(moov));
+            bo_free(moov);
+            moov = shifted;
 
-        if (!p_sys->b_fast_start) /* failed above */
-            continue;
+            /* Make space, move MDAT data by the missing size towards the end */
+            while (i_mdatsize > 0)
+            {
+                size_t i_chunk = __MIN(FASTSTART_MOVE_SIZE, i_mdatsize);
+                block_t *p_buf = block_Alloc(i_chunk);
+                if (!p_buf)
+                {
+                    p_sys->b_fast_start = false;
+                    break;
+                }
+                sout_AccessOutSeek(p_mux->p_access,
+                                    p_sys->i_mdat_pos + i_mdatsize - i_chunk);
+                ssize_t i_read = sout_AccessOutRead(p_mux->p_access, p_buf);
+                if (i_read < 0 || (size_t) i_read < i_chunk) {
+                    msg_Warn(p_this, "read() not supported by access output, "
+                              "won't create a fast start file");
+                    p_sys->b_fast_start = false;
+                    block_Release(p_buf);
+                    break;
+                }
+                sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos + i_mdatsize +
+                                   i_shift - i_chunk);
+                sout_AccessOutWrite(p_mux->p_access, p_buf);
+                i_mdatsize -= i_chunk;
+            }
 
-        /* Update pos pointers */
-        i_moov_pos = p_sys->i_mdat_pos;
-        p_sys->i_mdat_pos += bo_size(moov);
+            if (!p_sys->b_fast_start) /* failed above */
+            {
+                if (i_mdatsize == p_sys->i_pos - p_sys->i_mdat_pos)
+                {
+                    /* nothing moved, the moov can still go at the end */
+                    mp4mux_ShiftSamples(p_sys->muxh, -(int64_t)i_shift);
+                    bo_t *unshifted = mp4mux_GetMoov(p_sys->muxh, VLC_OBJECT(p_mux), 0);
+                    bo_free(moov);
+                    moov = unshifted;
+                }
+                continue;
+            }
+
+            /* Update pos pointers */
+            p_sys->i_mdat_pos += i_shift;
+        }
+
+        i_moov_pos = p_sys->i_moov_space ? p_sys->i_moov_space_pos
+                                         : p_sys->i_mdat_pos - i_shift;
+        i_moov_pad = p_sys->i_moov_space + i_shift - bo_size(moov);
 
         p_sys->b_fast_start = false;
     }
@@ -448,6 +557,18 @@ static void Close(vlc_object_t *p_this)
     if (moov != NULL)
         box_send(p_mux, moov);
 
+    /* and pad up to the media data */
+    if (i_moov_pad > 0)
+    {
+        bo_t pad;
+        if (bo_init(&pad, 8))
+        {
+            bo_add_32be  (&pad, i_moov_pad);
+            bo_add_fourcc(&pad, "free");
+            sout_AccessOutWrite(p_mux->p_access, pad.b);
+        }
+    }
+
 cleanup:
     /* Clean-up */
     for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++)
@@ -38,6 +38,11 @@ struct csa_t
 {
     bool    use_odd;
     struct dvbcsa_key_s *keys[2];
+
+    /* bitsliced keys and batches, for csa_DecryptBatch */
+    struct dvbcsa_bs_key_s *bs_keys[2];
+    struct dvbcsa_bs_batch_s *bs_batch[2];
+    unsigned i_bs_batch_size;
 };
 
 /*****************************************************************************
@@ -46,18 +51,24 @@ struct csa_t
 csa_t *csa_New( void )
 {
     csa_t *csa = calloc( 1, sizeof( csa_t ) );
-    if(csa)
+    if( !csa )
+        return NULL;
+
+    csa->i_bs_batch_size = dvbcsa_bs_batch_size();
+    for( int i = 0; i < 2; i++ )
     {
-        csa->keys[0] = dvbcsa_key_alloc();
-        if(csa->keys[0])
-            csa->keys[1] = dvbcsa_key_alloc();
-        if(csa->keys[1])
-            return csa;
-        else
-            dvbcsa_key_free(csa->keys[0]);
+        csa->keys[i] = dvbcsa_key_alloc();
+        csa->bs_keys[i] = dvbcsa_bs_key_alloc();
+        /* NULL terminated */
+        csa->bs_batch[i] = vlc_alloc( csa->i_bs_batch_size + 1,
+                                      sizeof(*csa->bs_batch[i]) );
+        if( !csa->keys[i] || !csa->bs_keys[i] || !csa->bs_batch[i] )
+        {
+            csa_Delete( csa );
+            return NULL;
+        }
     }
-    free(csa);
-    return NULL;
+    return csa;
 }
 
 /*****************************************************************************
@@ -65,8 +76,14 @@ csa_t *csa_New( void )
  *****************************************************************************/
 void csa_Delete( csa_t *c )
 {
-    dvbcsa_key_free( c->keys[0] );
-    dvbcsa_key_free( c->keys[1] );
+    for( int i = 0; i < 2; i++ )
+    {
+        if( c->keys[i] )
+            dvbcsa_key_free( c->keys[i] );
+        if( c->bs_keys[i] )
+            dvbcsa_bs_key_free( c->bs_keys[i] );
+        free( c->bs_batch[i] );
+    }
     free( c );
 }
 
@@ -104,6 +121,7 @@ int csa_SetCW( vlc_object_t *p_caller, csa_t *c, char *psz_ck, bool set_odd )
 # endif
 
         dvbcsa_key_set( ck, c->keys[set_odd ? 1 : 0] );
+        dvbcsa_bs_key_set( ck, c->bs_keys[set_odd ? 1 : 0] );
 
         return VLC_SUCCESS;
     }
@@ -122,25 +140,19 @@ void csa_UseKey( vlc_object_t *p_caller, csa_t *c, bool use_odd )
 # endif
 }
 
-/*****************************************************************************
- * csa_Decrypt:
- *****************************************************************************/
-void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+/* Clears the scrambling control of a packet, and returns the key to use and
+ * the offset of its payload, or -1 if there is nothing to descramble */
+static int csa_DecryptHeader( uint8_t *pkt, int i_pkt_size, int *pi_key )
 {
-    struct dvbcsa_key_s *key;
-
     int     i_hdr;
 
     /* transport scrambling control */
     if( (pkt[3]&0x80) == 0 )
     {
         /* not scrambled */
-        return;
+        return -1;
     }
-    if( pkt[3]&0x40 )
-        key = c->keys[1];
-    else
-        key = c->keys[0];
+    *pi_key = (pkt[3]&0x40) ? 1 : 0;
 
     /* clear transport scrambling control */
     pkt[3] &= 0x3f;
@@ -152,10 +164,71 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
         i_hdr += pkt[4] + 1;
     }
 
-    if( 188 - i_hdr < 8 )
+    if( 188 - i_hdr < 8 || i_pkt_size <= i_hdr )
+        return -1;
+
+    return i_hdr;
+}
+
+/*****************************************************************************
+ * csa_Decrypt:
+ *****************************************************************************/
+void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
+{
+    int i_key;
+    int i_hdr = csa_DecryptHeader( pkt, i_pkt_size, &i_key );
+    if( i_hdr < 0 )
         return;
 
-    dvbcsa_decrypt( key, &pkt[i_hdr], i_pkt_size - i_hdr );
+    dvbcsa_decrypt( c->keys[i_key], &pkt[i_hdr], i_pkt_size - i_hdr );
+}
+
+static void csa_DecryptFlush( csa_t *c, int i_key, unsigned *pi_count )
+{
+    if( *pi_count == 0 )
+        return;
+
+    c->bs_batch[i_key][*pi_count].data = NULL;
+    dvbcsa_bs_decrypt( c->bs_keys[i_key], c->bs_batch[i_key], 184 );
+    *pi_count = 0;
+}
+
+/*****************************************************************************
+ * csa_DecryptBatch: descrambles many packets at once, with the bitsliced
+ * implementation of libdvbcsa
+ *****************************************************************************/
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkts, size_t i_count,
+                       int i_pkt_size )
+{
+    unsigned pi_batch_count[2] = { 0, 0 };
+
+    for( size_t i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkts[i];
+        int i_key;
+        int i_hdr = csa_DecryptHeader( pkt, i_pkt_size, &i_key );
+        if( i_hdr < 0 )
+            continue;
+
+        struct dvbcsa_bs_batch_s *p_entry =
+            &c->bs_batch[i_key][pi_batch_count[i_key]++];
+        p_entry->data = &pkt[i_hdr];
+        p_entry->len = i_pkt_size - i_hdr;
+
+        if( pi_batch_count[i_key] == c->i_bs_batch_size )
+            csa_DecryptFlush( c, i_key, &pi_batch_count[i_key] );
+    }
+
+    csa_DecryptFlush( c, 0, &pi_batch_count[0] );
+    csa_DecryptFlush( c, 1, &pi_batch_count[1] );
+}
+
+/*****************************************************************************
+ * csa_GetBatchSize:
+ *****************************************************************************/
+size_t csa_GetBatchSize( const csa_t *c )
+{
+    return c->i_bs_batch_size;
 }
 
 /*****************************************************************************
@@ -232,6 +305,21 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     VLC_UNUSED(i_pkt_size);
 }
 
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkts, size_t i_count,
+                       int i_pkt_size )
+{
+    VLC_UNUSED(c);
+    VLC_UNUSED(pp_pkts);
+    VLC_UNUSED(i_count);
+    VLC_UNUSED(i_pkt_size);
+}
+
+size_t csa_GetBatchSize( const csa_t *c )
+{
+    VLC_UNUSED(c);
+    return 0;
+}
+
 void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
 {
     VLC_UNUSED(c);
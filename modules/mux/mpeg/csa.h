@@ -32,6 +32,10 @@ int    csa_SetCW( vlc_object_t *p_caller, csa_t *c, char *psz_ck, bool odd );
 void   csa_UseKey( vlc_object_t *p_caller, csa_t *, bool use_odd );
 
 void   csa_Decrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
+/* Descrambles i_count packets, faster than one by one */
+void   csa_DecryptBatch( csa_t *, uint8_t **pp_pkts, size_t i_count, int i_pkt_size );
+/* Number of packets descrambled together by csa_DecryptBatch */
+size_t csa_GetBatchSize( const csa_t * );
 void   csa_Encrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
 
 #endif /* _CSA_H */
@@ -41,6 +41,8 @@
 #include <vlc_block.h>
 #include <vlc_rand.h>
 #include <vlc_charset.h>
+#include <vlc_threads.h>
+#include <vlc_vector.h>
 
 #include <vlc_iso_lang.h>
 
@@ -155,6 +157,23 @@ static const char *const ts_standards_list_text[] =
   "PCRs (Program Clock Reference) will be sent (in milliseconds). " \
   "This value should be below 100ms. (default is 70ms).")
 
+#define MUXRATE_TEXT N_("Constant mux rate (bits/s)")
+#define MUXRATE_LONGTEXT N_("Output a constant bitrate stream at the given " \
+  "rate, padded with null packets, with its PCRs sent at least every 40ms " \
+  "and dated from their position in the stream. 0 disables it and outputs " \
+  "a variable bitrate stream.")
+
+#define THREADS_TEXT N_("Packetization threads")
+#define THREADS_LONGTEXT N_("Packetize the PES of the streams other than " \
+  "the PCR one into TS packets on the given number of threads, before " \
+  "interleaving them. 0 packetizes every stream on the muxing thread.")
+
+#define BURST_TEXT N_("Packets per output block")
+#define BURST_LONGTEXT N_("Output the TS packets in contiguous blocks of up " \
+  "to the given number of packets, dated from their first packet. 7 " \
+  "packets fill the payload of an UDP or RTP datagram. A block always " \
+  "starts at the PAT/PMT sent before the keyframes.")
+
 #define DTS_TEXT N_("DTS delay (ms)")
 #define DTS_LONGTEXT N_("Delay the DTS (decoding time " \
   "stamps) and PTS (presentation timestamps) of the data in the " \
@@ -189,6 +208,11 @@ static const char *const ts_standards_list_text[] =
 
 static_assert (MAX_SDT_DESC >= MAX_PMT, "MAX_SDT_DESC < MAX_PMT");
 
+#define TS_MUXRATE_MAX   200000000 /* keeps the 27MHz slot computations in range */
+#define TS_CBR_PCR_DELAY VLC_TICK_FROM_MS(40) /* ETSI TR 101 290 */
+#define TS_THREADS_MAX   16
+#define TS_BURST_MAX     64
+
 #define BLOCK_FLAG_NO_KEYFRAME (1 << BLOCK_FLAG_PRIVATE_SHIFT) /* This is not a key frame for bitrate shaping */
 #define BLOCK_FLAG_FOR_PCR     (1 << (BLOCK_FLAG_PRIVATE_SHIFT+1))
 
@@ -222,6 +246,12 @@ vlc_module_begin ()
 
     add_integer( SOUT_CFG_PREFIX "pcr", 70, PCR_TEXT, PCR_LONGTEXT)
     add_integer( SOUT_CFG_PREFIX "dts-delay", 400, DTS_TEXT, DTS_LONGTEXT)
+    add_integer( SOUT_CFG_PREFIX "muxrate", 0, MUXRATE_TEXT, MUXRATE_LONGTEXT)
+        change_integer_range( 0, TS_MUXRATE_MAX )
+    add_integer( SOUT_CFG_PREFIX "threads", 0, THREADS_TEXT, THREADS_LONGTEXT )
+        change_integer_range( 0, TS_THREADS_MAX )
+    add_integer( SOUT_CFG_PREFIX "burst", 1, BURST_TEXT, BURST_LONGTEXT )
+        change_integer_range( 1, TS_BURST_MAX )
 
     add_obsolete_integer( "sout-ts-bmin" ) /* since 4.0.0 */
     add_obsolete_integer( "sout-ts-bmax" ) /* since 4.0.0 */
@@ -245,7 +275,7 @@ static const char *const ppsz_sout_options[] = {
     "netid", "sdtdesc",
     "es-id-pid", "shaping", "pcr", "use-key-frames",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "muxrate", "threads", "burst",
     NULL
 };
 
@@ -311,13 +341,39 @@ typedef struct
 
 } pes_state_t;
 
+/* TS packets of a stream built ahead of the interleaving */
+typedef struct
+{
+    sout_buffer_chain_t chain;
+    struct VLC_VECTOR(vlc_tick_t) dts; /* stream DTS before each packet */
+    size_t              i_read;
+} ts_packets_t;
+
 typedef struct
 {
     tsmux_stream_t  ts;
     pesmux_stream_t pes;
     pes_state_t  state;
+    ts_packets_t packets;
 } sout_input_sys_t;
 
+/* Threads packetizing the streams other than the PCR one, while the muxing
+ * thread packetizes the PCR stream during the interleaving */
+typedef struct
+{
+    vlc_mutex_t         lock;
+    vlc_cond_t          wait_request;
+    vlc_cond_t          wait_done;
+    sout_input_sys_t  **pp_jobs;
+    size_t              i_jobs;
+    size_t              i_next;     /* next job to take */
+    size_t              i_done;
+    vlc_tick_t          i_end;      /* packetize up to this DTS */
+    bool                b_closing;
+    unsigned            i_threads;
+    vlc_thread_t        threads[];
+} ts_packetizer_t;
+
 typedef struct
 {
     sout_input_t    *p_pcr_input;
@@ -345,6 +401,11 @@ typedef struct
     sdt_psi_t       sdt;
     ts_mux_standard standard;
 
+    /* PAT and PMT/SDT packets as last built, repeated until the tables
+     * change, with only their continuity counter updated */
+    block_t         *p_pat_cache;
+    block_t         *p_pmt_cache;
+
     /* for TS building */
     vlc_tick_t      i_shaping_delay;
     vlc_tick_t      i_pcr_delay;
@@ -356,6 +417,22 @@ typedef struct
 
     vlc_tick_t      i_pcr;  /* last PCR emitted */
 
+    ts_packetizer_t *p_packetizer; /* NULL to packetize on the muxing thread */
+    struct VLC_VECTOR(sout_input_sys_t *) jobs;
+    unsigned        i_burst;       /* TS packets per output block */
+
+    /* constant mux rate, 0 for a variable bitrate output */
+    unsigned        i_muxrate;
+    struct
+    {
+        vlc_tick_t  i_start;     /* date of the first packet slot */
+        uint64_t    i_packets;   /* packet slots sent since i_start */
+        int64_t     i_last_pcr;  /* slot time of the last PCR, in 27MHz */
+        int         i_pcr_pid;
+        int         i_pcr_cc;    /* last continuity counter on i_pcr_pid, -1 if none */
+        bool        b_overflow;
+    } cbr;
+
     csa_t           *csa;
     int             i_csa_pkt_size;
     bool            b_crypt_audio;
@@ -454,9 +531,20 @@ static int TSDate       ( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
                           vlc_tick_t i_pcr_length, vlc_tick_t i_pcr_dts );
 static void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
+static void PSICacheReset( sout_mux_sys_t * );
 
 static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream, bool b_pcr );
-static void TSSetPCR( block_t *p_ts, vlc_tick_t i_dts );
+static void TSSetPCR( block_t *p_ts, int64_t i_pcr );
+
+static void TSPacketize( sout_input_sys_t *p_stream, vlc_tick_t i_end );
+static vlc_tick_t TSNextDts( const sout_input_sys_t *p_stream );
+static block_t *TSNext( sout_mux_t *p_mux, sout_input_sys_t *p_stream, bool b_pcr );
+static block_t *TSBurst( block_t *p_list, unsigned i_burst );
+
+static ts_packetizer_t *PacketizerNew( unsigned i_threads );
+static void PacketizerDelete( ts_packetizer_t * );
+static void PacketizerRun( ts_packetizer_t *, sout_input_sys_t **pp_jobs,
+                           size_t i_jobs, vlc_tick_t i_end );
 
 static void csaSetup( vlc_object_t *p_this )
 {
@@ -697,11 +785,40 @@ static int Open( vlc_object_t *p_this )
     var_Get( p_mux, SOUT_CFG_PREFIX "dts-delay", &val );
     p_sys->i_dts_delay = VLC_TICK_FROM_MS(val.i_int);
 
-    msg_Dbg( p_mux, "shaping=%"PRId64" pcr=%"PRId64" dts_delay=%"PRId64,
-             p_sys->i_shaping_delay, p_sys->i_pcr_delay, p_sys->i_dts_delay );
+    var_Get( p_mux, SOUT_CFG_PREFIX "muxrate", &val );
+    if( val.i_int < 0 || val.i_int > TS_MUXRATE_MAX )
+        msg_Err( p_mux, "invalid mux rate (%"PRId64"), using a variable bitrate",
+                 val.i_int );
+    else
+        p_sys->i_muxrate = val.i_int;
+
+    if( p_sys->i_muxrate > 0 )
+    {
+        if( p_sys->i_pcr_delay > TS_CBR_PCR_DELAY )
+            p_sys->i_pcr_delay = TS_CBR_PCR_DELAY;
+        p_sys->cbr.i_start = VLC_TICK_INVALID;
+        p_sys->cbr.i_pcr_cc = -1;
+    }
+
+    msg_Dbg( p_mux, "shaping=%"PRId64" pcr=%"PRId64" dts_delay=%"PRId64
+             " muxrate=%u", p_sys->i_shaping_delay, p_sys->i_pcr_delay,
+             p_sys->i_dts_delay, p_sys->i_muxrate );
 
     p_sys->b_use_key_frames = var_GetBool( p_mux, SOUT_CFG_PREFIX "use-key-frames" );
 
+    p_sys->i_burst = VLC_CLIP( var_GetInteger( p_mux, SOUT_CFG_PREFIX "burst" ),
+                               1, TS_BURST_MAX );
+    vlc_vector_init( &p_sys->jobs );
+    const int64_t i_threads = var_GetInteger( p_mux, SOUT_CFG_PREFIX "threads" );
+    if( i_threads > 0 )
+    {
+        p_sys->p_packetizer =
+            PacketizerNew( __MIN( i_threads, TS_THREADS_MAX ) );
+        if( p_sys->p_packetizer == NULL )
+            msg_Warn( p_mux, "cannot create the packetization threads, "
+                      "packetizing on the muxing thread" );
+    }
+
     p_mux->p_sys        = p_sys;
 
     csaSetup( p_this );
@@ -722,6 +839,12 @@ static void Close( vlc_object_t * p_this )
     sout_mux_t          *p_mux = (sout_mux_t*)p_this;
     sout_mux_sys_t      *p_sys = p_mux->p_sys;
 
+    PSICacheReset( p_sys );
+
+    if( p_sys->p_packetizer )
+        PacketizerDelete( p_sys->p_packetizer );
+    vlc_vector_destroy( &p_sys->jobs );
+
     if( p_sys->p_dvbpsi )
         dvbpsi_delete( p_sys->p_dvbpsi );
 
@@ -913,9 +1036,12 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
 
     /* Init pes chain */
     BufferChainInit( &p_stream->state.chain_pes );
+    BufferChainInit( &p_stream->packets.chain );
+    vlc_vector_init( &p_stream->packets.dts );
 
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number = ( p_sys->i_pmt_version_number + 1 )%32;
+    PSICacheReset( p_sys );
 
     /* Update pcr_pid */
     SelectPCRStream( p_mux, NULL );
@@ -964,6 +1090,9 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
 
     /* Empty all data in chain_pes */
     BufferChainClean( &p_stream->state.chain_pes );
+    /* Packets built ahead are always interleaved in the same slice */
+    assert( p_stream->packets.chain.i_depth == 0 );
+    vlc_vector_destroy( &p_stream->packets.dts );
 
     pid = var_GetInteger( p_mux, SOUT_CFG_PREFIX "pid-video" );
     if ( pid > 0 && pid == p_stream->ts.i_pid )
@@ -990,6 +1119,7 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number++;
     p_sys->i_pmt_version_number %= 32;
+    PSICacheReset( p_sys );
 }
 
 static void SetHeader( sout_buffer_chain_t *c,
@@ -1450,6 +1580,25 @@ static int MuxStreams( sout_mux_t *p_mux )
     /* msg_Dbg( p_mux, "estimated pck=%d", i_packet_count ); */
 
     const vlc_tick_t i_pcr_dts = p_pcr_stream->state.i_pes_dts;
+
+    /* Packetize the other streams concurrently, the PCR stream is
+     * packetized below as the PCR positions depend on the interleaving */
+    if( p_sys->p_packetizer != NULL )
+    {
+        vlc_vector_clear( &p_sys->jobs );
+        for (int i = 0; i < p_mux->i_nb_inputs; i++ )
+        {
+            sout_input_sys_t *p_stream =
+                (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
+            if( p_stream != p_pcr_stream && p_stream->state.i_pes_dts != 0 &&
+                !vlc_vector_push( &p_sys->jobs, p_stream ) )
+                TSPacketize( p_stream, i_pcr_dts + i_pcr_length );
+        }
+        if( p_sys->jobs.size > 0 )
+            PacketizerRun( p_sys->p_packetizer, p_sys->jobs.data,
+                           p_sys->jobs.size, i_pcr_dts + i_pcr_length );
+    }
+
     for (;;)
     {
         int          i_stream = -1;
@@ -1461,15 +1610,16 @@ static int MuxStreams( sout_mux_t *p_mux )
         {
             p_stream = (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
 
-            if( p_stream->state.i_pes_dts == 0 )
+            const vlc_tick_t i_stream_dts = TSNextDts( p_stream );
+            if( i_stream_dts == 0 )
             {
                 continue;
             }
 
-            if( i_stream == -1 || p_stream->state.i_pes_dts < i_dts )
+            if( i_stream == -1 || i_stream_dts < i_dts )
             {
                 i_stream = i;
-                i_dts = p_stream->state.i_pes_dts;
+                i_dts = i_stream_dts;
             }
         }
         if( i_stream == -1 || i_dts > i_pcr_dts + i_pcr_length )
@@ -1490,8 +1640,8 @@ static int MuxStreams( sout_mux_t *p_mux )
             p_sys->i_pcr = i_pcr_dts + packet_length;
         }
 
-        /* Build the TS packet */
-        block_t *p_ts = TSNew( p_mux, p_stream, b_pcr );
+        /* Build the TS packet, or take the one built ahead */
+        block_t *p_ts = TSNext( p_mux, p_stream, b_pcr );
         if( p_stream->ts.b_scramble )
             p_ts->i_flags |= BLOCK_FLAG_SCRAMBLED;
 
@@ -1717,12 +1867,182 @@ static int TSSchedule( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
     return VLC_SUCCESS;
 }
 
+static void TSScramble( sout_mux_sys_t *p_sys, block_t *p_ts )
+{
+    if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+    {
+        vlc_mutex_lock( &p_sys->csa_lock );
+        csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_sys->csa_lock );
+    }
+}
+
+/* Date of the i_slot th packet of a constant rate stream, in 27MHz */
+static int64_t TSSlotTime( unsigned i_rate, uint64_t i_slot )
+{
+    const uint64_t i_bits = i_slot * 188 * 8;
+    return i_bits / i_rate * 27000000 + i_bits % i_rate * 27000000 / i_rate;
+}
+
+/* Number of packets of a constant rate stream fitting in i_length */
+static uint64_t TSSlotCount( unsigned i_rate, vlc_tick_t i_length )
+{
+    lldiv_t d = lldiv( i_length, CLOCK_FREQ );
+    return ( (uint64_t)d.quot * i_rate +
+             samples_from_vlc_tick( d.rem, i_rate ) ) / ( 188 * 8 );
+}
+
+static block_t *TSNewNull( void )
+{
+    block_t *p_ts = block_Alloc( 188 );
+    if( unlikely(p_ts == NULL) )
+        return NULL;
+
+    p_ts->p_buffer[0] = 0x47;
+    p_ts->p_buffer[1] = 0x1f;
+    p_ts->p_buffer[2] = 0xff;
+    p_ts->p_buffer[3] = 0x10;
+    memset( &p_ts->p_buffer[4], 0xff, 184 );
+    return p_ts;
+}
+
+/* Adaptation field only packet carrying a PCR. It has no payload, so it
+ * repeats the continuity counter of the previous packet of the PID. */
+static block_t *TSNewPCR( int i_pid, int i_continuity_counter )
+{
+    block_t *p_ts = block_Alloc( 188 );
+    if( unlikely(p_ts == NULL) )
+        return NULL;
+
+    p_ts->p_buffer[0] = 0x47;
+    p_ts->p_buffer[1] = ( i_pid >> 8 ) & 0x1f;
+    p_ts->p_buffer[2] = i_pid & 0xff;
+    p_ts->p_buffer[3] = 0x20 | i_continuity_counter;
+    p_ts->p_buffer[4] = 183;
+    p_ts->p_buffer[5] = 1 << 4; /* PCR_flag */
+    memset( &p_ts->p_buffer[12], 0xff, 176 );
+    p_ts->i_flags |= BLOCK_FLAG_FOR_PCR;
+    return p_ts;
+}
+
+/* Constant mux rate: every packet gets the next slot of the output clock,
+ * slots without data are filled with null packets, or with PCR packets
+ * when the last PCR is older than the PCR delay. PCRs are computed from
+ * the slot, so they match the position of the packet in the stream. */
+static int TSDateCBR( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
+                      vlc_tick_t i_pcr_length, vlc_tick_t i_pcr_dts )
+{
+    sout_mux_sys_t  *p_sys = p_mux->p_sys;
+    const unsigned i_rate = p_sys->i_muxrate;
+    const uint64_t i_packet_count = p_chain_ts->i_depth;
+    const tsmux_stream_t *p_pcr_ts =
+        &((sout_input_sys_t *)p_sys->p_pcr_input->p_sys)->ts;
+
+    const vlc_tick_t i_end = i_pcr_dts + i_pcr_length;
+    /* aim a bit before the PCR delay, so that a free slot can be found
+     * before it expires */
+    const int64_t i_pcr_delay = samples_from_vlc_tick(
+        p_sys->i_pcr_delay - p_sys->i_pcr_delay / 8, 27000000 );
+    if( p_sys->cbr.i_start != VLC_TICK_INVALID )
+    {
+        const vlc_tick_t i_clock = p_sys->cbr.i_start +
+            vlc_tick_from_frac( p_sys->cbr.i_packets * 188 * 8, i_rate );
+        if( i_end > i_clock + VLC_TICK_FROM_SEC(10) ||
+            i_end + VLC_TICK_FROM_SEC(10) < i_clock )
+        {
+            msg_Warn( p_mux, "resetting the mux rate clock (%"PRId64"ms off)",
+                      MS_FROM_VLC_TICK(i_end - i_clock) );
+            p_sys->cbr.i_start = VLC_TICK_INVALID;
+        }
+    }
+    if( p_sys->cbr.i_start == VLC_TICK_INVALID )
+    {
+        p_sys->cbr.i_start = i_pcr_dts;
+        p_sys->cbr.i_packets = 0;
+        p_sys->cbr.i_last_pcr = -i_pcr_delay;
+    }
+
+    if( p_sys->cbr.i_pcr_pid != p_pcr_ts->i_pid )
+    {
+        p_sys->cbr.i_pcr_pid = p_pcr_ts->i_pid;
+        p_sys->cbr.i_pcr_cc = -1;
+    }
+
+    /* fill the slots up to the end of the slice, or run late if there is
+     * more data than the rate allows */
+    uint64_t i_slot_count = TSSlotCount( i_rate, i_end - p_sys->cbr.i_start );
+    if( i_slot_count >= p_sys->cbr.i_packets + i_packet_count )
+    {
+        i_slot_count -= p_sys->cbr.i_packets;
+        p_sys->cbr.b_overflow = false;
+    }
+    else
+    {
+        if( !p_sys->cbr.b_overflow )
+            msg_Warn( p_mux, "mux rate %u is too low, output is late", i_rate );
+        p_sys->cbr.b_overflow = true;
+        i_slot_count = i_packet_count;
+    }
+
+    const int64_t i_pcr_start = samples_from_vlc_tick(
+        p_sys->cbr.i_start - p_sys->first_dts, 27000000 );
+    const vlc_tick_t i_length = vlc_tick_from_frac( 188 * 8, i_rate );
+
+    block_t *p_list = NULL;
+    block_t **pp_last = &p_list;
+    for( uint64_t i = 0; i < i_slot_count; i++ )
+    {
+        const int64_t i_time = TSSlotTime( i_rate, p_sys->cbr.i_packets++ );
+        block_t *p_ts;
+
+        /* spread the data packets evenly over the slots */
+        if( ( i + 1 ) * i_packet_count / i_slot_count >
+            i * i_packet_count / i_slot_count )
+            p_ts = BufferChainGet( p_chain_ts );
+        else if( p_sys->cbr.i_pcr_cc >= 0 &&
+                 i_time >= p_sys->cbr.i_last_pcr + i_pcr_delay )
+            p_ts = TSNewPCR( p_sys->cbr.i_pcr_pid, p_sys->cbr.i_pcr_cc );
+        else
+            p_ts = TSNewNull();
+        if( unlikely(p_ts == NULL) )
+            continue;
+
+        if( ( ( p_ts->p_buffer[1] & 0x1f ) << 8 | p_ts->p_buffer[2] ) ==
+            p_sys->cbr.i_pcr_pid )
+            p_sys->cbr.i_pcr_cc = p_ts->p_buffer[3] & 0x0f;
+
+        if( p_ts->i_flags & BLOCK_FLAG_FOR_PCR )
+        {
+            TSSetPCR( p_ts, i_pcr_start + i_time );
+            p_sys->cbr.i_last_pcr = i_time;
+        }
+        TSScramble( p_sys, p_ts );
+
+        p_ts->i_dts    = p_sys->cbr.i_start +
+                         vlc_tick_from_frac( i_time, 27000000 );
+        p_ts->i_length = i_length;
+
+        /* latency */
+        p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
+
+        block_ChainLastAppend( &pp_last, p_ts );
+    }
+    ssize_t written = 0;
+    if ( p_list != NULL )
+        written = sout_AccessOutWrite( p_mux->p_access,
+                                       TSBurst( p_list, p_sys->i_burst ) );
+    return ( written == -1 ) ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
 static int TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
                    vlc_tick_t i_pcr_length, vlc_tick_t i_pcr_dts )
 {
     sout_mux_sys_t  *p_sys = p_mux->p_sys;
     int i_packet_count = p_chain_ts->i_depth;
 
+    if( p_sys->i_muxrate > 0 )
+        return TSDateCBR( p_mux, p_chain_ts, i_pcr_length, i_pcr_dts );
+
     if ( unlikely(i_pcr_length / 1000 <= 0) )
     {
         /* This shouldn't happen, but happens in some rare heavy load
@@ -1744,14 +2064,10 @@ static int TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
         if( p_ts->i_flags & BLOCK_FLAG_FOR_PCR )
         {
             /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
-            TSSetPCR( p_ts, p_ts->i_dts - p_sys->first_dts );
-        }
-        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
-        {
-            vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
-            vlc_mutex_unlock( &p_sys->csa_lock );
+            TSSetPCR( p_ts, samples_from_vlc_tick( p_ts->i_dts - p_sys->first_dts,
+                                                   27000000 ) );
         }
+        TSScramble( p_sys, p_ts );
 
         /* latency */
         p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
@@ -1760,7 +2076,8 @@ static int TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
     }
     ssize_t written = 0;
     if ( p_list != NULL )
-        written = sout_AccessOutWrite( p_mux->p_access, p_list );
+        written = sout_AccessOutWrite( p_mux->p_access,
+                                       TSBurst( p_list, p_sys->i_burst ) );
     return ( written == -1 ) ? VLC_EGENERIC : VLC_SUCCESS;
 }
 
@@ -1867,33 +2184,313 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
     return p_ts;
 }
 
-static void TSSetPCR( block_t *p_ts, vlc_tick_t i_dts )
+/* Packetize a stream up to the end of the slice, as the interleaving would:
+ * it selects the stream from its DTS before each packet, and stops at the
+ * first one past the slice. */
+static void TSPacketize( sout_input_sys_t *p_stream, vlc_tick_t i_end )
+{
+    ts_packets_t *p_packets = &p_stream->packets;
+
+    while( p_stream->state.i_pes_dts != 0 && p_stream->state.i_pes_dts <= i_end )
+    {
+        /* The rest is packetized during the interleaving */
+        if( !vlc_vector_push( &p_packets->dts, p_stream->state.i_pes_dts ) )
+            break;
+        BufferChainAppend( &p_packets->chain, TSNew( NULL, p_stream, false ) );
+    }
+}
+
+static vlc_tick_t TSNextDts( const sout_input_sys_t *p_stream )
+{
+    const ts_packets_t *p_packets = &p_stream->packets;
+
+    if( p_packets->i_read < p_packets->dts.size )
+        return p_packets->dts.data[p_packets->i_read];
+    return p_stream->state.i_pes_dts;
+}
+
+static block_t *TSNext( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
+                        bool b_pcr )
+{
+    ts_packets_t *p_packets = &p_stream->packets;
+
+    if( p_packets->i_read == p_packets->dts.size )
+        return TSNew( p_mux, p_stream, b_pcr );
+
+    /* Only the streams without PCR are packetized ahead */
+    assert( !b_pcr );
+    if( ++p_packets->i_read == p_packets->dts.size )
+    {
+        vlc_vector_clear( &p_packets->dts );
+        p_packets->i_read = 0;
+    }
+    return BufferChainGet( &p_packets->chain );
+}
+
+/* Gather the packets in contiguous blocks of up to i_burst packets, dated
+ * from their first packet. The packets flagged as header start a block, so
+ * that the segmenting outputs can still cut before them. */
+static block_t *TSBurst( block_t *p_list, unsigned i_burst )
+{
+    if( i_burst <= 1 )
+        return p_list;
+
+    block_t *p_out = NULL;
+    block_t **pp_last = &p_out;
+    while( p_list != NULL )
+    {
+        unsigned i_count = 1;
+        for( const block_t *p_ts = p_list->p_next;
+             p_ts != NULL && i_count < i_burst &&
+             !(p_ts->i_flags & BLOCK_FLAG_HEADER); p_ts = p_ts->p_next )
+            i_count++;
+
+        block_t *p_burst = block_Alloc( i_count * 188 );
+        if( unlikely(p_burst == NULL) )
+        {
+            /* Send the rest as is */
+            block_ChainLastAppend( &pp_last, p_list );
+            break;
+        }
+        p_burst->i_flags = p_list->i_flags & BLOCK_FLAG_HEADER;
+        p_burst->i_dts = p_list->i_dts;
+        p_burst->i_length = 0;
+
+        for( unsigned i = 0; i < i_count; i++ )
+        {
+            block_t *p_ts = p_list;
+            p_list = p_ts->p_next;
+
+            memcpy( &p_burst->p_buffer[i * 188], p_ts->p_buffer, 188 );
+            p_burst->i_length += p_ts->i_length;
+            block_Release( p_ts );
+        }
+        block_ChainLastAppend( &pp_last, p_burst );
+    }
+    return p_out;
+}
+
+static void *PacketizerThread( void *data )
 {
-    int64_t i_pcr = TO_SCALE_NZ(i_dts);
-
-    p_ts->p_buffer[6]  = ( i_pcr >> 25 )&0xff;
-    p_ts->p_buffer[7]  = ( i_pcr >> 17 )&0xff;
-    p_ts->p_buffer[8]  = ( i_pcr >> 9  )&0xff;
-    p_ts->p_buffer[9]  = ( i_pcr >> 1  )&0xff;
-    p_ts->p_buffer[10] = ( i_pcr << 7  )&0x80;
-    p_ts->p_buffer[10] |= 0x7e;
-    p_ts->p_buffer[11] = 0; /* we don't set PCR extension */
+    ts_packetizer_t *p_pkt = data;
+
+    vlc_thread_set_name( "vlc-ts-packetizer" );
+
+    vlc_mutex_lock( &p_pkt->lock );
+    for( ;; )
+    {
+        while( p_pkt->i_next == p_pkt->i_jobs && !p_pkt->b_closing )
+            vlc_cond_wait( &p_pkt->wait_request, &p_pkt->lock );
+        if( p_pkt->i_next == p_pkt->i_jobs )
+            break;
+
+        sout_input_sys_t *p_stream = p_pkt->pp_jobs[p_pkt->i_next++];
+        const vlc_tick_t i_end = p_pkt->i_end;
+        vlc_mutex_unlock( &p_pkt->lock );
+
+        TSPacketize( p_stream, i_end );
+
+        vlc_mutex_lock( &p_pkt->lock );
+        if( ++p_pkt->i_done == p_pkt->i_jobs )
+            vlc_cond_signal( &p_pkt->wait_done );
+    }
+    vlc_mutex_unlock( &p_pkt->lock );
+    return NULL;
+}
+
+static ts_packetizer_t *PacketizerNew( unsigned i_threads )
+{
+    ts_packetizer_t *p_pkt =
+        malloc( sizeof(*p_pkt) + i_threads * sizeof(p_pkt->threads[0]) );
+    if( unlikely(p_pkt == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &p_pkt->lock );
+    vlc_cond_init( &p_pkt->wait_request );
+    vlc_cond_init( &p_pkt->wait_done );
+    p_pkt->pp_jobs = NULL;
+    p_pkt->i_jobs = p_pkt->i_next = p_pkt->i_done = 0;
+    p_pkt->i_end = 0;
+    p_pkt->b_closing = false;
+
+    for( p_pkt->i_threads = 0; p_pkt->i_threads < i_threads; p_pkt->i_threads++ )
+    {
+        if( vlc_clone( &p_pkt->threads[p_pkt->i_threads], PacketizerThread,
+                       p_pkt ) )
+            break;
+    }
+    if( p_pkt->i_threads == 0 )
+    {
+        free( p_pkt );
+        return NULL;
+    }
+    return p_pkt;
+}
+
+static void PacketizerDelete( ts_packetizer_t *p_pkt )
+{
+    vlc_mutex_lock( &p_pkt->lock );
+    p_pkt->b_closing = true;
+    vlc_cond_broadcast( &p_pkt->wait_request );
+    vlc_mutex_unlock( &p_pkt->lock );
+
+    for( unsigned i = 0; i < p_pkt->i_threads; i++ )
+        vlc_join( p_pkt->threads[i], NULL );
+    free( p_pkt );
+}
+
+/* Packetize the streams on the threads, and on the calling thread until
+ * there is no stream left to take */
+static void PacketizerRun( ts_packetizer_t *p_pkt, sout_input_sys_t **pp_jobs,
+                           size_t i_jobs, vlc_tick_t i_end )
+{
+    vlc_mutex_lock( &p_pkt->lock );
+    p_pkt->pp_jobs = pp_jobs;
+    p_pkt->i_jobs = i_jobs;
+    p_pkt->i_next = 0;
+    p_pkt->i_done = 0;
+    p_pkt->i_end = i_end;
+    vlc_cond_broadcast( &p_pkt->wait_request );
+
+    while( p_pkt->i_next < p_pkt->i_jobs )
+    {
+        sout_input_sys_t *p_stream = p_pkt->pp_jobs[p_pkt->i_next++];
+        vlc_mutex_unlock( &p_pkt->lock );
+
+        TSPacketize( p_stream, i_end );
+
+        vlc_mutex_lock( &p_pkt->lock );
+        p_pkt->i_done++;
+    }
+    while( p_pkt->i_done < p_pkt->i_jobs )
+        vlc_cond_wait( &p_pkt->wait_done, &p_pkt->lock );
+    p_pkt->pp_jobs = NULL;
+    vlc_mutex_unlock( &p_pkt->lock );
+}
+
+/* i_pcr is in 27MHz units */
+static void TSSetPCR( block_t *p_ts, int64_t i_pcr )
+{
+    const int64_t i_base = i_pcr / 300;
+    const int     i_ext  = i_pcr % 300;
+
+    p_ts->p_buffer[6]  = ( i_base >> 25 )&0xff;
+    p_ts->p_buffer[7]  = ( i_base >> 17 )&0xff;
+    p_ts->p_buffer[8]  = ( i_base >> 9  )&0xff;
+    p_ts->p_buffer[9]  = ( i_base >> 1  )&0xff;
+    p_ts->p_buffer[10] = ( ( i_base << 7 )&0x80 ) | 0x7e | ( i_ext >> 8 );
+    p_ts->p_buffer[11] = i_ext & 0xff;
+}
+
+static void PSICacheReset( sout_mux_sys_t *p_sys )
+{
+    if( p_sys->p_pat_cache )
+        block_ChainRelease( p_sys->p_pat_cache );
+    if( p_sys->p_pmt_cache )
+        block_ChainRelease( p_sys->p_pmt_cache );
+    p_sys->p_pat_cache = NULL;
+    p_sys->p_pmt_cache = NULL;
+}
+
+/* Send the tables just built and keep a copy of their packets */
+static void PSICacheFill( block_t **pp_cache, sout_buffer_chain_t *p_built,
+                          sout_buffer_chain_t *c )
+{
+    block_t *p_cache = NULL;
+    block_t **pp_last = &p_cache;
+    bool b_complete = true;
+
+    block_t *p_ts;
+    while( (p_ts = BufferChainGet( p_built )) )
+    {
+        block_t *p_copy = block_Duplicate( p_ts );
+        if( likely(p_copy) )
+            block_ChainLastAppend( &pp_last, p_copy );
+        else
+            b_complete = false;
+        BufferChainAppend( c, p_ts );
+    }
+
+    if( !b_complete && p_cache )
+    {
+        /* build them again next time */
+        block_ChainRelease( p_cache );
+        p_cache = NULL;
+    }
+    *pp_cache = p_cache;
+}
+
+static tsmux_stream_t *PSICacheGetStream( sout_mux_sys_t *p_sys, uint16_t i_pid )
+{
+    if( i_pid == p_sys->pat.i_pid )
+        return &p_sys->pat;
+    for( unsigned i = 0; i < p_sys->i_num_pmt; i++ )
+    {
+        if( i_pid == p_sys->pmt[i].i_pid )
+            return &p_sys->pmt[i];
+    }
+    if( i_pid == p_sys->sdt.ts.i_pid )
+        return &p_sys->sdt.ts;
+    return NULL;
+}
+
+/* Send the cached tables again */
+static void PSICacheRepeat( sout_mux_sys_t *p_sys, const block_t *p_cache,
+                            sout_buffer_chain_t *c )
+{
+    for( ; p_cache != NULL; p_cache = p_cache->p_next )
+    {
+        const uint16_t i_pid = ( ( p_cache->p_buffer[1] & 0x1f ) << 8 ) |
+                               p_cache->p_buffer[2];
+        tsmux_stream_t *p_ts_stream = PSICacheGetStream( p_sys, i_pid );
+        if( unlikely(p_ts_stream == NULL) )
+            continue;
+
+        block_t *p_ts = block_Duplicate( p_cache );
+        if( unlikely(p_ts == NULL) )
+            return;
+
+        p_ts->p_buffer[3] = ( p_ts->p_buffer[3] & 0xf0 ) |
+                            p_ts_stream->i_continuity_counter;
+        p_ts_stream->i_continuity_counter = (p_ts_stream->i_continuity_counter+1)%16;
+        /* only the first emission can signal a discontinuity */
+        if( ( p_ts->p_buffer[3] & 0x20 ) && p_ts->p_buffer[4] > 0 )
+            p_ts->p_buffer[5] &= ~0x80;
+
+        BufferChainAppend( c, p_ts );
+    }
 }
 
 void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
 {
     sout_mux_sys_t       *p_sys = p_mux->p_sys;
 
+    if( p_sys->p_pat_cache )
+    {
+        PSICacheRepeat( p_sys, p_sys->p_pat_cache, c );
+        return;
+    }
+
+    sout_buffer_chain_t pat;
+    BufferChainInit( &pat );
     BuildPAT( p_sys->p_dvbpsi,
-              c, (PEStoTSCallback)BufferChainAppend,
+              &pat, (PEStoTSCallback)BufferChainAppend,
               p_sys->i_tsid, p_sys->i_pat_version_number,
               &p_sys->pat,
               p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number );
+    PSICacheFill( &p_sys->p_pat_cache, &pat, c );
 }
 
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( p_sys->p_pmt_cache )
+    {
+        PSICacheRepeat( p_sys, p_sys->p_pmt_cache, c );
+        return;
+    }
+
     pes_mapped_stream_t mapped[p_mux->i_nb_inputs];
 
     for (int i_stream = 0; i_stream < p_mux->i_nb_inputs; i_stream++ )
@@ -1912,11 +2509,14 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
         mapped[i_stream].ts = &p_stream->ts;
     }
 
+    sout_buffer_chain_t pmt;
+    BufferChainInit( &pmt );
     BuildPMT( p_sys->p_dvbpsi, VLC_OBJECT(p_mux), p_sys->standard,
-              c, (PEStoTSCallback)BufferChainAppend,
+              &pmt, (PEStoTSCallback)BufferChainAppend,
               p_sys->i_tsid, p_sys->i_pmt_version_number,
               ((sout_input_sys_t *)p_sys->p_pcr_input->p_sys)->ts.i_pid,
               &p_sys->sdt,
               p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number,
               p_mux->i_nb_inputs, mapped );
+    PSICacheFill( &p_sys->p_pmt_cache, &pmt, c );
 }
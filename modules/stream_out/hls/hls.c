@@ -965,6 +965,9 @@ static void Close(sout_stream_t *stream)
     if (sys->manifest != NULL)
         hls_storage_Destroy(sys->manifest);
 
+    if (sys->config.writer != NULL)
+        hls_storage_writer_Delete(sys->config.writer);
+
     hls_config_Clean(&sys->config);
 
     hls_variant_maps_Destroy(&sys->variant_stream_maps);
@@ -991,6 +994,7 @@ static int Open(vlc_object_t *this)
                                           "pace",
                                           "seg-len",
                                           "variants",
+                                          "write-queue",
                                           NULL};
     config_ChainParse(stream, SOUT_CFG_PREFIX, options, stream->p_cfg);
 
@@ -1004,6 +1008,7 @@ static int Open(vlc_object_t *this)
         VLC_TICK_FROM_SEC(var_GetInteger(stream, SOUT_CFG_PREFIX "seg-len"));
     sys->config.max_memory =
         BYTES_FROM_KB(var_GetInteger(stream, SOUT_CFG_PREFIX "max-memory"));
+    sys->config.writer = NULL;
 
     int status = VLC_EINVAL;
 
@@ -1047,6 +1052,19 @@ static int Open(vlc_object_t *this)
         goto error;
     }
 
+    const int64_t write_queue =
+        var_GetInteger(stream, SOUT_CFG_PREFIX "write-queue");
+    if (!hls_config_IsMemStorageEnabled(&sys->config) && write_queue > 0)
+    {
+        sys->config.writer =
+            hls_storage_writer_New(stream->obj.logger, write_queue);
+        if (unlikely(sys->config.writer == NULL))
+        {
+            status = VLC_ENOMEM;
+            goto writer_error;
+        }
+    }
+
     sys->manifest = NULL;
 
     sys->playlist_created_count = 0;
@@ -1069,6 +1087,12 @@ static int Open(vlc_object_t *this)
     stream->ops = &ops;
 
     return VLC_SUCCESS;
+writer_error:
+    if (sys->http_host != NULL)
+    {
+        httpd_UrlDelete(sys->http_manifest);
+        httpd_HostDelete(sys->http_host);
+    }
 error:
     hls_variant_maps_Destroy(&sys->variant_stream_maps);
 variant_error:
@@ -1109,6 +1133,12 @@ variant_error:
 #define PACE_TEXT N_("Enable pacing")
 #define SEGLEN_LONGTEXT N_("Length of segments in seconds")
 #define SEGLEN_TEXT N_("Segment length (sec)")
+#define WRITEQUEUE_LONGTEXT                                                    \
+    N_("Maximum number of segments and manifests waiting to be written to "   \
+       "the output directory by a background thread. The muxing is slowed "   \
+       "down when the queue is full. By default (0), they are written "       \
+       "synchronously from the muxing thread")
+#define WRITEQUEUE_TEXT N_("Asynchronous write queue size")
 
 vlc_module_begin()
     set_shortname("HLS")
@@ -1126,6 +1156,8 @@ vlc_module_begin()
     add_string(SOUT_CFG_PREFIX "out-dir", NULL, OUTDIR_TEXT, OUTDIR_LONGTEXT)
     add_bool(SOUT_CFG_PREFIX "pace", false, PACE_TEXT, PACE_LONGTEXT)
     add_integer(SOUT_CFG_PREFIX "seg-len", 4, SEGLEN_TEXT, SEGLEN_LONGTEXT)
+    add_integer_with_range(SOUT_CFG_PREFIX "write-queue", 0, 0, 1024,
+                           WRITEQUEUE_TEXT, WRITEQUEUE_LONGTEXT)
 
     set_callback(Open)
 vlc_module_end()
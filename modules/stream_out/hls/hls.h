@@ -34,6 +34,8 @@ struct hls_config
     bool pace;
     vlc_tick_t segment_length;
     size_t max_memory;
+    /** Asynchronous filesystem writer, NULL for synchronous writes. */
+    struct hls_storage_writer *writer;
 };
 
 #define BYTES_FROM_KB(x) ((x) * 1000)
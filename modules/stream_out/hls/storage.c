@@ -30,6 +30,8 @@
 
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_list.h>
+#include <vlc_threads.h>
 
 #include "hls.h"
 #include "storage.h"
@@ -50,33 +52,71 @@ struct storage_priv
         struct
         {
             char *path;
+            /**
+             * Content waiting to be written by the storage writer thread.
+             * NULL once the content is on disk.
+             */
+            block_t *pending;
+            /** Readers copying the pending content unlocked. */
+            unsigned readers;
+            /** Set when the writer thread failed to write the content. */
+            bool failed;
+            struct hls_storage_writer *writer;
+            /** Set when destroyed while pending, the writer frees it. */
+            bool orphaned;
+            struct vlc_list node;
         } fs;
     };
 };
 
+struct hls_storage_writer
+{
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t wait_request;
+    vlc_cond_t wait_space;
+    vlc_cond_t wait_readers;
+
+    /** Queue of `struct storage_priv` waiting to be written. */
+    struct vlc_list queue;
+    /** Storages queued or being written. */
+    size_t queue_length;
+    size_t max_pending;
+
+    bool closing;
+    struct vlc_logger *logger;
+};
+
 static void mem_storage_Destroy(struct storage_priv *priv)
 {
     block_ChainRelease(priv->mem.content);
     free(priv);
 }
 
-static ssize_t mem_storage_GetContent(const hls_storage_t *storage,
-                                      uint8_t **dest)
+static ssize_t storage_CopyBlocks(const block_t *content,
+                                  size_t size,
+                                  uint8_t **dest)
 {
-    const struct storage_priv *priv =
-        container_of(storage, struct storage_priv, storage);
-
-    *dest = malloc(priv->size);
+    *dest = malloc(size);
     if (unlikely(*dest == NULL))
         return -1;
 
     uint8_t *cursor = *dest;
-    for (const block_t *it = priv->mem.content; it != NULL; it = it->p_next)
+    for (const block_t *it = content; it != NULL; it = it->p_next)
     {
         memcpy(cursor, it->p_buffer, it->i_buffer);
         cursor += it->i_buffer;
     }
-    return priv->size;
+    return size;
+}
+
+static ssize_t mem_storage_GetContent(const hls_storage_t *storage,
+                                      uint8_t **dest)
+{
+    const struct storage_priv *priv =
+        container_of(storage, struct storage_priv, storage);
+
+    return storage_CopyBlocks(priv->mem.content, priv->size, dest);
 }
 
 static hls_storage_t *mem_storage_FromBlock(block_t *content)
@@ -135,9 +175,40 @@ static ssize_t fs_storage_Read(int fd, uint8_t buf[], size_t len)
 static ssize_t fs_storage_GetContent(const hls_storage_t *storage,
                                      uint8_t **dest)
 {
-    const struct storage_priv *priv =
+    struct storage_priv *priv =
         container_of(storage, struct storage_priv, storage);
 
+    struct hls_storage_writer *writer = priv->fs.writer;
+    if (writer != NULL)
+    {
+        vlc_mutex_lock(&writer->lock);
+        /* Never serve the partial file of a failed write. */
+        if (priv->fs.failed)
+        {
+            vlc_mutex_unlock(&writer->lock);
+            return -1;
+        }
+
+        /* Serve the content from memory while the writer hasn't put it on
+         * disk yet. The writer keeps the pending chain until the last reader
+         * is done, so that it is copied unlocked. */
+        const block_t *pending = priv->fs.pending;
+        if (pending != NULL)
+            ++priv->fs.readers;
+        vlc_mutex_unlock(&writer->lock);
+
+        if (pending != NULL)
+        {
+            const ssize_t ret = storage_CopyBlocks(pending, priv->size, dest);
+
+            vlc_mutex_lock(&writer->lock);
+            if (--priv->fs.readers == 0)
+                vlc_cond_broadcast(&writer->wait_readers);
+            vlc_mutex_unlock(&writer->lock);
+            return ret;
+        }
+    }
+
     const int fd = vlc_open(priv->fs.path, O_RDONLY);
 
     if (fd == -1)
@@ -154,7 +225,7 @@ static ssize_t fs_storage_GetContent(const hls_storage_t *storage,
     close(fd);
     return read;
 err:
-    free(dest);
+    free(*dest);
     close(fd);
     return -1;
 }
@@ -177,8 +248,150 @@ static int fs_storage_Write(int fd, const uint8_t *data, size_t len)
     return VLC_SUCCESS;
 }
 
+static int fs_storage_WriteFile(const char *path, const block_t *content)
+{
+    const int fd = vlc_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1)
+        return VLC_EGENERIC;
+
+    for (const block_t *it = content; it != NULL; it = it->p_next)
+    {
+        const int status = fs_storage_Write(fd, it->p_buffer, it->i_buffer);
+        if (status != VLC_SUCCESS)
+        {
+            close(fd);
+            return status;
+        }
+    }
+
+    close(fd);
+    return VLC_SUCCESS;
+}
+
+static void hls_storage_writer_Queue(struct hls_storage_writer *writer,
+                                     struct storage_priv *priv)
+{
+    vlc_mutex_lock(&writer->lock);
+    /* Bounded queue: slow disks apply back-pressure on the muxing thread
+     * instead of growing the memory usage endlessly. */
+    while (writer->queue_length >= writer->max_pending)
+        vlc_cond_wait(&writer->wait_space, &writer->lock);
+
+    vlc_list_append(&priv->fs.node, &writer->queue);
+    ++writer->queue_length;
+    vlc_cond_signal(&writer->wait_request);
+    vlc_mutex_unlock(&writer->lock);
+}
+
+static void *hls_storage_writer_Thread(void *data)
+{
+    struct hls_storage_writer *writer = data;
+
+    vlc_thread_set_name("vlc-hls-writer");
+
+    vlc_mutex_lock(&writer->lock);
+    for (;;)
+    {
+        while (vlc_list_is_empty(&writer->queue) && !writer->closing)
+            vlc_cond_wait(&writer->wait_request, &writer->lock);
+
+        /* Drain the queue before exiting so that every segment and manifest
+         * reaches the disk. */
+        struct storage_priv *priv = vlc_list_first_entry_or_null(
+            &writer->queue, struct storage_priv, fs.node);
+        if (priv == NULL)
+            break;
+
+        vlc_list_remove(&priv->fs.node);
+        vlc_mutex_unlock(&writer->lock);
+
+        /* The pending content is only released by this thread, it can be
+         * safely accessed unlocked. */
+        const int status =
+            fs_storage_WriteFile(priv->fs.path, priv->fs.pending);
+        if (status != VLC_SUCCESS)
+            vlc_error(writer->logger, "Failed to write '%s'", priv->fs.path);
+
+        vlc_mutex_lock(&writer->lock);
+        if (status != VLC_SUCCESS)
+            priv->fs.failed = true;
+        --writer->queue_length;
+        vlc_cond_signal(&writer->wait_space);
+        while (priv->fs.readers > 0)
+            vlc_cond_wait(&writer->wait_readers, &writer->lock);
+        block_t *written = priv->fs.pending;
+        priv->fs.pending = NULL;
+        const bool orphaned = priv->fs.orphaned;
+        vlc_mutex_unlock(&writer->lock);
+
+        block_ChainRelease(written);
+        if (orphaned)
+        {
+            free(priv->fs.path);
+            free(priv);
+        }
+        vlc_mutex_lock(&writer->lock);
+    }
+    vlc_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+struct hls_storage_writer *hls_storage_writer_New(struct vlc_logger *logger,
+                                                  size_t max_pending)
+{
+    assert(max_pending > 0);
+
+    struct hls_storage_writer *writer = malloc(sizeof(*writer));
+    if (unlikely(writer == NULL))
+        return NULL;
+
+    vlc_mutex_init(&writer->lock);
+    vlc_cond_init(&writer->wait_request);
+    vlc_cond_init(&writer->wait_space);
+    vlc_cond_init(&writer->wait_readers);
+    vlc_list_init(&writer->queue);
+    writer->queue_length = 0;
+    writer->max_pending = max_pending;
+    writer->closing = false;
+    writer->logger = logger;
+
+    if (vlc_clone(&writer->thread, hls_storage_writer_Thread, writer) != 0)
+    {
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void hls_storage_writer_Delete(struct hls_storage_writer *writer)
+{
+    vlc_mutex_lock(&writer->lock);
+    writer->closing = true;
+    vlc_cond_signal(&writer->wait_request);
+    vlc_mutex_unlock(&writer->lock);
+
+    vlc_join(writer->thread, NULL);
+    assert(vlc_list_is_empty(&writer->queue));
+    free(writer);
+}
+
 static void fs_storage_Destroy(struct storage_priv *priv)
 {
+    struct hls_storage_writer *writer = priv->fs.writer;
+    if (writer != NULL)
+    {
+        vlc_mutex_lock(&writer->lock);
+        if (priv->fs.pending != NULL)
+        {
+            /* Still queued or being written: let the writer thread finish
+             * its job and release the storage afterward. */
+            priv->fs.orphaned = true;
+            vlc_mutex_unlock(&writer->lock);
+            return;
+        }
+        vlc_mutex_unlock(&writer->lock);
+    }
+
     free(priv->fs.path);
     free(priv);
 }
@@ -206,29 +419,26 @@ fs_storage_FromBlock(block_t *content,
     if (unlikely(priv->fs.path == NULL))
         goto err;
 
-    const int fd = vlc_open(priv->fs.path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-    if (fd == -1)
-        goto err;
+    priv->storage.get_content = fs_storage_GetContent;
+    priv->destroy = fs_storage_Destroy;
+    priv->fs.writer = hls_config->writer;
+    priv->fs.orphaned = false;
+    priv->fs.readers = 0;
+    priv->fs.failed = false;
+    block_ChainProperties(content, NULL, &priv->size, NULL);
 
-    size_t size = 0;
-    for (const block_t *it = content; it != NULL; it = it->p_next)
+    if (priv->fs.writer != NULL)
     {
-        const int status = fs_storage_Write(fd, it->p_buffer, it->i_buffer);
-        if (status != VLC_SUCCESS)
-        {
-            close(fd);
-            goto err;
-        }
-        size += it->i_buffer;
+        priv->fs.pending = content;
+        hls_storage_writer_Queue(priv->fs.writer, priv);
+        return &priv->storage;
     }
 
-    close(fd);
-    block_ChainRelease(content);
-
-    priv->storage.get_content = fs_storage_GetContent;
-    priv->size = size;
-    priv->destroy = fs_storage_Destroy;
+    priv->fs.pending = NULL;
+    if (fs_storage_WriteFile(priv->fs.path, content) != VLC_SUCCESS)
+        goto err;
 
+    block_ChainRelease(content);
     return &priv->storage;
 err:
     block_ChainRelease(content);
@@ -244,36 +454,11 @@ fs_storage_FromBytes(void *bytes,
                      const struct hls_storage_config *config,
                      const struct hls_config *hls_config)
 {
-    struct storage_priv *priv = malloc(sizeof(*priv));
-    if (unlikely(priv == NULL))
+    block_t *content = block_heap_Alloc(bytes, size);
+    if (unlikely(content == NULL))
         return NULL;
 
-    priv->fs.path = fs_storage_CreatePath(hls_config->outdir, config->name);
-    if (unlikely(priv->fs.path == NULL))
-        goto err;
-
-    const int fd = vlc_open(priv->fs.path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-    if (fd == -1)
-        goto err;
-
-    const int status = fs_storage_Write(fd, bytes, size);
-    close(fd);
-
-    if (unlikely(status != VLC_SUCCESS))
-        goto err;
-
-    priv->storage.get_content = fs_storage_GetContent;
-    priv->size = size;
-    priv->destroy = fs_storage_Destroy;
-
-    free(bytes);
-    return &priv->storage;
-err:
-    free(bytes);
-    if (priv != NULL)
-        free(priv->fs.path);
-    free(priv);
-    return NULL;
+    return fs_storage_FromBlock(content, config, hls_config);
 }
 
 hls_storage_t *hls_storage_FromBlocks(block_t *content,
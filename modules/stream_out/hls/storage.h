@@ -39,7 +39,7 @@ typedef struct hls_storage
      *
      * \param[out] dest Pointer on a byte buffer, will be freshly allocated by
      * the function call. \return Byte count of the byte buffer. \retval -1 On
-     * allocation error.
+     * allocation or write error.
      */
     ssize_t (*get_content)(const struct hls_storage *, uint8_t **dest);
 } hls_storage_t;
@@ -82,4 +82,36 @@ size_t hls_storage_GetSize(const hls_storage_t *);
 
 void hls_storage_Destroy(hls_storage_t *);
 
+/**
+ * Asynchronous filesystem storage writer.
+ *
+ * When set in the \ref hls_config, filesystem storages are written to disk
+ * by a background thread instead of the muxing thread. Writes are processed
+ * in creation order, so a manifest never reaches the disk before the
+ * segments it references. Pending content is served from memory until it is
+ * written. A storage whose write failed can't be read anymore: its
+ * get_content() callback fails instead of serving a partial file.
+ */
+struct hls_storage_writer;
+
+/**
+ * Create and start a storage writer.
+ *
+ * \param logger Logger used to report write errors.
+ * \param max_pending Maximum number of storages waiting to be written or being
+ * written. Storage creation blocks when this limit is reached.
+ *
+ * \return The writer or NULL on error.
+ */
+struct hls_storage_writer *hls_storage_writer_New(struct vlc_logger *logger,
+                                                  size_t max_pending) VLC_USED;
+
+/**
+ * Write every pending storage and stop the writer.
+ *
+ * \note Every storage created with the writer must have been destroyed
+ * before calling this function.
+ */
+void hls_storage_writer_Delete(struct hls_storage_writer *);
+
 #endif
@@ -132,6 +132,17 @@
 #define POOL_TEXT N_("Picture pool size")
 #define POOL_LONGTEXT N_( "Defines how many pictures we allow to be in pool "\
     "between decoder/encoder threads when threads > 0" )
+#define PIPELINE_TEXT N_("Threaded video filters")
+#define PIPELINE_LONGTEXT N_( \
+    "Runs the video filters, scalers and subpicture blending on their own " \
+    "thread, between the decoder and the encoder. Up to pool-size " \
+    "pictures can be queued before the decoder waits." )
+#define LADDER_TEXT N_("Video ladder")
+#define LADDER_LONGTEXT N_( \
+    "Comma-separated list of additional video renditions encoded from the " \
+    "same decoded pictures, as height:bitrate pairs (\"720:2500,480:1000\"). " \
+    "Each rendition is scaled from the previous one and output as a new " \
+    "elementary stream whose ID is the source ID suffixed by the height." )
 #define FORWARD_PCR_TEXT N_( "Forward PCR" )
 #define FORWARD_PCR_LONGTEXT N_( \
     "Enable PCR events forwarding to the next stream." )
@@ -186,6 +197,8 @@ vlc_module_begin ()
                  MAXHEIGHT_LONGTEXT )
     add_module_list(SOUT_CFG_PREFIX "vfilter", "video filter", NULL,
                     VFILTER_TEXT, VFILTER_LONGTEXT)
+    add_string( SOUT_CFG_PREFIX "ladder", NULL, LADDER_TEXT,
+                LADDER_LONGTEXT )
 
     set_section( N_("Audio"), NULL )
     add_module(SOUT_CFG_PREFIX "aenc", "audio encoder", "none",
@@ -220,6 +233,8 @@ vlc_module_begin ()
         change_integer_range( 0, 32 )
     add_integer( SOUT_CFG_PREFIX "pool-size", 10, POOL_TEXT, POOL_LONGTEXT )
         change_integer_range( 1, 1000 )
+    add_bool( SOUT_CFG_PREFIX "pipeline", false, PIPELINE_TEXT,
+              PIPELINE_LONGTEXT )
     add_obsolete_bool( SOUT_CFG_PREFIX "high-priority" ) // Since 4.0.0
     add_bool( SOUT_CFG_PREFIX "forward-pcr", true, FORWARD_PCR_TEXT,
               FORWARD_PCR_LONGTEXT )
@@ -232,7 +247,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "high-priority", "maxwidth", "maxheight", "pool-size",
-    "forward-pcr", NULL
+    "forward-pcr", "ladder", "pipeline", NULL
 };
 
 /*****************************************************************************
@@ -291,6 +306,12 @@ static void SetAudioEncoderConfig( sout_stream_t *p_stream, transcode_encoder_co
     p_cfg->psz_lang = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "alang" );
 }
 
+/* Video bitrates below 16000 are given in kb/s */
+static unsigned VideoBitrate( unsigned i_bitrate )
+{
+    return i_bitrate < 16000 ? i_bitrate * 1000 : i_bitrate;
+}
+
 static void SetVideoEncoderConfig( sout_stream_t *p_stream, transcode_encoder_config_t *p_cfg )
 {
     char *psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "venc" );
@@ -313,9 +334,8 @@ static void SetVideoEncoderConfig( sout_stream_t *p_stream, transcode_encoder_co
     }
     free( psz_string );
 
-    p_cfg->video.i_bitrate = var_GetInteger( p_stream, SOUT_CFG_PREFIX "vb" );
-    if( p_cfg->video.i_bitrate < 16000 )
-        p_cfg->video.i_bitrate *= 1000;
+    p_cfg->video.i_bitrate =
+        VideoBitrate( var_GetInteger( p_stream, SOUT_CFG_PREFIX "vb" ) );
 
     p_cfg->video.f_scale = var_GetFloat( p_stream, SOUT_CFG_PREFIX "scale" );
 
@@ -332,6 +352,50 @@ static void SetVideoEncoderConfig( sout_stream_t *p_stream, transcode_encoder_co
     p_cfg->video.threads.pool_size = var_GetInteger( p_stream, SOUT_CFG_PREFIX "pool-size" );
 }
 
+static void SetVideoLadderConfig( sout_stream_t *p_stream, sout_stream_sys_t *p_sys )
+{
+    p_sys->p_ladder_cfg = NULL;
+    p_sys->i_ladder_cfg = 0;
+
+    char *psz_string = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "ladder" );
+    if( !psz_string )
+        return;
+
+    size_t i_count = 1;
+    for( const char *p = psz_string; *p; p++ )
+        if( *p == ',' )
+            i_count++;
+
+    p_sys->p_ladder_cfg = vlc_alloc( i_count, sizeof(*p_sys->p_ladder_cfg) );
+    if( !p_sys->p_ladder_cfg )
+    {
+        free( psz_string );
+        return;
+    }
+
+    char *psz_save;
+    for( char *psz_rung = strtok_r( psz_string, ",", &psz_save );
+         psz_rung != NULL; psz_rung = strtok_r( NULL, ",", &psz_save ) )
+    {
+        unsigned i_height, i_bitrate = 0;
+        if( sscanf( psz_rung, "%u:%u", &i_height, &i_bitrate ) < 1 ||
+            i_height < 16 )
+        {
+            msg_Warn( p_stream, "ignoring invalid ladder rendition `%s'",
+                      psz_rung );
+            continue;
+        }
+
+        transcode_ladder_config_t *p_cfg =
+            &p_sys->p_ladder_cfg[p_sys->i_ladder_cfg++];
+        p_cfg->i_height = i_height & ~1;
+        p_cfg->i_bitrate = VideoBitrate( i_bitrate );
+        msg_Dbg( p_stream, "video ladder rendition %up %ukb/s",
+                 p_cfg->i_height, p_cfg->i_bitrate / 1000 );
+    }
+    free( psz_string );
+}
+
 static void SetSPUEncoderConfig( sout_stream_t *p_stream, transcode_encoder_config_t *p_cfg )
 {
     char *psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "senc" );
@@ -460,6 +524,8 @@ static int Open( vlc_object_t *p_this )
                  p_sys->venc_cfg.video.i_bitrate / 1000 );
     }
 
+    SetVideoLadderConfig( p_stream, p_sys );
+
     /* Video Filter Parameters */
     sout_filters_config_init( &p_sys->vfilters_cfg );
 
@@ -486,6 +552,10 @@ static int Open( vlc_object_t *p_this )
     else
         free( psz_string );
 
+    if( var_GetBool( p_stream, SOUT_CFG_PREFIX "pipeline" ) )
+        p_sys->vfilters_cfg.video.i_pipeline_size =
+            p_sys->venc_cfg.video.threads.pool_size;
+
     /* Subpictures transcoding parameters */
     transcode_encoder_config_init( &p_sys->senc_cfg );
 
@@ -517,6 +587,7 @@ static void Close( sout_stream_t *p_stream )
 
     transcode_encoder_config_clean( &p_sys->venc_cfg );
     sout_filters_config_clean( &p_sys->vfilters_cfg );
+    free( p_sys->p_ladder_cfg );
 
     transcode_encoder_config_clean( &p_sys->aenc_cfg );
     sout_filters_config_clean( &p_sys->afilters_cfg );
@@ -754,11 +825,13 @@ static void Del( sout_stream_t *p_stream, void *_id )
             if(!id->b_error)
                 Send( p_stream, id, NULL );
             dec_Delete( id->p_decoder );
+            transcode_video_stop( id );
             vlc_mutex_lock( &p_sys->lock );
             if( id == p_sys->id_video )
                 p_sys->id_video = NULL;
             vlc_mutex_unlock( &p_sys->lock );
-            transcode_video_clean( id );
+            transcode_video_ladder_clean( p_stream, id );
+            transcode_video_clean( p_stream, id );
             break;
         case SPU_ES:
             dec_Delete( id->p_decoder );
@@ -819,6 +892,10 @@ static int Send( sout_stream_t *p_stream, void *_id, block_t *p_buffer )
 
     case VIDEO_ES:
         i_ret = transcode_video_process( p_stream, id, p_buffer, &p_out );
+        /* Ladder renditions don't take part in the PCR synchronisation,
+         * send them ahead of the main rendition and its PCR updates. */
+        if( transcode_video_ladder_send( p_stream, id ) != VLC_SUCCESS )
+            i_ret = VLC_EGENERIC;
         break;
 
     case SPU_ES:
@@ -1,5 +1,7 @@
 #include <vlc_configuration.h>
 #include <vlc_picture_fifo.h>
+#include <vlc_picture_pool.h>
+#include <vlc_vector.h>
 #include <vlc_filter.h>
 #include <vlc_codec.h>
 #include "encoder/encoder.h"
@@ -19,6 +21,8 @@ typedef struct
             config_chain_t  *p_deinterlace_cfg;
             char            *psz_spu_sources;
             bool             b_reorient;
+            /* Pictures queued for the filtering thread, 0 if disabled */
+            unsigned int     i_pipeline_size;
         } video;
     };
 } sout_filters_config_t;
@@ -43,6 +47,23 @@ void sout_filters_config_clean( sout_filters_config_t *p_cfg )
 
 typedef struct sout_stream_id_sys_t sout_stream_id_sys_t;
 
+/* Filter output pictures of one format */
+typedef struct
+{
+    video_format_t fmt;
+    picture_pool_t *pool;
+} transcode_picture_pool_t;
+
+/* One extra video rendition encoded from the same decoded pictures */
+typedef struct
+{
+    unsigned int i_height;
+    unsigned int i_bitrate;
+} transcode_ladder_config_t;
+
+typedef struct transcode_ladder_rung_t transcode_ladder_rung_t;
+typedef struct transcode_video_pipeline_t transcode_video_pipeline_t;
+
 typedef struct
 {
     bool                  b_soverlay;
@@ -54,6 +75,8 @@ typedef struct
     /* Video */
     transcode_encoder_config_t venc_cfg;
     sout_filters_config_t vfilters_cfg;
+    transcode_ladder_config_t *p_ladder_cfg;
+    size_t i_ladder_cfg;
 
     /* SPU */
     transcode_encoder_config_t senc_cfg;
@@ -134,6 +157,17 @@ struct sout_stream_id_sys_t
              spu_t           *p_spu;
              vlc_decoder_device *dec_dev;
              vlc_video_context *enc_vctx_in;
+             /* Ladder renditions, each one scaled from the previous one */
+             transcode_ladder_rung_t *p_rungs;
+             size_t i_rungs;
+             /* Filtering thread between the decoder and the encoder */
+             transcode_video_pipeline_t *p_pipeline;
+             /* Filter output pictures, recycled once the encoder is done,
+              * one pool per format produced by the filters and the ladder */
+             struct VLC_VECTOR(transcode_picture_pool_t) pic_pools;
+             unsigned i_pic_pool_size;
+             uint64_t i_pic_pooled; /**< pictures taken from the pools */
+             uint64_t i_pic_allocated; /**< pictures allocated when a pool ran out */
          };
          struct
          {
@@ -225,12 +259,15 @@ int  transcode_audio_init   ( sout_stream_t *, const es_format_t *,
 
 /* VIDEO */
 
-void transcode_video_clean  ( sout_stream_id_sys_t * );
+void transcode_video_clean  ( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_video_stop   ( sout_stream_id_sys_t * );
 int  transcode_video_process( sout_stream_t *, sout_stream_id_sys_t *,
                                      block_t *, block_t ** );
 void transcode_video_flush  ( sout_stream_id_sys_t * );
 int transcode_video_get_output_dimensions( sout_stream_id_sys_t *,
                                            unsigned *w, unsigned *h );
 void transcode_video_push_spu( sout_stream_t *, sout_stream_id_sys_t *, subpicture_t * );
+int  transcode_video_ladder_send( sout_stream_t *, sout_stream_id_sys_t * );
+void transcode_video_ladder_clean( sout_stream_t *, sout_stream_id_sys_t * );
 int  transcode_video_init    ( sout_stream_t *, const es_format_t *,
                                sout_stream_id_sys_t *);
@@ -35,6 +35,7 @@
 #include <vlc_spu.h>
 #include <vlc_modules.h>
 #include <vlc_sout.h>
+#include <vlc_picture_fifo.h>
 
 #include "transcode.h"
 
@@ -90,10 +91,77 @@ static void debug_format( vlc_object_t *p_obj, const es_format_t *fmt )
              fmt->video.orientation );
 }
 
+static picture_t *transcode_video_picture_new( sout_stream_id_sys_t *id,
+                                              const video_format_t *p_fmt )
+{
+    picture_t *p_pic = NULL;
+    picture_pool_t *p_pool = NULL;
+
+    transcode_picture_pool_t *p_entry;
+    vlc_vector_foreach_ref( p_entry, &id->pic_pools )
+    {
+        if( video_format_IsSimilar( &p_entry->fmt, p_fmt ) )
+        {
+            p_pool = p_entry->pool;
+            break;
+        }
+    }
+
+    if( p_pool == NULL )
+    {
+        /* New format: the pools are keyed by format and kept until the
+         * stream is closed, so that the main chain and the ladder scalers,
+         * which produce pictures concurrently in their own formats, never
+         * evict each other's pools. */
+        transcode_picture_pool_t entry = {
+            .pool = picture_pool_NewLazy( p_fmt, id->i_pic_pool_size ),
+        };
+        if( entry.pool != NULL )
+        {
+            video_format_Copy( &entry.fmt, p_fmt );
+            if( vlc_vector_push( &id->pic_pools, entry ) )
+                p_pool = entry.pool;
+            else
+            {
+                picture_pool_Release( entry.pool );
+                video_format_Clean( &entry.fmt );
+            }
+        }
+    }
+
+    if( p_pool != NULL )
+        p_pic = picture_pool_Get( p_pool );
+
+    if( p_pic != NULL )
+    {
+        /* Similar formats can still differ in colorimetry */
+        video_format_Clean( &p_pic->format );
+        video_format_Copy( &p_pic->format, p_fmt );
+        id->i_pic_pooled++;
+        return p_pic;
+    }
+
+    /* Downstream holds more pictures than expected: don't stall */
+    id->i_pic_allocated++;
+    return picture_NewFromFormat( p_fmt );
+}
+
+static void transcode_video_picture_pools_clean( sout_stream_id_sys_t *id )
+{
+    transcode_picture_pool_t *p_entry;
+    vlc_vector_foreach_ref( p_entry, &id->pic_pools )
+    {
+        picture_pool_Release( p_entry->pool );
+        video_format_Clean( &p_entry->fmt );
+    }
+    vlc_vector_destroy( &id->pic_pools );
+}
+
 static picture_t *transcode_video_filter_buffer_new( filter_t *p_filter )
 {
     assert(p_filter->fmt_out.video.i_chroma == p_filter->fmt_out.i_codec);
-    return picture_NewFromFormat( &p_filter->fmt_out.video );
+    return transcode_video_picture_new( p_filter->owner.sys,
+                                        &p_filter->fmt_out.video );
 }
 
 static vlc_decoder_device * transcode_video_filter_hold_device(vlc_object_t *o, void *sys)
@@ -114,11 +182,271 @@ static int transcode_video_filters_init( sout_stream_t *p_stream,
                                          const es_format_t *p_dst,
                                          sout_stream_id_sys_t *id );
 
+static void transcode_video_pipeline_wait( transcode_video_pipeline_t * );
+
+struct transcode_ladder_rung_t
+{
+    /* Borrows the strings and options of the main encoder configuration */
+    transcode_encoder_config_t cfg;
+    filter_chain_t *p_scaler; /**< previous rendition -> rung encoder */
+    transcode_encoder_t *encoder;
+    vlc_fifo_t *output_fifo;
+    void *downstream_id;
+    char *psz_es_id;
+    bool b_dropping; /**< output dropped, without downstream stream */
+};
+
+static void transcode_video_ladder_rung_clean( transcode_ladder_rung_t *p_rung )
+{
+    if( p_rung->encoder )
+        transcode_encoder_delete( p_rung->encoder );
+    transcode_remove_filters( &p_rung->p_scaler );
+    if( p_rung->output_fifo )
+        block_FifoRelease( p_rung->output_fifo );
+    free( p_rung->psz_es_id );
+}
+
+static int transcode_video_ladder_init( sout_stream_t *p_stream,
+                                        sout_stream_id_sys_t *id,
+                                        vlc_video_context *enc_vctx )
+{
+    const sout_stream_sys_t *p_sys = p_stream->p_sys;
+    if( p_sys->i_ladder_cfg == 0 )
+        return VLC_SUCCESS;
+
+    id->p_rungs = calloc( p_sys->i_ladder_cfg, sizeof(*id->p_rungs) );
+    if( !id->p_rungs )
+        return VLC_ENOMEM;
+
+    filter_owner_t chain_owner = {
+        .video = &transcode_filter_video_cbs,
+        .sys = id,
+    };
+
+    /* Each rendition is scaled from the previous one instead of the source
+     * so that every scaler works on the smallest possible input. */
+    const es_format_t *p_src = transcode_encoder_format_in( id->encoder );
+    vlc_video_context *src_vctx = enc_vctx;
+
+    for( size_t i = 0; i < p_sys->i_ladder_cfg; i++ )
+    {
+        const transcode_ladder_config_t *p_cfg = &p_sys->p_ladder_cfg[i];
+
+        /* Don't upscale a rendition from a smaller one */
+        const unsigned i_src_height = p_src->video.i_visible_height ?
+                                      p_src->video.i_visible_height :
+                                      p_src->video.i_height;
+        if( p_cfg->i_height > i_src_height )
+        {
+            msg_Warn( p_stream, "ignoring the %up ladder rendition, taller "
+                      "than its %up source", p_cfg->i_height, i_src_height );
+            continue;
+        }
+
+        transcode_ladder_rung_t *p_rung = &id->p_rungs[id->i_rungs++];
+
+        p_rung->cfg = *id->p_enccfg;
+        p_rung->cfg.video.f_scale = 0;
+        p_rung->cfg.video.i_width = 0;
+        p_rung->cfg.video.i_height = p_cfg->i_height;
+        p_rung->cfg.video.i_maxwidth = 0;
+        p_rung->cfg.video.i_maxheight = 0;
+        if( p_cfg->i_bitrate )
+            p_rung->cfg.video.i_bitrate = p_cfg->i_bitrate;
+
+        if( asprintf( &p_rung->psz_es_id, "%s/%up", id->es_id,
+                      p_cfg->i_height ) == -1 )
+        {
+            p_rung->psz_es_id = NULL;
+            goto error;
+        }
+
+        p_rung->output_fifo = block_FifoNew();
+        if( !p_rung->output_fifo )
+            goto error;
+
+        struct encoder_owner *p_enc_owner =
+           (struct encoder_owner *)sout_EncoderCreate( VLC_OBJECT(p_stream), sizeof(struct encoder_owner) );
+        if( unlikely(p_enc_owner == NULL) )
+            goto error;
+
+        p_rung->encoder = transcode_encoder_new( &p_enc_owner->enc, p_src );
+        if( !p_rung->encoder )
+        {
+            vlc_object_delete( &p_enc_owner->enc );
+            goto error;
+        }
+        p_enc_owner->id = id;
+        p_enc_owner->enc.cbs = &encoder_video_transcode_cbs;
+
+        transcode_encoder_video_configure( VLC_OBJECT(p_stream),
+                                           &id->p_decoder->fmt_out.video,
+                                           &p_rung->cfg, &p_src->video,
+                                           src_vctx, p_rung->encoder );
+        if( transcode_encoder_open( p_rung->encoder, &p_rung->cfg ) != VLC_SUCCESS )
+        {
+            msg_Err( p_stream, "cannot open the %up ladder encoder",
+                     p_cfg->i_height );
+            goto error;
+        }
+
+        p_rung->p_scaler = filter_chain_NewVideo( p_stream, false, &chain_owner );
+        if( !p_rung->p_scaler )
+            goto error;
+        filter_chain_Reset( p_rung->p_scaler, p_src, src_vctx,
+                            transcode_encoder_format_in( p_rung->encoder ) );
+        if( filter_chain_AppendConverter( p_rung->p_scaler, NULL ) != VLC_SUCCESS )
+        {
+            msg_Err( p_stream, "cannot scale to the %up ladder encoder",
+                     p_cfg->i_height );
+            goto error;
+        }
+
+        p_src = transcode_encoder_format_in( p_rung->encoder );
+        src_vctx = filter_chain_GetVideoCtxOut( p_rung->p_scaler );
+        debug_format( VLC_OBJECT(p_stream), p_src );
+    }
+
+    return VLC_SUCCESS;
+
+error:
+    for( size_t i = 0; i < id->i_rungs; i++ )
+        transcode_video_ladder_rung_clean( &id->p_rungs[i] );
+    free( id->p_rungs );
+    id->p_rungs = NULL;
+    id->i_rungs = 0;
+    return VLC_EGENERIC;
+}
+
+static void transcode_video_ladder_encode( sout_stream_id_sys_t *id,
+                                           picture_t *p_pic )
+{
+    for( size_t i = 0; i < id->i_rungs; i++ )
+    {
+        transcode_ladder_rung_t *p_rung = &id->p_rungs[i];
+
+        p_pic = filter_chain_VideoFilter( p_rung->p_scaler, p_pic );
+        if( !p_pic )
+            return;
+
+        block_t *p_encoded = transcode_encoder_encode( p_rung->encoder, p_pic );
+        if( p_encoded )
+            block_FifoPut( p_rung->output_fifo, p_encoded );
+    }
+    picture_Release( p_pic );
+}
+
+static void transcode_video_ladder_drain( sout_stream_id_sys_t *id )
+{
+    for( size_t i = 0; i < id->i_rungs; i++ )
+    {
+        transcode_ladder_rung_t *p_rung = &id->p_rungs[i];
+        block_t *p_drained = NULL;
+
+        if( transcode_encoder_drain( p_rung->encoder, &p_drained ) != VLC_SUCCESS )
+            continue;
+        if( p_drained )
+            block_FifoPut( p_rung->output_fifo, p_drained );
+    }
+}
+
+int transcode_video_ladder_send( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    int i_ret = VLC_SUCCESS;
+
+    for( size_t i = 0; i < id->i_rungs; i++ )
+    {
+        transcode_ladder_rung_t *p_rung = &id->p_rungs[i];
+
+        vlc_fifo_Lock( p_rung->output_fifo );
+        block_t *p_out = vlc_fifo_DequeueAllUnlocked( p_rung->output_fifo );
+        vlc_fifo_Unlock( p_rung->output_fifo );
+        block_ChainAppend( &p_out, transcode_encoder_get_output_async( p_rung->encoder ) );
+
+        if( p_out == NULL )
+            continue;
+
+        /* A rendition refused downstream doesn't stop the other ones */
+        if( p_rung->downstream_id == NULL )
+        {
+            if( !p_rung->b_dropping )
+                msg_Warn( p_stream, "dropping the %s ladder rendition, "
+                          "without output stream", p_rung->psz_es_id );
+            p_rung->b_dropping = true;
+            block_ChainRelease( p_out );
+            continue;
+        }
+
+        if( sout_StreamIdSend( p_stream->p_next, p_rung->downstream_id,
+                               p_out ) != VLC_SUCCESS )
+            i_ret = VLC_EGENERIC;
+    }
+    return i_ret;
+}
+
+static void transcode_video_ladder_delete( sout_stream_t *p_stream,
+                                           transcode_ladder_rung_t *p_rungs,
+                                           size_t i_rungs )
+{
+    for( size_t i = 0; i < i_rungs; i++ )
+    {
+        transcode_ladder_rung_t *p_rung = &p_rungs[i];
+        if( p_rung->downstream_id )
+            sout_StreamIdDel( p_stream->p_next, p_rung->downstream_id );
+        transcode_video_ladder_rung_clean( p_rung );
+    }
+    free( p_rungs );
+}
+
+void transcode_video_ladder_clean( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    transcode_video_ladder_delete( p_stream, id->p_rungs, id->i_rungs );
+    id->p_rungs = NULL;
+    id->i_rungs = 0;
+}
+
+/* (Re)create the ladder encoders, from the input of the main encoder that
+ * was just opened. The output streams of the renditions that are kept are
+ * reused, as the main one is. */
+static int transcode_video_ladder_open( sout_stream_t *p_stream,
+                                        sout_stream_id_sys_t *id,
+                                        vlc_video_context *enc_vctx )
+{
+    transcode_ladder_rung_t *p_old = id->p_rungs;
+    const size_t i_old = id->i_rungs;
+
+    id->p_rungs = NULL;
+    id->i_rungs = 0;
+    int i_ret = transcode_video_ladder_init( p_stream, id, enc_vctx );
+
+    for( size_t i = 0; i < id->i_rungs; i++ )
+    {
+        transcode_ladder_rung_t *p_rung = &id->p_rungs[i];
+        for( size_t j = 0; j < i_old; j++ )
+        {
+            if( p_old[j].downstream_id != NULL &&
+                !strcmp( p_old[j].psz_es_id, p_rung->psz_es_id ) )
+            {
+                p_rung->downstream_id = p_old[j].downstream_id;
+                p_old[j].downstream_id = NULL;
+                break;
+            }
+        }
+    }
+    transcode_video_ladder_delete( p_stream, p_old, i_old );
+    return i_ret;
+}
+
 static int video_update_format_decoder( decoder_t *p_dec, vlc_video_context *vctx )
 {
     struct decoder_owner *p_owner = dec_get_owner( p_dec );
     sout_stream_id_sys_t *id = p_owner->id;
 
+    /* The filters are rebuilt below: let the filtering thread finish with
+     * the pictures in the previous format first. */
+    if( id->p_pipeline != NULL )
+        transcode_video_pipeline_wait( id->p_pipeline );
+
     vlc_mutex_lock(&id->fifo.lock);
     if( id->encoder != NULL && transcode_encoder_opened( id->encoder ) )
     {
@@ -185,6 +513,7 @@ static int video_update_format_decoder( decoder_t *p_dec, vlc_video_context *vct
         out_fmt = &id->decoder_out;
     }
 
+    bool b_encoder_opened = false;
     if( !transcode_encoder_opened( id->encoder ) )
     {
         transcode_encoder_video_configure( VLC_OBJECT(p_owner->p_stream),
@@ -196,6 +525,7 @@ static int video_update_format_decoder( decoder_t *p_dec, vlc_video_context *vct
 
         if( transcode_encoder_open( id->encoder, id->p_enccfg ) != VLC_SUCCESS )
             goto error;
+        b_encoder_opened = true;
     }
 
     const es_format_t *encoder_fmt = transcode_encoder_format_in( id->encoder );
@@ -217,6 +547,15 @@ static int video_update_format_decoder( decoder_t *p_dec, vlc_video_context *vct
          if( filter_chain_AppendConverter( id->p_final_conv_static, NULL ) != VLC_SUCCESS )
              goto error;
     }
+
+    /* The ladder encoders are fed from the main encoder input, which doesn't
+     * change for the lifetime of the encoder: they are restarted with it. */
+    if( b_encoder_opened &&
+        transcode_video_ladder_open( p_owner->p_stream, id,
+                                     id->p_final_conv_static ?
+                                     filter_chain_GetVideoCtxOut( id->p_final_conv_static ) :
+                                     enc_vctx ) != VLC_SUCCESS )
+        goto error;
     vlc_mutex_unlock(&id->fifo.lock);
 
     if( !id->downstream_id )
@@ -225,6 +564,16 @@ static int video_update_format_decoder( decoder_t *p_dec, vlc_video_context *vct
                                              id->p_decoder->fmt_in,
                                              transcode_encoder_format_out( id->encoder ),
                                              id->es_id );
+    for( size_t i = 0; i < id->i_rungs; i++ )
+    {
+        transcode_ladder_rung_t *p_rung = &id->p_rungs[i];
+        if( !p_rung->downstream_id )
+            p_rung->downstream_id =
+                id->pf_transcode_downstream_add( p_owner->p_stream,
+                                                 id->p_decoder->fmt_in,
+                                                 transcode_encoder_format_out( p_rung->encoder ),
+                                                 p_rung->psz_es_id );
+    }
     msg_Info( p_dec, "video format update succeed" );
 
 end:
@@ -244,19 +593,18 @@ error:
     return VLC_EGENERIC;
 }
 
-static picture_t *video_new_buffer_encoder( transcode_encoder_t *p_enc )
+static picture_t *video_new_buffer_encoder( sout_stream_id_sys_t *id )
 {
-    return picture_NewFromFormat( &transcode_encoder_format_in( p_enc )->video );
+    return transcode_video_picture_new( id,
+                    &transcode_encoder_format_in( id->encoder )->video );
 }
 
 static int transcode_process_picture( sout_stream_id_sys_t *id,
                                       picture_t *p_pic, block_t **out);
 
-static void decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
+static void transcode_video_output_picture( sout_stream_id_sys_t *id,
+                                           picture_t *p_pic )
 {
-    struct decoder_owner *p_owner = dec_get_owner( p_dec );
-    sout_stream_id_sys_t *id = p_owner->id;
-
     block_t *p_block = NULL;
     int ret = transcode_process_picture( id, p_pic, &p_block );
 
@@ -276,6 +624,162 @@ static void decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
     vlc_fifo_Unlock( id->output_fifo );
 }
 
+struct transcode_video_pipeline_t
+{
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    vlc_cond_t wait_request; /**< a picture was queued, or closing */
+    vlc_cond_t wait_space; /**< a picture was dequeued */
+    vlc_cond_t wait_idle; /**< nothing queued nor being filtered */
+    picture_fifo_t *queue;
+    size_t i_queued;
+    size_t i_max;
+    bool b_busy;
+    bool b_closing;
+
+    sout_stream_id_sys_t *id;
+};
+
+static void *transcode_video_pipeline_Thread( void *data )
+{
+    transcode_video_pipeline_t *p_pl = data;
+
+    vlc_thread_set_name( "vlc-tc-filter" );
+
+    vlc_mutex_lock( &p_pl->lock );
+    for( ;; )
+    {
+        while( p_pl->i_queued == 0 && !p_pl->b_closing )
+            vlc_cond_wait( &p_pl->wait_request, &p_pl->lock );
+        if( p_pl->i_queued == 0 )
+            break;
+
+        picture_t *p_pic = picture_fifo_Pop( p_pl->queue );
+        p_pl->i_queued--;
+        p_pl->b_busy = true;
+        vlc_cond_signal( &p_pl->wait_space );
+        vlc_mutex_unlock( &p_pl->lock );
+
+        transcode_video_output_picture( p_pl->id, p_pic );
+
+        vlc_mutex_lock( &p_pl->lock );
+        p_pl->b_busy = false;
+        if( p_pl->i_queued == 0 )
+            vlc_cond_broadcast( &p_pl->wait_idle );
+    }
+    vlc_mutex_unlock( &p_pl->lock );
+    return NULL;
+}
+
+static int transcode_video_pipeline_start( sout_stream_t *p_stream,
+                                           sout_stream_id_sys_t *id,
+                                           size_t i_max )
+{
+    transcode_video_pipeline_t *p_pl = malloc( sizeof(*p_pl) );
+    if( unlikely(p_pl == NULL) )
+        return VLC_ENOMEM;
+
+    p_pl->queue = picture_fifo_New();
+    if( unlikely(p_pl->queue == NULL) )
+    {
+        free( p_pl );
+        return VLC_ENOMEM;
+    }
+
+    vlc_mutex_init( &p_pl->lock );
+    vlc_cond_init( &p_pl->wait_request );
+    vlc_cond_init( &p_pl->wait_space );
+    vlc_cond_init( &p_pl->wait_idle );
+    p_pl->i_queued = 0;
+    p_pl->i_max = i_max;
+    p_pl->b_busy = false;
+    p_pl->b_closing = false;
+    p_pl->id = id;
+
+    if( vlc_clone( &p_pl->thread, transcode_video_pipeline_Thread, p_pl ) )
+    {
+        msg_Err( p_stream, "cannot spawn the video filtering thread" );
+        picture_fifo_Delete( p_pl->queue );
+        free( p_pl );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_stream, "filtering video on a separate thread, queue of %zu",
+             i_max );
+    id->p_pipeline = p_pl;
+    return VLC_SUCCESS;
+}
+
+/* Drop the queued pictures, if any, and wait for the picture being filtered
+ * to reach the encoder. */
+static void transcode_video_pipeline_flush( transcode_video_pipeline_t *p_pl )
+{
+    vlc_mutex_lock( &p_pl->lock );
+    picture_fifo_Flush( p_pl->queue, VLC_TICK_INVALID, true );
+    p_pl->i_queued = 0;
+    vlc_cond_broadcast( &p_pl->wait_space );
+    while( p_pl->b_busy )
+        vlc_cond_wait( &p_pl->wait_idle, &p_pl->lock );
+    vlc_mutex_unlock( &p_pl->lock );
+}
+
+/* Wait for every queued picture to reach the encoder. */
+static void transcode_video_pipeline_wait( transcode_video_pipeline_t *p_pl )
+{
+    vlc_mutex_lock( &p_pl->lock );
+    while( p_pl->i_queued > 0 || p_pl->b_busy )
+        vlc_cond_wait( &p_pl->wait_idle, &p_pl->lock );
+    vlc_mutex_unlock( &p_pl->lock );
+}
+
+void transcode_video_stop( sout_stream_id_sys_t *id )
+{
+    transcode_video_pipeline_t *p_pl = id->p_pipeline;
+    if( p_pl == NULL )
+        return;
+
+    vlc_mutex_lock( &p_pl->lock );
+    picture_fifo_Flush( p_pl->queue, VLC_TICK_INVALID, true );
+    p_pl->i_queued = 0;
+    p_pl->b_closing = true;
+    vlc_cond_signal( &p_pl->wait_request );
+    vlc_mutex_unlock( &p_pl->lock );
+
+    vlc_join( p_pl->thread, NULL );
+    picture_fifo_Delete( p_pl->queue );
+    free( p_pl );
+    id->p_pipeline = NULL;
+}
+
+static void decoder_queue_video( decoder_t *p_dec, picture_t *p_pic )
+{
+    struct decoder_owner *p_owner = dec_get_owner( p_dec );
+    sout_stream_id_sys_t *id = p_owner->id;
+    transcode_video_pipeline_t *p_pl = id->p_pipeline;
+
+    if( p_pl == NULL )
+    {
+        transcode_video_output_picture( id, p_pic );
+        return;
+    }
+
+    /* Block the decoder while the filtering thread is late, so that the
+     * input, and the PCR forwarded downstream, stay close to the output. */
+    vlc_mutex_lock( &p_pl->lock );
+    while( p_pl->i_queued >= p_pl->i_max && !p_pl->b_closing )
+        vlc_cond_wait( &p_pl->wait_space, &p_pl->lock );
+    if( p_pl->b_closing )
+    {
+        vlc_mutex_unlock( &p_pl->lock );
+        picture_Release( p_pic );
+        return;
+    }
+    picture_fifo_Push( p_pl->queue, p_pic );
+    p_pl->i_queued++;
+    vlc_cond_signal( &p_pl->wait_request );
+    vlc_mutex_unlock( &p_pl->lock );
+}
+
 int transcode_video_init( sout_stream_t *p_stream, const es_format_t *p_fmt,
                           sout_stream_id_sys_t *id )
 {
@@ -307,12 +811,29 @@ int transcode_video_init( sout_stream_t *p_stream, const es_format_t *p_fmt,
     id->p_decoder->pf_decode = NULL;
     id->p_decoder->pf_get_cc = NULL;
 
+    /* Enough pictures for the encoder queue, the filtering queue and the
+     * ones being filtered or held by the encoder as references. */
+    id->i_pic_pool_size = __MIN( id->p_enccfg->video.threads.pool_size +
+                                 id->p_filterscfg->video.i_pipeline_size + 4,
+                                 64 );
+    vlc_vector_init( &id->pic_pools );
+
+    id->p_pipeline = NULL;
+    if( id->p_filterscfg->video.i_pipeline_size > 0 &&
+        transcode_video_pipeline_start( p_stream, id,
+                    id->p_filterscfg->video.i_pipeline_size ) != VLC_SUCCESS )
+    {
+        es_format_Clean( &id->decoder_out );
+        return VLC_EGENERIC;
+    }
+
     id->p_decoder->p_module =
         module_need_var( id->p_decoder, "video decoder", "codec" );
 
     if( !id->p_decoder->p_module )
     {
         msg_Err( p_stream, "cannot find video decoder" );
+        transcode_video_stop( id );
         es_format_Clean( &id->decoder_out );
         return VLC_EGENERIC;
     }
@@ -396,16 +917,25 @@ static int transcode_video_filters_init( sout_stream_t *p_stream,
 
 void transcode_video_flush( sout_stream_id_sys_t *id )
 {
+    if( id->p_pipeline != NULL )
+        transcode_video_pipeline_flush( id->p_pipeline );
     if ( id->p_f_chain != NULL )
         filter_chain_VideoFlush( id->p_f_chain );
     if ( id->p_uf_chain != NULL )
         filter_chain_VideoFlush( id->p_uf_chain );
     if ( id->p_final_conv_static != NULL )
         filter_chain_VideoFlush( id->p_final_conv_static );
+    for( size_t i = 0; i < id->i_rungs; i++ )
+        filter_chain_VideoFlush( id->p_rungs[i].p_scaler );
 }
 
-void transcode_video_clean( sout_stream_id_sys_t *id )
+void transcode_video_clean( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
 {
+    transcode_video_stop( id );
+
+    msg_Dbg( p_stream, "%"PRIu64" filtered pictures recycled, %"PRIu64
+             " allocated", id->i_pic_pooled, id->i_pic_allocated );
+
     /* Close encoder, but only if one was opened. */
     if ( id->encoder )
         transcode_encoder_delete( id->encoder );
@@ -416,6 +946,7 @@ void transcode_video_clean( sout_stream_id_sys_t *id )
     transcode_remove_filters( &id->p_f_chain );
     transcode_remove_filters( &id->p_uf_chain );
     transcode_remove_filters( &id->p_final_conv_static );
+    transcode_video_picture_pools_clean( id );
     if( id->p_spu_blender )
         filter_DeleteBlend( id->p_spu_blender );
     if( id->p_spu )
@@ -478,7 +1009,7 @@ static picture_t * RenderSubpictures( sout_stream_id_sys_t *id, picture_t *p_pic
         {
             /* We can't modify the picture, we need to duplicate it,
                  * in this point the picture is already p_encoder->fmt.in format*/
-            picture_t *p_tmp = video_new_buffer_encoder( id->encoder );
+            picture_t *p_tmp = video_new_buffer_encoder( id );
             if( likely( p_tmp ) )
             {
                 picture_Copy( p_tmp, p_pic );
@@ -545,10 +1076,16 @@ static int transcode_process_picture( sout_stream_id_sys_t *id,
 
             if( p_in )
             {
+                /* Decoded once, encoded for every rendition */
+                picture_t *p_ladder_src = id->i_rungs > 0 ? picture_Hold( p_in ) : NULL;
+
                 /* If a packetizer is used, multiple blocks might be returned, in w */
                 block_t *p_encoded = transcode_encoder_encode( id->encoder, p_in );
                 picture_Release( p_in );
                 block_ChainAppend( out, p_encoded );
+
+                if( p_ladder_src )
+                    transcode_video_ladder_encode( id, p_ladder_src );
             }
         }
     }
@@ -574,6 +1111,9 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
     if( id->encoder == NULL )
         return VLC_SUCCESS;
 
+    if( in == NULL && id->p_pipeline != NULL )
+        transcode_video_pipeline_wait( id->p_pipeline );
+
     vlc_fifo_Lock( id->output_fifo );
     if( unlikely( !id->b_error && in == NULL ) && transcode_encoder_opened( id->encoder ) )
     {
@@ -582,6 +1122,7 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             msg_Dbg( p_stream, "Draining done");
         else
             msg_Warn( p_stream, "Draining failed");
+        transcode_video_ladder_drain( id );
     }
     bool has_error = id->b_error;
     if( !has_error )
@@ -156,6 +156,7 @@ struct vlc_aout_stream_cfg
     struct vlc_clock_t *clock;
     const char *str_id;
     const audio_replay_gain_t *replay_gain;
+    struct vlc_histogram *histograms; /**< input latency histograms, or NULL */
 };
 
 vlc_aout_stream *vlc_aout_stream_New(audio_output_t *p_aout,
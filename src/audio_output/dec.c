@@ -30,6 +30,7 @@
 #include <assert.h>
 
 #include <math.h>
+#include <stdlib.h>
 
 #include <vlc_common.h>
 #include <vlc_aout.h>
@@ -38,6 +39,8 @@
 #include "aout_internal.h"
 #include "clock/clock.h"
 #include "libvlc.h"
+#include "misc/latency.h"
+#include "misc/histogram.h"
 
 struct vlc_aout_stream
 {
@@ -81,6 +84,7 @@ struct vlc_aout_stream
     } timing;
 
     const char *str_id;
+    struct vlc_histogram *histograms;
 
     /* Original input format and profile, won't change for the lifetime of a
      * stream (between vlc_aout_stream_New() and vlc_aout_stream_Delete()). */
@@ -269,6 +273,7 @@ vlc_aout_stream * vlc_aout_stream_New(audio_output_t *p_aout,
 
     stream->sync.clock = cfg->clock;
     stream->str_id = cfg->str_id;
+    stream->histograms = cfg->histograms;
 
     stream->timing.rate_audio_ts = VLC_TICK_INVALID;
     stream->timing.rate = 1.f;
@@ -678,6 +683,14 @@ static void stream_Synchronize(vlc_aout_stream *stream, vlc_tick_t system_now,
         vlc_clock_Unlock(stream->sync.clock);
     }
 
+    if (stream->histograms != NULL && drift != VLC_TICK_MAX)
+    {
+        vlc_histogram_Add(&stream->histograms[INPUT_STATS_AOUT_LATENCY],
+                          delay);
+        vlc_histogram_Add(&stream->histograms[INPUT_STATS_AOUT_DRIFT],
+                          llabs(drift));
+    }
+
     stream_HandleDrift(stream, drift, dec_pts);
 }
 
@@ -737,6 +750,9 @@ int vlc_aout_stream_Play(vlc_aout_stream *stream, block_t *block)
     block->i_length = vlc_tick_from_samples( block->i_nb_samples,
                                    stream->input_format.i_rate );
 
+    vlc_latency_StampFrame(aout_stream_tracer(stream), stream->str_id, block,
+                           VLC_LATENCY_PLAY);
+
     int ret = stream_CheckReady (stream);
     if (unlikely(ret == AOUT_DEC_FAILED))
         goto drop; /* Pipeline is unrecoverably broken :-( */
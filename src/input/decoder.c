@@ -53,6 +53,7 @@
 #include "decoder.h"
 #include "resource.h"
 #include "libvlc.h"
+#include "../misc/latency.h"
 
 #include "../video_output/vout_internal.h"
 
@@ -101,6 +102,16 @@
  * Taking this lock ensures that the sub-decoder won't get
  * asynchronously removed while using it, and any mutex from the
  * sub-decoder can then be taken under this lock.
+ *
+ * When the "packetizer-thread" option is set, the packetizer runs in its
+ * own thread (PacketizerThread) ahead of the DecoderThread. The input
+ * client then pushes data into the `pktz.fifo` queue and the packetized
+ * frames are queued into the decoder fifo, which is bounded to
+ * `DECODER_PACKETIZED_MAX` frames in that case. The packetizer module is
+ * only called from the PacketizerThread, which flushes it synchronously
+ * with vlc_input_decoder_Flush() and forwards the drain requests to the
+ * DecoderThread once drained. The `pktz.fifo` lock must not be held when
+ * locking the decoder fifo.
  **/
 
 /*
@@ -123,6 +134,7 @@ struct vlc_input_decoder_t
 
     const struct vlc_input_decoder_callbacks *cbs;
     void *cbs_userdata;
+    struct vlc_histogram *histograms;
 
     ssize_t          i_spu_channel;
     int64_t          i_spu_order;
@@ -149,6 +161,24 @@ struct vlc_input_decoder_t
     /* fifo */
     block_fifo_t *p_fifo;
 
+    /* Packetizer thread, if any */
+    struct
+    {
+        vlc_thread_t thread;
+        block_fifo_t *fifo; /* NULL if packetizing in the DecoderThread */
+        vlc_cond_t wait_space;
+        vlc_cond_t wait_flushed;
+        es_format_t fmt; /* last format sent to the DecoderThread */
+        atomic_bool flushing;
+        /* -- Guarded by the fifo lock -- */
+        bool draining;
+        bool idle;
+        bool aborting;
+    } pktz;
+
+    /* trails of the frames being decoded, when tracing */
+    struct vlc_latency_queue latency;
+
     /* Lock for communication with decoder thread */
     vlc_cond_t  wait_request;
     vlc_cond_t  wait_acknowledge;
@@ -252,6 +282,13 @@ struct vlc_input_decoder_t
 #define DECODER_SPU_VOUT_WAIT_DURATION   VLC_TICK_FROM_MS(200)
 #define BLOCK_FLAG_CORE_PRIVATE_RELOADED (1 << BLOCK_FLAG_CORE_PRIVATE_SHIFT)
 
+/* Packetized frames queued by the PacketizerThread */
+#define DECODER_PACKETIZED_MAX 16
+
+/* Output format of the packetizer attached to the first frame packetized
+ * after a change, when packetizing in the PacketizerThread */
+#define DECODER_ANCILLARY_ID_FORMAT VLC_ANCILLARY_ID('P','k','F','m')
+
 #define decoder_Notify(decoder_priv, event, ...) \
     if (decoder_priv->cbs && decoder_priv->cbs->event) \
         decoder_priv->cbs->event(decoder_priv, __VA_ARGS__, \
@@ -570,6 +607,7 @@ static int ModuleThread_UpdateAudioFormat( decoder_t *p_dec )
                 .clock = p_owner->p_clock,
                 .str_id = p_owner->psz_id,
                 .replay_gain = &p_dec->fmt_out.audio_replay_gain,
+                .histograms = p_owner->histograms,
             };
             p_astream = vlc_aout_stream_New( p_aout, &cfg );
             if( p_astream == NULL )
@@ -675,6 +713,7 @@ static int ModuleThread_UpdateVideoFormat( decoder_t *p_dec, vlc_video_context *
         .str_id = p_owner->psz_id,
         .fmt = &p_dec->fmt_out.video,
         .mouse_event = MouseEvent, .mouse_opaque = p_dec,
+        .histograms = p_owner->histograms,
     };
     vlc_fifo_Unlock(p_owner->p_fifo);
 
@@ -1401,6 +1440,17 @@ static void ModuleThread_QueueVideo( decoder_t *p_dec, picture_t *p_pic )
     {
         vlc_tracer_TraceStreamPTS( tracer, "DEC", p_owner->psz_id,
                             "OUT", p_pic->date );
+
+        struct vlc_ancillary *trail =
+            vlc_latency_queue_Pop( &p_owner->latency, p_pic->date );
+        if( trail != NULL )
+        {
+            if( picture_GetAncillary( p_pic, VLC_ANCILLARY_ID_LATENCY ) == NULL )
+                picture_AttachAncillary( p_pic, trail );
+            vlc_ancillary_Release( trail );
+        }
+        vlc_latency_StampPicture( tracer, p_owner->psz_id, p_pic,
+                                  VLC_LATENCY_DECODE );
     }
 
     vlc_fifo_Lock( p_owner->p_fifo );
@@ -1538,6 +1588,18 @@ static void ModuleThread_QueueAudio( decoder_t *p_dec, vlc_frame_t *p_aout_buf )
     {
         vlc_tracer_TraceStreamDTS( tracer, "DEC", p_owner->psz_id, "OUT",
                             p_aout_buf->i_pts, p_aout_buf->i_dts );
+
+        struct vlc_ancillary *trail =
+            vlc_latency_queue_Pop( &p_owner->latency, p_aout_buf->i_pts );
+        if( trail != NULL )
+        {
+            if( vlc_frame_GetAncillary( p_aout_buf,
+                                        VLC_ANCILLARY_ID_LATENCY ) == NULL )
+                vlc_frame_AttachAncillary( p_aout_buf, trail );
+            vlc_ancillary_Release( trail );
+        }
+        vlc_latency_StampFrame( tracer, p_owner->psz_id, p_aout_buf,
+                                VLC_LATENCY_DECODE );
     }
 
     vlc_fifo_Lock(p_owner->p_fifo);
@@ -1621,10 +1683,19 @@ static void DecoderThread_DecodeBlock( vlc_input_decoder_t *p_owner, vlc_frame_t
     {
         vlc_tracer_TraceStreamDTS( tracer, "DEC", p_owner->psz_id, "IN",
                             frame->i_pts, frame->i_dts );
+        vlc_latency_queue_Push( &p_owner->latency, frame );
     }
 
+    const vlc_tick_t decode_start =
+        p_owner->histograms != NULL && frame != NULL ? vlc_tick_now()
+                                                     : VLC_TICK_INVALID;
+
     int ret = p_dec->pf_decode( p_dec, frame );
 
+    if( decode_start != VLC_TICK_INVALID )
+        vlc_histogram_Add( &p_owner->histograms[INPUT_STATS_DECODE_TIME],
+                           vlc_tick_now() - decode_start );
+
     vlc_fifo_Lock(p_owner->p_fifo);
     switch( ret )
     {
@@ -1677,18 +1748,44 @@ static void DecoderThread_ProcessInput( vlc_input_decoder_t *p_owner, vlc_frame_
             goto error;
     }
 
-    bool packetize = p_owner->p_packetizer != NULL;
+    struct vlc_tracer *tracer = vlc_object_get_tracer( &p_dec->obj );
+    /* The frames are already packetized by the PacketizerThread, if any */
+    bool packetize = p_owner->p_packetizer != NULL && p_owner->pktz.fifo == NULL;
     if( frame )
     {
         if( frame->i_buffer <= 0 )
             goto error;
 
+        vlc_latency_StampFrame( tracer, p_owner->psz_id, frame,
+                                VLC_LATENCY_QUEUE );
+
         DecoderUpdatePreroll( &p_owner->i_preroll_end, frame );
         if( unlikely( frame->i_flags & BLOCK_FLAG_CORE_PRIVATE_RELOADED ) )
         {
             /* This frame has already been packetized */
             packetize = false;
         }
+
+        struct vlc_ancillary *fmt_anc =
+            vlc_frame_GetAncillary( frame, DECODER_ANCILLARY_ID_FORMAT );
+        if( fmt_anc != NULL )
+        {
+            const es_format_t *fmt = vlc_ancillary_GetData( fmt_anc );
+            if( !es_format_IsSimilar( p_dec->fmt_in, fmt ) )
+            {
+                msg_Dbg( p_dec, "restarting module due to input format change");
+                es_format_LogDifferences( vlc_object_logger(p_dec),
+                                          "decoder in", p_dec->fmt_in,
+                                          "packetizer out", fmt );
+
+                /* Drain the decoder module */
+                DecoderThread_DecodeBlock( p_owner, NULL );
+
+                if( DecoderThread_Reload( p_owner, fmt,
+                                          RELOAD_DECODER ) != VLC_SUCCESS )
+                    goto error;
+            }
+        }
     }
 
     if( p_owner->p_sout != NULL )
@@ -1704,6 +1801,16 @@ static void DecoderThread_ProcessInput( vlc_input_decoder_t *p_owner, vlc_frame_
         vlc_frame_t **ppframe = frame ? &frame : NULL;
         decoder_t *p_packetizer = p_owner->p_packetizer;
 
+        /* A packetized frame is complete when its last input frame arrives,
+         * carry its trail if the packetizer did not forward any. */
+        struct vlc_ancillary *trail = NULL;
+        if( tracer != NULL && frame != NULL )
+        {
+            trail = vlc_frame_GetAncillary( frame, VLC_ANCILLARY_ID_LATENCY );
+            if( trail != NULL )
+                vlc_ancillary_Hold( trail );
+        }
+
         while( (packetized_frame =
                 p_packetizer->pf_packetize( p_packetizer, ppframe ) ) )
         {
@@ -1721,6 +1828,8 @@ static void DecoderThread_ProcessInput( vlc_input_decoder_t *p_owner, vlc_frame_
                                           RELOAD_DECODER ) != VLC_SUCCESS )
                 {
                     block_ChainRelease( packetized_frame );
+                    if( trail != NULL )
+                        vlc_ancillary_Release( trail );
                     return;
                 }
             }
@@ -1733,17 +1842,29 @@ static void DecoderThread_ProcessInput( vlc_input_decoder_t *p_owner, vlc_frame_
                 vlc_frame_t *p_next = packetized_frame->p_next;
                 packetized_frame->p_next = NULL;
 
+                if( trail != NULL &&
+                    vlc_frame_GetAncillary( packetized_frame,
+                                            VLC_ANCILLARY_ID_LATENCY ) == NULL )
+                    vlc_frame_AttachAncillary( packetized_frame, trail );
+                vlc_latency_StampFrame( tracer, p_owner->psz_id,
+                                        packetized_frame,
+                                        VLC_LATENCY_PACKETIZER );
+
                 DecoderThread_DecodeBlock( p_owner, packetized_frame );
 
                 if( p_owner->error )
                 {
                     block_ChainRelease( p_next );
+                    if( trail != NULL )
+                        vlc_ancillary_Release( trail );
                     return;
                 }
 
                 packetized_frame = p_next;
             }
         }
+        if( trail != NULL )
+            vlc_ancillary_Release( trail );
         /* Drain the decoder after the packetizer is drained */
         if( !ppframe )
             DecoderThread_DecodeBlock( p_owner, NULL );
@@ -1765,11 +1886,15 @@ static void DecoderThread_Flush( vlc_input_decoder_t *p_owner )
     if( p_owner->error )
         return;
 
-    if( p_packetizer != NULL && p_packetizer->pf_flush != NULL )
+    /* The PacketizerThread flushes its packetizer itself */
+    if( p_packetizer != NULL && p_packetizer->pf_flush != NULL
+     && p_owner->pktz.fifo == NULL )
         p_packetizer->pf_flush( p_packetizer );
 
     if ( p_dec->pf_flush != NULL )
         p_dec->pf_flush( p_dec );
+
+    vlc_latency_queue_Clear( &p_owner->latency );
 }
 
 /**
@@ -1883,6 +2008,293 @@ static void *DecoderThread( void *p_data )
     return NULL;
 }
 
+static void PacketizerFormatFree( void *data )
+{
+    es_format_t *fmt = data;
+
+    es_format_Clean( fmt );
+    free( fmt );
+}
+
+/**
+ * Attach the packetizer output format to a frame, for the DecoderThread to
+ * reload the decoder module if needed.
+ */
+static void PacketizerThread_AttachFormat( vlc_input_decoder_t *p_owner,
+                                           vlc_frame_t *frame )
+{
+    const es_format_t *fmt_out = &p_owner->p_packetizer->fmt_out;
+
+    es_format_t *fmt = malloc( sizeof( *fmt ) );
+    if( unlikely(fmt == NULL) )
+        return;
+    if( es_format_Copy( fmt, fmt_out ) != VLC_SUCCESS )
+    {
+        free( fmt );
+        return;
+    }
+
+    struct vlc_ancillary *ancillary =
+        vlc_ancillary_CreateWithFreeCb( fmt, DECODER_ANCILLARY_ID_FORMAT,
+                                        PacketizerFormatFree );
+    if( unlikely(ancillary == NULL) )
+    {
+        PacketizerFormatFree( fmt );
+        return;
+    }
+
+    if( vlc_frame_AttachAncillary( frame, ancillary ) == VLC_SUCCESS )
+    {
+        es_format_Clean( &p_owner->pktz.fmt );
+        es_format_Copy( &p_owner->pktz.fmt, fmt_out );
+    }
+    vlc_ancillary_Release( ancillary );
+}
+
+/**
+ * Queue packetized frames to the DecoderThread
+ *
+ * Wait for the DecoderThread to consume its fifo if it is full, and drop the
+ * frames if the packetizer is being flushed or the decoder deleted.
+ */
+static void PacketizerThread_Queue( vlc_input_decoder_t *p_owner,
+                                    vlc_frame_t *frame )
+{
+    vlc_fifo_Lock( p_owner->p_fifo );
+    while( vlc_fifo_GetCount( p_owner->p_fifo ) >= DECODER_PACKETIZED_MAX
+        && !p_owner->aborting && !atomic_load( &p_owner->pktz.flushing ) )
+        vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+
+    if( p_owner->aborting || atomic_load( &p_owner->pktz.flushing ) )
+    {
+        vlc_fifo_Unlock( p_owner->p_fifo );
+        block_ChainRelease( frame );
+        return;
+    }
+    vlc_fifo_QueueUnlocked( p_owner->p_fifo, frame );
+    vlc_fifo_Unlock( p_owner->p_fifo );
+}
+
+static void PacketizerThread_ProcessInput( vlc_input_decoder_t *p_owner,
+                                           vlc_frame_t *frame )
+{
+    decoder_t *p_packetizer = p_owner->p_packetizer;
+    struct vlc_tracer *tracer = vlc_object_get_tracer( &p_owner->dec.obj );
+    struct vlc_ancillary *trail = NULL;
+
+    if( frame != NULL )
+    {
+        if( frame->i_buffer <= 0 )
+        {
+            block_Release( frame );
+            return;
+        }
+
+        if( tracer != NULL )
+        {
+            vlc_latency_StampFrame( tracer, p_owner->psz_id, frame,
+                                    VLC_LATENCY_QUEUE );
+            trail = vlc_frame_GetAncillary( frame, VLC_ANCILLARY_ID_LATENCY );
+            if( trail != NULL )
+                vlc_ancillary_Hold( trail );
+        }
+    }
+
+    vlc_frame_t *packetized_frame;
+    vlc_frame_t **ppframe = frame ? &frame : NULL;
+
+    while( (packetized_frame =
+            p_packetizer->pf_packetize( p_packetizer, ppframe ) ) )
+    {
+        if( !es_format_IsSimilar( &p_owner->pktz.fmt, &p_packetizer->fmt_out ) )
+            PacketizerThread_AttachFormat( p_owner, packetized_frame );
+
+        if( p_packetizer->pf_get_cc )
+        {
+            vlc_fifo_Lock( p_owner->p_fifo );
+            PacketizerGetCc( p_owner, p_packetizer );
+            vlc_fifo_Unlock( p_owner->p_fifo );
+        }
+
+        for( vlc_frame_t *it = packetized_frame; it != NULL; it = it->p_next )
+        {
+            if( trail != NULL &&
+                vlc_frame_GetAncillary( it, VLC_ANCILLARY_ID_LATENCY ) == NULL )
+                vlc_frame_AttachAncillary( it, trail );
+            vlc_latency_StampFrame( tracer, p_owner->psz_id, it,
+                                    VLC_LATENCY_PACKETIZER );
+        }
+
+        PacketizerThread_Queue( p_owner, packetized_frame );
+    }
+    if( trail != NULL )
+        vlc_ancillary_Release( trail );
+
+    if( ppframe == NULL )
+    {   /* The packetizer is drained, now drain the decoder */
+        vlc_fifo_Lock( p_owner->p_fifo );
+        if( !atomic_load( &p_owner->pktz.flushing ) )
+        {
+            p_owner->b_draining = true;
+            vlc_fifo_Signal( p_owner->p_fifo );
+        }
+        vlc_fifo_Unlock( p_owner->p_fifo );
+    }
+}
+
+/**
+ * The packetizing main loop
+ *
+ * \param p_data the input decoder object
+ */
+static void *PacketizerThread( void *p_data )
+{
+    vlc_input_decoder_t *p_owner = (vlc_input_decoder_t *)p_data;
+    decoder_t *p_packetizer = p_owner->p_packetizer;
+    block_fifo_t *fifo = p_owner->pktz.fifo;
+
+    vlc_thread_set_name( "vlc-packetizer" );
+
+    vlc_fifo_Lock( fifo );
+    while( !p_owner->pktz.aborting )
+    {
+        if( atomic_load( &p_owner->pktz.flushing ) )
+        {
+            vlc_fifo_Unlock( fifo );
+
+            if( p_packetizer->pf_flush != NULL )
+                p_packetizer->pf_flush( p_packetizer );
+
+            vlc_fifo_Lock( fifo );
+            atomic_store( &p_owner->pktz.flushing, false );
+            vlc_cond_signal( &p_owner->pktz.wait_flushed );
+            continue;
+        }
+
+        vlc_frame_t *frame = vlc_fifo_DequeueUnlocked( fifo );
+        if( frame == NULL )
+        {
+            if( !p_owner->pktz.draining )
+            {
+                if( !p_owner->pktz.idle )
+                {   /* Signal vlc_input_decoder_Wait() that the decoder may
+                     * not get any more data. */
+                    p_owner->pktz.idle = true;
+                    vlc_fifo_Unlock( fifo );
+
+                    vlc_fifo_Lock( p_owner->p_fifo );
+                    vlc_cond_signal( &p_owner->wait_acknowledge );
+                    vlc_fifo_Unlock( p_owner->p_fifo );
+
+                    vlc_fifo_Lock( fifo );
+                    continue;
+                }
+                /* Wait for a block to packetize (or a request to drain) */
+                vlc_fifo_Wait( fifo );
+                continue;
+            }
+            /* We have emptied the FIFO and there is a pending request to
+             * drain. Pass frame = NULL to the packetizer just once. */
+            p_owner->pktz.draining = false;
+        }
+        p_owner->pktz.idle = false;
+        vlc_cond_signal( &p_owner->pktz.wait_space );
+        vlc_fifo_Unlock( fifo );
+
+        PacketizerThread_ProcessInput( p_owner, frame );
+
+        vlc_fifo_Lock( fifo );
+    }
+    vlc_fifo_Unlock( fifo );
+    return NULL;
+}
+
+static int PacketizerThread_Start( vlc_input_decoder_t *p_owner )
+{
+    p_owner->pktz.fifo = block_FifoNew();
+    if( unlikely(p_owner->pktz.fifo == NULL) )
+        return VLC_ENOMEM;
+
+    if( es_format_Copy( &p_owner->pktz.fmt,
+                        &p_owner->p_packetizer->fmt_out ) != VLC_SUCCESS )
+        goto error;
+
+    vlc_cond_init( &p_owner->pktz.wait_space );
+    vlc_cond_init( &p_owner->pktz.wait_flushed );
+    atomic_init( &p_owner->pktz.flushing, false );
+    p_owner->pktz.draining = false;
+    p_owner->pktz.idle = false;
+    p_owner->pktz.aborting = false;
+
+    if( vlc_clone( &p_owner->pktz.thread, PacketizerThread, p_owner ) )
+    {
+        es_format_Clean( &p_owner->pktz.fmt );
+        goto error;
+    }
+    return VLC_SUCCESS;
+
+error:
+    block_FifoRelease( p_owner->pktz.fifo );
+    p_owner->pktz.fifo = NULL;
+    return VLC_EGENERIC;
+}
+
+static void PacketizerThread_Stop( vlc_input_decoder_t *p_owner )
+{
+    block_fifo_t *fifo = p_owner->pktz.fifo;
+
+    vlc_fifo_Lock( fifo );
+    p_owner->pktz.aborting = true;
+    vlc_fifo_Signal( fifo );
+    vlc_fifo_Unlock( fifo );
+
+    vlc_join( p_owner->pktz.thread, NULL );
+}
+
+/**
+ * Flush the packetizer thread
+ *
+ * This waits for the packetizer to be flushed, so that no frame packetized
+ * before the flush can be queued to the DecoderThread after it.
+ */
+static void PacketizerThread_Flush( vlc_input_decoder_t *p_owner )
+{
+    block_fifo_t *fifo = p_owner->pktz.fifo;
+
+    vlc_fifo_Lock( fifo );
+    block_ChainRelease( vlc_fifo_DequeueAllUnlocked( fifo ) );
+    p_owner->pktz.draining = false;
+    atomic_store( &p_owner->pktz.flushing, true );
+    vlc_fifo_Signal( fifo );
+    vlc_fifo_Unlock( fifo );
+
+    /* Unblock the packetizer thread if the decoder fifo is full */
+    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_cond_signal( &p_owner->wait_fifo );
+    vlc_fifo_Unlock( p_owner->p_fifo );
+
+    vlc_fifo_Lock( fifo );
+    while( atomic_load( &p_owner->pktz.flushing ) )
+        vlc_fifo_WaitCond( fifo, &p_owner->pktz.wait_flushed );
+    vlc_fifo_Unlock( fifo );
+}
+
+/**
+ * Check that the packetizer thread, if any, has nothing left to packetize
+ */
+static bool PacketizerThread_IsIdle( vlc_input_decoder_t *p_owner )
+{
+    block_fifo_t *fifo = p_owner->pktz.fifo;
+    if( fifo == NULL )
+        return true;
+
+    vlc_fifo_Lock( fifo );
+    bool idle = p_owner->pktz.idle && !p_owner->pktz.draining
+             && vlc_fifo_IsEmpty( fifo );
+    vlc_fifo_Unlock( fifo );
+    return idle;
+}
+
 static const struct decoder_owner_callbacks dec_video_cbs =
 {
     .video = {
@@ -1952,6 +2364,7 @@ CreateDecoder( vlc_object_t *p_parent, const struct vlc_input_decoder_cfg *cfg )
     p_owner->p_resource = cfg->resource;
     p_owner->cbs = cfg->cbs;
     p_owner->cbs_userdata = cfg->cbs_data;
+    p_owner->histograms = cfg->histograms;
     p_owner->p_aout = NULL;
     p_owner->p_astream = NULL;
     p_owner->p_vout = NULL;
@@ -1961,6 +2374,7 @@ CreateDecoder( vlc_object_t *p_parent, const struct vlc_input_decoder_cfg *cfg )
     p_owner->p_sout = cfg->sout;
     p_owner->p_sout_input = NULL;
     p_owner->p_packetizer = NULL;
+    p_owner->pktz.fifo = NULL;
 
     p_owner->b_fmt_description = false;
     p_owner->p_description = NULL;
@@ -1995,6 +2409,7 @@ CreateDecoder( vlc_object_t *p_parent, const struct vlc_input_decoder_cfg *cfg )
         return NULL;
     }
 
+    vlc_latency_queue_Init( &p_owner->latency );
     vlc_mutex_init( &p_owner->mouse_lock );
     vlc_cond_init( &p_owner->wait_request );
     vlc_cond_init( &p_owner->wait_acknowledge );
@@ -2098,6 +2513,11 @@ static void DeleteDecoder( vlc_input_decoder_t *p_owner, enum es_format_category
 
     if ( p_owner->out_pool )
     {
+        struct picture_pool_stats stats;
+        picture_pool_GetStats( p_owner->out_pool, &stats );
+        msg_Dbg( p_dec, "picture pool: %u/%u pictures used, %"PRIu64
+                 " waits for %"PRId64" ms", stats.high_water, stats.count,
+                 stats.waits, MS_FROM_VLC_TICK(stats.wait_time) );
         picture_pool_Release( p_owner->out_pool );
         p_owner->out_pool = NULL;
     }
@@ -2174,6 +2594,12 @@ static void DeleteDecoder( vlc_input_decoder_t *p_owner, enum es_format_category
         vlc_meta_Delete( p_owner->p_description );
 
     block_FifoRelease( p_owner->p_fifo );
+    if( p_owner->pktz.fifo != NULL )
+    {
+        block_FifoRelease( p_owner->pktz.fifo );
+        es_format_Clean( &p_owner->pktz.fmt );
+    }
+    vlc_latency_queue_Clear( &p_owner->latency );
     decoder_Destroy( p_owner->p_packetizer );
     decoder_Destroy( &p_owner->dec );
 }
@@ -2239,10 +2665,24 @@ decoder_New( vlc_object_t *p_parent, const struct vlc_input_decoder_cfg *cfg )
 
     if( !vlc_input_decoder_IsSynchronous( p_owner ) )
     {
+        /* Spawn the packetizer thread before the decoder thread, which
+         * checks if it must packetize itself. */
+        if( p_owner->p_packetizer != NULL
+         && var_InheritBool( p_dec, "packetizer-thread" )
+         && PacketizerThread_Start( p_owner ) != VLC_SUCCESS )
+            msg_Warn( p_dec, "cannot spawn packetizer thread" );
+
         /* Spawn the decoder thread in asynchronous scenario. */
         if( vlc_clone( &p_owner->thread, DecoderThread, p_owner ) )
         {
             msg_Err( p_dec, "cannot spawn decoder thread" );
+            if( p_owner->pktz.fifo != NULL )
+            {
+                vlc_fifo_Lock( p_owner->p_fifo );
+                p_owner->aborting = true;
+                vlc_fifo_Unlock( p_owner->p_fifo );
+                PacketizerThread_Stop( p_owner );
+            }
             DeleteDecoder( p_owner, p_dec->fmt_in->i_cat );
             return NULL;
         }
@@ -2311,8 +2751,13 @@ void vlc_input_decoder_Delete( vlc_input_decoder_t *p_owner )
 
     /* Make sure we aren't waiting/decoding anymore */
     vlc_cond_signal( &p_owner->wait_request );
+    /* Nor queueing packetized frames */
+    vlc_cond_signal( &p_owner->wait_fifo );
     vlc_fifo_Unlock( p_owner->p_fifo );
 
+    if( p_owner->pktz.fifo != NULL )
+        PacketizerThread_Stop( p_owner );
+
     if( !vlc_input_decoder_IsSynchronous( p_owner ) )
         vlc_join( p_owner->thread, NULL );
 
@@ -2432,17 +2877,26 @@ void vlc_input_decoder_DecodeWithStatus(vlc_input_decoder_t *p_owner, vlc_frame_
         return;
     }
 
-    vlc_fifo_Lock( p_owner->p_fifo );
+    /* Feed the packetizer thread, if any */
+    block_fifo_t *fifo = p_owner->p_fifo;
+    vlc_cond_t *wait_fifo = &p_owner->wait_fifo;
+    if( p_owner->pktz.fifo != NULL )
+    {
+        fifo = p_owner->pktz.fifo;
+        wait_fifo = &p_owner->pktz.wait_space;
+    }
+
+    vlc_fifo_Lock( fifo );
     if( !b_do_pace )
     {
         /* FIXME: ideally we would check the time amount of data
          * in the FIFO instead of its size. */
         /* 400 MiB, i.e. ~ 50mb/s for 60s */
-        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
+        if( vlc_fifo_GetBytes( fifo ) > 400*1024*1024 )
         {
             msg_Warn( &p_owner->dec, "decoder/packetizer fifo full (data not "
                       "consumed quickly enough), resetting fifo!" );
-            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+            block_ChainRelease( vlc_fifo_DequeueAllUnlocked( fifo ) );
             frame->i_flags |= BLOCK_FLAG_DISCONTINUITY;
         }
     }
@@ -2451,11 +2905,18 @@ void vlc_input_decoder_DecodeWithStatus(vlc_input_decoder_t *p_owner, vlc_frame_
     {   /* The FIFO is not consumed when waiting, so pacing would deadlock VLC.
          * Locking is not necessary as b_waiting is only read, not written by
          * the decoder thread. */
-        while( vlc_fifo_GetCount( p_owner->p_fifo ) >= 10 )
-            vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        while( vlc_fifo_GetCount( fifo ) >= 10 )
+            vlc_fifo_WaitCond( fifo, wait_fifo );
     }
 
-    vlc_fifo_QueueUnlocked( p_owner->p_fifo, frame );
+    vlc_fifo_QueueUnlocked( fifo, frame );
+    if( fifo != p_owner->p_fifo )
+    {
+        vlc_fifo_Unlock( fifo );
+        if( status == NULL )
+            return;
+        vlc_fifo_Lock( p_owner->p_fifo );
+    }
     if (status != NULL)
         GetStatusLocked(p_owner, status);
     vlc_fifo_Unlock( p_owner->p_fifo );
@@ -2471,6 +2932,10 @@ bool vlc_input_decoder_IsEmpty( vlc_input_decoder_t * p_owner )
 {
     assert( !p_owner->b_waiting );
 
+    /* Check the packetizer first, it queues to the decoder before idling */
+    if( !PacketizerThread_IsIdle( p_owner ) )
+        return false;
+
     vlc_fifo_Lock( p_owner->p_fifo );
     if( !vlc_fifo_IsEmpty( p_owner->p_fifo ) || p_owner->b_draining )
     {
@@ -2504,6 +2969,16 @@ void vlc_input_decoder_Drain( vlc_input_decoder_t *p_owner )
         return;
     }
 
+    if( p_owner->pktz.fifo != NULL )
+    {
+        /* The packetizer thread will request the decoder to drain */
+        vlc_fifo_Lock( p_owner->pktz.fifo );
+        p_owner->pktz.draining = true;
+        vlc_fifo_Signal( p_owner->pktz.fifo );
+        vlc_fifo_Unlock( p_owner->pktz.fifo );
+        return;
+    }
+
     vlc_fifo_Lock( p_owner->p_fifo );
     p_owner->b_draining = true;
     vlc_fifo_Signal( p_owner->p_fifo );
@@ -2512,6 +2987,9 @@ void vlc_input_decoder_Drain( vlc_input_decoder_t *p_owner )
 
 void vlc_input_decoder_Flush( vlc_input_decoder_t *p_owner )
 {
+    if( p_owner->pktz.fifo != NULL )
+        PacketizerThread_Flush( p_owner );
+
     vlc_fifo_Lock( p_owner->p_fifo );
     enum es_format_category_e cat = p_owner->dec.fmt_in->i_cat;
 
@@ -2690,7 +3168,8 @@ void vlc_input_decoder_Wait( vlc_input_decoder_t *p_owner )
          * owner */
         if( p_owner->paused )
             break;
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo )
+         && PacketizerThread_IsIdle( p_owner ) )
         {
             msg_Err( &p_owner->dec, "buffer deadlock prevented" );
             break;
@@ -2718,9 +3197,28 @@ void vlc_input_decoder_FrameNext( vlc_input_decoder_t *p_owner )
     vlc_fifo_Unlock(p_owner->p_fifo);
 }
 
+int vlc_input_decoder_FramePrevious( vlc_input_decoder_t *p_owner )
+{
+    assert( p_owner->paused );
+    int ret = VLC_EGENERIC;
+
+    vlc_fifo_Lock(p_owner->p_fifo);
+    if( p_owner->dec.fmt_in->i_cat == VIDEO_ES && p_owner->p_vout )
+        ret = vout_PreviousPicture( p_owner->p_vout );
+    vlc_fifo_Unlock(p_owner->p_fifo);
+    return ret;
+}
+
 size_t vlc_input_decoder_GetFifoSize( vlc_input_decoder_t *p_owner )
 {
-    return block_FifoSize( p_owner->p_fifo );
+    size_t size = block_FifoSize( p_owner->p_fifo );
+    if( p_owner->pktz.fifo != NULL )
+    {
+        vlc_fifo_Lock( p_owner->pktz.fifo );
+        size += vlc_fifo_GetBytes( p_owner->pktz.fifo );
+        vlc_fifo_Unlock( p_owner->pktz.fifo );
+    }
+    return size;
 }
 
 static bool DecoderHasVbi( decoder_t *dec )
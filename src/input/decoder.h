@@ -61,6 +61,8 @@ struct vlc_input_decoder_cfg
     unsigned cc_decoder;
     const struct vlc_input_decoder_callbacks *cbs;
     void *cbs_data;
+    /* latency histograms of the input statistics, or NULL */
+    struct vlc_histogram *histograms;
 };
 
 vlc_input_decoder_t *
@@ -118,6 +120,14 @@ vlc_input_decoder_CreateSubDec(vlc_input_decoder_t *dec,
  */
 void vlc_input_decoder_FrameNext( vlc_input_decoder_t *p_dec );
 
+/**
+ * This function forces the display of the previous picture, if the video
+ * output still has it
+ *
+ * \return VLC_SUCCESS, or VLC_EGENERIC if the picture must be decoded again
+ */
+int vlc_input_decoder_FramePrevious( vlc_input_decoder_t *p_dec );
+
 struct vlc_subdec_desc
 {
     es_format_t *fmt_array;
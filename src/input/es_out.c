@@ -55,6 +55,7 @@
 #include "resource.h"
 #include "info.h"
 #include "item.h"
+#include "../misc/latency.h"
 
 #include "../stream_output/stream_output.h"
 
@@ -223,6 +224,15 @@ typedef struct
     /* Current preroll */
     vlc_tick_t  i_preroll_end;
 
+    /* Keyframe trick-play, cf. ES_OUT_PRIV_SET_TRICKPLAY */
+    struct
+    {
+        bool        b_active;
+        bool        b_pending;  /* a keyframe was requested and not sent yet */
+        vlc_tick_t  i_interval; /* display duration of each keyframe */
+        vlc_tick_t  i_next_ts;  /* date given to the next keyframe */
+    } trickplay;
+
     /* Used for buffering */
     bool        b_buffering;
     vlc_tick_t  i_buffering_extra_initial;
@@ -1161,6 +1171,28 @@ static void EsOutFrameNext(es_out_sys_t *p_sys)
 
     vlc_input_decoder_FrameNext( p_sys->p_next_frame_es->p_dec );
 }
+
+static int EsOutFramePrevious(es_out_sys_t *p_sys)
+{
+    assert( p_sys->b_paused );
+
+    struct input_stats *stats = input_priv(p_sys->p_input)->stats;
+    es_out_id_t *p_es;
+    int ret = VLC_EGENERIC;
+
+    vlc_list_foreach( p_es, &p_sys->es, node )
+        if( p_es->fmt.i_cat == VIDEO_ES && p_es->p_dec )
+        {
+            ret = vlc_input_decoder_FramePrevious( p_es->p_dec );
+            break;
+        }
+
+    if( stats != NULL )
+        atomic_fetch_add_explicit(ret == VLC_SUCCESS ? &stats->frame_cache_hits
+                                                     : &stats->frame_cache_misses,
+                                  1, memory_order_relaxed);
+    return ret;
+}
 static vlc_tick_t EsOutGetBuffering(es_out_sys_t *p_sys)
 {
     vlc_tick_t i_stream_duration, i_system_start;
@@ -2296,6 +2328,9 @@ static void EsOutCreateDecoder(es_out_sys_t *p_sys, es_out_id_t *p_es)
         .cc_decoder = p_sys->cc_decoder,
         .cbs = &decoder_cbs,
         .cbs_data = p_es,
+        .histograms = priv->stats != NULL && (p_es->fmt.i_cat == VIDEO_ES
+                                           || p_es->fmt.i_cat == AUDIO_ES)
+                    ? priv->stats->histograms : NULL,
     };
     if (p_es->p_master != NULL)
     {
@@ -2842,6 +2877,59 @@ static void EsOutCreateSubESes(es_out_sys_t *sys,
  * \param es the es_out_id
  * \param p_block the data block to send
  */
+/**
+ * Filter the blocks sent in trick-play mode
+ *
+ * Only the first video frame following a keyframe request is kept: the input
+ * thread seeks the demuxer without precision before each request, so that it
+ * is the keyframe the demuxer indexes at this position. It is dated after the
+ * previous one, whatever the direction and the speed of the scan, so that the
+ * decoders and the clock see a regular stream at the nominal rate.
+ *
+ * \return true if the block must be decoded
+ */
+static bool EsOutTrickPlayFilter(es_out_sys_t *p_sys, es_out_id_t *es,
+                                 block_t *p_block)
+{
+    struct input_stats *stats = input_priv(p_sys->p_input)->stats;
+
+    if( es->fmt.i_cat != VIDEO_ES || es->p_dec == NULL )
+        return false;
+
+    /* Unpacketized streams are split by the packetizer on the next frame
+     * start, that would never come. Frames flagged as not intra, if the
+     * demuxer knows, cannot be decoded alone. */
+    if( !p_sys->trickplay.b_pending || !es->fmt.b_packetized
+     || (p_block->i_flags & (BLOCK_FLAG_TYPE_P|BLOCK_FLAG_TYPE_B|
+                             BLOCK_FLAG_TYPE_PB)) )
+        goto skip;
+
+    if( p_sys->trickplay.i_next_ts == VLC_TICK_INVALID )
+    {
+        p_sys->trickplay.i_next_ts = p_block->i_dts != VLC_TICK_INVALID ?
+                                     p_block->i_dts : p_block->i_pts;
+        if( p_sys->trickplay.i_next_ts == VLC_TICK_INVALID )
+            goto skip;
+    }
+
+    p_block->i_dts = p_block->i_pts = p_sys->trickplay.i_next_ts;
+    p_block->i_length = p_sys->trickplay.i_interval;
+    p_block->i_flags &= ~BLOCK_FLAG_PREROLL;
+    p_sys->trickplay.i_next_ts += p_sys->trickplay.i_interval;
+    p_sys->trickplay.b_pending = false;
+
+    if( stats != NULL )
+        atomic_fetch_add_explicit(&stats->trickplay_keyframes, 1,
+                                  memory_order_relaxed);
+    return true;
+
+skip:
+    if( stats != NULL )
+        atomic_fetch_add_explicit(&stats->trickplay_skipped, 1,
+                                  memory_order_relaxed);
+    return false;
+}
+
 static int EsOutSend(es_out_t *out, es_out_id_t *es, block_t *p_block )
 {
     es_out_sys_t *p_sys = PRIV(out);
@@ -2854,6 +2942,8 @@ static int EsOutSend(es_out_t *out, es_out_id_t *es, block_t *p_block )
     {
         vlc_tracer_TraceStreamDTS( tracer, "DEMUX", es->id.str_id, "OUT",
                             p_block->i_pts, p_block->i_dts);
+        if( es->fmt.i_cat == VIDEO_ES || es->fmt.i_cat == AUDIO_ES )
+            vlc_latency_Start( tracer, es->id.str_id, p_block );
     }
 
     struct input_stats *stats = input_priv(p_input)->stats;
@@ -2901,6 +2991,19 @@ static int EsOutSend(es_out_t *out, es_out_id_t *es, block_t *p_block )
         return VLC_SUCCESS;
     }
 
+    /* Keep only the requested keyframes in trick-play mode */
+    vlc_tick_t i_trickplay_pcr = VLC_TICK_INVALID;
+    if( p_sys->trickplay.b_active )
+    {
+        if( !EsOutTrickPlayFilter( p_sys, es, p_block ) )
+        {
+            block_Release( p_block );
+            vlc_mutex_unlock( &p_sys->lock );
+            return VLC_SUCCESS;
+        }
+        i_trickplay_pcr = p_block->i_dts;
+    }
+
     /* Mark preroll blocks */
     if( p_sys->i_preroll_end >= 0 )
     {
@@ -2981,6 +3084,11 @@ static int EsOutSend(es_out_t *out, es_out_id_t *es, block_t *p_block )
 
     vlc_subdec_desc_Clean(&status.subdec_desc);
 
+    /* The keyframes drive the clock in trick-play mode */
+    if( i_trickplay_pcr != VLC_TICK_INVALID )
+        EsOutControlLocked( p_sys, es->id.source, ES_OUT_SET_GROUP_PCR,
+                            es->p_pgrm->i_id, i_trickplay_pcr );
+
     vlc_mutex_unlock( &p_sys->lock );
 
     return VLC_SUCCESS;
@@ -3828,6 +3936,11 @@ static int EsOutVaPrivControlLocked(es_out_sys_t *p_sys, input_source_t *source,
     case ES_OUT_PRIV_SET_FRAME_NEXT:
         EsOutFrameNext(p_sys);
         return VLC_SUCCESS;
+    case ES_OUT_PRIV_SET_FRAME_PREVIOUS:
+        return EsOutFramePrevious(p_sys);
+    case ES_OUT_PRIV_SEEK_TIMESHIFT:
+        /* Only handled by the timeshift */
+        return VLC_EGENERIC;
     case ES_OUT_PRIV_SET_TIMES:
     {
         double f_position = va_arg( args, double );
@@ -3948,6 +4061,53 @@ static int EsOutVaPrivControlLocked(es_out_sys_t *p_sys, input_source_t *source,
         }
         return ret;
     }
+    case ES_OUT_PRIV_SET_TRICKPLAY:
+    {
+        const bool b_active = va_arg( args, int );
+        const vlc_tick_t i_interval = va_arg( args, vlc_tick_t );
+
+        if( b_active && i_interval <= 0 )
+            return VLC_EGENERIC;
+        p_sys->trickplay.b_active = b_active;
+        p_sys->trickplay.b_pending = false;
+        p_sys->trickplay.i_interval = i_interval;
+        p_sys->trickplay.i_next_ts = VLC_TICK_INVALID;
+        return VLC_SUCCESS;
+    }
+    case ES_OUT_PRIV_REQUEST_KEYFRAME:
+        if( !p_sys->trickplay.b_active )
+            return VLC_EGENERIC;
+        p_sys->trickplay.b_pending = true;
+        return VLC_SUCCESS;
+    case ES_OUT_PRIV_GET_KEYFRAME_PENDING:
+    {
+        bool *pb = va_arg( args, bool * );
+        if( !p_sys->trickplay.b_active )
+            return VLC_EGENERIC;
+        *pb = p_sys->trickplay.b_pending;
+        return VLC_SUCCESS;
+    }
+    case ES_OUT_PRIV_CAN_TRICKPLAY:
+    {
+        bool *pb = va_arg( args, bool * );
+        es_out_id_t *es;
+
+        /* The packetizers would hold an unpacketized keyframe until the next
+         * frame start, that is never sent. */
+        *pb = false;
+        vlc_list_foreach( es, &p_sys->es, node )
+        {
+            if( es->fmt.i_cat != VIDEO_ES || es->p_dec == NULL )
+                continue;
+            if( !es->fmt.b_packetized )
+            {
+                *pb = false;
+                break;
+            }
+            *pb = true;
+        }
+        return VLC_SUCCESS;
+    }
     default: vlc_assert_unreachable();
     }
 
@@ -3960,6 +4120,24 @@ static int EsOutControl(es_out_t *out, input_source_t *source,
     int i_ret;
 
     vlc_mutex_lock( &p_sys->lock );
+
+    /* The clock is driven by the keyframes in trick-play mode, and the
+     * demuxer is seeked for each of them. */
+    if( p_sys->trickplay.b_active )
+    {
+        switch( i_query )
+        {
+            case ES_OUT_SET_PCR:
+            case ES_OUT_SET_GROUP_PCR:
+            case ES_OUT_RESET_PCR:
+            case ES_OUT_SET_NEXT_DISPLAY_TIME:
+                vlc_mutex_unlock( &p_sys->lock );
+                return VLC_SUCCESS;
+            default:
+                break;
+        }
+    }
+
     i_ret = EsOutVaControlLocked(p_sys, source, i_query, args);
     vlc_mutex_unlock( &p_sys->lock );
 
@@ -4022,6 +4200,8 @@ input_EsOutNew(input_thread_t *p_input, input_source_t *main_source, float rate,
 
     p_sys->b_active = false;
     p_sys->p_next_frame_es = NULL;
+    p_sys->trickplay.b_active = false;
+    p_sys->trickplay.b_pending = false;
     p_sys->i_mode   = ES_OUT_MODE_NONE;
     p_sys->input_type = input_type;
 
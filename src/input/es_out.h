@@ -101,7 +101,29 @@ enum es_out_query_private_e
     ES_OUT_PRIV_SET_VBI_PAGE,                       /* arg1=unsigned res=can fail */
 
     /* Set VBI/Teletext menu transparent */
-    ES_OUT_PRIV_SET_VBI_TRANSPARENCY                /* arg1=bool res=can fail */
+    ES_OUT_PRIV_SET_VBI_TRANSPARENCY,               /* arg1=bool res=can fail */
+
+    /* Enable/disable the keyframe trick-play mode: only the first video frame
+     * sent after each keyframe request is decoded, dated to be displayed
+     * i_interval after the previous one, and the demuxer clock is ignored */
+    ES_OUT_PRIV_SET_TRICKPLAY,                      /* arg1=bool arg2=vlc_tick_t i_interval res=can fail */
+
+    /* Request the next video keyframe in trick-play mode */
+    ES_OUT_PRIV_REQUEST_KEYFRAME,                   /* res=can fail */
+
+    /* Get if the last requested keyframe is still expected */
+    ES_OUT_PRIV_GET_KEYFRAME_PENDING,               /* arg1=bool* res=can fail */
+
+    /* Get if the selected video ES can be played from its keyframes alone,
+     * i.e. if one is selected and all the selected ones are packetized */
+    ES_OUT_PRIV_CAN_TRICKPLAY,                      /* arg1=bool* res=can fail */
+
+    /* Set previous frame, fails if it is not cached by the video output */
+    ES_OUT_PRIV_SET_FRAME_PREVIOUS,                 /*                          res=can fail */
+
+    /* Resume the playback of the timeshift buffer at the last entry point
+     * before a timestamp, fails if it is not buffered */
+    ES_OUT_PRIV_SEEK_TIMESHIFT,                     /* arg1=vlc_tick_t res=can fail */
 };
 
 struct vlc_input_es_out;
@@ -268,6 +290,18 @@ es_out_SetFrameNext(struct vlc_input_es_out *out )
     return es_out_PrivControl(out, ES_OUT_PRIV_SET_FRAME_NEXT);
 }
 
+static inline int
+es_out_SetFramePrevious(struct vlc_input_es_out *out)
+{
+    return es_out_PrivControl(out, ES_OUT_PRIV_SET_FRAME_PREVIOUS);
+}
+
+static inline int
+es_out_SeekTimeshift(struct vlc_input_es_out *out, vlc_tick_t i_ts)
+{
+    return es_out_PrivControl(out, ES_OUT_PRIV_SEEK_TIMESHIFT, i_ts);
+}
+
 static inline void
 es_out_SetTimes(struct vlc_input_es_out *out, double f_position,
                 vlc_tick_t i_time, vlc_tick_t i_normal_time,
@@ -319,6 +353,38 @@ es_out_SetVbiTransparency(struct vlc_input_es_out *out, vlc_es_id_t *id,
                               enabled);
 }
 
+static inline int
+es_out_SetTrickPlay(struct vlc_input_es_out *out, bool b_enabled,
+                    vlc_tick_t i_interval)
+{
+    return es_out_PrivControl(out, ES_OUT_PRIV_SET_TRICKPLAY, b_enabled,
+                              i_interval);
+}
+
+static inline int
+es_out_RequestKeyframe(struct vlc_input_es_out *out)
+{
+    return es_out_PrivControl(out, ES_OUT_PRIV_REQUEST_KEYFRAME);
+}
+
+static inline bool
+es_out_IsKeyframePending(struct vlc_input_es_out *out)
+{
+    bool b;
+    if (es_out_PrivControl(out, ES_OUT_PRIV_GET_KEYFRAME_PENDING, &b))
+        return false;
+    return b;
+}
+
+static inline bool
+es_out_CanTrickPlay(struct vlc_input_es_out *out)
+{
+    bool b;
+    if (es_out_PrivControl(out, ES_OUT_PRIV_CAN_TRICKPLAY, &b))
+        return false;
+    return b;
+}
+
 struct vlc_input_es_out *
 input_EsOutNew(input_thread_t *, input_source_t *main_source, float rate,
                enum input_type input_type);
@@ -36,9 +36,19 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+/* The data is written in place into a shared mapping of the storage file:
+ * its space must be reserved beforehand, as writing a page that the
+ * filesystem cannot allocate raises SIGBUS */
+#if defined(HAVE_MMAP) && defined(HAVE_POSIX_FALLOCATE)
+#  define TS_STORAGE_MMAP 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_arrays.h>
+#include <vlc_atomic.h>
+#include <vlc_vector.h>
 #include <vlc_fs.h>
 #include <vlc_mouse.h>
 #include <vlc_es_out.h>
@@ -191,27 +201,67 @@ static_assert(offsetof(ts_cmd_t, header) == offsetof(ts_cmd_send_t, header), "in
 static_assert(offsetof(ts_cmd_t, header) == offsetof(ts_cmd_control_t, header), "invalid packing");
 static_assert(offsetof(ts_cmd_t, header) == offsetof(ts_cmd_privcontrol_t, header), "invalid packing");
 
+/* Header of the blocks stored in the data file */
+typedef struct
+{
+    size_t     i_buffer;
+    uint32_t   i_flags;
+    unsigned   i_nb_samples;
+    vlc_tick_t i_pts;
+    vlc_tick_t i_dts;
+    vlc_tick_t i_length;
+} ts_storage_block_t;
+
+/* Entry point of the stream, where the playback can be resumed after
+ * skipping the commands before it */
+typedef struct
+{
+    uint64_t   i_cmd;   /* Index of the command */
+    vlc_tick_t i_date;  /* Date of the command */
+    vlc_tick_t i_ts;    /* Timestamp of the block */
+} ts_index_entry_t;
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
     ts_storage_t *p_next;
 
+    /* Held by the storage and by the blocks read from its mapping */
+    vlc_atomic_rc_t rc;
+
     /* */
 #ifdef _WIN32
     char    *psz_file;  /* Filename */
 #endif
     size_t  i_file_max; /* Max size in bytes */
     int64_t i_file_size;/* Current size in bytes */
+#ifdef TS_STORAGE_MMAP
+    int     fd;
+    uint8_t *p_map;     /* Mapping of the whole preallocated file */
+#else
     FILE    *p_filew;   /* FILE handle for data writing */
     FILE    *p_filer;   /* FILE handle for data reading */
+#endif
 
     /* */
     uint8_t *p_cmd_r;
     uint8_t *p_cmd_w;
     uint8_t *p_cmd_buf;
     size_t   i_cmd_buf;
+
+    /* */
+    struct VLC_VECTOR(ts_index_entry_t) index;
 };
 
+#ifdef TS_STORAGE_MMAP
+/* Block referencing the data of a storage mapping */
+typedef struct
+{
+    block_t self;
+    ts_storage_t *p_storage;
+} ts_storage_view_t;
+#endif
+
 typedef struct
 {
     vlc_thread_t   thread;
@@ -243,14 +293,26 @@ typedef struct
     /* */
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
+    ts_storage_t   *p_storage_spare; /* Emptied storage kept for reuse */
 
     vlc_tick_t     i_cmd_delay;
 
+    /* */
+    uint64_t       i_cmd_pushed;
+    uint64_t       i_cmd_popped;
+    vlc_tick_t     i_index_ts;      /* Timestamp of the last index entry */
+    bool           b_index_video;   /* Video entry points were found */
+
+    /* Pending seek inside the buffered commands */
+    bool             b_skip;
+    ts_index_entry_t skip;
+
 } ts_thread_t;
 
 struct es_out_id_t
 {
     es_out_id_t *p_es;
+    enum es_format_category_e i_cat;
 };
 
 struct es_out_timeshift
@@ -294,15 +356,17 @@ static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, vlc_tick_t i_date );
 static int          TsChangeRate( ts_thread_t *, float src_rate, float rate );
+static int          TsSeek( ts_thread_t *, vlc_tick_t i_ts );
 
 static void         *TsRun( void * );
 
 static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
 static void         TsStorageDelete( ts_storage_t * );
+static bool         TsStorageRecycle( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
+static int          TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
 
 static void CmdClean( ts_cmd_t * );
@@ -390,6 +454,7 @@ static es_out_id_t *Add( es_out_t *p_out, input_source_t *in, const es_format_t
     es_out_id_t *p_es = malloc( sizeof( *p_es ) );
     if( !p_es )
         return NULL;
+    p_es->i_cat = p_fmt->i_cat;
 
     vlc_mutex_lock( &p_sys->lock );
 
@@ -797,8 +862,26 @@ static int PrivControlLocked(struct vlc_input_es_out *p_tsout,
     {
         return ControlLockedSetFrameNext(p_sys, in);
     }
+    case ES_OUT_PRIV_SET_FRAME_PREVIOUS:
+        return es_out_in_vaPrivControl( p_sys->p_out, in, i_query, args );
+    case ES_OUT_PRIV_SEEK_TIMESHIFT:
+    {
+        const vlc_tick_t i_ts = va_arg( args, vlc_tick_t );
+
+        if( !p_sys->b_delayed )
+            return VLC_EGENERIC;
+        return TsSeek( p_sys->p_ts, i_ts );
+    }
     case ES_OUT_PRIV_GET_GROUP_FORCED:
         return es_out_in_vaPrivControl( p_sys->p_out, in, i_query, args );
+    case ES_OUT_PRIV_SET_TRICKPLAY:
+    case ES_OUT_PRIV_REQUEST_KEYFRAME:
+    case ES_OUT_PRIV_GET_KEYFRAME_PENDING:
+    case ES_OUT_PRIV_CAN_TRICKPLAY:
+        /* Trick-play seeks the source, it cannot be delayed */
+        if( p_sys->b_delayed )
+            return VLC_EGENERIC;
+        return es_out_in_vaPrivControl( p_sys->p_out, in, i_query, args );
     /* Invalid queries for this es_out level */
     case ES_OUT_PRIV_SET_ES:
     case ES_OUT_PRIV_UNSET_ES:
@@ -980,6 +1063,12 @@ static int TsStart(struct es_out_timeshift *p_sys)
     p_ts->i_cmd_delay = 0;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->p_storage_spare = NULL;
+    p_ts->i_cmd_pushed = 0;
+    p_ts->i_cmd_popped = 0;
+    p_ts->i_index_ts = VLC_TICK_INVALID;
+    p_ts->b_index_video = false;
+    p_ts->b_skip = false;
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts ) )
@@ -1027,17 +1116,68 @@ static void TsStop( ts_thread_t *p_ts )
     assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
     if( p_ts->p_storage_r )
         TsStorageDelete( p_ts->p_storage_r );
+    if( p_ts->p_storage_spare )
+        TsStorageDelete( p_ts->p_storage_spare );
     vlc_mutex_unlock( &p_ts->lock );
 
     TsDestroy( p_ts );
 }
+/* Add the entry points of the stream to the index of the storage: the video
+ * keyframes flagged by the demuxer, or one audio block per TS_INDEX_INTERVAL
+ * as long as no video keyframe was found. Video blocks without the keyframe
+ * flag are never entry points, as decoding could not resume from them: when
+ * the demuxer does not flag the keyframes of a video only stream, there is
+ * no entry point and the timeshift cannot be seeked. */
+#define TS_INDEX_INTERVAL VLC_TICK_FROM_MS(500)
+
+static void TsIndexCmd( ts_thread_t *p_ts, const ts_cmd_send_t *p_cmd )
+{
+    const block_t *p_block = p_cmd->p_block;
+    const vlc_tick_t i_ts = p_block->i_dts != VLC_TICK_INVALID ?
+                            p_block->i_dts : p_block->i_pts;
+    if( i_ts == VLC_TICK_INVALID )
+        return;
+
+    const bool b_interval = p_ts->i_index_ts == VLC_TICK_INVALID
+                         || i_ts < p_ts->i_index_ts
+                         || i_ts - p_ts->i_index_ts >= TS_INDEX_INTERVAL;
+    bool b_entry;
+    switch( p_cmd->p_es->i_cat )
+    {
+        case VIDEO_ES:
+            b_entry = p_block->i_flags & BLOCK_FLAG_TYPE_I;
+            if( b_entry )
+                p_ts->b_index_video = true;
+            break;
+        case AUDIO_ES:
+            b_entry = b_interval && !p_ts->b_index_video;
+            break;
+        default:
+            return;
+    }
+    if( !b_entry )
+        return;
+
+    const ts_index_entry_t entry = {
+        .i_cmd = p_ts->i_cmd_pushed,
+        .i_date = p_cmd->header.i_date,
+        .i_ts = i_ts,
+    };
+    if( vlc_vector_push( &p_ts->p_storage_w->index, entry ) )
+        p_ts->i_index_ts = i_ts;
+}
+
 static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
     vlc_mutex_lock( &p_ts->lock );
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        ts_storage_t *p_storage = p_ts->p_storage_spare;
+        if( p_storage )
+            p_ts->p_storage_spare = NULL;
+        else
+            p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
 
         if( !p_storage )
         {
@@ -1059,8 +1199,15 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
         }
     }
 
+    const size_t i_index = p_ts->p_storage_w->index.size;
+    if( p_cmd->header.i_type == C_SEND )
+        TsIndexCmd( p_ts, &p_cmd->send );
+
     /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    if( !TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w ) )
+        p_ts->i_cmd_pushed++;
+    else if( p_ts->p_storage_w->index.size > i_index )
+        vlc_vector_remove_noshrink( &p_ts->p_storage_w->index, i_index );
 
     vlc_cond_signal( &p_ts->wait );
 
@@ -1074,6 +1221,7 @@ static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
         return VLC_EGENERIC;
 
     TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+    p_ts->i_cmd_popped++;
 
     while( TsStorageIsEmpty( p_ts->p_storage_r ) )
     {
@@ -1081,7 +1229,11 @@ static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
         if( !p_next )
             break;
 
-        TsStorageDelete( p_ts->p_storage_r );
+        /* Keep one storage around, to avoid creating a file per segment */
+        if( p_ts->p_storage_spare == NULL && TsStorageRecycle( p_ts->p_storage_r ) )
+            p_ts->p_storage_spare = p_ts->p_storage_r;
+        else
+            TsStorageDelete( p_ts->p_storage_r );
         p_ts->p_storage_r = p_next;
     }
 
@@ -1158,6 +1310,131 @@ static int TsChangeRate( ts_thread_t *p_ts, float src_rate, float rate )
 
     return i_ret;
 }
+static int TsSeek( ts_thread_t *p_ts, vlc_tick_t i_ts )
+{
+    const ts_index_entry_t *p_target = NULL;
+    bool b_done = false;
+
+    vlc_mutex_lock( &p_ts->lock );
+
+    /* Last entry point not played yet before the timestamp */
+    for( ts_storage_t *p_storage = p_ts->p_storage_r;
+         p_storage != NULL && !b_done; p_storage = p_storage->p_next )
+    {
+        for( size_t i = 0; i < p_storage->index.size; i++ )
+        {
+            const ts_index_entry_t *p_entry = &p_storage->index.data[i];
+            if( p_entry->i_cmd < p_ts->i_cmd_popped )
+                continue;
+            if( p_entry->i_ts > i_ts )
+            {
+                b_done = true;
+                break;
+            }
+            p_target = p_entry;
+        }
+    }
+
+    if( p_target != NULL )
+    {
+        p_ts->skip = *p_target;
+        p_ts->b_skip = true;
+        vlc_cond_signal( &p_ts->wait );
+    }
+    vlc_mutex_unlock( &p_ts->lock );
+
+    return p_target != NULL ? VLC_SUCCESS : VLC_EGENERIC;
+}
+/* The lock is released while executing the kept commands, as in TsRun() */
+static void TsSkipLocked( ts_thread_t *p_ts )
+{
+    vlc_mutex_assert( &p_ts->lock );
+
+    const ts_index_entry_t target = p_ts->skip;
+    vlc_tick_t i_date = VLC_TICK_INVALID;
+    ts_cmd_t cmd;
+
+    p_ts->b_skip = false;
+
+    /* Drop the blocks and the clock updates, but keep the ES and the
+     * programs up to date */
+    while( p_ts->i_cmd_popped < target.i_cmd
+        && !TsPopCmdLocked( p_ts, &cmd, true ) )
+    {
+        if( i_date == VLC_TICK_INVALID )
+            i_date = cmd.header.i_date;
+
+        bool b_drop;
+        switch( cmd.header.i_type )
+        {
+        case C_SEND:
+            b_drop = true;
+            break;
+        case C_CONTROL:
+            switch( cmd.control.i_query )
+            {
+            case ES_OUT_SET_PCR:
+            case ES_OUT_SET_GROUP_PCR:
+            case ES_OUT_RESET_PCR:
+            case ES_OUT_SET_NEXT_DISPLAY_TIME:
+                b_drop = true;
+                break;
+            default:
+                b_drop = false;
+                break;
+            }
+            break;
+        default:
+            b_drop = false;
+            break;
+        }
+        if( b_drop )
+        {
+            CmdClean( &cmd );
+            continue;
+        }
+
+        vlc_mutex_unlock( &p_ts->lock );
+        switch( cmd.header.i_type )
+        {
+        case C_ADD:
+            CmdExecuteAdd(p_ts->ts, &cmd.add);
+            break;
+        case C_DEL:
+            CmdExecuteDel(p_ts->ts, &cmd.del);
+            break;
+        case C_CONTROL:
+            CmdExecuteControl(p_ts->ts, &cmd.control);
+            break;
+        case C_PRIVCONTROL:
+            CmdExecutePrivControl(p_ts->ts, &cmd.privcontrol);
+            break;
+        default:
+            vlc_assert_unreachable();
+        }
+        CmdClean( &cmd );
+        vlc_mutex_lock( &p_ts->lock );
+    }
+
+    if( i_date == VLC_TICK_INVALID )
+        return;
+
+    msg_Dbg( p_ts->p_input, "es out timeshift: skipped %"PRId64" ms",
+             MS_FROM_VLC_TICK(target.i_date - i_date) );
+
+    /* Reset the decoders and the clock as for a seek */
+    vlc_mutex_unlock( &p_ts->lock );
+    es_out_Control( &p_ts->p_out->out, ES_OUT_RESET_PCR );
+    vlc_mutex_lock( &p_ts->lock );
+
+    /* The next command is played now, as the skipped ones would have been */
+    p_ts->i_cmd_delay += p_ts->i_rate_delay;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    p_ts->i_cmd_delay -= target.i_date - i_date;
+    if( p_ts->i_cmd_delay < 0 )
+        p_ts->i_cmd_delay = 0;
+}
 
 static void *TsRun( void *p_data )
 {
@@ -1172,6 +1449,9 @@ static void *TsRun( void *p_data )
         ts_cmd_t cmd;
         vlc_tick_t  i_deadline;
 
+        if( p_ts->b_skip )
+            TsSkipLocked( p_ts );
+
         /* Pop a command to execute */
         bool b_buffering = es_out_GetBuffering( p_ts->p_out );
 
@@ -1275,6 +1555,11 @@ static void *TsRun( void *p_data )
 #define MAX_COMMAND_SIZE sizeof(ts_cmd_t)
 #define TS_STORAGE_COMMAND_PREALLOC 30000
 
+/* Alignment of the data of the blocks in the data file */
+#define TS_STORAGE_ALIGN 32
+#define TS_STORAGE_BLOCK_HEADER \
+    ((sizeof(ts_storage_block_t) + TS_STORAGE_ALIGN - 1) & ~(TS_STORAGE_ALIGN - 1))
+
 static const size_t TsStorageSizeofCommand[] =
 {
     [C_ADD] = sizeof(ts_cmd_add_t),
@@ -1298,6 +1583,21 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         return NULL;
     }
 
+#ifdef TS_STORAGE_MMAP
+    /* Allocate the blocks of the whole file, not only its size: the storage
+     * is refused if the temporary filesystem cannot hold it */
+    p_storage->p_map = MAP_FAILED;
+    if( posix_fallocate( fd, 0, i_tmp_size_max ) == 0 )
+        p_storage->p_map = mmap( NULL, i_tmp_size_max, PROT_READ|PROT_WRITE,
+                                 MAP_SHARED, fd, 0 );
+    if( p_storage->p_map == MAP_FAILED )
+    {
+        vlc_close( fd );
+        vlc_unlink( psz_file );
+        goto error;
+    }
+    p_storage->fd = fd;
+#else
     p_storage->p_filew = fdopen( fd, "w+b" );
     if( p_storage->p_filew == NULL )
     {
@@ -1313,6 +1613,7 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         vlc_unlink( psz_file );
         goto error;
     }
+#endif
 
 #ifndef _WIN32
     vlc_unlink( psz_file );
@@ -1321,6 +1622,8 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     p_storage->psz_file = psz_file;
 #endif
     p_storage->p_next = NULL;
+    vlc_atomic_rc_init( &p_storage->rc );
+    vlc_vector_init( &p_storage->index );
 
     /* */
     p_storage->i_file_max = i_tmp_size_max;
@@ -1345,6 +1648,25 @@ error:
     return NULL;
 }
 
+static void TsStorageRelease( ts_storage_t *p_storage )
+{
+    if( !vlc_atomic_rc_dec( &p_storage->rc ) )
+        return;
+
+#ifdef TS_STORAGE_MMAP
+    munmap( p_storage->p_map, p_storage->i_file_max );
+    vlc_close( p_storage->fd );
+#else
+    fclose( p_storage->p_filer );
+    fclose( p_storage->p_filew );
+#endif
+#ifdef _WIN32
+    vlc_unlink( p_storage->psz_file );
+    free( p_storage->psz_file );
+#endif
+    free( p_storage );
+}
+
 static void TsStorageDelete( ts_storage_t *p_storage )
 {
     while( p_storage->p_cmd_r < p_storage->p_cmd_w )
@@ -1356,14 +1678,42 @@ static void TsStorageDelete( ts_storage_t *p_storage )
         CmdClean( &cmd );
     }
     free( p_storage->p_cmd_buf );
+    vlc_vector_destroy( &p_storage->index );
 
-    fclose( p_storage->p_filer );
-    fclose( p_storage->p_filew );
-#ifdef _WIN32
-    vlc_unlink( p_storage->psz_file );
-    free( p_storage->psz_file );
+    /* The blocks still in use keep the mapping */
+    TsStorageRelease( p_storage );
+}
+
+/* Reset an empty storage to be filled again */
+static bool TsStorageRecycle( ts_storage_t *p_storage )
+{
+    assert( TsStorageIsEmpty( p_storage ) );
+
+    /* Its data is still referenced by blocks */
+    if( vlc_atomic_rc_get( &p_storage->rc ) > 1 )
+        return false;
+
+    /* It was packed when the next storage was created */
+    if( p_storage->i_cmd_buf < TS_STORAGE_COMMAND_PREALLOC * MAX_COMMAND_SIZE )
+    {
+        uint8_t *p_realloc = realloc( p_storage->p_cmd_buf,
+                                      TS_STORAGE_COMMAND_PREALLOC * MAX_COMMAND_SIZE );
+        if( !p_realloc )
+            return false;
+        p_storage->p_cmd_buf = p_realloc;
+        p_storage->i_cmd_buf = TS_STORAGE_COMMAND_PREALLOC * MAX_COMMAND_SIZE;
+    }
+
+#ifndef TS_STORAGE_MMAP
+    if( fseek( p_storage->p_filew, 0, SEEK_SET ) )
+        return false;
 #endif
-    free( p_storage );
+    p_storage->p_next = NULL;
+    p_storage->i_file_size = 0;
+    p_storage->p_cmd_w = p_storage->p_cmd_buf;
+    p_storage->p_cmd_r = p_storage->p_cmd_buf;
+    vlc_vector_clear( &p_storage->index );
+    return true;
 }
 
 static void TsStoragePack( ts_storage_t *p_storage )
@@ -1383,11 +1733,19 @@ static void TsStoragePack( ts_storage_t *p_storage )
     }
 }
 
+/* Size used in the data file by a block, the data is aligned so that it can
+ * be handed out in place */
+static size_t TsStorageSizeofBlock( const block_t *p_block )
+{
+    return TS_STORAGE_BLOCK_HEADER
+         + ((p_block->i_buffer + TS_STORAGE_ALIGN - 1) & ~(TS_STORAGE_ALIGN - 1));
+}
+
 static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     if( p_cmd && p_cmd->header.i_type == C_SEND && p_storage->p_cmd_w )
     {
-        size_t i_size = sizeof(*p_cmd->send.p_block) + p_cmd->send.p_block->i_buffer;
+        size_t i_size = TsStorageSizeofBlock( p_cmd->send.p_block );
 
         if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
             return true;
@@ -1400,44 +1758,87 @@ static bool TsStorageIsEmpty( ts_storage_t *p_storage )
     return !p_storage || p_storage->p_cmd_r >= p_storage->p_cmd_w;
 }
 
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static int TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
 {
-    assert( !TsStorageIsFull( p_storage, p_cmd ) );
     ts_cmd_t cmd;
     memcpy(&cmd, p_cmd, TsStorageSizeofCommand[p_cmd->header.i_type]);
 
     if( cmd.header.i_type == C_SEND )
     {
         block_t *p_block = cmd.send.p_block;
+        const ts_storage_block_t block = {
+            .i_buffer = p_block->i_buffer,
+            .i_flags = p_block->i_flags,
+            .i_nb_samples = p_block->i_nb_samples,
+            .i_pts = p_block->i_pts,
+            .i_dts = p_block->i_dts,
+            .i_length = p_block->i_length,
+        };
+        const size_t i_size = TsStorageSizeofBlock( p_block );
 
         cmd.send.p_block = NULL;
-        cmd.send.i_offset = ftell( p_storage->p_filew );
+        cmd.send.i_offset = p_storage->i_file_size;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
+#ifdef TS_STORAGE_MMAP
+        /* Blocks larger than a whole storage are lost */
+        if( p_storage->i_file_size + i_size > p_storage->i_file_max )
         {
             block_Release( p_block );
-            return;
+            return VLC_EGENERIC;
+        }
+        uint8_t *p_dst = &p_storage->p_map[p_storage->i_file_size];
+        memcpy( p_dst, &block, sizeof(block) );
+        if( p_block->i_buffer > 0 )
+            memcpy( &p_dst[TS_STORAGE_BLOCK_HEADER], p_block->p_buffer,
+                    p_block->i_buffer );
+        (void) b_flush;
+#else
+        if( fseek( p_storage->p_filew, p_storage->i_file_size, SEEK_SET )
+         || fwrite( &block, sizeof(block), 1, p_storage->p_filew ) != 1
+         || fseek( p_storage->p_filew, p_storage->i_file_size + TS_STORAGE_BLOCK_HEADER, SEEK_SET ) )
+        {
+            block_Release( p_block );
+            return VLC_EGENERIC;
         }
-        p_storage->i_file_size += sizeof(*p_block);
         if( p_block->i_buffer > 0 )
         {
             if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
             {
                 block_Release( p_block );
-                return;
+                return VLC_EGENERIC;
             }
         }
-        p_storage->i_file_size += p_block->i_buffer;
-        block_Release( p_block );
 
         if( b_flush )
             fflush( p_storage->p_filew );
+#endif
+        p_storage->i_file_size += i_size;
+        block_Release( p_block );
     }
+    else
+        assert( !TsStorageIsFull( p_storage, p_cmd ) );
+
     size_t i_cmdsize = TsStorageSizeofCommand[ cmd.header.i_type ];
     memcpy( p_storage->p_cmd_w, &cmd, i_cmdsize );
     p_storage->p_cmd_w += i_cmdsize;
+    return VLC_SUCCESS;
+}
+
+#ifdef TS_STORAGE_MMAP
+static void TsStorageViewRelease( block_t *p_block )
+{
+    ts_storage_view_t *p_view = container_of( p_block, ts_storage_view_t, self );
+
+    TsStorageRelease( p_view->p_storage );
+    free( p_view );
 }
 
+static const struct vlc_block_callbacks ts_storage_view_cbs =
+{
+    TsStorageViewRelease,
+};
+#endif
+
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
@@ -1449,29 +1850,57 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
 
     if( p_cmd->header.i_type == C_SEND )
     {
-        block_t block;
+        ts_storage_block_t block;
+        block_t *p_block = NULL;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
+        if( b_flush )
         {
-            block_t *p_block = block_Alloc( block.i_buffer );
+            p_cmd->send.p_block = NULL;
+            return;
+        }
+
+#ifdef TS_STORAGE_MMAP
+        /* Hand out the data in place, without reading nor copying it */
+        uint8_t *p_src = &p_storage->p_map[p_cmd->send.i_offset];
+        memcpy( &block, p_src, sizeof(block) );
+
+        ts_storage_view_t *p_view = malloc( sizeof(*p_view) );
+        if( p_view )
+        {
+            p_block = &p_view->self;
+            block_Init( p_block, &ts_storage_view_cbs,
+                        &p_src[TS_STORAGE_BLOCK_HEADER], block.i_buffer );
+            p_view->p_storage = p_storage;
+            vlc_atomic_rc_inc( &p_storage->rc );
+        }
+#else
+        if( !fseek( p_storage->p_filer, p_cmd->send.i_offset, SEEK_SET ) &&
+            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 &&
+            !fseek( p_storage->p_filer, p_cmd->send.i_offset + TS_STORAGE_BLOCK_HEADER, SEEK_SET ) )
+        {
+            p_block = block_Alloc( block.i_buffer );
             if( p_block )
-            {
-                p_block->i_dts      = block.i_dts;
-                p_block->i_pts      = block.i_pts;
-                p_block->i_flags    = block.i_flags;
-                p_block->i_length   = block.i_length;
-                p_block->i_nb_samples = block.i_nb_samples;
                 p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
-            }
-            p_cmd->send.p_block = p_block;
         }
         else
         {
             //perror( "TsStoragePopCmd" );
-            p_cmd->send.p_block = block_Alloc( 1 );
+            p_block = block_Alloc( 1 );
+            block.i_buffer = 0;
+            block.i_flags = BLOCK_FLAG_CORRUPTED;
+            block.i_nb_samples = 0;
+            block.i_pts = block.i_dts = block.i_length = VLC_TICK_INVALID;
+        }
+#endif
+        if( p_block )
+        {
+            p_block->i_dts      = block.i_dts;
+            p_block->i_pts      = block.i_pts;
+            p_block->i_flags    = block.i_flags;
+            p_block->i_length   = block.i_length;
+            p_block->i_nb_samples = block.i_nb_samples;
         }
+        p_cmd->send.p_block = p_block;
     }
 }
 
@@ -109,6 +109,11 @@ static void AppendAttachment(input_thread_t* p_input,
 #define SLAVE_ADD_CANFAIL   (1<<1)
 #define SLAVE_ADD_SET_TIME  (1<<2)
 
+/* Maximal rate of the keyframe trick-play */
+#define TRICKPLAY_RATE_MAX  64.f
+/* Maximal number of demux calls to get a keyframe after a seek */
+#define TRICKPLAY_DEMUX_MAX 256
+
 static int input_SlaveSourceAdd( input_thread_t *, enum slave_type,
                                  const char *, unsigned );
 static char *input_SubtitleFile2Uri( input_thread_t *, const char * );
@@ -345,6 +350,12 @@ input_thread_t *input_Create( vlc_object_t *p_parent,
     priv->b_low_delay = var_InheritBool( p_input, "low-delay" );
     priv->i_jitter_max = VLC_TICK_FROM_MS(var_InheritInteger( p_input, "clock-jitter" ));
 
+    priv->trickplay.b_active = false;
+    priv->trickplay.threshold = var_InheritFloat( p_input, "trickplay-rate" );
+    int64_t i_trickplay_fps = var_InheritInteger( p_input, "trickplay-fps" );
+    priv->trickplay.i_interval = vlc_tick_from_samples( 1,
+                                    VLC_CLIP( i_trickplay_fps, 1, 60 ) );
+
     /* Remove 'Now playing' info as it is probably outdated */
     input_item_SetNowPlaying( p_item, NULL );
     input_item_SetESNowPlaying( p_item, NULL );
@@ -525,6 +536,90 @@ static void MainLoopDemux( input_thread_t *p_input, bool *pb_changed )
         SlaveDemux( p_input );
 }
 
+/**
+ * MainLoopTrickPlay
+ * Fetch the keyframe at the trick-play target, then move the target.
+ *
+ * The demuxer is seeked without precision, so that it lands on the keyframe
+ * it indexes at the target, and demuxed until the es_out got the first video
+ * frame. The decoders and the outputs only get the keyframes, at the nominal
+ * rate. Everything runs on the input thread: the next keyframe is only
+ * fetched once the demuxer returned the previous one, while the decoder
+ * thread may still be decoding it.
+ */
+static void MainLoopTrickPlay( input_thread_t *p_input, bool *pb_changed )
+{
+    input_thread_private_t *priv = input_priv(p_input);
+    demux_t *p_demux = priv->master->p_demux;
+    const vlc_tick_t i_step = priv->trickplay.i_step;
+    int i_ret = VLC_DEMUXER_SUCCESS;
+
+    *pb_changed = false;
+
+    /* Waiting for the rate change */
+    if( i_step == 0 )
+        return;
+
+    if( priv->trickplay.i_target == VLC_TICK_INVALID
+     && demux_Control( p_demux, DEMUX_GET_TIME, &priv->trickplay.i_target ) )
+        priv->trickplay.i_target = 0;
+
+    bool b_start = false;
+    if( priv->trickplay.i_target <= 0 )
+    {
+        priv->trickplay.i_target = 0;
+        b_start = i_step < 0;
+    }
+
+    if( i_step > 0 && priv->i_stop > 0
+     && priv->trickplay.i_target >= priv->i_stop )
+        i_ret = VLC_DEMUXER_EOF;
+    else if( demux_SetTime( p_demux, priv->trickplay.i_target, false ) )
+        i_ret = i_step > 0 ? VLC_DEMUXER_EOF : VLC_DEMUXER_SUCCESS;
+    else
+    {
+        es_out_RequestKeyframe( priv->p_es_out );
+        for( unsigned i = 0; i < TRICKPLAY_DEMUX_MAX
+                          && es_out_IsKeyframePending( priv->p_es_out ); i++ )
+        {
+            i_ret = demux_Demux( p_demux );
+            i_ret = i_ret > 0 ? VLC_DEMUXER_SUCCESS :
+                    ( i_ret < 0 ? VLC_DEMUXER_EGENERIC : VLC_DEMUXER_EOF );
+            if( i_ret != VLC_DEMUXER_SUCCESS )
+                break;
+        }
+        if( i_ret == VLC_DEMUXER_SUCCESS )
+            UpdateGenericFromDemux( p_input );
+        priv->trickplay.i_last = priv->trickplay.i_target;
+    }
+
+    if (input_Stopped(p_input))
+        return;
+
+    if( i_ret == VLC_DEMUXER_EGENERIC )
+    {
+        input_ChangeState( p_input, ERROR_S, VLC_TICK_INVALID );
+        return;
+    }
+
+    if( i_ret == VLC_DEMUXER_EOF && i_step > 0 )
+    {
+        msg_Dbg( p_input, "EOF reached" );
+        priv->master->b_eof = true;
+        es_out_Eos(priv->p_es_out);
+    }
+    else if( b_start || i_ret == VLC_DEMUXER_EOF )
+    {
+        /* Play from the start when scanning backward reached it */
+        msg_Dbg( p_input, "start reached, leaving trick-play" );
+        priv->trickplay.i_step = 0;
+        input_ControlPushHelper( p_input, INPUT_CONTROL_SET_RATE,
+                                 &(vlc_value_t) { .f_float = 1.f } );
+    }
+    else
+        priv->trickplay.i_target += i_step;
+}
+
 static int MainLoopTryRepeat( input_thread_t *p_input )
 {
     int i_repeat = var_GetInteger( p_input, "input-repeat" );
@@ -665,7 +760,10 @@ static void MainLoop( input_thread_t *p_input, bool b_interactive )
             {
                 bool b_force_update = false;
 
-                MainLoopDemux( p_input, &b_force_update );
+                if( input_priv(p_input)->trickplay.b_active )
+                    MainLoopTrickPlay( p_input, &b_force_update );
+                else
+                    MainLoopDemux( p_input, &b_force_update );
 
                 if( b_can_demux )
                     i_wakeup = es_out_GetWakeup( input_priv(p_input)->p_es_out );
@@ -1913,6 +2011,76 @@ static void ControlSetEsList(input_thread_t *input,
     free(array);
 }
 
+static bool InputCanTrickPlay( input_thread_t *p_input )
+{
+    input_thread_private_t *priv = input_priv(p_input);
+    input_source_t *master = priv->master;
+    bool b_can_seek;
+
+    if( priv->trickplay.threshold <= 0.f || priv->p_sout != NULL
+     || priv->b_recording || !master->b_can_pace_control
+     || !master->b_rescale_ts )
+        return false;
+
+    if( demux_Control( master->p_demux, DEMUX_CAN_SEEK, &b_can_seek )
+     || !b_can_seek )
+        return false;
+
+    /* Otherwise, no keyframe could be decoded: the rate is changed as for
+     * the inputs without trick-play */
+    return es_out_CanTrickPlay( priv->p_es_out );
+}
+
+static int InputTrickPlayStart( input_thread_t *p_input, float rate )
+{
+    input_thread_private_t *priv = input_priv(p_input);
+
+    if( !priv->trickplay.b_active )
+    {
+        /* Reset the decoders and clock, the keyframes drive it from now */
+        es_out_Control(&priv->p_es_out->out, ES_OUT_RESET_PCR);
+        if( es_out_SetTrickPlay( priv->p_es_out, true,
+                                 priv->trickplay.i_interval ) )
+            return VLC_EGENERIC;
+        es_out_SetRate( priv->p_es_out, 1.f, 1.f );
+
+        msg_Dbg( p_input, "starting keyframe trick-play" );
+        priv->trickplay.b_active = true;
+        priv->trickplay.i_target = VLC_TICK_INVALID;
+        priv->trickplay.i_last = VLC_TICK_INVALID;
+    }
+    priv->trickplay.i_step = rate * priv->trickplay.i_interval;
+    return VLC_SUCCESS;
+}
+
+static void InputTrickPlayStop( input_thread_t *p_input )
+{
+    input_thread_private_t *priv = input_priv(p_input);
+
+    es_out_SetTrickPlay( priv->p_es_out, false, 0 );
+    priv->trickplay.b_active = false;
+
+    /* Resume from the last keyframe fetched */
+    es_out_Control(&priv->p_es_out->out, ES_OUT_RESET_PCR);
+    if( priv->trickplay.i_last != VLC_TICK_INVALID
+     && !demux_SetTime( priv->master->p_demux, priv->trickplay.i_last, true ) )
+    {
+        if( priv->i_slave > 0 )
+            SlaveSeek( p_input );
+        priv->master->b_eof = false;
+    }
+
+    if( priv->stats != NULL )
+    {
+        input_stats_t st;
+        input_stats_Compute( priv->stats, &st );
+        msg_Dbg( p_input, "keyframe trick-play stopped: %"PRIu64" keyframes "
+                 "decoded, %"PRIu64" frames skipped, %"PRIu64" pictures "
+                 "displayed in total", st.i_trickplay_keyframes,
+                 st.i_trickplay_skipped, st.i_displayed_pictures );
+    }
+}
+
 static bool Control( input_thread_t *p_input,
                      int i_type, input_control_param_t param )
 {
@@ -1948,6 +2116,7 @@ static bool Control( input_thread_t *p_input,
                 if( priv->i_slave > 0 )
                     SlaveSeek( p_input );
                 priv->master->b_eof = false;
+                priv->trickplay.i_target = VLC_TICK_INVALID;
 
                 b_force_update = true;
             }
@@ -1964,6 +2133,22 @@ static bool Control( input_thread_t *p_input,
                 break;
             }
 
+            /* Live streams can still be scrubbed inside the timeshift
+             * buffer, the player time being the timestamp minus the normal
+             * time */
+            bool b_can_seek;
+            if( demux_Control( priv->master->p_demux, DEMUX_CAN_SEEK,
+                               &b_can_seek ) )
+                b_can_seek = false;
+            if( !b_can_seek &&
+                es_out_SeekTimeshift( priv->p_es_out, param.time.i_val
+                    + priv->master->i_normal_time - VLC_TICK_0 ) == VLC_SUCCESS )
+            {
+                priv->trickplay.i_target = VLC_TICK_INVALID;
+                b_force_update = true;
+                break;
+            }
+
             /* Reset the decoders states and clock sync (before calling the demuxer */
             es_out_Control(&priv->p_es_out->out, ES_OUT_RESET_PCR);
 
@@ -1990,6 +2175,7 @@ static bool Control( input_thread_t *p_input,
                 if( priv->i_slave > 0 )
                     SlaveSeek( p_input );
                 priv->master->b_eof = false;
+                priv->trickplay.i_target = VLC_TICK_INVALID;
 
                 b_force_update = true;
             }
@@ -2023,12 +2209,15 @@ static bool Control( input_thread_t *p_input,
             /* Get rate and direction */
             float rate = fabsf( param.val.f_float );
             int i_rate_sign = param.val.f_float < 0 ? -1 : 1;
+            const bool b_can_trickplay = InputCanTrickPlay( p_input );
+            const float rate_max = b_can_trickplay ? TRICKPLAY_RATE_MAX
+                                                   : INPUT_RATE_MAX;
 
             /* Check rate bound */
-            if( rate > INPUT_RATE_MAX )
+            if( rate > rate_max )
             {
                 msg_Info( p_input, "cannot set rate faster" );
-                rate = INPUT_RATE_MAX;
+                rate = rate_max;
             }
             else if( rate < INPUT_RATE_MIN )
             {
@@ -2039,7 +2228,7 @@ static bool Control( input_thread_t *p_input,
             /* Apply direction */
             if( i_rate_sign < 0 )
             {
-                if( priv->master->b_rescale_ts )
+                if( priv->master->b_rescale_ts && !b_can_trickplay )
                 {
                     msg_Dbg( p_input, "cannot set negative rate" );
                     rate = priv->rate;
@@ -2058,6 +2247,24 @@ static bool Control( input_thread_t *p_input,
                 msg_Dbg( p_input, "cannot change rate" );
                 rate = 1.f;
             }
+
+            /* Only decode the keyframes when scanning fast or backward */
+            const bool b_trickplay = b_can_trickplay &&
+                ( rate < 0.f || rate >= priv->trickplay.threshold );
+            if( b_trickplay && rate != priv->rate )
+            {
+                if( InputTrickPlayStart( p_input, rate ) == VLC_SUCCESS )
+                {
+                    priv->rate = rate;
+                    input_SendEventRate( p_input, rate );
+                    b_force_update = true;
+                    break;
+                }
+                if( rate < 0.f )
+                    rate = priv->rate;
+            }
+            else if( !b_trickplay && priv->trickplay.b_active )
+                InputTrickPlayStop( p_input );
             if( rate != priv->rate &&
                 !priv->master->b_can_pace_control && priv->master->b_can_rate_control )
             {
@@ -2312,6 +2519,28 @@ static bool Control( input_thread_t *p_input,
             b_force_update = true;
             break;
 
+        case INPUT_CONTROL_SET_FRAME_PREVIOUS:
+            if( priv->i_state == PLAYING_S )
+                ControlPause( p_input, i_control_date );
+            if( priv->i_state != PAUSE_S )
+            {
+                msg_Err( p_input, "invalid state for frame previous" );
+                break;
+            }
+
+            if( es_out_SetFramePrevious( priv->p_es_out ) != VLC_SUCCESS )
+            {
+                /* Not cached anymore: seek precisely to the previous frame
+                 * and step to it */
+                if( param.time.i_val == VLC_TICK_INVALID )
+                    break;
+                param.time.b_fast_seek = false;
+                Control( p_input, INPUT_CONTROL_SET_TIME, param );
+                es_out_SetFrameNext( priv->p_es_out );
+            }
+            b_force_update = true;
+            break;
+
         case INPUT_CONTROL_SET_RENDERER:
         {
             vlc_renderer_item_t *p_item = param.val.p_address;
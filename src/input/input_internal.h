@@ -27,6 +27,7 @@
 #include <vlc_input.h>
 #include "input_interface.h"
 #include "../misc/interrupt.h"
+#include "../misc/histogram.h"
 #include "./source.h"
 
 struct input_stats;
@@ -447,6 +448,17 @@ typedef struct input_thread_private_t
     vlc_tick_t  i_start;    /* :start-time,0 by default */
     vlc_tick_t  i_stop;     /* :stop-time, 0 if none */
 
+    /* Keyframe trick-play, used from :trickplay-rate or backward */
+    struct
+    {
+        bool        b_active;
+        float       threshold;  /* :trickplay-rate, 0 if disabled */
+        vlc_tick_t  i_interval; /* display duration of a keyframe */
+        vlc_tick_t  i_step;     /* media time between keyframes, signed */
+        vlc_tick_t  i_target;   /* time of the next keyframe to fetch */
+        vlc_tick_t  i_last;     /* time of the last keyframe fetched */
+    } trickplay;
+
     /* Delays */
     bool        b_low_delay;
     vlc_tick_t  i_jitter_max;
@@ -553,6 +565,7 @@ enum input_control_e
     INPUT_CONTROL_SET_RECORD_STATE,
 
     INPUT_CONTROL_SET_FRAME_NEXT,
+    INPUT_CONTROL_SET_FRAME_PREVIOUS,
 
     INPUT_CONTROL_SET_RENDERER,
 
@@ -688,6 +701,11 @@ struct input_stats {
     atomic_uintmax_t displayed_pictures;
     atomic_uintmax_t late_pictures;
     atomic_uintmax_t lost_pictures;
+    atomic_uintmax_t trickplay_keyframes;
+    atomic_uintmax_t trickplay_skipped;
+    atomic_uintmax_t frame_cache_hits;
+    atomic_uintmax_t frame_cache_misses;
+    struct vlc_histogram histograms[INPUT_STATS_HISTOGRAM_COUNT];
 };
 
 struct input_stats *input_stats_Create(void);
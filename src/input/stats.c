@@ -68,6 +68,12 @@ struct input_stats *input_stats_Create(void)
     atomic_init(&stats->displayed_pictures, 0);
     atomic_init(&stats->late_pictures, 0);
     atomic_init(&stats->lost_pictures, 0);
+    atomic_init(&stats->trickplay_keyframes, 0);
+    atomic_init(&stats->trickplay_skipped, 0);
+    atomic_init(&stats->frame_cache_hits, 0);
+    atomic_init(&stats->frame_cache_misses, 0);
+    for (size_t i = 0; i < INPUT_STATS_HISTOGRAM_COUNT; i++)
+        vlc_histogram_Init(&stats->histograms[i]);
     return stats;
 }
 
@@ -111,6 +117,22 @@ void input_stats_Compute(struct input_stats *stats, input_stats_t *st)
                                                     memory_order_relaxed);
     st->i_lost_pictures = atomic_load_explicit(&stats->lost_pictures,
                                                memory_order_relaxed);
+
+    /* Trick-play */
+    st->i_trickplay_keyframes = atomic_load_explicit(
+                    &stats->trickplay_keyframes, memory_order_relaxed);
+    st->i_trickplay_skipped = atomic_load_explicit(&stats->trickplay_skipped,
+                                                   memory_order_relaxed);
+
+    /* Previous frame */
+    st->i_frame_cache_hits = atomic_load_explicit(&stats->frame_cache_hits,
+                                                  memory_order_relaxed);
+    st->i_frame_cache_misses = atomic_load_explicit(
+                    &stats->frame_cache_misses, memory_order_relaxed);
+
+    /* Latency histograms */
+    for (size_t i = 0; i < INPUT_STATS_HISTOGRAM_COUNT; i++)
+        vlc_histogram_Read(&stats->histograms[i], &st->histograms[i]);
 }
 
 /** Update a counter element with new values
@@ -500,6 +500,18 @@ static const char *const fit_descriptions[] = {
     "This drops frames that are late (arrive to the video output after " \
     "their intended display date)." )
 
+#define RENDER_AHEAD_TEXT N_("Pictures filtered ahead")
+#define RENDER_AHEAD_LONGTEXT N_( \
+    "Number of pictures run through the video filters by a separate thread " \
+    "ahead of their display, so that heavy filters such as deinterlacing " \
+    "run in parallel with the display. 0 filters them when displayed." )
+
+#define FRAME_CACHE_TEXT N_("Decoded frame cache (MiB)")
+#define FRAME_CACHE_LONGTEXT N_( \
+    "Size of the cache of the last decoded video frames, used to step " \
+    "backward frame by frame without decoding again. Each frame is copied " \
+    "into the cache, 0 disables it." )
+
 #define QUIET_SYNCHRO_TEXT N_("Quiet synchro")
 #define QUIET_SYNCHRO_LONGTEXT N_( \
     "This avoids flooding the message log with debug output from the " \
@@ -705,6 +717,16 @@ static const char *const ppsz_prefres[] = {
 #define INPUT_RATE_LONGTEXT N_( \
     "This defines the playback speed (nominal speed is 1.0)." )
 
+#define TRICKPLAY_RATE_TEXT N_("Keyframe trick-play rate")
+#define TRICKPLAY_RATE_LONGTEXT N_( \
+    "From this playback speed, and for backward playback, only the " \
+    "keyframes of seekable inputs are decoded and displayed. " \
+    "0 disables the keyframe trick-play." )
+
+#define TRICKPLAY_FPS_TEXT N_("Keyframe trick-play frame rate")
+#define TRICKPLAY_FPS_LONGTEXT N_( \
+    "Number of keyframes displayed per second in trick-play." )
+
 #define INPUT_LIST_TEXT N_("Input list")
 #define INPUT_LIST_LONGTEXT N_( \
     "You can give a comma-separated list " \
@@ -1008,6 +1030,12 @@ static const char* const ppsz_restore_playback_desc[] = {
 #define DEC_DEV_TEXT N_("Preferred decoder hardware device")
 #define DEC_DEV_LONGTEXT N_("This allows hardware decoding when available.")
 
+#define PACKETIZER_THREAD_TEXT N_("Packetize in a separate thread")
+#define PACKETIZER_THREAD_LONGTEXT N_( \
+    "Run the packetizers in their own thread, ahead of the decoders. " \
+    "This can increase the throughput of software decoders on multi-core " \
+    "systems at the cost of some additional latency." )
+
 /*****************************************************************************
  * Sout
  ****************************************************************************/
@@ -1639,6 +1667,10 @@ vlc_module_begin ()
         change_private ()
     add_bool( "drop-late-frames", true, DROP_LATE_FRAMES_TEXT,
               DROP_LATE_FRAMES_LONGTEXT )
+    add_integer_with_range( "vout-render-ahead", 0, 0, 16,
+                            RENDER_AHEAD_TEXT, RENDER_AHEAD_LONGTEXT )
+    add_integer_with_range( "vout-frame-cache", 0, 0, 4096,
+                            FRAME_CACHE_TEXT, FRAME_CACHE_LONGTEXT )
     /* Used in vout_synchro */
     add_bool( "skip-frames", true, SKIP_FRAMES_TEXT,
               SKIP_FRAMES_LONGTEXT )
@@ -1862,6 +1894,10 @@ vlc_module_begin ()
         change_safe ()
     add_float( "rate", 1.,
                INPUT_RATE_TEXT, INPUT_RATE_LONGTEXT )
+    add_float( "trickplay-rate", 0.,
+               TRICKPLAY_RATE_TEXT, TRICKPLAY_RATE_LONGTEXT )
+    add_integer_with_range( "trickplay-fps", 10, 1, 60,
+                            TRICKPLAY_FPS_TEXT, TRICKPLAY_FPS_LONGTEXT )
 
     add_string( "input-list", NULL,
                  INPUT_LIST_TEXT, INPUT_LIST_LONGTEXT )
@@ -2012,6 +2048,8 @@ vlc_module_begin ()
     add_bool( "hw-dec", true, HW_DEC_TEXT, HW_DEC_LONGTEXT )
     add_obsolete_string( "encoder" ) /* since 4.0.0 */
     add_module("dec-dev", "decoder device", "any", DEC_DEV_TEXT, DEC_DEV_LONGTEXT)
+    add_bool( "packetizer-thread", false, PACKETIZER_THREAD_TEXT,
+              PACKETIZER_THREAD_LONGTEXT )
 
     //set_subcategory( SUBCAT_INPUT_SCODEC )
     set_subcategory( SUBCAT_INPUT_STREAM_FILTER )
@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * histogram.c: lock-less histograms of durations
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdatomic.h>
+#include <stdbit.h>
+
+#include <vlc_common.h>
+
+#include "histogram.h"
+
+void vlc_histogram_Add(struct vlc_histogram *h, vlc_tick_t value)
+{
+    if (value < 0)
+        value = 0;
+
+    unsigned bucket = stdc_bit_width((unsigned long long)US_FROM_VLC_TICK(value));
+    if (bucket >= INPUT_STATS_HISTOGRAM_BUCKETS)
+        bucket = INPUT_STATS_HISTOGRAM_BUCKETS - 1;
+
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->total, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+
+    int_least64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > max
+        && !atomic_compare_exchange_weak_explicit(&h->max, &max, value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed));
+}
+
+void vlc_histogram_Read(struct vlc_histogram *h,
+                        struct input_stats_histogram *out)
+{
+    out->i_count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    out->i_total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    out->i_max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (size_t i = 0; i < INPUT_STATS_HISTOGRAM_BUCKETS; i++)
+        out->buckets[i] = atomic_load_explicit(&h->buckets[i],
+                                               memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * histogram.h: lock-less histograms of durations
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_HISTOGRAM_H
+#define VLC_HISTOGRAM_H 1
+
+#include <stdatomic.h>
+
+#include <vlc_common.h>
+#include <vlc_input_item.h>
+
+/*
+ * The decoders and the outputs record their durations in the histograms of
+ * the input statistics, with a few relaxed atomic operations per sample.
+ * The histograms are only copied when the statistics are computed.
+ */
+struct vlc_histogram
+{
+    atomic_uint_least64_t count;
+    atomic_int_least64_t total;
+    atomic_int_least64_t max;
+    atomic_uint_least64_t buckets[INPUT_STATS_HISTOGRAM_BUCKETS];
+};
+
+static inline void vlc_histogram_Init(struct vlc_histogram *h)
+{
+    atomic_init(&h->count, 0);
+    atomic_init(&h->total, 0);
+    atomic_init(&h->max, 0);
+    for (size_t i = 0; i < INPUT_STATS_HISTOGRAM_BUCKETS; i++)
+        atomic_init(&h->buckets[i], 0);
+}
+
+/**
+ * Record a duration.
+ */
+void vlc_histogram_Add(struct vlc_histogram *h, vlc_tick_t value);
+
+/**
+ * Copy a histogram to the input statistics.
+ */
+void vlc_histogram_Read(struct vlc_histogram *h,
+                        struct input_stats_histogram *out);
+
+#endif /* VLC_HISTOGRAM_H */
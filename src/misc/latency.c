@@ -0,0 +1,171 @@
+/*****************************************************************************
+ * latency.c: per frame latency tracing
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_frame.h>
+#include <vlc_picture.h>
+#include <vlc_tracer.h>
+
+#include "latency.h"
+
+static const char *const stage_names[VLC_LATENCY_STAGE_COUNT] = {
+    [VLC_LATENCY_DEMUX]      = "demux",
+    [VLC_LATENCY_QUEUE]      = "queue",
+    [VLC_LATENCY_PACKETIZER] = "packetizer",
+    [VLC_LATENCY_DECODE]     = "decode",
+    [VLC_LATENCY_FILTER]     = "filter",
+    [VLC_LATENCY_PREPARE]    = "prepare",
+    [VLC_LATENCY_DISPLAY]    = "display",
+    [VLC_LATENCY_PLAY]       = "play",
+};
+
+static atomic_uint_least64_t trail_ids;
+
+void vlc_latency_Start(struct vlc_tracer *tracer, const char *es_id,
+                       vlc_frame_t *frame)
+{
+    struct vlc_latency_trail *trail = calloc(1, sizeof (*trail));
+    if (unlikely(trail == NULL))
+        return;
+    trail->id = atomic_fetch_add_explicit(&trail_ids, 1,
+                                          memory_order_relaxed);
+    for (size_t i = 0; i < VLC_LATENCY_STAGE_COUNT; i++)
+        atomic_init(&trail->stages[i], VLC_TICK_INVALID);
+
+    struct vlc_ancillary *ancillary =
+        vlc_ancillary_Create(trail, VLC_ANCILLARY_ID_LATENCY);
+    if (unlikely(ancillary == NULL))
+    {
+        free(trail);
+        return;
+    }
+
+    if (vlc_frame_AttachAncillary(frame, ancillary) == VLC_SUCCESS)
+        vlc_latency_Stamp(tracer, es_id, ancillary, VLC_LATENCY_DEMUX);
+    vlc_ancillary_Release(ancillary);
+}
+
+void vlc_latency_Stamp(struct vlc_tracer *tracer, const char *es_id,
+                       struct vlc_ancillary *ancillary,
+                       enum vlc_latency_stage stage)
+{
+    if (ancillary == NULL)
+        return;
+
+    struct vlc_latency_trail *trail = vlc_ancillary_GetData(ancillary);
+    if (atomic_load_explicit(&trail->stages[stage],
+                             memory_order_relaxed) != VLC_TICK_INVALID)
+        return;
+
+    /* Only the first thread stamping a stage traces it */
+    const vlc_tick_t now = vlc_tick_now();
+    vlc_tick_t expected = VLC_TICK_INVALID;
+    if (!atomic_compare_exchange_strong_explicit(&trail->stages[stage],
+                                                 &expected, now,
+                                                 memory_order_release,
+                                                 memory_order_relaxed))
+        return;
+
+    /* The previous stage is the last one stamped, as audio frames are
+     * neither filtered nor displayed, and the packetizer is optional. */
+    vlc_tick_t previous = now;
+    for (int i = stage - 1; i >= 0; i--)
+    {
+        const vlc_tick_t date = atomic_load_explicit(&trail->stages[i],
+                                                     memory_order_acquire);
+        if (date != VLC_TICK_INVALID)
+        {
+            previous = date;
+            break;
+        }
+    }
+    const vlc_tick_t start =
+        atomic_load_explicit(&trail->stages[VLC_LATENCY_DEMUX],
+                             memory_order_acquire);
+
+    vlc_tracer_TraceWithTs(tracer, now,
+                           VLC_TRACE("type", "LATENCY"),
+                           VLC_TRACE("id", es_id),
+                           VLC_TRACE("frame", (int64_t)trail->id),
+                           VLC_TRACE("stage", stage_names[stage]),
+                           VLC_TRACE_TICK_NS("delay", now - previous),
+                           VLC_TRACE_TICK_NS("total", now - start),
+                           VLC_TRACE_END);
+}
+
+void vlc_latency_queue_Init(struct vlc_latency_queue *queue)
+{
+    vlc_mutex_init(&queue->lock);
+    queue->next = 0;
+    for (size_t i = 0; i < VLC_LATENCY_QUEUE_SIZE; i++)
+        queue->entries[i].trail = NULL;
+}
+
+void vlc_latency_queue_Clear(struct vlc_latency_queue *queue)
+{
+    vlc_mutex_lock(&queue->lock);
+    for (size_t i = 0; i < VLC_LATENCY_QUEUE_SIZE; i++)
+        if (queue->entries[i].trail != NULL)
+        {
+            vlc_ancillary_Release(queue->entries[i].trail);
+            queue->entries[i].trail = NULL;
+        }
+    vlc_mutex_unlock(&queue->lock);
+}
+
+void vlc_latency_queue_Push(struct vlc_latency_queue *queue,
+                            vlc_frame_t *frame)
+{
+    struct vlc_ancillary *trail =
+        vlc_frame_GetAncillary(frame, VLC_ANCILLARY_ID_LATENCY);
+    if (trail == NULL || frame->i_pts == VLC_TICK_INVALID)
+        return;
+
+    vlc_mutex_lock(&queue->lock);
+    /* Overwrite the oldest trail, its output was likely dropped */
+    size_t i = queue->next;
+    if (queue->entries[i].trail != NULL)
+        vlc_ancillary_Release(queue->entries[i].trail);
+    queue->entries[i].pts = frame->i_pts;
+    queue->entries[i].trail = vlc_ancillary_Hold(trail);
+    queue->next = (i + 1) % VLC_LATENCY_QUEUE_SIZE;
+    vlc_mutex_unlock(&queue->lock);
+}
+
+struct vlc_ancillary *vlc_latency_queue_Pop(struct vlc_latency_queue *queue,
+                                            vlc_tick_t pts)
+{
+    struct vlc_ancillary *trail = NULL;
+
+    vlc_mutex_lock(&queue->lock);
+    for (size_t i = 0; i < VLC_LATENCY_QUEUE_SIZE; i++)
+        if (queue->entries[i].trail != NULL && queue->entries[i].pts == pts)
+        {
+            trail = queue->entries[i].trail;
+            queue->entries[i].trail = NULL;
+            break;
+        }
+    vlc_mutex_unlock(&queue->lock);
+    return trail;
+}
@@ -0,0 +1,137 @@
+/*****************************************************************************
+ * latency.h: per frame latency tracing
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_LATENCY_H
+#define VLC_LATENCY_H 1
+
+#include <stdatomic.h>
+
+#include <vlc_common.h>
+#include <vlc_ancillary.h>
+#include <vlc_frame.h>
+#include <vlc_picture.h>
+
+/*
+ * When a tracer is enabled, the frames sent by the demuxer carry a trail
+ * ancillary, forwarded to the packetized frames, then to the decoded
+ * pictures and audio buffers. Each stage of the pipeline stamps the trail
+ * and emits a "LATENCY" trace with the time spent since the previous stage
+ * and since the demuxer, cf. extras/analyser/latency.py.
+ *
+ * The access read time cannot be told apart from the demux time, as the
+ * demuxers read a byte stream and not frames.
+ */
+
+#define VLC_ANCILLARY_ID_LATENCY VLC_ANCILLARY_ID('L','a','t','n')
+
+enum vlc_latency_stage
+{
+    VLC_LATENCY_DEMUX,      /**< sent by the demuxer */
+    VLC_LATENCY_QUEUE,      /**< taken from the decoder queue */
+    VLC_LATENCY_PACKETIZER, /**< output by the packetizer */
+    VLC_LATENCY_DECODE,     /**< output by the decoder */
+    VLC_LATENCY_FILTER,     /**< output by the video filter chains */
+    VLC_LATENCY_PREPARE,    /**< prepared by the display */
+    VLC_LATENCY_DISPLAY,    /**< displayed */
+    VLC_LATENCY_PLAY,       /**< sent to the audio output */
+};
+#define VLC_LATENCY_STAGE_COUNT (VLC_LATENCY_PLAY + 1)
+
+/* The trail of a demuxed frame is shared by all the frames, pictures and
+ * audio buffers coming from it, stamped from the decoder, packetizer and
+ * output threads. */
+struct vlc_latency_trail
+{
+    uint64_t id;
+    _Atomic vlc_tick_t stages[VLC_LATENCY_STAGE_COUNT];
+};
+
+/**
+ * Attach a new trail to a frame sent by a demuxer and stamp it.
+ */
+void vlc_latency_Start(struct vlc_tracer *tracer, const char *es_id,
+                       vlc_frame_t *frame);
+
+/**
+ * Stamp the trail of a frame or picture, if any, and trace the stage.
+ *
+ * A stage is only traced once per trail, as frames can be split or
+ * displayed several times.
+ */
+void vlc_latency_Stamp(struct vlc_tracer *tracer, const char *es_id,
+                       struct vlc_ancillary *trail,
+                       enum vlc_latency_stage stage);
+
+static inline void
+vlc_latency_StampFrame(struct vlc_tracer *tracer, const char *es_id,
+                       vlc_frame_t *frame, enum vlc_latency_stage stage)
+{
+    if (tracer != NULL)
+        vlc_latency_Stamp(tracer, es_id,
+                          vlc_frame_GetAncillary(frame, VLC_ANCILLARY_ID_LATENCY),
+                          stage);
+}
+
+static inline void
+vlc_latency_StampPicture(struct vlc_tracer *tracer, const char *es_id,
+                         const picture_t *pic, enum vlc_latency_stage stage)
+{
+    if (tracer != NULL)
+        vlc_latency_Stamp(tracer, es_id,
+                          picture_GetAncillary(pic, VLC_ANCILLARY_ID_LATENCY),
+                          stage);
+}
+
+/*
+ * Decoders do not forward ancillaries from their input frames to their
+ * output, the decoder owner keeps the trails of the last decoded frames to
+ * attach them to the output matching their timestamp.
+ */
+#define VLC_LATENCY_QUEUE_SIZE 32
+
+struct vlc_latency_queue
+{
+    vlc_mutex_t lock;
+    size_t next;
+    struct
+    {
+        vlc_tick_t pts;
+        struct vlc_ancillary *trail;
+    } entries[VLC_LATENCY_QUEUE_SIZE];
+};
+
+void vlc_latency_queue_Init(struct vlc_latency_queue *queue);
+void vlc_latency_queue_Clear(struct vlc_latency_queue *queue);
+
+/**
+ * Keep the trail of a frame sent to the decoder, if any.
+ */
+void vlc_latency_queue_Push(struct vlc_latency_queue *queue,
+                            vlc_frame_t *frame);
+
+/**
+ * Get the trail of the decoder input matching a decoded timestamp.
+ *
+ * \return a trail reference or NULL
+ */
+struct vlc_ancillary *vlc_latency_queue_Pop(struct vlc_latency_queue *queue,
+                                            vlc_tick_t pts);
+
+#endif /* VLC_LATENCY_H */
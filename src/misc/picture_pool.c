@@ -30,25 +30,52 @@
 #include <stdatomic.h>
 #include <stdbit.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <vlc_common.h>
 #include <vlc_threads.h>
 #include <vlc_picture_pool.h>
 #include <vlc_atomic.h>
+#include <vlc_tick.h>
 #include "picture.h"
 
-#define POOL_MAX (CHAR_BIT * sizeof (unsigned long long))
+#define POOL_MAX 1024
+#define POOL_WORD_BITS (CHAR_BIT * sizeof (unsigned long long))
+#define POOL_WORDS (POOL_MAX / POOL_WORD_BITS)
 
-static_assert ((POOL_MAX & (POOL_MAX - 1)) == 0, "Not a power of two");
+static_assert ((POOL_MAX % POOL_WORD_BITS) == 0, "Not a multiple of a word");
+
+/*
+ * The free and allocated slots are tracked in atomic bitmaps, one bit per
+ * picture. A slot is taken by clearing its free bit with a compare-and-swap,
+ * so that getting a picture never blocks: it only retries when another
+ * thread took a slot from the same word in the meantime.
+ *
+ * picture_pool_Wait() sleeps on a sequence number that is only bumped when a
+ * slot is freed while a thread waits for one.
+ */
+struct picture_pool_slot {
+    picture_pool_t *pool;
+    picture_t *picture;
+};
 
 struct picture_pool_t {
-    vlc_mutex_t lock;
-    vlc_cond_t  wait;
+    atomic_ullong      available[POOL_WORDS];
+    atomic_ullong      allocated[POOL_WORDS];
+    atomic_uint        waiters;
+    atomic_uint        seq;
+
+    /* Statistics */
+    atomic_uint        in_use;
+    atomic_uint        high_water;
+    atomic_uint_least64_t waits;
+    atomic_int_least64_t  wait_time;
 
-    unsigned long long available;
     vlc_atomic_rc_t    refs;
+    video_format_t     fmt; /**< format of lazily allocated pictures */
     unsigned short     picture_count;
-    picture_t  *picture[];
+    unsigned short     words;
+    struct picture_pool_slot slots[];
 };
 
 static void picture_pool_Destroy(picture_pool_t *pool)
@@ -56,72 +83,135 @@ static void picture_pool_Destroy(picture_pool_t *pool)
     if (!vlc_atomic_rc_dec(&pool->refs))
         return;
 
-    aligned_free(pool);
+    video_format_Clean(&pool->fmt);
+    free(pool);
 }
 
 void picture_pool_Release(picture_pool_t *pool)
 {
     for (unsigned i = 0; i < pool->picture_count; i++)
-        picture_Release(pool->picture[i]);
+        if (pool->slots[i].picture != NULL)
+            picture_Release(pool->slots[i].picture);
     picture_pool_Destroy(pool);
 }
 
+/* Marks a slot free again and wakes up the waiting threads, if any. */
+static void picture_pool_PutSlot(picture_pool_t *pool, unsigned offset)
+{
+    unsigned long long bit = 1ULL << (offset % POOL_WORD_BITS);
+
+    /* Before the slot can be taken again, not to overestimate the peak */
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+
+    unsigned long long prev =
+        atomic_fetch_or_explicit(&pool->available[offset / POOL_WORD_BITS],
+                                 bit, memory_order_release);
+    assert(!(prev & bit));
+    (void) prev;
+
+    /* Pairs with the fence of picture_pool_Wait(): either the waiter sees the
+     * free slot, or this sees the waiter. */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add_explicit(&pool->seq, 1, memory_order_relaxed);
+        vlc_atomic_notify_all(&pool->seq);
+    }
+}
+
 static void picture_pool_ReleaseClone(picture_t *clone)
 {
     picture_priv_t *priv = (picture_priv_t *)clone;
-    uintptr_t sys = (uintptr_t)priv->gc.opaque;
-    picture_pool_t *pool = (void *)(sys & ~(POOL_MAX - 1));
-    unsigned offset = sys & (POOL_MAX - 1);
-    picture_t *picture = pool->picture[offset];
-
-    picture_Release(picture);
-
-    vlc_mutex_lock(&pool->lock);
-    assert(!(pool->available & (1ULL << offset)));
-    pool->available |= 1ULL << offset;
-    vlc_cond_signal(&pool->wait);
-    vlc_mutex_unlock(&pool->lock);
+    struct picture_pool_slot *slot = priv->gc.opaque;
+    picture_pool_t *pool = slot->pool;
 
+    picture_Release(slot->picture);
+    picture_pool_PutSlot(pool, slot - pool->slots);
     picture_pool_Destroy(pool);
 }
 
 static picture_t *picture_pool_ClonePicture(picture_pool_t *pool,
                                             unsigned offset)
 {
-    picture_t *picture = pool->picture[offset];
-    uintptr_t sys = ((uintptr_t)pool) + offset;
+    struct picture_pool_slot *slot = &pool->slots[offset];
 
-    picture_t *clone = picture_InternalClone(picture, picture_pool_ReleaseClone,
-                                 (void*)sys);
+    picture_t *clone = picture_InternalClone(slot->picture,
+                                             picture_pool_ReleaseClone, slot);
     if (clone != NULL) {
         assert(!picture_HasChainedPics(clone));
         vlc_atomic_rc_inc(&pool->refs);
     }
+    else
+        picture_pool_PutSlot(pool, offset);
     return clone;
 }
 
-picture_pool_t *picture_pool_New(unsigned count, picture_t *const *tab)
+static picture_pool_t *picture_pool_Alloc(unsigned count)
 {
     if (unlikely(count > POOL_MAX))
         return NULL;
 
-    picture_pool_t *pool;
-    size_t size = sizeof (*pool) + count * sizeof (picture_t *);
-
-    size += (-size) & (POOL_MAX - 1);
-    pool = aligned_alloc(POOL_MAX, size);
+    picture_pool_t *pool =
+        malloc(sizeof (*pool) + count * sizeof (struct picture_pool_slot));
     if (unlikely(pool == NULL))
         return NULL;
 
-    vlc_mutex_init(&pool->lock);
-    vlc_cond_init(&pool->wait);
-    if (count == POOL_MAX)
-        pool->available = ~0ULL;
-    else
-        pool->available = (1ULL << count) - 1;
+    pool->words = (count + POOL_WORD_BITS - 1) / POOL_WORD_BITS;
+    for (unsigned i = 0; i < POOL_WORDS; i++) {
+        unsigned long long mask;
+
+        if (count >= (i + 1) * POOL_WORD_BITS)
+            mask = ~0ULL;
+        else if (count > i * POOL_WORD_BITS)
+            mask = (1ULL << (count % POOL_WORD_BITS)) - 1;
+        else
+            mask = 0;
+        atomic_init(&pool->available[i], mask);
+        atomic_init(&pool->allocated[i], mask);
+    }
+    atomic_init(&pool->waiters, 0);
+    atomic_init(&pool->seq, 0);
+    atomic_init(&pool->in_use, 0);
+    atomic_init(&pool->high_water, 0);
+    atomic_init(&pool->waits, 0);
+    atomic_init(&pool->wait_time, 0);
     vlc_atomic_rc_init(&pool->refs);
+    video_format_Init(&pool->fmt, 0);
     pool->picture_count = count;
-    memcpy(pool->picture, tab, count * sizeof (picture_t *));
+    for (unsigned i = 0; i < count; i++) {
+        pool->slots[i].pool = pool;
+        pool->slots[i].picture = NULL;
+    }
+    return pool;
+}
+
+picture_pool_t *picture_pool_New(unsigned count, picture_t *const *tab)
+{
+    picture_pool_t *pool = picture_pool_Alloc(count);
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    for (unsigned i = 0; i < count; i++)
+        pool->slots[i].picture = tab[i];
+    return pool;
+}
+
+picture_pool_t *picture_pool_NewLazy(const video_format_t *fmt,
+                                     unsigned count)
+{
+    if (count == 0)
+        vlc_assert_unreachable();
+
+    picture_pool_t *pool = picture_pool_Alloc(count);
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    if (video_format_Copy(&pool->fmt, fmt) != VLC_SUCCESS)
+    {
+        free(pool);
+        return NULL;
+    }
+    for (unsigned i = 0; i < pool->words; i++)
+        atomic_init(&pool->allocated[i], 0);
     return pool;
 }
 
@@ -133,7 +223,10 @@ picture_pool_t *picture_pool_NewFromFormat(const video_format_t *fmt,
     if (unlikely(count > POOL_MAX))
         return NULL;
 
-    picture_t *picture[POOL_MAX];
+    picture_t **picture = vlc_alloc(count, sizeof (*picture));
+    if (unlikely(picture == NULL))
+        return NULL;
+
     unsigned i;
 
     for (i = 0; i < count; i++) {
@@ -146,44 +239,136 @@ picture_pool_t *picture_pool_NewFromFormat(const video_format_t *fmt,
     if (!pool)
         goto error;
 
+    free(picture);
     return pool;
 
 error:
     while (i > 0)
         picture_Release(picture[--i]);
+    free(picture);
     return NULL;
 }
 
-picture_t *picture_pool_Get(picture_pool_t *pool)
+/* Takes a free slot from the bitmap, if any. With allocated_only, only the
+ * slots with an allocated picture are considered. */
+static int picture_pool_TakeSlot(picture_pool_t *pool, bool allocated_only)
 {
+    for (unsigned w = 0; w < pool->words; w++) {
+        unsigned long long avail =
+            atomic_load_explicit(&pool->available[w], memory_order_relaxed);
+
+        for (;;) {
+            unsigned long long candidates = avail;
+
+            if (allocated_only)
+                candidates &= atomic_load_explicit(&pool->allocated[w],
+                                                   memory_order_relaxed);
+            if (candidates == 0)
+                break;
+
+            unsigned bit = stdc_trailing_zeros(candidates);
+
+            /* On failure, avail is updated and the word is scanned again. */
+            if (atomic_compare_exchange_weak_explicit(&pool->available[w],
+                                                      &avail,
+                                                      avail & ~(1ULL << bit),
+                                                      memory_order_acquire,
+                                                      memory_order_relaxed))
+                return w * POOL_WORD_BITS + bit;
+        }
+    }
+    return -1;
+}
 
-    vlc_mutex_lock(&pool->lock);
-    assert(vlc_atomic_rc_get(&pool->refs) > 0);
+/* Takes a free picture slot, preferring the already allocated ones. */
+static int picture_pool_Take(picture_pool_t *pool)
+{
+    int offset = picture_pool_TakeSlot(pool, true);
+    if (offset < 0)
+        offset = picture_pool_TakeSlot(pool, false);
+    if (offset < 0)
+        return -1;
+
+    unsigned in_use = atomic_fetch_add_explicit(&pool->in_use, 1,
+                                                memory_order_relaxed) + 1;
+    unsigned high = atomic_load_explicit(&pool->high_water,
+                                         memory_order_relaxed);
+    while (in_use > high
+        && !atomic_compare_exchange_weak_explicit(&pool->high_water, &high,
+                                                  in_use,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed));
+    return offset;
+}
 
-    if (pool->available == 0)
-    {
-        vlc_mutex_unlock(&pool->lock);
-        return NULL;
+static picture_t *picture_pool_GetSlot(picture_pool_t *pool, unsigned offset)
+{
+    atomic_ullong *allocated = &pool->allocated[offset / POOL_WORD_BITS];
+    unsigned long long bit = 1ULL << (offset % POOL_WORD_BITS);
+
+    if (!(atomic_load_explicit(allocated, memory_order_acquire) & bit)) {
+        /* The slot is owned by this thread until it is marked available or
+         * allocated again, so its picture can be created without any lock. */
+        picture_t *picture = picture_NewFromFormat(&pool->fmt);
+        if (unlikely(picture == NULL)) {
+            picture_pool_PutSlot(pool, offset);
+            return NULL;
+        }
+        pool->slots[offset].picture = picture;
+        atomic_fetch_or_explicit(allocated, bit, memory_order_release);
     }
+    return picture_pool_ClonePicture(pool, offset);
+}
+
+picture_t *picture_pool_Get(picture_pool_t *pool)
+{
+    assert(vlc_atomic_rc_get(&pool->refs) > 0);
 
-    int i = stdc_trailing_zeros(pool->available);
-    pool->available &= ~(1ULL << i);
-    vlc_mutex_unlock(&pool->lock);
+    int offset = picture_pool_Take(pool);
+    if (offset < 0)
+        return NULL;
 
-    return picture_pool_ClonePicture(pool, i);
+    return picture_pool_GetSlot(pool, offset);
 }
 
 picture_t *picture_pool_Wait(picture_pool_t *pool)
 {
-    vlc_mutex_lock(&pool->lock);
     assert(vlc_atomic_rc_get(&pool->refs) > 0);
 
-    while (pool->available == 0)
-        vlc_cond_wait(&pool->wait, &pool->lock);
+    int offset = picture_pool_Take(pool);
+    if (offset >= 0)
+        return picture_pool_GetSlot(pool, offset);
 
-    int i = stdc_trailing_zeros(pool->available);
-    pool->available &= ~(1ULL << i);
-    vlc_mutex_unlock(&pool->lock);
+    vlc_tick_t start = vlc_tick_now();
 
-    return picture_pool_ClonePicture(pool, i);
+    for (;;) {
+        unsigned seq = atomic_load_explicit(&pool->seq, memory_order_relaxed);
+
+        atomic_fetch_add_explicit(&pool->waiters, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        offset = picture_pool_Take(pool);
+        if (offset < 0) {
+            atomic_fetch_add_explicit(&pool->waits, 1, memory_order_relaxed);
+            vlc_atomic_wait(&pool->seq, seq);
+        }
+        atomic_fetch_sub_explicit(&pool->waiters, 1, memory_order_relaxed);
+
+        if (offset >= 0)
+            break;
+    }
+
+    atomic_fetch_add_explicit(&pool->wait_time, vlc_tick_now() - start,
+                              memory_order_relaxed);
+    return picture_pool_GetSlot(pool, offset);
+}
+
+void picture_pool_GetStats(picture_pool_t *pool,
+                           struct picture_pool_stats *stats)
+{
+    stats->count = pool->picture_count;
+    stats->high_water = atomic_load_explicit(&pool->high_water,
+                                             memory_order_relaxed);
+    stats->waits = atomic_load_explicit(&pool->waits, memory_order_relaxed);
+    stats->wait_time = atomic_load_explicit(&pool->wait_time,
+                                            memory_order_relaxed);
 }
@@ -1274,6 +1274,33 @@ vlc_player_NextVideoFrame(vlc_player_t *player)
         vlc_player_osd_Message(player, _("Next frame"));
 }
 
+void
+vlc_player_PreviousVideoFrame(vlc_player_t *player)
+{
+    struct vlc_player_input *input = vlc_player_get_input_locked(player);
+    if (!input)
+        return;
+
+    /* Target of the seek if the frame is not cached anymore */
+    vlc_tick_t frame_duration = VLC_TICK_FROM_MS(40);
+    const struct vlc_player_track *track =
+        vlc_player_GetSelectedTrack(player, VIDEO_ES);
+    if (track != NULL && track->fmt.video.i_frame_rate != 0
+     && track->fmt.video.i_frame_rate_base != 0)
+        frame_duration = vlc_tick_from_samples(track->fmt.video.i_frame_rate_base,
+                                               track->fmt.video.i_frame_rate);
+
+    input_control_param_t param = { .time.i_val = VLC_TICK_INVALID };
+    const vlc_tick_t time = vlc_player_GetTime(player);
+    if (time != VLC_TICK_INVALID && time >= frame_duration)
+        param.time.i_val = time - frame_duration;
+
+    int ret = input_ControlPush(input->thread,
+                                INPUT_CONTROL_SET_FRAME_PREVIOUS, &param);
+    if (ret == VLC_SUCCESS)
+        vlc_player_osd_Message(player, _("Previous frame"));
+}
+
 enum vlc_player_state
 vlc_player_GetState(vlc_player_t *player)
 {
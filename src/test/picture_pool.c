@@ -29,8 +29,12 @@
 #include <vlc_common.h>
 #include <vlc_es.h>
 #include <vlc_picture_pool.h>
+#include <vlc_threads.h>
 
 #define PICTURES 10
+#define LARGE_PICTURES 200
+#define THREADS 8
+#define ITERATIONS 1000
 
 const char vlc_module_name[] = "test_picture_pool";
 
@@ -87,6 +91,130 @@ static void test(bool zombie)
             picture_Release(pics[i]);
 }
 
+static void test_lazy(void)
+{
+    picture_t *pics[PICTURES];
+
+    pool = picture_pool_NewLazy(&fmt, PICTURES);
+    assert(pool != NULL);
+
+    /* Only one picture gets allocated while it is recycled. */
+    pics[0] = picture_pool_Get(pool);
+    assert(pics[0] != NULL);
+    void *plane = pics[0]->p[0].p_pixels;
+    assert(plane != NULL);
+    assert(pics[0]->format.i_chroma == fmt.i_chroma);
+    assert(pics[0]->format.i_width == fmt.i_width);
+    picture_Release(pics[0]);
+
+    for (unsigned i = 0; i < PICTURES; i++) {
+        pics[0] = picture_pool_Get(pool);
+        assert(pics[0] != NULL);
+        assert(pics[0]->p[0].p_pixels == plane);
+        picture_Release(pics[0]);
+    }
+
+    /* The pool grows up to its size. */
+    for (unsigned i = 0; i < PICTURES; i++) {
+        pics[i] = picture_pool_Get(pool);
+        assert(pics[i] != NULL);
+        for (unsigned j = 0; j < i; j++)
+            assert(pics[i]->p[0].p_pixels != pics[j]->p[0].p_pixels);
+    }
+    assert(picture_pool_Get(pool) == NULL);
+
+    for (unsigned i = 0; i < PICTURES; i++)
+        picture_Release(pics[i]);
+
+    for (unsigned i = 0; i < PICTURES; i++) {
+        pics[i] = picture_pool_Wait(pool);
+        assert(pics[i] != NULL);
+    }
+
+    picture_pool_Release(pool);
+
+    for (unsigned i = 0; i < PICTURES; i++)
+        picture_Release(pics[i]);
+}
+
+static void test_large(void)
+{
+    static picture_t *pics[LARGE_PICTURES];
+    struct picture_pool_stats stats;
+
+    pool = picture_pool_NewLazy(&fmt, LARGE_PICTURES);
+    assert(pool != NULL);
+
+    for (unsigned i = 0; i < LARGE_PICTURES; i++) {
+        pics[i] = picture_pool_Get(pool);
+        assert(pics[i] != NULL);
+    }
+    assert(picture_pool_Get(pool) == NULL);
+
+    picture_pool_GetStats(pool, &stats);
+    assert(stats.count == LARGE_PICTURES);
+    assert(stats.high_water == LARGE_PICTURES);
+    assert(stats.waits == 0);
+
+    /* A slot of the last word is recycled. */
+    void *plane = pics[LARGE_PICTURES - 1]->p[0].p_pixels;
+    picture_Release(pics[LARGE_PICTURES - 1]);
+    pics[LARGE_PICTURES - 1] = picture_pool_Wait(pool);
+    assert(pics[LARGE_PICTURES - 1] != NULL);
+    assert(pics[LARGE_PICTURES - 1]->p[0].p_pixels == plane);
+
+    for (unsigned i = 0; i < LARGE_PICTURES; i++)
+        picture_Release(pics[i]);
+    picture_pool_Release(pool);
+}
+
+static void *worker(void *data)
+{
+    picture_pool_t *p = data;
+
+    for (unsigned i = 0; i < ITERATIONS; i++) {
+        picture_t *a = picture_pool_Wait(p);
+        picture_t *b = picture_pool_Wait(p);
+        assert(a != NULL && b != NULL);
+        assert(a->p[0].p_pixels != b->p[0].p_pixels);
+        picture_Release(a);
+        picture_Release(b);
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    vlc_thread_t threads[THREADS];
+    struct picture_pool_stats stats;
+
+    /* Fewer pictures than needed by the threads, so that they wait. */
+    pool = picture_pool_NewFromFormat(&fmt, THREADS + 1);
+    assert(pool != NULL);
+
+    for (unsigned i = 0; i < THREADS; i++) {
+        int ret = vlc_clone(&threads[i], worker, pool);
+        assert(ret == 0);
+    }
+    for (unsigned i = 0; i < THREADS; i++)
+        vlc_join(threads[i], NULL);
+
+    picture_pool_GetStats(pool, &stats);
+    assert(stats.high_water <= THREADS + 1);
+
+    /* All the pictures were returned to the pool. */
+    picture_t *pics[THREADS + 1];
+    for (unsigned i = 0; i < THREADS + 1; i++) {
+        pics[i] = picture_pool_Get(pool);
+        assert(pics[i] != NULL);
+    }
+    assert(picture_pool_Get(pool) == NULL);
+    for (unsigned i = 0; i < THREADS + 1; i++)
+        picture_Release(pics[i]);
+
+    picture_pool_Release(pool);
+}
+
 int main(void)
 {
     video_format_Setup(&fmt, VLC_CODEC_I420, 320, 200, 320, 200, 1, 1);
@@ -98,6 +226,9 @@ int main(void)
 
     test(false);
     test(true);
+    test_lazy();
+    test_large();
+    test_threads();
 
     return 0;
 }
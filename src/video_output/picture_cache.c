@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * picture_cache.c: cache of the last decoded pictures
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_list.h>
+#include <vlc_picture.h>
+
+#include "picture_cache.h"
+
+struct vout_picture_cache_entry
+{
+    picture_t *picture;
+    size_t size;
+    struct vlc_list node;
+};
+
+struct vout_picture_cache
+{
+    size_t budget;
+    size_t size;
+    struct vlc_list entries; /* from the oldest to the newest */
+};
+
+vout_picture_cache_t *vout_picture_cache_New(size_t budget)
+{
+    vout_picture_cache_t *cache = malloc(sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    cache->budget = budget;
+    cache->size = 0;
+    vlc_list_init(&cache->entries);
+    return cache;
+}
+
+static void EntryDelete(vout_picture_cache_t *cache,
+                        struct vout_picture_cache_entry *entry)
+{
+    assert(cache->size >= entry->size);
+    cache->size -= entry->size;
+    vlc_list_remove(&entry->node);
+    picture_Release(entry->picture);
+    free(entry);
+}
+
+void vout_picture_cache_Flush(vout_picture_cache_t *cache)
+{
+    struct vout_picture_cache_entry *entry;
+    vlc_list_foreach(entry, &cache->entries, node)
+        EntryDelete(cache, entry);
+    assert(cache->size == 0);
+}
+
+void vout_picture_cache_Delete(vout_picture_cache_t *cache)
+{
+    vout_picture_cache_Flush(cache);
+    free(cache);
+}
+
+void vout_picture_cache_Add(vout_picture_cache_t *cache,
+                            const picture_t *picture)
+{
+    if (picture->date == VLC_TICK_INVALID)
+        return;
+
+    const vlc_chroma_description_t *dsc =
+        vlc_fourcc_GetChromaDescription(picture->format.i_chroma);
+    if (dsc == NULL || dsc->plane_count == 0)
+        return;
+
+    struct vout_picture_cache_entry *last =
+        vlc_list_last_entry_or_null(&cache->entries,
+                                    struct vout_picture_cache_entry, node);
+    if (last != NULL && last->picture->date >= picture->date)
+        vout_picture_cache_Flush(cache);
+
+    struct vout_picture_cache_entry *entry = malloc(sizeof (*entry));
+    if (unlikely(entry == NULL))
+        return;
+
+    entry->picture = picture_NewFromFormat(&picture->format);
+    if (unlikely(entry->picture == NULL))
+    {
+        free(entry);
+        return;
+    }
+    picture_Copy(entry->picture, picture);
+
+    entry->size = 0;
+    for (int i = 0; i < entry->picture->i_planes; i++)
+        entry->size += (size_t)entry->picture->p[i].i_pitch
+                     * entry->picture->p[i].i_lines;
+
+    vlc_list_append(&entry->node, &cache->entries);
+    cache->size += entry->size;
+
+    /* Evict the oldest pictures */
+    struct vout_picture_cache_entry *oldest;
+    vlc_list_foreach(oldest, &cache->entries, node)
+    {
+        if (cache->size <= cache->budget)
+            break;
+        EntryDelete(cache, oldest);
+    }
+}
+
+picture_t *vout_picture_cache_GetBefore(vout_picture_cache_t *cache,
+                                        vlc_tick_t date)
+{
+    struct vout_picture_cache_entry *entry;
+    vlc_list_reverse_foreach(entry, &cache->entries, node)
+        if (entry->picture->date < date)
+            return picture_Hold(entry->picture);
+    return NULL;
+}
+
+picture_t *vout_picture_cache_GetAfter(vout_picture_cache_t *cache,
+                                       vlc_tick_t date)
+{
+    struct vout_picture_cache_entry *last =
+        vlc_list_last_entry_or_null(&cache->entries,
+                                    struct vout_picture_cache_entry, node);
+    /* Fast path: not replaying the cached pictures */
+    if (last == NULL || last->picture->date <= date)
+        return NULL;
+
+    struct vout_picture_cache_entry *entry;
+    vlc_list_foreach(entry, &cache->entries, node)
+        if (entry->picture->date > date)
+            return picture_Hold(entry->picture);
+    vlc_assert_unreachable();
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * picture_cache.h: cache of the last decoded pictures
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_VOUT_PICTURE_CACHE_H
+#define LIBVLC_VOUT_PICTURE_CACHE_H
+
+#include <vlc_picture.h>
+
+/*
+ * The video output keeps copies of the last decoded pictures, within a
+ * memory budget, so that stepping backward and replaying them forward again
+ * does not need to seek and decode the group of pictures again.
+ *
+ * The pictures are ordered by date. Pictures with an opaque chroma are not
+ * cached, as they cannot be copied and their pools are small.
+ */
+typedef struct vout_picture_cache vout_picture_cache_t;
+
+/**
+ * Create a cache
+ *
+ * \param budget maximal size of the cached pictures in bytes
+ */
+vout_picture_cache_t *vout_picture_cache_New(size_t budget);
+void vout_picture_cache_Delete(vout_picture_cache_t *);
+
+void vout_picture_cache_Flush(vout_picture_cache_t *);
+
+/**
+ * Cache a copy of a decoded picture, evicting the oldest ones if needed.
+ *
+ * A picture not newer than the cached ones is a discontinuity, and flushes
+ * the cache.
+ */
+void vout_picture_cache_Add(vout_picture_cache_t *, const picture_t *);
+
+/**
+ * Get the newest cached picture older than a date
+ *
+ * \return a picture reference or NULL
+ */
+picture_t *vout_picture_cache_GetBefore(vout_picture_cache_t *,
+                                        vlc_tick_t date);
+
+/**
+ * Get the oldest cached picture newer than a date
+ *
+ * \return a picture reference or NULL
+ */
+picture_t *vout_picture_cache_GetAfter(vout_picture_cache_t *,
+                                       vlc_tick_t date);
+
+#endif
@@ -24,6 +24,17 @@
 # define LIBVLC_VOUT_STATISTIC_H
 # include <stdatomic.h>
 
+/* Stages of the rendering of a picture, timed separately */
+enum vout_statistic_stage
+{
+    VOUT_STAGE_STATIC_FILTER,       /**< static filters (deinterlacing) */
+    VOUT_STAGE_INTERACTIVE_FILTER,  /**< user video filters */
+    VOUT_STAGE_BLEND,   /**< subpicture rendering, blending and conversion */
+    VOUT_STAGE_PREPARE, /**< display prepare */
+    VOUT_STAGE_DISPLAY, /**< display */
+};
+#define VOUT_STAGE_COUNT (VOUT_STAGE_DISPLAY + 1)
+
 /* NOTE: Both statistics are atomic on their own, so one might be older than
  * the other one. Currently, only one of them is updated at a time, so this
  * is a non-issue. */
@@ -31,6 +42,11 @@ typedef struct {
     atomic_uint displayed;
     atomic_uint lost;
     atomic_uint late;
+
+    struct {
+        atomic_uint_least64_t time; /* total, in ticks */
+        atomic_uint count;
+    } stages[VOUT_STAGE_COUNT];
 } vout_statistic_t;
 
 static inline void vout_statistic_Init(vout_statistic_t *stat)
@@ -38,6 +54,11 @@ static inline void vout_statistic_Init(vout_statistic_t *stat)
     atomic_init(&stat->displayed, 0);
     atomic_init(&stat->lost, 0);
     atomic_init(&stat->late, 0);
+    for (int i = 0; i < VOUT_STAGE_COUNT; i++)
+    {
+        atomic_init(&stat->stages[i].time, 0);
+        atomic_init(&stat->stages[i].count, 0);
+    }
 }
 
 static inline void vout_statistic_Clean(vout_statistic_t *stat)
@@ -73,4 +94,27 @@ static inline void vout_statistic_AddLate(vout_statistic_t *stat, int late)
     atomic_fetch_add_explicit(&stat->late, late, memory_order_relaxed);
 }
 
+static inline void vout_statistic_AddStage(vout_statistic_t *stat,
+                                           enum vout_statistic_stage stage,
+                                           vlc_tick_t duration)
+{
+    atomic_fetch_add_explicit(&stat->stages[stage].time, duration,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat->stages[stage].count, 1,
+                              memory_order_relaxed);
+}
+
+/* Average time spent in a stage, 0 if it was never run */
+static inline vlc_tick_t
+vout_statistic_GetStageAverage(vout_statistic_t *stat,
+                               enum vout_statistic_stage stage)
+{
+    unsigned count = atomic_load_explicit(&stat->stages[stage].count,
+                                          memory_order_relaxed);
+    if (count == 0)
+        return 0;
+    return atomic_load_explicit(&stat->stages[stage].time,
+                                memory_order_relaxed) / count;
+}
+
 #endif
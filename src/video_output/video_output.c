@@ -52,15 +52,19 @@
 #include <vlc_codec.h>
 #include <vlc_tracer.h>
 #include <vlc_atomic.h>
+#include <vlc_list.h>
 
 #include <libvlc.h>
 #include "vout_private.h"
 #include "vout_internal.h"
 #include "display.h"
+#include "picture_cache.h"
 #include "snapshot.h"
 #include "video_window.h"
 #include "../misc/variables.h"
 #include "../misc/threads.h"
+#include "../misc/latency.h"
+#include "../misc/histogram.h"
 #include "../clock/clock.h"
 #include "statistic.h"
 #include "chrono.h"
@@ -78,6 +82,7 @@ typedef struct vout_thread_sys_t
     char            *splitter_name;
 
     const char      *str_id;
+    struct vlc_histogram *histograms;
 
     vlc_mutex_t clock_lock;
     bool clock_nowait; /* protected by vlc_clock_Lock()/vlc_clock_Unlock() */
@@ -162,6 +167,29 @@ typedef struct vout_thread_sys_t
     } filter;
 
     picture_fifo_t  *decoder_fifo;
+
+    /* Copies of the last decoded pictures, to step backward */
+    vout_picture_cache_t *picture_cache;
+    picture_t       *frame_previous; /* cached picture to step back to */
+
+    /* Pictures filtered ahead of their display date */
+    struct {
+        unsigned        depth; /* 0 if disabled */
+        vlc_thread_t    thread;
+        vlc_mutex_t     lock;
+        vlc_cond_t      wait;
+        bool            stop;
+        bool            filtering;
+        struct vlc_list queue; /* struct vout_ahead_entry, in display order */
+        unsigned        count;
+        picture_t       *pending; /* changing the filters, for the vout thread */
+        bool            blocked; /* until the vout thread handled pending */
+
+        /* Interactive filters output of the current picture, vout thread */
+        picture_t       *source;
+        picture_t       *filtered;
+    } ahead;
+
     struct {
         vout_chrono_t static_filter;
         vout_chrono_t render;         /**< picture render time estimator */
@@ -182,6 +210,9 @@ typedef struct vout_thread_sys_t
  * 3 for interactive+static filters, 1 for SPU blending, 1 for currently displayed */
 #define FILTER_POOL_SIZE  (3+1+1)
 
+/* The pictures filtered ahead hold up to one more picture for each chain */
+#define VOUT_PRIVATE_POOL_SIZE(sys) (FILTER_POOL_SIZE + 2 * (sys)->ahead.depth)
+
 /* Maximum delay between 2 displayed pictures.
  * XXX it is needed for now but should be removed in the long term.
  */
@@ -276,14 +307,39 @@ void vout_GetResetStatistic(vout_thread_t *vout, unsigned *restrict displayed,
     vout_statistic_GetReset( &sys->statistic, displayed, lost, late );
 }
 
+/* Account the time spent in a rendering stage, also in the histograms of the
+ * input statistics */
+static void vout_AddStage(vout_thread_sys_t *sys,
+                          enum vout_statistic_stage stage, vlc_tick_t duration)
+{
+    static const enum input_stats_histogram_type types[VOUT_STAGE_COUNT] = {
+        [VOUT_STAGE_STATIC_FILTER] = INPUT_STATS_STATIC_FILTER_TIME,
+        [VOUT_STAGE_INTERACTIVE_FILTER] = INPUT_STATS_INTERACTIVE_FILTER_TIME,
+        [VOUT_STAGE_BLEND] = INPUT_STATS_BLEND_TIME,
+        [VOUT_STAGE_PREPARE] = INPUT_STATS_PREPARE_TIME,
+        [VOUT_STAGE_DISPLAY] = INPUT_STATS_DISPLAY_TIME,
+    };
+
+    vout_statistic_AddStage(&sys->statistic, stage, duration);
+    if (sys->histograms != NULL)
+        vlc_histogram_Add(&sys->histograms[types[stage]], duration);
+}
+
 bool vout_IsEmpty(vout_thread_t *vout)
 {
     vout_thread_sys_t *sys = VOUT_THREAD_TO_SYS(vout);
     assert(!sys->dummy);
     if (!sys->decoder_fifo)
         return true;
+    if (sys->ahead.depth == 0)
+        return picture_fifo_IsEmpty(sys->decoder_fifo);
 
-    return picture_fifo_IsEmpty(sys->decoder_fifo);
+    vlc_mutex_lock(&sys->ahead.lock);
+    bool empty = picture_fifo_IsEmpty(sys->decoder_fifo) &&
+                 vlc_list_is_empty(&sys->ahead.queue) &&
+                 sys->ahead.pending == NULL && !sys->ahead.filtering;
+    vlc_mutex_unlock(&sys->ahead.lock);
+    return empty;
 }
 
 void vout_DisplayTitle(vout_thread_t *vout, const char *title)
@@ -395,7 +451,14 @@ void vout_PutPicture(vout_thread_t *vout, picture_t *picture)
     assert(!sys->dummy);
     assert( !picture_HasChainedPics( picture ) );
     picture_fifo_Push(sys->decoder_fifo, picture);
-    vout_control_Wake(&sys->control);
+    if (sys->ahead.depth > 0)
+    {
+        vlc_mutex_lock(&sys->ahead.lock);
+        vlc_cond_signal(&sys->ahead.wait);
+        vlc_mutex_unlock(&sys->ahead.lock);
+    }
+    else
+        vout_control_Wake(&sys->control);
 }
 
 /* */
@@ -893,7 +956,7 @@ static void ChangeFilters(vout_thread_sys_t *vout)
         {
             picture_pool_t *new_private_pool =
                     picture_pool_NewFromFormat(&p_fmt_current->video,
-                                               FILTER_POOL_SIZE);
+                                               VOUT_PRIVATE_POOL_SIZE(sys));
             if (new_private_pool != NULL)
             {
                 msg_Dbg(&vout->obj, "Changing vout format to %4.4s",
@@ -961,6 +1024,279 @@ static bool IsPictureLate(vout_thread_sys_t *vout, picture_t *decoded,
     return false;
 }
 
+/*****************************************************************************
+ * Render ahead
+ *
+ * The render-ahead thread runs the decoded pictures through both filter
+ * chains up to "vout-render-ahead" pictures ahead of their display, so that
+ * heavy filters run in parallel with the rendering of the previous pictures.
+ * The vout thread only blends the subpictures and prepares the display.
+ *
+ * A picture changing the source format is left to the vout thread, as the
+ * filters must be changed along with the display.
+ *****************************************************************************/
+struct vout_ahead_entry
+{
+    picture_t *decoded;  /* before the static filters */
+    picture_t *current;  /* after the static filters */
+    picture_t *filtered; /* after the interactive filters, or NULL */
+    struct vlc_list node;
+};
+
+static void AheadEntryDelete(struct vout_ahead_entry *entry)
+{
+    picture_Release(entry->decoded);
+    picture_Release(entry->current);
+    if (entry->filtered != NULL)
+        picture_Release(entry->filtered);
+    free(entry);
+}
+
+static void ReleaseAheadFiltered(vout_thread_sys_t *sys)
+{
+    if (sys->ahead.filtered != NULL)
+    {
+        picture_Release(sys->ahead.filtered);
+        sys->ahead.filtered = NULL;
+    }
+    if (sys->ahead.source != NULL)
+    {
+        picture_Release(sys->ahead.source);
+        sys->ahead.source = NULL;
+    }
+}
+
+static void RenderAheadPicture(vout_thread_sys_t *sys)
+{
+    struct vlc_tracer *tracer = GetTracer(sys);
+
+    vlc_mutex_lock(&sys->filter.lock);
+
+    vlc_mutex_lock(&sys->ahead.lock);
+    picture_t *decoded = picture_fifo_Pop(sys->decoder_fifo);
+    bool pending = false;
+    if (decoded != NULL &&
+        !VideoFormatIsCropArEqual(&decoded->format, &sys->filter.src_fmt))
+    {
+        sys->ahead.pending = decoded;
+        sys->ahead.blocked = true;
+        decoded = NULL;
+        pending = true;
+    }
+    sys->ahead.filtering = decoded != NULL;
+    vlc_mutex_unlock(&sys->ahead.lock);
+
+    if (decoded == NULL)
+    {
+        vlc_mutex_unlock(&sys->filter.lock);
+        if (pending)
+            vout_control_Wake(&sys->control);
+        return;
+    }
+
+    vlc_tick_t start = vlc_tick_now();
+    picture_t *current = filter_chain_VideoFilter(sys->filter.chain_static,
+                                                  picture_Hold(decoded));
+    vout_AddStage(sys, VOUT_STAGE_STATIC_FILTER, vlc_tick_now() - start);
+
+    while (current != NULL)
+    {
+        start = vlc_tick_now();
+        picture_t *filtered =
+            filter_chain_VideoFilter(sys->filter.chain_interactive,
+                                     picture_Hold(current));
+        vout_AddStage(sys, VOUT_STAGE_INTERACTIVE_FILTER,
+                      vlc_tick_now() - start);
+        if (filtered != NULL)
+            vlc_latency_StampPicture(tracer, sys->str_id, filtered,
+                                     VLC_LATENCY_FILTER);
+
+        struct vout_ahead_entry *entry = malloc(sizeof (*entry));
+        if (likely(entry != NULL))
+        {
+            entry->decoded = picture_Hold(decoded);
+            entry->current = current;
+            entry->filtered = filtered;
+
+            vlc_mutex_lock(&sys->ahead.lock);
+            vlc_list_append(&entry->node, &sys->ahead.queue);
+            sys->ahead.count++;
+            vlc_mutex_unlock(&sys->ahead.lock);
+            vout_control_Wake(&sys->control);
+        }
+        else
+        {
+            picture_Release(current);
+            if (filtered != NULL)
+                picture_Release(filtered);
+        }
+
+        current = filter_chain_VideoFilter(sys->filter.chain_static, NULL);
+    }
+    picture_Release(decoded);
+
+    vlc_mutex_lock(&sys->ahead.lock);
+    sys->ahead.filtering = false;
+    vlc_mutex_unlock(&sys->ahead.lock);
+
+    vlc_mutex_unlock(&sys->filter.lock);
+}
+
+static void *RenderAheadThread(void *data)
+{
+    vout_thread_sys_t *sys = data;
+
+    vlc_thread_set_name("vlc-vout-ahead");
+
+    vlc_mutex_lock(&sys->ahead.lock);
+    while (!sys->ahead.stop)
+    {
+        if (sys->ahead.count >= sys->ahead.depth || sys->ahead.blocked ||
+            picture_fifo_IsEmpty(sys->decoder_fifo))
+        {
+            vlc_cond_wait(&sys->ahead.wait, &sys->ahead.lock);
+            continue;
+        }
+        vlc_mutex_unlock(&sys->ahead.lock);
+
+        RenderAheadPicture(sys);
+
+        vlc_mutex_lock(&sys->ahead.lock);
+    }
+    vlc_mutex_unlock(&sys->ahead.lock);
+    return NULL;
+}
+
+/**
+ * Take the next picture filtered ahead
+ *
+ * \param blocked set if the next picture must be handled by the vout thread
+ * \return the picture output by the static filters, or NULL
+ */
+static picture_t *TakeAheadPicture(vout_thread_sys_t *sys,
+                                   bool is_late_dropped, bool *blocked)
+{
+    vlc_mutex_lock(&sys->ahead.lock);
+    for (;;)
+    {
+        struct vout_ahead_entry *entry =
+            vlc_list_first_entry_or_null(&sys->ahead.queue,
+                                         struct vout_ahead_entry, node);
+        if (entry == NULL)
+            break;
+
+        vlc_list_remove(&entry->node);
+        sys->ahead.count--;
+        vlc_cond_signal(&sys->ahead.wait);
+        vlc_mutex_unlock(&sys->ahead.lock);
+
+        if (is_late_dropped && !entry->decoded->b_force)
+        {
+            const vlc_tick_t system_now = vlc_tick_now();
+            vlc_clock_Lock(sys->clock);
+            const vlc_tick_t system_pts =
+                vlc_clock_ConvertToSystem(sys->clock, system_now,
+                                          entry->current->date, sys->rate);
+            vlc_clock_Unlock(sys->clock);
+
+            if (IsPictureLate(sys, entry->current, system_now, system_pts))
+            {
+                AheadEntryDelete(entry);
+                vout_statistic_AddLost(&sys->statistic, 1);
+                vlc_mutex_lock(&sys->ahead.lock);
+                continue;
+            }
+        }
+
+        /* The deinterlacers output several pictures per decoded one */
+        if (entry->decoded != sys->displayed.decoded)
+        {
+            if (sys->picture_cache != NULL)
+                vout_picture_cache_Add(sys->picture_cache, entry->decoded);
+
+            if (sys->displayed.decoded)
+                picture_Release(sys->displayed.decoded);
+            sys->displayed.decoded       = picture_Hold(entry->decoded);
+            sys->displayed.timestamp     = entry->decoded->date;
+            sys->displayed.is_interlaced = !entry->decoded->b_progressive;
+        }
+
+        picture_t *current = entry->current;
+        ReleaseAheadFiltered(sys);
+        if (entry->filtered != NULL)
+        {
+            sys->ahead.source = picture_Hold(current);
+            sys->ahead.filtered = entry->filtered;
+        }
+        picture_Release(entry->decoded);
+        free(entry);
+        *blocked = false;
+        return current;
+    }
+    *blocked = sys->ahead.blocked;
+    vlc_mutex_unlock(&sys->ahead.lock);
+    return NULL;
+}
+
+/* Take the picture left to the vout thread, once the queue is drained */
+static picture_t *TakeAheadPending(vout_thread_sys_t *sys)
+{
+    vlc_mutex_lock(&sys->ahead.lock);
+    picture_t *decoded = NULL;
+    if (vlc_list_is_empty(&sys->ahead.queue))
+    {
+        decoded = sys->ahead.pending;
+        sys->ahead.pending = NULL;
+        if (decoded == NULL && sys->ahead.blocked)
+        {
+            /* The static filters are drained, resume filtering ahead */
+            sys->ahead.blocked = false;
+            vlc_cond_signal(&sys->ahead.wait);
+        }
+    }
+    vlc_mutex_unlock(&sys->ahead.lock);
+    return decoded;
+}
+
+static void FlushAhead(vout_thread_sys_t *sys, bool below, vlc_tick_t date)
+{
+    ReleaseAheadFiltered(sys);
+
+    /* Wait for the picture being filtered */
+    vlc_mutex_lock(&sys->filter.lock);
+    vlc_mutex_lock(&sys->ahead.lock);
+
+    struct vout_ahead_entry *entry;
+    vlc_list_foreach(entry, &sys->ahead.queue, node)
+    {
+        const vlc_tick_t pic_date = entry->decoded->date;
+        if (date == VLC_TICK_INVALID ||
+            ( below && pic_date <= date) ||
+            (!below && pic_date >= date))
+        {
+            vlc_list_remove(&entry->node);
+            sys->ahead.count--;
+            AheadEntryDelete(entry);
+        }
+    }
+
+    picture_t *pending = sys->ahead.pending;
+    if (pending != NULL &&
+        (date == VLC_TICK_INVALID ||
+         ( below && pending->date <= date) ||
+         (!below && pending->date >= date)))
+    {
+        picture_Release(pending);
+        sys->ahead.pending = NULL;
+    }
+    /* The static filters were flushed too */
+    sys->ahead.blocked = sys->ahead.pending != NULL;
+    vlc_cond_signal(&sys->ahead.wait);
+
+    vlc_mutex_unlock(&sys->ahead.lock);
+    vlc_mutex_unlock(&sys->filter.lock);
+}
+
 /* */
 VLC_USED
 static picture_t *PreparePicture(vout_thread_sys_t *vout, bool reuse_decoded,
@@ -968,18 +1304,54 @@ static picture_t *PreparePicture(vout_thread_sys_t *vout, bool reuse_decoded,
 {
     vout_thread_sys_t *sys = vout;
     bool is_late_dropped = sys->is_late_dropped && !frame_by_frame;
+    const bool ahead = sys->ahead.depth > 0;
+
+    if (ahead && !(reuse_decoded && sys->displayed.decoded != NULL))
+    {
+        /* Replay the cached pictures from the vout thread */
+        picture_t *cached = NULL;
+        if (sys->picture_cache != NULL &&
+            sys->displayed.timestamp != VLC_TICK_INVALID)
+            cached = vout_picture_cache_GetAfter(sys->picture_cache,
+                                                 sys->displayed.timestamp);
+        if (cached != NULL)
+            picture_Release(cached);
+        else
+        {
+            bool blocked;
+            picture_t *picture = TakeAheadPicture(sys, is_late_dropped,
+                                                  &blocked);
+            if (picture != NULL || !blocked)
+                return picture;
+        }
+    }
 
     vlc_mutex_lock(&sys->filter.lock);
 
     picture_t *picture = filter_chain_VideoFilter(sys->filter.chain_static, NULL);
     assert(!reuse_decoded || !picture);
 
+    vlc_tick_t replay_date = sys->displayed.timestamp;
     while (!picture) {
         picture_t *decoded;
+        bool cached = false;
         if (unlikely(reuse_decoded && sys->displayed.decoded)) {
             decoded = picture_Hold(sys->displayed.decoded);
         } else {
-            decoded = picture_fifo_Pop(sys->decoder_fifo);
+            /* Replay the cached pictures after stepping backward */
+            decoded = NULL;
+            if (sys->picture_cache != NULL && replay_date != VLC_TICK_INVALID)
+                decoded = vout_picture_cache_GetAfter(sys->picture_cache,
+                                                      replay_date);
+            if (decoded != NULL)
+            {
+                cached = true;
+                replay_date = decoded->date;
+            }
+            else if (ahead)
+                decoded = TakeAheadPending(sys);
+            else
+                decoded = picture_fifo_Pop(sys->decoder_fifo);
 
             if (decoded) {
                 if (is_late_dropped && !decoded->b_force)
@@ -1016,6 +1388,9 @@ static picture_t *PreparePicture(vout_thread_sys_t *vout, bool reuse_decoded,
 
                     ChangeFilters(vout);
                 }
+
+                if (sys->picture_cache != NULL && !cached)
+                    vout_picture_cache_Add(sys->picture_cache, decoded);
             }
         }
 
@@ -1032,11 +1407,19 @@ static picture_t *PreparePicture(vout_thread_sys_t *vout, bool reuse_decoded,
 
         vout_chrono_Start(&sys->chrono.static_filter);
         picture = filter_chain_VideoFilter(sys->filter.chain_static, sys->displayed.decoded);
-        vout_chrono_Stop(&sys->chrono.static_filter);
+        vout_AddStage(sys, VOUT_STAGE_STATIC_FILTER,
+                      vout_chrono_Stop(&sys->chrono.static_filter));
     }
 
     vlc_mutex_unlock(&sys->filter.lock);
 
+    if (picture == NULL && ahead)
+    {
+        /* Back from the cached pictures or from a format change */
+        bool blocked;
+        picture = TakeAheadPicture(sys, is_late_dropped, &blocked);
+    }
+
     return picture;
 }
 
@@ -1105,11 +1488,27 @@ static picture_t *ConvertRGBAAndBlend(vout_thread_sys_t *vout, picture_t *pic,
 
 static picture_t *FilterPictureInteractive(vout_thread_sys_t *sys)
 {
+    if (sys->ahead.filtered != NULL)
+    {
+        /* First rendering of a picture filtered ahead */
+        picture_t *filtered = NULL;
+        if (sys->ahead.source == sys->displayed.current)
+        {
+            filtered = sys->ahead.filtered;
+            sys->ahead.filtered = NULL;
+        }
+        ReleaseAheadFiltered(sys);
+        if (filtered != NULL)
+            return filtered;
+    }
+
     // hold it as the filter chain will release it or return it and we release it
     picture_Hold(sys->displayed.current);
 
     vlc_mutex_lock(&sys->filter.lock);
+    const vlc_tick_t start = vlc_tick_now();
     picture_t *filtered = filter_chain_VideoFilter(sys->filter.chain_interactive, sys->displayed.current);
+    vout_AddStage(sys, VOUT_STAGE_INTERACTIVE_FILTER, vlc_tick_now() - start);
     vlc_mutex_unlock(&sys->filter.lock);
 
     if (filtered && filtered->date != sys->displayed.current->date)
@@ -1307,6 +1706,10 @@ static int RenderPicture(vout_thread_sys_t *sys, bool render_now)
     if (!filtered)
         return VLC_EGENERIC;
 
+    struct vlc_tracer *tracer = GetTracer(sys);
+    vlc_latency_StampPicture(tracer, sys->str_id, filtered,
+                             VLC_LATENCY_FILTER);
+
     vlc_clock_Lock(sys->clock);
     sys->clock_nowait = false;
     vlc_clock_Unlock(sys->clock);
@@ -1314,12 +1717,14 @@ static int RenderPicture(vout_thread_sys_t *sys, bool render_now)
 
     picture_t *todisplay;
     vlc_render_subpicture *subpic;
+    vlc_tick_t start = vlc_tick_now();
     int ret = PrerenderPicture(sys, filtered, &todisplay, &subpic);
     if (ret != VLC_SUCCESS)
     {
         vlc_queuedmutex_unlock(&sys->display_lock);
         return ret;
     }
+    vout_AddStage(sys, VOUT_STAGE_BLEND, vlc_tick_now() - start);
 
     vlc_tick_t system_now = vlc_tick_now();
     const vlc_tick_t pts = todisplay->date;
@@ -1332,15 +1737,27 @@ static int RenderPicture(vout_thread_sys_t *sys, bool render_now)
     const unsigned frame_rate_base = todisplay->format.i_frame_rate_base;
 
     if (vd->ops->prepare != NULL)
+    {
+        start = vlc_tick_now();
         vd->ops->prepare(vd, todisplay, subpic, system_pts);
+        vout_AddStage(sys, VOUT_STAGE_PREPARE, vlc_tick_now() - start);
+    }
 
-    vout_chrono_Stop(&sys->chrono.render);
+    const vlc_tick_t render_time = vout_chrono_Stop(&sys->chrono.render);
+    if (sys->histograms != NULL)
+        vlc_histogram_Add(&sys->histograms[INPUT_STATS_RENDER_TIME],
+                          render_time);
+
+    vlc_latency_StampPicture(tracer, sys->str_id, todisplay,
+                             VLC_LATENCY_PREPARE);
 
-    struct vlc_tracer *tracer = GetTracer(sys);
     system_now = vlc_tick_now();
     if (!render_now)
     {
         const vlc_tick_t late = system_now - system_pts;
+        if (sys->histograms != NULL)
+            vlc_histogram_Add(&sys->histograms[INPUT_STATS_DISPLAY_LATE],
+                              late);
         if (unlikely(late > 0))
         {
             if (tracer != NULL)
@@ -1397,7 +1814,11 @@ static int RenderPicture(vout_thread_sys_t *sys, bool render_now)
     }
 
     /* Display the direct buffer returned by vout_RenderPicture */
+    start = vlc_tick_now();
     vout_display_Display(vd, todisplay);
+    vout_AddStage(sys, VOUT_STAGE_DISPLAY, vlc_tick_now() - start);
+    vlc_latency_StampPicture(tracer, sys->str_id, todisplay,
+                             VLC_LATENCY_DISPLAY);
     vlc_clock_Lock(sys->clock);
     vlc_tick_t drift = vlc_clock_UpdateVideo(sys->clock,
                                              vlc_tick_now(),
@@ -1455,10 +1876,54 @@ static int DisplayNextFrame(vout_thread_sys_t *sys)
     return RenderPicture(sys, true);
 }
 
+static int DisplayPreviousFrame(vout_thread_sys_t *sys)
+{
+    picture_t *previous = sys->frame_previous;
+    sys->frame_previous = NULL;
+
+    UpdateDeinterlaceFilter(sys);
+
+    vlc_mutex_lock(&sys->filter.lock);
+    if (!video_format_IsSimilar(&previous->format, &sys->filter.src_fmt))
+    {
+        vlc_mutex_unlock(&sys->filter.lock);
+        picture_Release(previous);
+        return VLC_EGENERIC;
+    }
+
+    /* Going backward is a discontinuity for the filters */
+    filter_chain_VideoFlush(sys->filter.chain_static);
+
+    if (sys->displayed.decoded)
+        picture_Release(sys->displayed.decoded);
+    sys->displayed.decoded       = picture_Hold(previous);
+    sys->displayed.timestamp     = previous->date;
+    sys->displayed.is_interlaced = !previous->b_progressive;
+
+    picture_t *next = filter_chain_VideoFilter(sys->filter.chain_static,
+                                               previous);
+    vlc_mutex_unlock(&sys->filter.lock);
+
+    if (next == NULL)
+        return VLC_EGENERIC;
+
+    if (likely(sys->displayed.current != NULL))
+        picture_Release(sys->displayed.current);
+    sys->displayed.current = next;
+
+    return RenderPicture(sys, true);
+}
+
 static bool UpdateCurrentPicture(vout_thread_sys_t *sys)
 {
     assert(sys->clock);
 
+    if (sys->frame_previous != NULL)
+    {
+        DisplayPreviousFrame(sys);
+        return false;
+    }
+
     if (sys->frame_next_count > 0)
     {
         if (DisplayNextFrame(sys) == VLC_SUCCESS)
@@ -1605,6 +2070,16 @@ static void vout_FlushUnlocked(vout_thread_sys_t *vout, bool below,
     }
 
     picture_fifo_Flush(sys->decoder_fifo, date, below);
+    if (sys->ahead.depth > 0)
+        FlushAhead(sys, below, date);
+
+    if (sys->frame_previous != NULL)
+    {
+        picture_Release(sys->frame_previous);
+        sys->frame_previous = NULL;
+    }
+    if (sys->picture_cache != NULL)
+        vout_picture_cache_Flush(sys->picture_cache);
 
     vlc_queuedmutex_lock(&sys->display_lock);
     if (sys->display != NULL)
@@ -1648,6 +2123,34 @@ void vout_NextPicture(vout_thread_t *vout)
     vout_control_ReleaseAndWake(&sys->control);
 }
 
+int vout_PreviousPicture(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = VOUT_THREAD_TO_SYS(vout);
+    assert(!sys->dummy);
+    int ret = VLC_EGENERIC;
+
+    vout_control_Hold(&sys->control);
+
+    /* Step back from the previous step if it is not displayed yet */
+    vlc_tick_t date = sys->frame_previous != NULL ?
+                      sys->frame_previous->date : sys->displayed.timestamp;
+    if (sys->picture_cache != NULL && date != VLC_TICK_INVALID)
+    {
+        picture_t *previous =
+            vout_picture_cache_GetBefore(sys->picture_cache, date);
+        if (previous != NULL)
+        {
+            if (sys->frame_previous != NULL)
+                picture_Release(sys->frame_previous);
+            sys->frame_previous = previous;
+            ret = VLC_SUCCESS;
+        }
+    }
+
+    vout_control_ReleaseAndWake(&sys->control);
+    return ret;
+}
+
 void vout_ChangeDelay(vout_thread_t *vout, vlc_tick_t delay)
 {
     vout_thread_sys_t *sys = VOUT_THREAD_TO_SYS(vout);
@@ -1704,6 +2207,26 @@ static int vout_Start(vout_thread_sys_t *vout, vlc_video_context *vctx, const vo
     sys->decoder_fifo = picture_fifo_New();
     sys->private_pool = NULL;
 
+    sys->picture_cache = NULL;
+    sys->frame_previous = NULL;
+    const size_t cache_budget =
+        var_InheritInteger(&vout->obj, "vout-frame-cache") * 1024 * 1024;
+    if (cache_budget > 0)
+    {
+        sys->picture_cache = vout_picture_cache_New(cache_budget);
+        if (sys->picture_cache == NULL)
+            msg_Warn(&vout->obj, "cannot create the picture cache");
+    }
+
+    sys->ahead.depth = var_InheritInteger(&vout->obj, "vout-render-ahead");
+    sys->ahead.stop = false;
+    sys->ahead.filtering = false;
+    sys->ahead.count = 0;
+    sys->ahead.pending = NULL;
+    sys->ahead.blocked = false;
+    sys->ahead.source = NULL;
+    sys->ahead.filtered = NULL;
+
     sys->filter.configuration = NULL;
     video_format_Copy(&sys->filter.src_fmt, &sys->original);
     sys->filter.src_vctx = vctx ? vlc_video_context_Hold(vctx) : NULL;
@@ -1759,7 +2282,8 @@ static int vout_Start(vout_thread_sys_t *vout, vlc_video_context *vctx, const vo
     dcfg.display.height = sys->window_height;
 
     sys->private_pool =
-        picture_pool_NewFromFormat(&sys->original, FILTER_POOL_SIZE);
+        picture_pool_NewFromFormat(&sys->original,
+                                   VOUT_PRIVATE_POOL_SIZE(sys));
     if (sys->private_pool == NULL) {
         vlc_queuedmutex_unlock(&sys->display_lock);
         goto error;
@@ -1789,6 +2313,13 @@ static int vout_Start(vout_thread_sys_t *vout, vlc_video_context *vctx, const vo
 
     sys->spu_blend               = NULL;
 
+    if (sys->ahead.depth > 0 &&
+        vlc_clone(&sys->ahead.thread, RenderAheadThread, sys))
+    {
+        msg_Warn(&vout->obj, "cannot filter the pictures ahead");
+        sys->ahead.depth = 0;
+    }
+
     video_format_Print(VLC_OBJECT(&vout->obj), "original format", &sys->original);
     return VLC_SUCCESS;
 error:
@@ -1820,6 +2351,16 @@ error:
         picture_fifo_Delete(sys->decoder_fifo);
         sys->decoder_fifo = NULL;
     }
+    if (sys->frame_previous != NULL)
+    {
+        picture_Release(sys->frame_previous);
+        sys->frame_previous = NULL;
+    }
+    if (sys->picture_cache != NULL)
+    {
+        vout_picture_cache_Delete(sys->picture_cache);
+        sys->picture_cache = NULL;
+    }
     vlc_mutex_lock(&sys->window_lock);
     vout_display_window_SetMouseHandler(sys->display_cfg.window, NULL, NULL);
     vlc_mutex_unlock(&sys->window_lock);
@@ -1871,6 +2412,15 @@ static void vout_ReleaseDisplay(vout_thread_sys_t *vout)
 
     assert(sys->display != NULL);
 
+    if (sys->ahead.depth > 0)
+    {
+        vlc_mutex_lock(&sys->ahead.lock);
+        sys->ahead.stop = true;
+        vlc_cond_signal(&sys->ahead.wait);
+        vlc_mutex_unlock(&sys->ahead.lock);
+        vlc_join(sys->ahead.thread, NULL);
+    }
+
     if (sys->spu_blend != NULL)
         filter_DeleteBlend(sys->spu_blend);
 
@@ -1911,6 +2461,16 @@ static void vout_ReleaseDisplay(vout_thread_sys_t *vout)
         picture_fifo_Delete(sys->decoder_fifo);
         sys->decoder_fifo = NULL;
     }
+    if (sys->frame_previous != NULL)
+    {
+        picture_Release(sys->frame_previous);
+        sys->frame_previous = NULL;
+    }
+    if (sys->picture_cache != NULL)
+    {
+        vout_picture_cache_Delete(sys->picture_cache);
+        sys->picture_cache = NULL;
+    }
     assert(sys->private_pool == NULL);
 
     vlc_mutex_lock(&sys->window_lock);
@@ -1932,6 +2492,7 @@ static void vout_ReleaseDisplay(vout_thread_sys_t *vout)
     sys->clock = NULL;
     vlc_mutex_unlock(&sys->clock_lock);
     sys->str_id = NULL;
+    sys->histograms = NULL;
 }
 
 void vout_StopDisplay(vout_thread_t *vout)
@@ -1943,6 +2504,20 @@ void vout_StopDisplay(vout_thread_t *vout)
     vout_control_Wake(&sys->control);
     vlc_join(sys->thread, NULL);
 
+    msg_Dbg(&sys->obj, "average rendering time: static filters %"PRId64" us, "
+            "interactive filters %"PRId64" us, blending %"PRId64" us, "
+            "prepare %"PRId64" us, display %"PRId64" us",
+            US_FROM_VLC_TICK(vout_statistic_GetStageAverage(&sys->statistic,
+                                                VOUT_STAGE_STATIC_FILTER)),
+            US_FROM_VLC_TICK(vout_statistic_GetStageAverage(&sys->statistic,
+                                                VOUT_STAGE_INTERACTIVE_FILTER)),
+            US_FROM_VLC_TICK(vout_statistic_GetStageAverage(&sys->statistic,
+                                                VOUT_STAGE_BLEND)),
+            US_FROM_VLC_TICK(vout_statistic_GetStageAverage(&sys->statistic,
+                                                VOUT_STAGE_PREPARE)),
+            US_FROM_VLC_TICK(vout_statistic_GetStageAverage(&sys->statistic,
+                                                VOUT_STAGE_DISPLAY)));
+
     vout_ReleaseDisplay(sys);
 }
 
@@ -2103,9 +2678,19 @@ vout_thread_t *vout_Create(vlc_object_t *object)
     vout_InitInterlacingSupport(vout, &sys->interlacing);
 
     sys->is_late_dropped = var_InheritBool(vout, "drop-late-frames");
+    sys->picture_cache = NULL;
+    sys->frame_previous = NULL;
 
     vlc_mutex_init(&sys->filter.lock);
 
+    sys->ahead.depth = 0;
+    vlc_mutex_init(&sys->ahead.lock);
+    vlc_cond_init(&sys->ahead.wait);
+    vlc_list_init(&sys->ahead.queue);
+    sys->ahead.pending = NULL;
+    sys->ahead.source = NULL;
+    sys->ahead.filtered = NULL;
+
     vlc_mutex_init(&sys->clock_lock);
     sys->clock_nowait = false;
     sys->wait_interrupted = false;
@@ -2269,6 +2854,7 @@ int vout_Request(const vout_configuration_t *cfg, vlc_video_context *vctx, input
     sys->delay = 0;
     sys->rate = 1.f;
     sys->str_id = cfg->str_id;
+    sys->histograms = cfg->histograms;
 
     vlc_mutex_lock(&sys->clock_lock);
     sys->clock = cfg->clock;
@@ -2312,6 +2898,7 @@ error_display:
     vlc_mutex_lock(&sys->clock_lock);
     sys->clock = NULL;
     vlc_mutex_unlock(&sys->clock_lock);
+    sys->histograms = NULL;
     return -1;
 }
 
@@ -40,6 +40,7 @@ typedef struct {
     const video_format_t *fmt;
     vlc_mouse_event      mouse_event;
     void                 *mouse_opaque;
+    struct vlc_histogram *histograms; /**< input latency histograms, or NULL */
 } vout_configuration_t;
 
 /**
@@ -221,6 +222,14 @@ void vout_GetResetStatistic( vout_thread_t *p_vout, unsigned *pi_displayed,
  */
 void vout_NextPicture( vout_thread_t *p_vout );
 
+/**
+ * This function will display the picture preceding the displayed one while
+ * paused, if it is still in the picture cache
+ *
+ * \return VLC_SUCCESS, or VLC_EGENERIC if the picture must be decoded again
+ */
+int vout_PreviousPicture( vout_thread_t *p_vout );
+
 /**
  * This function will ask the display of the input title
  */
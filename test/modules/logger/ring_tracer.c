@@ -0,0 +1,320 @@
+/*****************************************************************************
+ * ring_tracer.c: binary ring buffer tracer unit tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+
+#include <vlc_threads.h>
+#include <vlc_tick.h>
+#include <vlc_tracer.h>
+#include <vlc_variables.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#define THREAD_COUNT 4
+#define ROUND_COUNT 2
+#define TRACE_COUNT 10000
+#define EVENT_COUNT (ROUND_COUNT * THREAD_COUNT * TRACE_COUNT)
+
+struct trace_ctx
+{
+    struct vlc_tracer *tracer;
+    vlc_tick_t elapsed;
+};
+
+/** Emulate the clock traces of one output thread. */
+static void *TraceThread(void *data)
+{
+    struct trace_ctx *ctx = data;
+
+    const vlc_tick_t start = vlc_tick_now();
+    for (int64_t i = 0; i < TRACE_COUNT; ++i)
+        vlc_tracer_Trace(ctx->tracer, VLC_TRACE("type", "RENDER"),
+                                      VLC_TRACE("id", "video"),
+                                      VLC_TRACE("index", i),
+                                      VLC_TRACE("rate", 1.0),
+                                      VLC_TRACE_TICK_NS("offset", i * 1000),
+                                      VLC_TRACE_END);
+    ctx->elapsed = vlc_tick_now() - start;
+    return NULL;
+}
+
+/**
+ * Trace from successive rounds of threads, so that the buffers of the exited
+ * threads are released while tracing. Returns the average cost of a trace,
+ * in ns.
+ */
+static vlc_tick_t RunTracer(vlc_object_t *obj, const char *name)
+{
+    struct trace_ctx ctx[THREAD_COUNT];
+    vlc_thread_t threads[THREAD_COUNT];
+    vlc_tick_t elapsed = 0;
+
+    struct vlc_tracer *tracer = vlc_tracer_Create(obj, name);
+    assert(tracer != NULL);
+
+    for (unsigned round = 0; round < ROUND_COUNT; ++round)
+    {
+        for (unsigned i = 0; i < THREAD_COUNT; ++i)
+        {
+            ctx[i].tracer = tracer;
+            const int status = vlc_clone(&threads[i], TraceThread, &ctx[i]);
+            assert(status == 0);
+        }
+
+        for (unsigned i = 0; i < THREAD_COUNT; ++i)
+        {
+            vlc_join(threads[i], NULL);
+            elapsed += ctx[i].elapsed;
+        }
+
+        /* let the ring tracer flush and free the released buffers */
+        vlc_tick_sleep(VLC_TICK_FROM_MS(200));
+    }
+    vlc_tracer_Destroy(tracer);
+
+    return NS_FROM_VLC_TICK(elapsed) / EVENT_COUNT;
+}
+
+static uint8_t *ReadFile(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    int ret = fseek(file, 0, SEEK_END);
+    assert(ret == 0);
+    const long len = ftell(file);
+    assert(len > 0);
+    rewind(file);
+
+    uint8_t *data = malloc(len);
+    assert(data != NULL);
+    *size = fread(data, 1, len, file);
+    assert(*size == (size_t)len);
+    fclose(file);
+    unlink(path);
+    return data;
+}
+
+static uint64_t ReadVarint(const uint8_t **p, const uint8_t *end)
+{
+    uint64_t value = 0;
+    for (unsigned shift = 0; ; shift += 7)
+    {
+        assert(*p < end && shift < 64);
+        const uint8_t byte = *(*p)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+}
+
+/** Count the TracePacket fields of a protobuf message. */
+static void CountFields(const uint8_t *p, const uint8_t *end,
+                        unsigned field, size_t *count)
+{
+    while (p < end)
+    {
+        const uint64_t tag = ReadVarint(&p, end);
+        if ((tag >> 3) == field)
+            (*count)++;
+        switch (tag & 7)
+        {
+            case 0:
+                ReadVarint(&p, end);
+                break;
+            case 1:
+                p += 8;
+                break;
+            case 2:
+                p += ReadVarint(&p, end);
+                break;
+            case 5:
+                p += 4;
+                break;
+            default:
+                assert(!"invalid wire type");
+        }
+        assert(p <= end);
+    }
+}
+
+static void CheckPerfetto(const char *path)
+{
+    size_t size;
+    uint8_t *data = ReadFile(path, &size);
+    const uint8_t *p = data, *end = data + size;
+    size_t events = 0, tracks = 0;
+
+    while (p < end)
+    {
+        /* Trace.packet */
+        assert(ReadVarint(&p, end) == ((1 << 3) | 2));
+        const uint64_t len = ReadVarint(&p, end);
+        assert(len <= (uint64_t)(end - p));
+        CountFields(p, p + len, 11 /* track_event */, &events);
+        CountFields(p, p + len, 60 /* track_descriptor */, &tracks);
+        p += len;
+    }
+    free(data);
+
+    assert(events == EVENT_COUNT);
+    /* one track per tracing thread */
+    assert(tracks == ROUND_COUNT * THREAD_COUNT);
+}
+
+static void CheckJson(const char *path)
+{
+    size_t size;
+    uint8_t *data = ReadFile(path, &size);
+    size_t events = 0;
+
+    /* one object per line */
+    for (const uint8_t *p = data, *end = data + size; p < end;)
+    {
+        const uint8_t *eol = memchr(p, '\n', end - p);
+        assert(eol != NULL);
+        assert(*p == '{' && eol[-1] == '}');
+        p = eol + 1;
+        events++;
+    }
+    free(data);
+
+    assert(events == EVENT_COUNT);
+}
+
+static void CheckCtf(const char *dirname)
+{
+    char path[256];
+    size_t size;
+
+    snprintf(path, sizeof(path), "%s/metadata", dirname);
+    uint8_t *data = ReadFile(path, &size);
+    assert(size > 14 && memcmp(data, "/* CTF 1.8 */\n", 14) == 0);
+    free(data);
+
+    snprintf(path, sizeof(path), "%s/stream", dirname);
+    data = ReadFile(path, &size);
+    const uint8_t *p = data, *end = data + size;
+
+    uint32_t magic;
+    memcpy(&magic, p, sizeof(magic));
+    assert(magic == 0xC1FC1FC1);
+    p += sizeof(magic);
+
+    size_t events = 0;
+    while (p < end)
+    {
+        uint16_t count;
+        p += 16; /* timestamp and thread id */
+        memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+        assert(count == 5);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const uint8_t type = *p++;
+            p += strlen((const char *)p) + 1;
+            if (type == VLC_TRACER_STRING)
+                p += strlen((const char *)p) + 1;
+            else
+                p += 8;
+            assert(p <= end);
+        }
+        events++;
+    }
+    free(data);
+    rmdir(dirname);
+
+    assert(events == EVENT_COUNT);
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *const args[] = {
+        "-vvv",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if (vlc == NULL)
+        return 1;
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    const char *tmpdir = getenv("TMPDIR");
+    if (tmpdir == NULL || tmpdir[0] == '\0')
+        tmpdir = "/tmp";
+
+    char *outdir;
+    if (asprintf(&outdir, "%s/vlc-test-tracer-XXXXXX", tmpdir) == -1)
+        return 1;
+    if (mkdtemp(outdir) == NULL)
+    {
+        free(outdir);
+        return 77;
+    }
+
+    char *json, *perfetto, *ctf;
+    int ret = asprintf(&json, "%s/trace.json", outdir);
+    assert(ret != -1);
+    ret = asprintf(&perfetto, "%s/trace.perfetto-trace", outdir);
+    assert(ret != -1);
+    ret = asprintf(&ctf, "%s/trace.ctf", outdir);
+    assert(ret != -1);
+
+    var_Create(obj, "json-tracer-file", VLC_VAR_STRING);
+    var_SetString(obj, "json-tracer-file", json);
+    var_Create(obj, "ring-tracer-file", VLC_VAR_STRING);
+    var_Create(obj, "ring-tracer-format", VLC_VAR_STRING);
+    /* large enough not to drop any trace */
+    var_Create(obj, "ring-tracer-buffer", VLC_VAR_INTEGER);
+    var_SetInteger(obj, "ring-tracer-buffer", 4096);
+
+    const vlc_tick_t json_cost = RunTracer(obj, "json_tracer");
+    CheckJson(json);
+
+    var_SetString(obj, "ring-tracer-file", perfetto);
+    var_SetString(obj, "ring-tracer-format", "perfetto");
+    const vlc_tick_t perfetto_cost = RunTracer(obj, "ring_tracer");
+    CheckPerfetto(perfetto);
+
+    var_SetString(obj, "ring-tracer-file", ctf);
+    var_SetString(obj, "ring-tracer-format", "ctf");
+    const vlc_tick_t ctf_cost = RunTracer(obj, "ring_tracer");
+    CheckCtf(ctf);
+
+    /* Not asserted, as timings depend on the load of the machine */
+    test_log("%d x %d threads x %d traces, cost per trace: json %" PRId64
+             " ns, ring/perfetto %" PRId64 " ns, ring/ctf %" PRId64 " ns\n",
+             ROUND_COUNT, THREAD_COUNT, TRACE_COUNT, json_cost, perfetto_cost,
+             ctf_cost);
+
+    free(json);
+    free(perfetto);
+    free(ctf);
+    rmdir(outdir);
+    free(outdir);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*****************************************************************************
+ * csa.c: CSA descrambler unit tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_tick.h>
+
+#include "../../libvlc/test.h"
+#include "../../../modules/mux/mpeg/csa.h"
+#include "../lib/libvlc_internal.h"
+
+#define PACKET_COUNT 4096
+#define BENCH_ROUNDS 16
+
+static uint8_t clear[PACKET_COUNT][188];
+static uint8_t scrambled[PACKET_COUNT][188];
+static uint8_t single[PACKET_COUNT][188];
+static uint8_t batch[PACKET_COUNT][188];
+
+/** Build packets with various adaptation field sizes, scrambled with both
+ * keys, and a few clear ones. */
+static void MakePackets(vlc_object_t *obj, csa_t *csa)
+{
+    for (unsigned i = 0; i < PACKET_COUNT; ++i)
+    {
+        uint8_t *pkt = clear[i];
+        for (unsigned j = 0; j < 188; ++j)
+            pkt[j] = (i * 31 + j * 7) ^ (i >> 3);
+
+        pkt[0] = 0x47;
+        pkt[1] = 0x01;
+        pkt[2] = 0x00;
+        pkt[3] = 0x10 | (i & 0x0f);
+        if (i % 5 == 0)
+        {
+            /* adaptation field, up to leaving less than a block */
+            pkt[3] |= 0x20;
+            pkt[4] = (i / 5) % 184;
+        }
+
+        memcpy(scrambled[i], pkt, 188);
+        if (i % 17 == 0)
+            continue; /* left clear */
+
+        csa_UseKey(obj, csa, (i / 64) % 2);
+        csa_Encrypt(csa, scrambled[i], 188);
+        /* only the scrambling control bits remain in the header */
+        assert((scrambled[i][3] & 0x3f) == (pkt[3] & 0x3f));
+    }
+}
+
+static void DecryptSingle(csa_t *csa)
+{
+    for (unsigned i = 0; i < PACKET_COUNT; ++i)
+        csa_Decrypt(csa, single[i], 188);
+}
+
+static void DecryptBatch(csa_t *csa)
+{
+    uint8_t *pkts[PACKET_COUNT];
+    for (unsigned i = 0; i < PACKET_COUNT; ++i)
+        pkts[i] = batch[i];
+    csa_DecryptBatch(csa, pkts, PACKET_COUNT, 188);
+}
+
+static vlc_tick_t Bench(csa_t *csa, void (*decrypt)(csa_t *),
+                        uint8_t (*out)[188])
+{
+    vlc_tick_t total = 0;
+    for (unsigned i = 0; i < BENCH_ROUNDS; ++i)
+    {
+        memcpy(out, scrambled, sizeof(scrambled));
+        const vlc_tick_t start = vlc_tick_now();
+        decrypt(csa);
+        total += vlc_tick_now() - start;
+    }
+    return total;
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *const args[] = {
+        "-vvv",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if (vlc == NULL)
+        return 1;
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    csa_t *csa = csa_New();
+    if (csa == NULL)
+    {
+        /* built without libdvbcsa */
+        libvlc_release(vlc);
+        return 77;
+    }
+    assert(csa_GetBatchSize(csa) > 0);
+
+    char odd[] = "0x0123456789abcdef";
+    char even[] = "fedcba9876543210";
+    int ret = csa_SetCW(obj, csa, odd, true);
+    assert(ret == VLC_SUCCESS);
+    ret = csa_SetCW(obj, csa, even, false);
+    assert(ret == VLC_SUCCESS);
+
+    MakePackets(obj, csa);
+
+    /* Both implementations must give back the exact clear packets. */
+    const vlc_tick_t single_time = Bench(csa, DecryptSingle, single);
+    const vlc_tick_t batch_time = Bench(csa, DecryptBatch, batch);
+    for (unsigned i = 0; i < PACKET_COUNT; ++i)
+    {
+        assert(memcmp(single[i], clear[i], 188) == 0);
+        assert(memcmp(batch[i], clear[i], 188) == 0);
+    }
+
+    /* Partial packets, as with --ts-csa-pkt */
+    memcpy(single, scrambled, sizeof(scrambled));
+    memcpy(batch, scrambled, sizeof(scrambled));
+    for (unsigned i = 0; i < PACKET_COUNT; ++i)
+        csa_Decrypt(csa, single[i], 100);
+    uint8_t *pkts[PACKET_COUNT];
+    for (unsigned i = 0; i < PACKET_COUNT; ++i)
+        pkts[i] = batch[i];
+    csa_DecryptBatch(csa, pkts, PACKET_COUNT, 100);
+    assert(memcmp(single, batch, sizeof(batch)) == 0);
+
+    const uint64_t packets = (uint64_t)PACKET_COUNT * BENCH_ROUNDS;
+    test_log("batches of %zu packets, single: %" PRIu64 " packets/s, "
+             "batch: %" PRIu64 " packets/s\n", csa_GetBatchSize(csa),
+             packets * CLOCK_FREQ / (single_time ? single_time : 1),
+             packets * CLOCK_FREQ / (batch_time ? batch_time : 1));
+
+    csa_Delete(csa);
+    libvlc_release(vlc);
+    return 0;
+}
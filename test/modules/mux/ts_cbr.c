@@ -0,0 +1,248 @@
+/*****************************************************************************
+ * ts_cbr.c: TS muxer constant mux rate unit testing
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include <vlc_block.h>
+#include <vlc_sout.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#define MUXRATE 2000000
+#define AUDIO_PID 200
+#define FRAME_SIZE 417              /* 128kbps MPEG audio at 44.1kHz */
+#define FRAME_LENGTH VLC_TICK_FROM_US(26122)
+
+#define PCR_JITTER_MAX 13           /* 500ns in 27MHz */
+#define PCR_INTERVAL_MAX (40 * 27000)
+
+/* Analysis of the muxed stream, as done by a TR 101 290 probe */
+struct ts_analysis
+{
+    uint64_t packets;
+    uint64_t nulls;
+
+    vlc_tick_t first_dts;
+    vlc_tick_t last_dts;
+    vlc_tick_t max_dts_error;
+
+    uint64_t pcrs;
+    uint64_t first_pcr_packet;
+    int64_t first_pcr;
+    int64_t last_pcr;
+    int64_t max_pcr_jitter;
+    int64_t max_pcr_interval;
+
+    int audio_cc;
+};
+
+static void AnalysePacket(struct ts_analysis *ts, const block_t *pkt)
+{
+    assert(pkt->i_buffer == 188);
+
+    const uint8_t *p = pkt->p_buffer;
+    assert(p[0] == 0x47);
+
+    const uint16_t pid = ((p[1] & 0x1f) << 8) | p[2];
+    const bool has_adaptation = p[3] & 0x20;
+    const bool has_payload = p[3] & 0x10;
+    const uint64_t index = ts->packets++;
+
+    /* every packet must be dated on the constant rate clock */
+    const vlc_tick_t slot = vlc_tick_from_frac(index * 188 * 8, MUXRATE);
+    if (index == 0)
+        ts->first_dts = pkt->i_dts;
+    vlc_tick_t error = pkt->i_dts - ts->first_dts - slot;
+    if (error < 0)
+        error = -error;
+    if (error > ts->max_dts_error)
+        ts->max_dts_error = error;
+    ts->last_dts = pkt->i_dts;
+
+    if (pid == 0x1fff)
+    {
+        ts->nulls++;
+        return;
+    }
+
+    if (pid == AUDIO_PID)
+    {
+        const int cc = p[3] & 0x0f;
+        if (ts->audio_cc >= 0)
+            assert(cc == (has_payload ? (ts->audio_cc + 1) % 16
+                                      : ts->audio_cc));
+        ts->audio_cc = cc;
+    }
+
+    if (!has_adaptation || p[4] < 7 || !(p[5] & 0x10))
+        return;
+
+    const int64_t base = ((int64_t)p[6] << 25) | (p[7] << 17) | (p[8] << 9) |
+                         (p[9] << 1) | (p[10] >> 7);
+    const int64_t pcr = base * 300 + (((p[10] & 0x01) << 8) | p[11]);
+
+    if (ts->pcrs++ == 0)
+    {
+        ts->first_pcr = pcr;
+        ts->first_pcr_packet = index;
+    }
+    else
+    {
+        const uint64_t bits = (index - ts->first_pcr_packet) * 188 * 8;
+        const int64_t expected = ts->first_pcr +
+            bits / MUXRATE * 27000000 + bits % MUXRATE * 27000000 / MUXRATE;
+        int64_t jitter = pcr - expected;
+        if (jitter < 0)
+            jitter = -jitter;
+        if (jitter > ts->max_pcr_jitter)
+            ts->max_pcr_jitter = jitter;
+
+        if (pcr - ts->last_pcr > ts->max_pcr_interval)
+            ts->max_pcr_interval = pcr - ts->last_pcr;
+    }
+    ts->last_pcr = pcr;
+}
+
+static ssize_t AccessOutWrite(sout_access_out_t *access, block_t *block)
+{
+    struct ts_analysis *ts = access->p_sys;
+    ssize_t r = 0;
+
+    for (const block_t *pkt = block; pkt != NULL; pkt = pkt->p_next)
+    {
+        AnalysePacket(ts, pkt);
+        r += pkt->i_buffer;
+    }
+    block_ChainRelease(block);
+    return r;
+}
+
+static sout_access_out_t *CreateAccessOut(vlc_object_t *parent,
+                                          struct ts_analysis *ts)
+{
+    sout_access_out_t *access = vlc_object_create(parent, sizeof(*access));
+    if (unlikely(access == NULL))
+        return NULL;
+
+    access->psz_access = strdup("mock");
+    if (unlikely(access->psz_access == NULL))
+    {
+        vlc_object_delete(access);
+        return NULL;
+    }
+
+    access->p_cfg = NULL;
+    access->p_module = NULL;
+    access->p_sys = ts;
+    access->psz_path = NULL;
+
+    access->pf_control = NULL;
+    access->pf_read = NULL;
+    access->pf_seek = NULL;
+    access->pf_write = AccessOutWrite;
+    return access;
+}
+
+static void SendAudio(sout_mux_t *mux, sout_input_t *input)
+{
+    for (vlc_tick_t time = VLC_TICK_FROM_SEC(1); time < VLC_TICK_FROM_SEC(4);
+         time += FRAME_LENGTH)
+    {
+        block_t *frame = block_Alloc(FRAME_SIZE);
+        assert(frame != NULL);
+        memset(frame->p_buffer, 0, frame->i_buffer);
+        frame->i_dts = frame->i_pts = time;
+        frame->i_length = FRAME_LENGTH;
+
+        const int status = sout_MuxSendBuffer(mux, input, frame);
+        assert(status == VLC_SUCCESS);
+    }
+}
+
+static void RunTest(libvlc_instance_t *instance)
+{
+    struct ts_analysis ts = { .audio_cc = -1 };
+
+    sout_access_out_t *access =
+        CreateAccessOut(VLC_OBJECT(instance->p_libvlc_int), &ts);
+    assert(access != NULL);
+
+    char mux_cfg[64];
+    snprintf(mux_cfg, sizeof(mux_cfg), "ts{muxrate=%d,pid-audio=%d}",
+             MUXRATE, AUDIO_PID);
+    sout_mux_t *mux = sout_MuxNew(access, mux_cfg);
+    assert(mux != NULL);
+
+    es_format_t fmt;
+    es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_MPGA);
+    fmt.audio.i_rate = 44100;
+    fmt.audio.i_channels = 2;
+    sout_input_t *input = sout_MuxAddStream(mux, &fmt);
+    assert(input != NULL);
+
+    // Disable mux caching.
+    mux->b_waiting_stream = false;
+
+    SendAudio(mux, input);
+
+    sout_MuxDeleteStream(mux, input);
+    sout_MuxDelete(mux);
+    sout_AccessOutDelete(access);
+
+    assert(ts.packets > 0);
+    assert(ts.pcrs > 1);
+
+    const double bitrate = (double)(ts.packets - 1) * 188 * 8 * CLOCK_FREQ /
+                           (ts.last_dts - ts.first_dts);
+    test_log("%" PRIu64 " packets (%" PRIu64 " null), %.0f bits/s, "
+             "dts error %" PRId64 " us, %" PRIu64 " PCRs, "
+             "jitter %" PRId64 " ns, max interval %" PRId64 " us\n",
+             ts.packets, ts.nulls, bitrate,
+             US_FROM_VLC_TICK(ts.max_dts_error), ts.pcrs,
+             ts.max_pcr_jitter * 1000 / 27, ts.max_pcr_interval / 27);
+
+    /* the audio is well below the mux rate: stuffing is needed */
+    assert(ts.nulls > ts.packets / 2);
+    /* constant rate: every packet on its slot, rounding apart */
+    assert(ts.max_dts_error <= VLC_TICK_FROM_US(1));
+    /* PCR accuracy and repetition */
+    assert(ts.max_pcr_jitter <= PCR_JITTER_MAX);
+    assert(ts.max_pcr_interval <= PCR_INTERVAL_MAX);
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *const args[] = {
+        "-vvv",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if (vlc == NULL)
+        return 1;
+
+    RunTest(vlc);
+
+    libvlc_release(vlc);
+}
@@ -0,0 +1,250 @@
+/*****************************************************************************
+ * ts_threads.c: TS muxer packetization threads unit testing and benchmark
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include <vlc_block.h>
+#include <vlc_sout.h>
+#include <vlc_tick.h>
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+/* Multiple program stream: each service has a video and an audio stream */
+#define SERVICE_COUNT 20
+#define PID_BASE 0x100
+#define PMT_PID 32
+#define DURATION VLC_TICK_FROM_SEC(5)
+
+#define VIDEO_FRAME_SIZE 10000      /* 2Mbps at 25fps */
+#define VIDEO_FRAME_LENGTH VLC_TICK_FROM_MS(40)
+#define AUDIO_FRAME_SIZE 417        /* 128kbps MPEG audio at 44.1kHz */
+#define AUDIO_FRAME_LENGTH VLC_TICK_FROM_US(26122)
+
+struct ts_output
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t blocks;
+};
+
+static ssize_t AccessOutWrite(sout_access_out_t *access, block_t *block)
+{
+    struct ts_output *out = access->p_sys;
+    ssize_t r = 0;
+
+    for (const block_t *b = block; b != NULL; b = b->p_next)
+    {
+        assert(b->i_buffer % 188 == 0);
+        if (out->size + b->i_buffer > out->capacity)
+        {
+            out->capacity = (out->size + b->i_buffer) * 2;
+            out->data = realloc(out->data, out->capacity);
+            assert(out->data != NULL);
+        }
+        memcpy(&out->data[out->size], b->p_buffer, b->i_buffer);
+        out->size += b->i_buffer;
+        out->blocks++;
+        r += b->i_buffer;
+    }
+    block_ChainRelease(block);
+    return r;
+}
+
+static sout_access_out_t *CreateAccessOut(vlc_object_t *parent,
+                                          struct ts_output *out)
+{
+    sout_access_out_t *access = vlc_object_create(parent, sizeof(*access));
+    if (unlikely(access == NULL))
+        return NULL;
+
+    access->psz_access = strdup("mock");
+    if (unlikely(access->psz_access == NULL))
+    {
+        vlc_object_delete(access);
+        return NULL;
+    }
+
+    access->p_cfg = NULL;
+    access->p_module = NULL;
+    access->p_sys = out;
+    access->psz_path = NULL;
+
+    access->pf_control = NULL;
+    access->pf_read = NULL;
+    access->pf_seek = NULL;
+    access->pf_write = AccessOutWrite;
+    return access;
+}
+
+static block_t *MakeFrame(size_t size, vlc_tick_t time, vlc_tick_t length,
+                          unsigned pid)
+{
+    block_t *frame = block_Alloc(size);
+    assert(frame != NULL);
+    memset(frame->p_buffer, pid & 0xff, frame->i_buffer);
+    frame->i_dts = frame->i_pts = time;
+    frame->i_length = length;
+    return frame;
+}
+
+/** Mux the services, and return the time spent in the muxer. */
+static vlc_tick_t RunMux(libvlc_instance_t *instance, unsigned threads,
+                         unsigned burst, struct ts_output *out)
+{
+    sout_access_out_t *access =
+        CreateAccessOut(VLC_OBJECT(instance->p_libvlc_int), out);
+    assert(access != NULL);
+
+    /* One program per service, with fixed identifiers so that the outputs
+     * of the runs can be compared */
+    char muxpmt[SERVICE_COUNT * 14];
+    size_t len = 0;
+    for (unsigned i = 0; i < SERVICE_COUNT; ++i)
+        len += snprintf(&muxpmt[len], sizeof(muxpmt) - len, "%s%u,%u",
+                        i > 0 ? ",," : "", PID_BASE + 2 * i,
+                        PID_BASE + 2 * i + 1);
+
+    char mux_cfg[sizeof(muxpmt) + 128];
+    snprintf(mux_cfg, sizeof(mux_cfg), "ts{es-id-pid,muxpmt=\"%s\","
+             "pid-pmt=%d,tsid=1,netid=1,threads=%u,burst=%u}",
+             muxpmt, PMT_PID, threads, burst);
+    sout_mux_t *mux = sout_MuxNew(access, mux_cfg);
+    assert(mux != NULL);
+
+    sout_input_t *inputs[SERVICE_COUNT * 2];
+    for (unsigned i = 0; i < SERVICE_COUNT; ++i)
+    {
+        es_format_t fmt;
+        es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_MP2V);
+        fmt.i_id = PID_BASE + 2 * i;
+        fmt.video.i_frame_rate = 25;
+        fmt.video.i_frame_rate_base = 1;
+        inputs[2 * i] = sout_MuxAddStream(mux, &fmt);
+        assert(inputs[2 * i] != NULL);
+
+        es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_MPGA);
+        fmt.i_id = PID_BASE + 2 * i + 1;
+        fmt.audio.i_rate = 44100;
+        fmt.audio.i_channels = 2;
+        inputs[2 * i + 1] = sout_MuxAddStream(mux, &fmt);
+        assert(inputs[2 * i + 1] != NULL);
+    }
+
+    // Disable mux caching.
+    mux->b_waiting_stream = false;
+
+    vlc_tick_t muxing = 0;
+    vlc_tick_t video = VLC_TICK_FROM_SEC(1);
+    vlc_tick_t audio = VLC_TICK_FROM_SEC(1);
+    while (video < VLC_TICK_FROM_SEC(1) + DURATION)
+    {
+        const bool is_video = video <= audio;
+        for (unsigned i = 0; i < SERVICE_COUNT; ++i)
+        {
+            block_t *frame = is_video
+                ? MakeFrame(VIDEO_FRAME_SIZE, video, VIDEO_FRAME_LENGTH,
+                            PID_BASE + 2 * i)
+                : MakeFrame(AUDIO_FRAME_SIZE, audio, AUDIO_FRAME_LENGTH,
+                            PID_BASE + 2 * i + 1);
+            if (is_video && video % VLC_TICK_FROM_SEC(1) == 0)
+                frame->i_flags |= BLOCK_FLAG_TYPE_I;
+
+            const vlc_tick_t start = vlc_tick_now();
+            const int status =
+                sout_MuxSendBuffer(mux, inputs[2 * i + !is_video], frame);
+            muxing += vlc_tick_now() - start;
+            assert(status == VLC_SUCCESS);
+        }
+        if (is_video)
+            video += VIDEO_FRAME_LENGTH;
+        else
+            audio += AUDIO_FRAME_LENGTH;
+    }
+
+    for (unsigned i = 0; i < ARRAY_SIZE(inputs); ++i)
+        sout_MuxDeleteStream(mux, inputs[i]);
+    sout_MuxDelete(mux);
+    sout_AccessOutDelete(access);
+
+    assert(out->size > 0);
+    return muxing;
+}
+
+/** The packets of the elementary streams must not depend on the threads. */
+static void CheckSameOutput(const struct ts_output *ref,
+                            const struct ts_output *out)
+{
+    assert(out->size == ref->size);
+    for (size_t i = 0; i < ref->size; i += 188)
+    {
+        const uint8_t *p = &ref->data[i];
+        const uint16_t pid = ((p[1] & 0x1f) << 8) | p[2];
+
+        /* The table versions are random */
+        const bool psi = pid == 0 || pid == 0x11 ||
+                         (pid >= PMT_PID && pid < PMT_PID + SERVICE_COUNT);
+        assert(memcmp(p, &out->data[i], psi ? 4 : 188) == 0);
+    }
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *const args[] = {
+        "-vvv",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if (vlc == NULL)
+        return 1;
+
+    struct ts_output ref = { 0 };
+    const vlc_tick_t ref_time = RunMux(vlc, 0, 1, &ref);
+    assert(ref.blocks == ref.size / 188);
+
+    struct ts_output burst = { 0 };
+    const vlc_tick_t burst_time = RunMux(vlc, 0, 7, &burst);
+    CheckSameOutput(&ref, &burst);
+    assert(burst.blocks < ref.blocks / 6);
+
+    struct ts_output threads = { 0 };
+    const vlc_tick_t threads_time = RunMux(vlc, 4, 7, &threads);
+    CheckSameOutput(&ref, &threads);
+    assert(threads.blocks == burst.blocks);
+
+    /* Not asserted, as timings depend on the load of the machine */
+    const double mbytes = ref.size / (1024. * 1024.);
+    test_log("%d services, %.1f MiB muxed in: %" PRId64 " ms, "
+             "%" PRId64 " ms with 7 packets blocks, "
+             "%" PRId64 " ms with 4 threads (%" PRIu64 " -> %" PRIu64
+             " blocks)\n", SERVICE_COUNT, mbytes,
+             MS_FROM_VLC_TICK(ref_time), MS_FROM_VLC_TICK(burst_time),
+             MS_FROM_VLC_TICK(threads_time), ref.blocks, threads.blocks);
+
+    free(ref.data);
+    free(burst.data);
+    free(threads.data);
+    libvlc_release(vlc);
+}
@@ -0,0 +1,243 @@
+/*****************************************************************************
+ * storage.c: HLS segment storage unit tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+
+#include <vlc_block.h>
+#include <vlc_threads.h>
+#include <vlc_tick.h>
+
+#include "../../../libvlc/test.h"
+#include "../../modules/stream_out/hls/hls.h"
+#include "../../modules/stream_out/hls/storage.h"
+#include "../lib/libvlc_internal.h"
+
+#define VARIANT_COUNT 4
+#define SEGMENT_COUNT 16
+#define SEGMENT_SIZE (512 * 1024)
+
+struct variant_ctx
+{
+    unsigned id;
+    const struct hls_config *config;
+    hls_storage_t *segments[SEGMENT_COUNT];
+    vlc_tick_t blocked;
+};
+
+static block_t *MakeSegment(unsigned variant, unsigned segment)
+{
+    block_t *block = block_Alloc(SEGMENT_SIZE);
+    assert(block != NULL);
+    memset(block->p_buffer, (variant * SEGMENT_COUNT + segment) & 0xff,
+           block->i_buffer);
+    return block;
+}
+
+static void CheckContent(const hls_storage_t *storage,
+                         unsigned variant,
+                         unsigned segment)
+{
+    uint8_t *content;
+    const ssize_t size = storage->get_content(storage, &content);
+    assert(size == SEGMENT_SIZE);
+    for (ssize_t i = 0; i < size; ++i)
+        assert(content[i] == ((variant * SEGMENT_COUNT + segment) & 0xff));
+    free(content);
+}
+
+/** Emulate one variant muxing thread outputting its segments. */
+static void *VariantThread(void *data)
+{
+    struct variant_ctx *ctx = data;
+
+    for (unsigned i = 0; i < SEGMENT_COUNT; ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "playlist-%u-%u.ts", ctx->id, i);
+        const struct hls_storage_config storage_conf = {
+            .name = name,
+            .mime = "video/MP2T",
+        };
+
+        block_t *segment = MakeSegment(ctx->id, i);
+        const vlc_tick_t start = vlc_tick_now();
+        ctx->segments[i] =
+            hls_storage_FromBlocks(segment, &storage_conf, ctx->config);
+        ctx->blocked += vlc_tick_now() - start;
+        assert(ctx->segments[i] != NULL);
+        assert(hls_storage_GetSize(ctx->segments[i]) == SEGMENT_SIZE);
+
+        /* Content must be available whether or not it reached the disk. */
+        CheckContent(ctx->segments[i], ctx->id, i);
+    }
+    return NULL;
+}
+
+static vlc_tick_t RunVariants(const struct hls_config *config)
+{
+    struct variant_ctx ctx[VARIANT_COUNT];
+    vlc_thread_t threads[VARIANT_COUNT];
+
+    for (unsigned i = 0; i < VARIANT_COUNT; ++i)
+    {
+        ctx[i].id = i;
+        ctx[i].config = config;
+        ctx[i].blocked = 0;
+        const int status = vlc_clone(&threads[i], VariantThread, &ctx[i]);
+        assert(status == 0);
+    }
+
+    vlc_tick_t blocked = 0;
+    for (unsigned i = 0; i < VARIANT_COUNT; ++i)
+    {
+        vlc_join(threads[i], NULL);
+        blocked += ctx[i].blocked;
+        for (unsigned j = 0; j < SEGMENT_COUNT; ++j)
+            hls_storage_Destroy(ctx[i].segments[j]);
+    }
+    return blocked;
+}
+
+static void CheckOutputDir(const char *outdir)
+{
+    for (unsigned i = 0; i < VARIANT_COUNT; ++i)
+        for (unsigned j = 0; j < SEGMENT_COUNT; ++j)
+        {
+            char *path;
+            int ret = asprintf(&path, "%s/playlist-%u-%u.ts", outdir, i, j);
+            assert(ret != -1);
+
+            FILE *file = fopen(path, "rb");
+            assert(file != NULL);
+            uint8_t *content = malloc(SEGMENT_SIZE);
+            assert(content != NULL);
+            const size_t read = fread(content, 1, SEGMENT_SIZE, file);
+            assert(read == SEGMENT_SIZE);
+            assert(fgetc(file) == EOF);
+            for (size_t k = 0; k < read; ++k)
+                assert(content[k] == ((i * SEGMENT_COUNT + j) & 0xff));
+            free(content);
+            fclose(file);
+
+            ret = unlink(path);
+            assert(ret == 0);
+            free(path);
+        }
+}
+
+/** Write errors must be reported by the storage that failed. */
+static void CheckWriteError(struct hls_config *config)
+{
+    const struct hls_storage_config storage_conf = {
+        .name = "playlist-0-0.ts",
+        .mime = "video/MP2T",
+    };
+
+    if (config->writer == NULL)
+    {
+        hls_storage_t *storage = hls_storage_FromBlocks(MakeSegment(0, 0),
+                                                        &storage_conf, config);
+        assert(storage == NULL);
+        return;
+    }
+
+    /* The queue holds one storage: the next one is created once the first
+     * write failed, which only fails the reads of the first storage */
+    hls_storage_t *failed = hls_storage_FromBlocks(MakeSegment(0, 0),
+                                                   &storage_conf, config);
+    assert(failed != NULL);
+    hls_storage_t *next = hls_storage_FromBlocks(MakeSegment(0, 1),
+                                                 &storage_conf, config);
+    assert(next != NULL);
+
+    uint8_t *content;
+    const ssize_t size = failed->get_content(failed, &content);
+    assert(size == -1);
+
+    hls_storage_Destroy(next);
+    hls_storage_Destroy(failed);
+}
+
+int main(void)
+{
+    test_init();
+
+    const char *const args[] = {
+        "-vvv",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(args), args);
+    if (vlc == NULL)
+        return 1;
+
+    char outdir[] = "/tmp/vlc-test-hls-XXXXXX";
+    if (mkdtemp(outdir) == NULL)
+        return 77;
+
+    struct hls_config config = {
+        .outdir = outdir,
+    };
+
+    /* Synchronous writes from the muxing threads. */
+    const vlc_tick_t sync_blocked = RunVariants(&config);
+    CheckOutputDir(outdir);
+
+    /* Asynchronous writes. */
+    config.writer =
+        hls_storage_writer_New(vlc->p_libvlc_int->obj.logger, 16);
+    assert(config.writer != NULL);
+    const vlc_tick_t async_blocked = RunVariants(&config);
+    hls_storage_writer_Delete(config.writer);
+    CheckOutputDir(outdir);
+
+    /* Write errors, in a missing directory */
+    char missing[sizeof(outdir) + 8];
+    snprintf(missing, sizeof(missing), "%s/missing", outdir);
+    config.outdir = missing;
+    config.writer = NULL;
+    CheckWriteError(&config);
+    config.writer =
+        hls_storage_writer_New(vlc->p_libvlc_int->obj.logger, 1);
+    assert(config.writer != NULL);
+    CheckWriteError(&config);
+    hls_storage_writer_Delete(config.writer);
+
+    /* In-memory storage. */
+    config.outdir = NULL;
+    config.writer = NULL;
+    const vlc_tick_t mem_blocked = RunVariants(&config);
+
+    /* Not asserted, as timings depend on the load of the machine */
+    test_log("%d variants x %d segments of %d KiB, muxing threads blocked "
+             "for: sync %" PRId64 " us, async %" PRId64 " us, "
+             "memory %" PRId64 " us\n",
+             VARIANT_COUNT, SEGMENT_COUNT, SEGMENT_SIZE / 1024,
+             US_FROM_VLC_TICK(sync_blocked), US_FROM_VLC_TICK(async_blocked),
+             US_FROM_VLC_TICK(mem_blocked));
+
+    rmdir(outdir);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -139,6 +139,10 @@ static int OpenFilter(filter_t *filter)
 
 static picture_t *ConverterFilter(filter_t *filter, picture_t *input)
 {
+    struct transcode_scenario *scenario = &transcode_scenarios[current_scenario];
+    if (scenario->converter_convert != NULL)
+        input = scenario->converter_convert(filter, input);
+
     video_format_Clean(&input->format);
     video_format_Copy(&input->format, &filter->fmt_out.video);
     return input;
@@ -172,6 +176,8 @@ static vlc_frame_t *EncodeVideo(encoder_t *enc, picture_t *pic)
 
     assert(pic->format.i_chroma == enc->fmt_in.video.i_chroma);
     vlc_frame_t *frame = vlc_frame_Alloc(4);
+    assert(frame != NULL);
+    frame->i_pts = frame->i_dts = pic->date;
 
     struct transcode_scenario *scenario = &transcode_scenarios[current_scenario];
     if (scenario->encoder_encode != NULL)
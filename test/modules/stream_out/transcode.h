@@ -35,8 +35,13 @@ struct transcode_scenario {
     void (*encoder_encode)(encoder_t *, picture_t *);
     void (*filter_setup)(filter_t *);
     void (*converter_setup)(filter_t *);
+    picture_t *(*converter_convert)(filter_t *, picture_t *);
     void (*report_error)(sout_stream_t *);
     void (*report_output)(const vlc_frame_t *);
+    unsigned expected_decoders;
+    unsigned expected_encoders;
+    unsigned expected_heights[4]; /* encoded rendition heights */
+    size_t max_pool_slots;
 };
 
 
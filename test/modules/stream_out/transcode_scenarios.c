@@ -30,16 +30,37 @@
 #include "transcode.h"
 
 #include <vlc_filter.h>
+#include <vlc_picture.h>
 
 static struct scenario_data
 {
     vlc_sem_t wait_stop;
+    vlc_mutex_t counter_lock;
     struct vlc_video_context *decoder_vctx;
     unsigned output_frame_count;
+    unsigned decoded_frame_count;
+    unsigned decoder_count;
+    unsigned encoder_count;
+    unsigned converter_count;
     bool converter_opened;
     bool encoder_opened;
     bool encoder_closed;
     bool error_reported;
+    bool stop_posted;
+    unsigned output_frame_target;
+    vlc_tick_t last_output_date;
+    vlc_tick_t first_output;
+    vlc_tick_t last_output;
+    unsigned encoded_picture_count;
+    const void *pool_slots[64];
+    size_t pool_slot_count;
+    struct
+    {
+        unsigned width;
+        unsigned height;
+        unsigned picture_count;
+    } renditions[4];
+    size_t rendition_count;
 } scenario_data;
 
 static void decoder_fixed_size(decoder_t *dec, vlc_fourcc_t chroma,
@@ -59,6 +80,14 @@ static void decoder_fixed_size(decoder_t *dec, vlc_fourcc_t chroma,
 static void decoder_i420_800_600(decoder_t *dec)
     { decoder_fixed_size(dec, VLC_CODEC_I420, 800, 600); }
 
+static void decoder_i420_800_600_counted(decoder_t *dec)
+{
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    ++scenario_data.decoder_count;
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+    decoder_i420_800_600(dec);
+}
+
 static void decoder_nv12_800_600(decoder_t *dec)
     { decoder_fixed_size(dec, VLC_CODEC_NV12, 800, 600); }
 
@@ -136,6 +165,23 @@ static int decoder_decode_vctx_update(decoder_t *dec, picture_t *pic)
     return VLC_SUCCESS;
 }
 
+static int decoder_decode_counted(decoder_t *dec, picture_t *pic)
+{
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    ++scenario_data.decoded_frame_count;
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+    return decoder_decode_dummy(dec, pic);
+}
+
+/* Simulated cost of each pipeline stage for the throughput scenarios */
+#define STAGE_COST VLC_TICK_FROM_MS(4)
+
+static int decoder_decode_slow(decoder_t *dec, picture_t *pic)
+{
+    vlc_tick_sleep(STAGE_COST);
+    return decoder_decode_counted(dec, pic);
+}
+
 static int decoder_decode_error(decoder_t *dec, picture_t *pic)
 {
     (void)dec;
@@ -194,12 +240,101 @@ static void encoder_i420_800_600_no_vctx(encoder_t *enc)
 }
 #endif
 
+/* Every rendition keeps the size computed by transcode from its
+ * configuration, each one smaller than the previous one. */
+static void encoder_i420_rendition(encoder_t *enc)
+{
+    enc->fmt_in.video.i_chroma
+        = enc->fmt_in.i_codec
+        = VLC_CODEC_I420;
+
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    static const unsigned heights[] = { 600, 400, 200 };
+    assert(scenario_data.encoder_count < ARRAY_SIZE(heights));
+    assert(enc->fmt_in.video.i_visible_height ==
+           heights[scenario_data.encoder_count]);
+    ++scenario_data.encoder_count;
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+
+    msg_Info(enc, "Setting up the rendition encoder %ux%u",
+             enc->fmt_in.video.i_visible_width,
+             enc->fmt_in.video.i_visible_height);
+    scenario_data.encoder_opened = true;
+}
+
+static void encoder_i420_any_size(encoder_t *enc)
+{
+    enc->fmt_in.video.i_chroma
+        = enc->fmt_in.i_codec
+        = VLC_CODEC_I420;
+
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    ++scenario_data.encoder_count;
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+    scenario_data.encoder_opened = true;
+}
+
 static void encoder_encode_dummy(encoder_t *enc, picture_t *pic)
 {
     (void)enc; (void)pic;
     msg_Info(enc, "Encode");
 }
 
+/* Count the pictures encoded for each rendition size. */
+static void encoder_encode_renditions(encoder_t *enc, picture_t *pic)
+{
+    const unsigned width = pic->format.i_visible_width;
+    const unsigned height = pic->format.i_visible_height;
+    assert(width == enc->fmt_in.video.i_visible_width);
+    assert(height == enc->fmt_in.video.i_visible_height);
+
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    size_t i;
+    for (i = 0; i < scenario_data.rendition_count; ++i)
+        if (scenario_data.renditions[i].height == height)
+            break;
+    if (i == scenario_data.rendition_count)
+    {
+        assert(i < ARRAY_SIZE(scenario_data.renditions));
+        scenario_data.renditions[i].width = width;
+        scenario_data.renditions[i].height = height;
+        scenario_data.renditions[i].picture_count = 0;
+        scenario_data.rendition_count++;
+    }
+    assert(scenario_data.renditions[i].width == width);
+    ++scenario_data.renditions[i].picture_count;
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+}
+
+static void encoder_encode_slow(encoder_t *enc, picture_t *pic)
+{
+    (void)enc; (void)pic;
+    vlc_tick_sleep(STAGE_COST);
+}
+
+/* Count the distinct pixel buffers of the pictures reaching the encoder. A
+ * pooled picture is a clone sharing the planes of its slot, which live as
+ * long as the pool, so recycled pictures keep using the same few buffers. */
+static void encoder_encode_track_pool_slots(encoder_t *enc, picture_t *pic)
+{
+    (void)enc;
+    assert(pic->i_planes > 0);
+    const void *slot = pic->p[0].p_pixels;
+
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    ++scenario_data.encoded_picture_count;
+    size_t i;
+    for (i = 0; i < scenario_data.pool_slot_count; ++i)
+        if (scenario_data.pool_slots[i] == slot)
+            break;
+    if (i == scenario_data.pool_slot_count)
+    {
+        assert(scenario_data.pool_slot_count < ARRAY_SIZE(scenario_data.pool_slots));
+        scenario_data.pool_slots[scenario_data.pool_slot_count++] = slot;
+    }
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+}
+
 static void encoder_close(encoder_t *enc)
 {
     (void)enc;
@@ -216,6 +351,46 @@ static void wait_output_10_frames_reported(const vlc_frame_t *out)
         vlc_sem_post(&scenario_data.wait_stop);
 }
 
+/* Count the output frames, from any thread, and stop the scenario once
+ * `target` frames were output. The frames of a single encoder must be
+ * output in order. */
+static void wait_output_frames(const vlc_frame_t *out, unsigned target,
+                               bool ordered)
+{
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    scenario_data.output_frame_target = target;
+    for (; out != NULL; out = out->p_next )
+    {
+        if (ordered)
+        {
+            assert(out->i_dts != VLC_TICK_INVALID);
+            assert(scenario_data.last_output_date == VLC_TICK_INVALID ||
+                   out->i_dts > scenario_data.last_output_date);
+            scenario_data.last_output_date = out->i_dts;
+        }
+
+        /* Skip the first frame, which includes the chain setup. */
+        if (scenario_data.output_frame_count++ == 0)
+            scenario_data.first_output = vlc_tick_now();
+        else if (scenario_data.output_frame_count == target)
+            scenario_data.last_output = vlc_tick_now();
+    }
+
+    if (scenario_data.output_frame_count >= target && !scenario_data.stop_posted)
+    {
+        scenario_data.stop_posted = true;
+        vlc_sem_post(&scenario_data.wait_stop);
+    }
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+}
+
+/* The renditions of a ladder are output by concurrent encoders */
+static void wait_output_30_frames_reported(const vlc_frame_t *out)
+    { wait_output_frames(out, 30, false); }
+
+static void wait_output_60_frames_ordered(const vlc_frame_t *out)
+    { wait_output_frames(out, 60, true); }
+
 static void wait_output_reported(const vlc_frame_t *out)
 {
     (void)out;
@@ -241,6 +416,37 @@ static void converter_fixed_size(filter_t *filter, vlc_fourcc_t chroma_in,
     scenario_data.converter_opened = true;
 }
 
+static void converter_downscale(filter_t *filter)
+{
+    assert(filter->fmt_in.video.i_chroma == VLC_CODEC_I420);
+    assert(filter->fmt_out.video.i_chroma == VLC_CODEC_I420);
+    assert(filter->fmt_out.video.i_visible_height <
+           filter->fmt_in.video.i_visible_height);
+
+    vlc_mutex_lock(&scenario_data.counter_lock);
+    ++scenario_data.converter_count;
+    vlc_mutex_unlock(&scenario_data.counter_lock);
+    scenario_data.converter_opened = true;
+}
+
+static picture_t *converter_convert_slow(filter_t *filter, picture_t *pic)
+{
+    (void)filter;
+    vlc_tick_sleep(STAGE_COST);
+    return pic;
+}
+
+/* Output to a new picture from the owner, like actual scalers do. */
+static picture_t *converter_convert_new_picture(filter_t *filter,
+                                                picture_t *pic)
+{
+    picture_t *out = filter_NewPicture(filter);
+    assert(out != NULL);
+    picture_CopyProperties(out, pic);
+    picture_Release(pic);
+    return out;
+}
+
 static void converter_i420_to_nv12_800_600(filter_t *filter)
     { converter_fixed_size(filter, VLC_CODEC_I420, VLC_CODEC_NV12, 800, 600); }
 
@@ -356,6 +562,81 @@ struct transcode_scenario transcode_scenarios[] =
     .encoder_close = encoder_close,
     .converter_setup = converter_nv12_to_i420_800_600_vctx,
     .report_output = wait_output_10_frames_reported,
+},{
+    /* Make sure a ladder decodes once and scales every rendition from the
+     * previous one. */
+    .source = source_800_600,
+    .sout = "sout=#transcode{ladder=\"400:500,200:250\"}:output_checker",
+    .decoder_setup = decoder_i420_800_600_counted,
+    .decoder_decode = decoder_decode_counted,
+    .encoder_setup = encoder_i420_rendition,
+    .encoder_encode = encoder_encode_renditions,
+    .encoder_close = encoder_close,
+    .converter_setup = converter_downscale,
+    .report_output = wait_output_30_frames_reported,
+    .expected_decoders = 1,
+    .expected_encoders = 3,
+    .expected_heights = { 600, 400, 200 },
+},{
+    /* Same renditions through independent transcode chains, as a reference
+     * for the decoding work saved by the ladder. */
+    .source = source_800_600,
+    .sout = "sout=#duplicate{"
+                "dst=transcode:output_checker,"
+                "dst=transcode{height=400,vb=500}:output_checker,"
+                "dst=transcode{height=200,vb=250}:output_checker}",
+    .decoder_setup = decoder_i420_800_600_counted,
+    .decoder_decode = decoder_decode_counted,
+    .encoder_setup = encoder_i420_any_size,
+    .encoder_encode = encoder_encode_renditions,
+    .encoder_close = encoder_close,
+    .converter_setup = converter_downscale,
+    .report_output = wait_output_30_frames_reported,
+    .expected_decoders = 3,
+    .expected_encoders = 3,
+    .expected_heights = { 600, 400, 200 },
+},{
+    /* Throughput reference: scaling runs on the decoder thread. */
+    .source = source_800_600,
+    .sout = "sout=#transcode{height=400,threads=1}:output_checker",
+    .decoder_setup = decoder_i420_800_600,
+    .decoder_decode = decoder_decode_slow,
+    .encoder_setup = encoder_i420_any_size,
+    .encoder_encode = encoder_encode_slow,
+    .encoder_close = encoder_close,
+    .converter_setup = converter_downscale,
+    .converter_convert = converter_convert_slow,
+    .report_output = wait_output_60_frames_ordered,
+    .expected_encoders = 1,
+},{
+    /* Throughput with decoding, scaling and encoding on separate threads. */
+    .source = source_800_600,
+    .sout = "sout=#transcode{height=400,threads=1,pipeline}:output_checker",
+    .decoder_setup = decoder_i420_800_600,
+    .decoder_decode = decoder_decode_slow,
+    .encoder_setup = encoder_i420_any_size,
+    .encoder_encode = encoder_encode_slow,
+    .encoder_close = encoder_close,
+    .converter_setup = converter_downscale,
+    .converter_convert = converter_convert_slow,
+    .report_output = wait_output_60_frames_ordered,
+    .expected_encoders = 1,
+},{
+    /* Scaled pictures must be recycled instead of allocated for every
+     * frame: threads=0 and the default pool-size of 10 make a pool of 14
+     * pictures. */
+    .source = source_800_600,
+    .sout = "sout=#transcode{height=400}:output_checker",
+    .decoder_setup = decoder_i420_800_600,
+    .decoder_decode = decoder_decode_counted,
+    .encoder_setup = encoder_i420_any_size,
+    .encoder_encode = encoder_encode_track_pool_slots,
+    .encoder_close = encoder_close,
+    .converter_setup = converter_downscale,
+    .converter_convert = converter_convert_new_picture,
+    .report_output = wait_output_60_frames_ordered,
+    .expected_encoders = 1,
+    .max_pool_slots = 14,
 },{
     /* Ensure that error are correctly forwarded back to the stream output
      * pipeline. */
@@ -372,9 +653,22 @@ void transcode_scenario_init(void)
 {
     scenario_data.decoder_vctx = NULL;
     scenario_data.output_frame_count = 0;
+    scenario_data.decoded_frame_count = 0;
+    scenario_data.decoder_count = 0;
+    scenario_data.encoder_count = 0;
+    scenario_data.converter_count = 0;
     scenario_data.converter_opened = false;
     scenario_data.encoder_opened = false;
+    scenario_data.stop_posted = false;
+    scenario_data.encoded_picture_count = 0;
+    scenario_data.pool_slot_count = 0;
+    scenario_data.rendition_count = 0;
+    scenario_data.output_frame_target = 0;
+    scenario_data.last_output_date = VLC_TICK_INVALID;
+    scenario_data.first_output = VLC_TICK_INVALID;
+    scenario_data.last_output = VLC_TICK_INVALID;
     vlc_sem_init(&scenario_data.wait_stop, 0);
+    vlc_mutex_init(&scenario_data.counter_lock);
 }
 
 void transcode_scenario_wait(struct transcode_scenario *scenario)
@@ -393,4 +687,69 @@ void transcode_scenario_check(struct transcode_scenario *scenario)
 
     if (scenario_data.encoder_opened && scenario->encoder_close != NULL)
         assert(scenario_data.encoder_closed);
+
+    if (scenario->max_pool_slots != 0)
+    {
+        fprintf(stderr, "%u pictures encoded from %zu pool slots\n",
+                scenario_data.encoded_picture_count,
+                scenario_data.pool_slot_count);
+        assert(scenario_data.encoded_picture_count >= 60);
+        assert(scenario_data.pool_slot_count <= scenario->max_pool_slots);
+    }
+
+    if (scenario_data.output_frame_target != 0)
+    {
+        /* Every output frame comes from a decoded picture */
+        assert(scenario_data.output_frame_count >=
+               scenario_data.output_frame_target);
+        if (scenario_data.decoded_frame_count > 0)
+            assert(scenario_data.output_frame_count <=
+                   scenario_data.decoded_frame_count *
+                   __MAX(scenario->expected_encoders, 1));
+
+        /* Not asserted, as timings depend on the load of the machine */
+        const vlc_tick_t elapsed =
+            scenario_data.last_output - scenario_data.first_output;
+        fprintf(stderr, "%s: %.1f frames/s\n", scenario->sout,
+                (scenario_data.output_frame_target - 1) * (double)CLOCK_FREQ
+                / elapsed);
+    }
+
+    if (scenario->expected_decoders != 0)
+        assert(scenario_data.decoder_count == scenario->expected_decoders);
+
+    /* Every rendition is encoded, at its size and with the source aspect
+     * ratio */
+    size_t rendition_count = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(scenario->expected_heights)
+                    && scenario->expected_heights[i] != 0; ++i)
+    {
+        const unsigned height = scenario->expected_heights[i];
+        size_t j;
+        for (j = 0; j < scenario_data.rendition_count; ++j)
+            if (scenario_data.renditions[j].height == height)
+                break;
+        assert(j < scenario_data.rendition_count);
+        assert(scenario_data.renditions[j].picture_count > 0);
+
+        const unsigned width = scenario_data.renditions[j].width;
+        assert(width + 2 >= height * 4 / 3 && width <= height * 4 / 3 + 2);
+        rendition_count++;
+    }
+    if (rendition_count > 0)
+        assert(scenario_data.rendition_count == rendition_count);
+
+    if (scenario->expected_encoders != 0)
+    {
+        assert(scenario_data.encoder_count == scenario->expected_encoders);
+        assert(scenario_data.decoded_frame_count > 0);
+        fprintf(stderr, "%u encoders: %u pictures decoded, %u frames output "
+                "(%.2f decoded pictures per output frame), %u scalers\n",
+                scenario_data.encoder_count,
+                scenario_data.decoded_frame_count,
+                scenario_data.output_frame_count,
+                (double)scenario_data.decoded_frame_count /
+                    scenario_data.output_frame_count,
+                scenario_data.converter_count);
+    }
 }
@@ -25,9 +25,11 @@
 #include <vlc_common.h>
 #include <vlc_tick.h>
 #include <vlc_es.h>
+#include <vlc_aout.h>
 #include <vlc_tracer.h>
 
 #include "../../../src/clock/clock.h"
+#include "../../../src/clock/input_clock.h"
 
 #include <vlc/vlc.h>
 #include "../../libvlc/test.h"
@@ -43,6 +45,23 @@ const char vlc_module_name[] = MODULE_STRING;
 
 struct clock_ctx;
 
+/* Parameters of a simulated live playback, cf. simulate() */
+struct clock_sim
+{
+    bool input_master; /* the input (PCR) is the clock source, as for IPTV */
+    vlc_tick_t pts_delay; /* input buffering */
+    vlc_tick_t pcr_period;
+    vlc_tick_t pcr_jitter; /* maximum network delay of a PCR */
+    int input_drift_ppm; /* drift of the sender clock */
+    int aout_drift_ppm; /* drift of the audio output clock */
+    vlc_tick_t aout_jitter; /* maximum error of the audio output delay */
+    vlc_tick_t dropout_period; /* interval between PCR dropouts, or 0 */
+    vlc_tick_t dropout_duration;
+
+    vlc_tick_t max_sync_error; /* maximum A/V sync error expected */
+    unsigned max_flushes; /* maximum audio flushes and silences expected */
+};
+
 struct clock_scenario
 {
     const char *name;
@@ -51,6 +70,7 @@ struct clock_scenario
     enum {
         CLOCK_SCENARIO_UPDATE,
         CLOCK_SCENARIO_RUN,
+        CLOCK_SCENARIO_SIMULATION,
     } type;
 
     union {
@@ -67,6 +87,7 @@ struct clock_scenario
                            vlc_tick_t *system, vlc_tick_t stream);
             void (*check)(const struct clock_ctx *ctx, size_t update_count,
                           vlc_tick_t expected_system_end, vlc_tick_t stream_end);
+            const struct clock_sim *sim;
         };
         void (*run)(const struct clock_ctx *ctx);
     };
@@ -74,9 +95,11 @@ struct clock_scenario
 
 struct clock_ctx
 {
+    vlc_object_t *obj;
     vlc_clock_main_t *mainclk;
     vlc_clock_t *master;
     vlc_clock_t *slave;
+    vlc_clock_t *input_master; /* only for input master simulations */
 
     const struct clock_scenario *scenario;
 };
@@ -300,13 +323,16 @@ VLC_EXPORT const vlc_plugin_cb vlc_static_modules[] = {
     NULL
 };
 
+static void simulate(const struct clock_ctx *ctx);
+
 static void play_scenario(libvlc_int_t *vlc, struct vlc_tracer *tracer,
                           struct clock_scenario *scenario)
 {
     fprintf(stderr, "[%s]: checking that %s\n", scenario->name, scenario->desc);
 
     assert((scenario->type == CLOCK_SCENARIO_UPDATE && scenario->update != NULL)
-        || (scenario->type == CLOCK_SCENARIO_RUN && scenario->run != NULL));
+        || (scenario->type == CLOCK_SCENARIO_RUN && scenario->run != NULL)
+        || (scenario->type == CLOCK_SCENARIO_SIMULATION && scenario->sim != NULL));
 
     tracer_ctx_Reset(&tracer_ctx);
 
@@ -326,12 +352,23 @@ static void play_scenario(libvlc_int_t *vlc, struct vlc_tracer *tracer,
     vlc_clock_t *slave = vlc_clock_main_CreateSlave(mainclk, slave_name, VIDEO_ES,
                                                     NULL, NULL);
     assert(slave != NULL);
+
+    vlc_clock_t *input_master = NULL;
+    if (scenario->type == CLOCK_SCENARIO_SIMULATION && scenario->sim->input_master)
+    {
+        /* Demote the master as a slave, as the audio output of an IPTV
+         * playback */
+        input_master = vlc_clock_main_CreateInputMaster(mainclk);
+        assert(input_master != NULL);
+    }
     vlc_clock_main_Unlock(mainclk);
 
     const struct clock_ctx ctx = {
+        .obj = VLC_OBJECT(vlc),
         .mainclk = mainclk,
         .master = master,
         .slave = slave,
+        .input_master = input_master,
         .scenario = scenario,
     };
 
@@ -341,6 +378,12 @@ static void play_scenario(libvlc_int_t *vlc, struct vlc_tracer *tracer,
         goto end;
     }
 
+    if (scenario->type == CLOCK_SCENARIO_SIMULATION)
+    {
+        simulate(&ctx);
+        goto end;
+    }
+
     vlc_tick_t stream_end = scenario->stream_start + scenario->duration;
     vlc_tick_t stream = scenario->stream_start;
     if (scenario->system_start == VLC_TICK_INVALID)
@@ -392,6 +435,9 @@ static void play_scenario(libvlc_int_t *vlc, struct vlc_tracer *tracer,
 end:
     vlc_clock_Delete(master);
     vlc_clock_Delete(slave);
+    /* The input master must be deleted last */
+    if (input_master != NULL)
+        vlc_clock_Delete(input_master);
     free(slave_name);
     vlc_clock_main_Delete(mainclk);
 }
@@ -726,6 +772,304 @@ static void monotonic_convert_paused_run(const struct clock_ctx *ctx)
     convert_paused_common(ctx, ctx->slave);
 }
 
+/*
+ * Simulation of a live playback, on a fake system clock:
+ *  - the sender clock drifts from the local one, and the PCRs are received
+ *    with a random network delay, or lost during dropouts,
+ *  - the PCRs feed an input clock, that drives the main clock when the input
+ *    is the clock source,
+ *  - the audio output plays the blocks with its own drifting clock, and
+ *    reports its delay with some jitter; its drift is corrected by
+ *    resampling, as done by src/audio_output/dec.c,
+ *  - the video is displayed at the dates converted by its clock.
+ *
+ * The random values are seeded, so that the runs are reproducible.
+ */
+#define SIM_AOUT_RATE 48000
+
+struct clock_sim_aout
+{
+    vlc_tick_t system; /* play date of the next block */
+    bool started;
+
+    /* Resampling, as in src/audio_output/dec.c */
+    enum { SIM_RESAMPLING_NONE, SIM_RESAMPLING_UP, SIM_RESAMPLING_DOWN } type;
+    vlc_tick_t start_drift;
+    int resampling; /* Hz */
+
+    /* Statistics */
+    size_t resampled_blocks;
+    unsigned resampling_starts;
+    int max_resampling;
+    unsigned flushes;
+    unsigned silences;
+};
+
+static uint64_t sim_Random(uint64_t *state)
+{
+    /* xorshift64* */
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * UINT64_C(2685821657736338717);
+}
+
+/* Uniform random delay in [0, max] */
+static vlc_tick_t sim_RandomDelay(uint64_t *state, vlc_tick_t max)
+{
+    return max > 0 ? (vlc_tick_t)(sim_Random(state) % (max + 1)) : 0;
+}
+
+static vlc_tick_t sim_Drift(vlc_tick_t duration, int ppm)
+{
+    return duration * ppm / 1000000;
+}
+
+static void sim_aout_StopResampling(struct clock_sim_aout *aout)
+{
+    aout->type = SIM_RESAMPLING_NONE;
+    aout->resampling = 0;
+}
+
+/* Port of stream_HandleDrift(), without the filters */
+static void sim_aout_HandleDrift(struct clock_sim_aout *aout, vlc_tick_t drift)
+{
+    drift = -drift;
+
+    if (drift > 3 * AOUT_MAX_PTS_DELAY)
+    {
+        /* Flush the buffers: the next block is played on time */
+        aout->flushes++;
+        aout->system -= drift;
+        sim_aout_StopResampling(aout);
+        return;
+    }
+
+    if (drift < -3 * AOUT_MAX_PTS_ADVANCE)
+    {
+        /* Play silence until the block is on time */
+        aout->silences++;
+        aout->system += -drift;
+        sim_aout_StopResampling(aout);
+        drift = 0;
+    }
+
+    if (drift > +AOUT_MAX_PTS_DELAY && aout->type != SIM_RESAMPLING_UP)
+    {
+        aout->type = SIM_RESAMPLING_UP;
+        aout->start_drift = +drift;
+        aout->resampling_starts++;
+    }
+    if (drift < -AOUT_MAX_PTS_ADVANCE && aout->type != SIM_RESAMPLING_DOWN)
+    {
+        aout->type = SIM_RESAMPLING_DOWN;
+        aout->start_drift = -drift;
+        aout->resampling_starts++;
+    }
+
+    if (aout->type == SIM_RESAMPLING_NONE)
+        return;
+
+    if (llabs(drift) > 2 * aout->start_drift)
+    {
+        sim_aout_StopResampling(aout);
+        return;
+    }
+
+    int adj = aout->type == SIM_RESAMPLING_UP ? +2 : -2;
+    if (2 * llabs(drift) <= aout->start_drift)
+        adj *= -1;
+
+    aout->resampling += adj;
+    if (aout->resampling == 0)
+        aout->type = SIM_RESAMPLING_NONE;
+    if (abs(aout->resampling) > aout->max_resampling)
+        aout->max_resampling = abs(aout->resampling);
+}
+
+static unsigned tracer_ctx_CountResets(struct tracer_ctx *ctx)
+{
+    unsigned resets = 0;
+
+    for (size_t i = 0; i < ctx->events.size; ++i)
+        if (ctx->events.data[i].type == TRACER_EVENT_TYPE_STATUS
+         && ctx->events.data[i].status == TRACER_EVENT_STATUS_RESET_BADSOURCE)
+            resets++;
+
+    /* Don't keep the events of hours of playback */
+    ctx->events.size = 0;
+    return resets;
+}
+
+static vlc_tick_t
+sim_InputClockUpdate(void *opaque, vlc_tick_t ck_system,
+                     vlc_tick_t ck_stream, double rate)
+{
+    vlc_clock_t *input_master = opaque;
+    vlc_clock_Lock(input_master);
+    vlc_tick_t drift =
+        vlc_clock_Update(input_master, ck_system, ck_stream, rate);
+    vlc_clock_Unlock(input_master);
+    return drift;
+}
+
+static void sim_InputClockReset(void *opaque)
+{
+    vlc_clock_t *input_master = opaque;
+    vlc_clock_Lock(input_master);
+    vlc_clock_Reset(input_master);
+    vlc_clock_Unlock(input_master);
+}
+
+static void simulate(const struct clock_ctx *ctx)
+{
+    const struct clock_scenario *scenario = ctx->scenario;
+    const struct clock_sim *sim = scenario->sim;
+    const vlc_tick_t block_length = scenario->stream_increment;
+    const vlc_tick_t frame_length = vlc_tick_rate_duration(scenario->video_fps);
+    uint64_t seed = 0x2545F4914F6CDD1D;
+
+    static const struct vlc_input_clock_cbs input_clock_cbs = {
+        .update = sim_InputClockUpdate,
+        .reset = sim_InputClockReset,
+    };
+
+    input_clock_t *input_clock = input_clock_New(1.f);
+    assert(input_clock != NULL);
+    input_clock_SetJitter(input_clock, sim->pts_delay, 40);
+
+    if (ctx->input_master != NULL)
+        input_clock_AttachListener(input_clock, &input_clock_cbs,
+                                   ctx->input_master);
+
+    vlc_clock_main_Lock(ctx->mainclk);
+    vlc_clock_main_SetInputDejitter(ctx->mainclk, sim->pts_delay);
+    vlc_clock_main_Unlock(ctx->mainclk);
+
+    struct clock_sim_aout aout = { .type = SIM_RESAMPLING_NONE };
+
+    vlc_tick_t next_pcr = scenario->stream_start;
+    vlc_tick_t next_frame = scenario->stream_start;
+    const vlc_tick_t stream_end = scenario->stream_start + scenario->duration;
+
+    vlc_tick_t sync_error_max = 0, sync_error_sum = 0;
+    size_t frames = 0, blocks = 0;
+    vlc_tick_t margin_min = VLC_TICK_MAX, margin_max = VLC_TICK_MIN;
+    unsigned resets = 0;
+
+    for (vlc_tick_t pts = scenario->stream_start; pts < stream_end;
+         pts += block_length, ++blocks)
+    {
+        /* Date at which the block is sent, according to the local clock */
+        const vlc_tick_t sent = scenario->system_start + pts
+            - scenario->stream_start
+            + sim_Drift(pts - scenario->stream_start, sim->input_drift_ppm);
+
+        /* Receive the PCRs sent until the block is played */
+        while (next_pcr <= pts + sim->pts_delay)
+        {
+            const vlc_tick_t elapsed = next_pcr - scenario->stream_start;
+            const vlc_tick_t arrival = scenario->system_start + elapsed
+                + sim_Drift(elapsed, sim->input_drift_ppm)
+                + sim_RandomDelay(&seed, sim->pcr_jitter);
+
+            bool lost = sim->dropout_period > 0
+                     && elapsed % sim->dropout_period
+                        >= sim->dropout_period - sim->dropout_duration;
+            if (!lost)
+            {
+                tracer_ctx.forced_ts = arrival;
+                vlc_clock_main_Lock(ctx->mainclk);
+                vlc_clock_main_SetFirstPcr(ctx->mainclk, arrival, next_pcr);
+                vlc_clock_main_Unlock(ctx->mainclk);
+                input_clock_Update(input_clock, ctx->obj, false, false,
+                                   next_pcr, arrival);
+            }
+            next_pcr += sim->pcr_period;
+        }
+
+        /* The first block is played on time */
+        if (!aout.started)
+        {
+            vlc_clock_Lock(ctx->master);
+            aout.system = vlc_clock_ConvertToSystem(ctx->master, sent, pts,
+                                                    1.0f);
+            vlc_clock_Unlock(ctx->master);
+            aout.started = true;
+        }
+
+        tracer_ctx.forced_ts = aout.system;
+        const vlc_tick_t reported = aout.system
+            + sim_RandomDelay(&seed, 2 * sim->aout_jitter) - sim->aout_jitter;
+        vlc_clock_Lock(ctx->master);
+        vlc_tick_t drift = vlc_clock_Update(ctx->master, reported, pts, 1.0f);
+        vlc_clock_Unlock(ctx->master);
+        if (drift != VLC_TICK_INVALID && drift != VLC_TICK_MAX)
+            sim_aout_HandleDrift(&aout, drift);
+
+        if (aout.resampling != 0)
+            aout.resampled_blocks++;
+
+        /* Duration of the block on the local clock */
+        const double speed = (1. + aout.resampling / (double) SIM_AOUT_RATE)
+                           * (1. + sim->aout_drift_ppm / 1e6);
+        const vlc_tick_t played = block_length / speed;
+
+        /* Time spent by the block in the input buffer */
+        const vlc_tick_t margin = aout.system - sent;
+        if (margin < margin_min)
+            margin_min = margin;
+        if (margin > margin_max)
+            margin_max = margin;
+
+        /* Display the frames of the block, and compare with the audio */
+        for (; next_frame < pts + block_length; next_frame += frame_length)
+        {
+            const vlc_tick_t audio_date =
+                aout.system + (next_frame - pts) / speed;
+
+            vlc_clock_Lock(ctx->slave);
+            const vlc_tick_t video_date =
+                vlc_clock_ConvertToSystem(ctx->slave, audio_date, next_frame,
+                                          1.0f);
+            vlc_clock_Update(ctx->slave, video_date, next_frame, 1.0f);
+            vlc_clock_Unlock(ctx->slave);
+
+            const vlc_tick_t error = llabs(video_date - audio_date);
+            if (error > sync_error_max)
+                sync_error_max = error;
+            sync_error_sum += error;
+            frames++;
+        }
+
+        aout.system += played;
+
+        if (blocks % 1000 == 0)
+            resets += tracer_ctx_CountResets(&tracer_ctx);
+    }
+    resets += tracer_ctx_CountResets(&tracer_ctx);
+
+    fprintf(stderr, "[%s]: %"PRId64" s played: A/V sync error mean %.3f ms, "
+            "max %.3f ms\n", scenario->name, SEC_FROM_VLC_TICK(scenario->duration),
+            frames > 0 ? secf_from_vlc_tick(sync_error_sum / frames) * 1000. : 0.,
+            secf_from_vlc_tick(sync_error_max) * 1000.);
+    fprintf(stderr, "[%s]: resampling %.2f%% of the time (%u starts, max %d Hz), "
+            "%u flushes, %u silences, %u clock resets\n", scenario->name,
+            blocks > 0 ? aout.resampled_blocks * 100. / blocks : 0.,
+            aout.resampling_starts, aout.max_resampling, aout.flushes,
+            aout.silences, resets);
+    /* Otherwise, the input would be paced by the audio output */
+    if (sim->input_master)
+        fprintf(stderr, "[%s]: input buffering from %.3f to %.3f ms\n",
+                scenario->name, secf_from_vlc_tick(margin_min) * 1000.,
+                secf_from_vlc_tick(margin_max) * 1000.);
+
+    assert(sync_error_max <= sim->max_sync_error);
+    assert(aout.flushes + aout.silences <= sim->max_flushes);
+
+    input_clock_Delete(input_clock);
+}
+
 #define VLC_TICK_12H VLC_TICK_FROM_SEC(12 * 60 * 60)
 #define VLC_TICK_2H VLC_TICK_FROM_SEC(2 * 60 * 60)
 #define DEFAULT_STREAM_INCREMENT VLC_TICK_FROM_MS(100)
@@ -737,6 +1081,53 @@ static void monotonic_convert_paused_run(const struct clock_ctx *ctx)
     .stream_increment = increment_, \
     .video_fps = video_fps_
 
+/* The simulation runs on a fake system clock */
+#define INIT_SIMULATION_TIMING(duration_, video_fps_) \
+    .stream_start = VLC_TICK_0 + VLC_TICK_FROM_MS(31000000), \
+    .system_start = VLC_TICK_0 + VLC_TICK_FROM_SEC(3600), \
+    .duration = duration_, \
+    .stream_increment = VLC_TICK_FROM_MS(20), \
+    .video_fps = video_fps_
+
+static const struct clock_sim sim_audio_master = {
+    .pts_delay = VLC_TICK_FROM_MS(300),
+    .pcr_period = VLC_TICK_FROM_MS(40),
+    .pcr_jitter = VLC_TICK_FROM_MS(20),
+    .input_drift_ppm = 0,
+    .aout_drift_ppm = 50,
+    .aout_jitter = VLC_TICK_FROM_MS(2),
+    /* The video only suffers from the audio output jitter */
+    .max_sync_error = VLC_TICK_FROM_MS(5),
+    .max_flushes = 0,
+};
+
+static const struct clock_sim sim_input_master = {
+    .input_master = true,
+    .pts_delay = VLC_TICK_FROM_MS(300),
+    .pcr_period = VLC_TICK_FROM_MS(40),
+    .pcr_jitter = VLC_TICK_FROM_MS(20),
+    .input_drift_ppm = 30,
+    .aout_drift_ppm = -50,
+    .aout_jitter = VLC_TICK_FROM_MS(2),
+    /* The audio output only resamples beyond AOUT_MAX_PTS_DELAY */
+    .max_sync_error = AOUT_MAX_PTS_DELAY + VLC_TICK_FROM_MS(20),
+    .max_flushes = 0,
+};
+
+static const struct clock_sim sim_dropouts = {
+    .input_master = true,
+    .pts_delay = VLC_TICK_FROM_MS(300),
+    .pcr_period = VLC_TICK_FROM_MS(40),
+    .pcr_jitter = VLC_TICK_FROM_MS(50),
+    .input_drift_ppm = -30,
+    .aout_drift_ppm = 50,
+    .aout_jitter = VLC_TICK_FROM_MS(5),
+    .dropout_period = VLC_TICK_FROM_SEC(60),
+    .dropout_duration = VLC_TICK_FROM_SEC(2),
+    .max_sync_error = AOUT_MAX_PTS_DELAY + VLC_TICK_FROM_MS(20),
+    .max_flushes = 0,
+};
+
 static struct clock_scenario clock_scenarios[] = {
 {
     .name = "normal",
@@ -824,6 +1215,27 @@ static struct clock_scenario clock_scenarios[] = {
     .type = CLOCK_SCENARIO_RUN,
     .run = monotonic_convert_paused_run,
 },
+{
+    .name = "sim_audio_master",
+    .desc = "the video follows a drifting audio output",
+    .type = CLOCK_SCENARIO_SIMULATION,
+    INIT_SIMULATION_TIMING(VLC_TICK_2H, 25),
+    .sim = &sim_audio_master,
+},
+{
+    .name = "sim_input_master",
+    .desc = "the audio output is resampled to follow a jittery input",
+    .type = CLOCK_SCENARIO_SIMULATION,
+    INIT_SIMULATION_TIMING(VLC_TICK_2H, 25),
+    .sim = &sim_input_master,
+},
+{
+    .name = "sim_dropouts",
+    .desc = "the sync recovers from input dropouts",
+    .type = CLOCK_SCENARIO_SIMULATION,
+    INIT_SIMULATION_TIMING(VLC_TICK_2H, 25),
+    .sim = &sim_dropouts,
+},
 };
 
 int main(int argc, const char *argv[])
@@ -134,16 +134,28 @@ static void CloseCcDecoder(vlc_object_t *obj)
 
 static vlc_frame_t *PacketizerPacketize(decoder_t *dec, vlc_frame_t **in)
 {
-    (void)dec;
     if (in == NULL)
         return NULL;
 
     vlc_frame_t *ret = *in;
     if (ret != NULL)
+    {
         *in = NULL;
+
+        struct input_decoder_scenario *scenario = &input_decoder_scenarios[current_scenario];
+        if (scenario->packetizer_packetize != NULL)
+            scenario->packetizer_packetize(dec, ret);
+    }
     return ret;
 }
 
+static void PacketizerFlush(decoder_t *dec)
+{
+    struct input_decoder_scenario *scenario = &input_decoder_scenarios[current_scenario];
+    if (scenario->packetizer_flush != NULL)
+        scenario->packetizer_flush(dec);
+}
+
 static vlc_frame_t *PacketizerGetCC(decoder_t *dec, decoder_cc_desc_t *cc_desc)
 {
     struct input_decoder_scenario *scenario = &input_decoder_scenarios[current_scenario];
@@ -158,7 +170,7 @@ static int OpenPacketizer(vlc_object_t *obj)
 
     dec->pf_packetize = PacketizerPacketize;
     dec->pf_get_cc = PacketizerGetCC;
-    dec->pf_flush = NULL;
+    dec->pf_flush = PacketizerFlush;
     es_format_Clean(&dec->fmt_out);
     es_format_Copy(&dec->fmt_out, dec->fmt_in);
 
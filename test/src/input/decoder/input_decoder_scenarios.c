@@ -47,6 +47,13 @@ static struct scenario_data
     bool stream_out_sent;
     size_t decoder_image_sent;
     size_t cc_track_idx;
+    bool flush_requested;
+    unsigned long packetizer_thread;
+    vlc_mutex_t packetized_lock;
+    vlc_cond_t packetized_wait;
+    size_t packetized;
+    vlc_tick_t last_date;
+    vlc_tick_t start;
 } scenario_data;
 
 static void decoder_fixed_size(decoder_t *dec, vlc_fourcc_t chroma,
@@ -246,6 +253,105 @@ static int decoder_decode_check_flush_video(decoder_t *dec, picture_t *pic)
     return VLC_SUCCESS;
 }
 
+#define THROUGHPUT_FRAMES 50
+#define THROUGHPUT_WORK VLC_TICK_FROM_MS(2)
+
+static void packetizer_packetize_work(decoder_t *dec, vlc_frame_t *frame)
+{
+    (void)dec; (void)frame;
+    scenario_data.packetizer_thread = vlc_thread_id();
+    vlc_tick_sleep(THROUGHPUT_WORK);
+
+    vlc_mutex_lock(&scenario_data.packetized_lock);
+    scenario_data.packetized++;
+    vlc_cond_signal(&scenario_data.packetized_wait);
+    vlc_mutex_unlock(&scenario_data.packetized_lock);
+}
+
+static void decoder_decode_throughput_common(decoder_t *dec, picture_t *pic,
+                                             bool threaded)
+{
+    /* The packetizer only runs in its own thread if requested */
+    assert((scenario_data.packetizer_thread != vlc_thread_id()) == threaded);
+
+    /* The frames are not reordered by the packetizer thread */
+    assert(pic->date > scenario_data.last_date);
+    scenario_data.last_date = pic->date;
+    picture_Release(pic);
+
+    if (scenario_data.decoder_image_sent == 0)
+        scenario_data.start = vlc_tick_now();
+
+    const size_t decoded = scenario_data.decoder_image_sent;
+    vlc_mutex_lock(&scenario_data.packetized_lock);
+    if (threaded)
+    {
+        /* The packetizer works ahead: the next frame is packetized while
+         * this one is being decoded. This would never return if both
+         * ran in the same thread. */
+        while (scenario_data.packetized < decoded + 2)
+            vlc_cond_wait(&scenario_data.packetized_wait,
+                          &scenario_data.packetized_lock);
+    }
+    else
+    {
+        /* Each frame is packetized right before being decoded */
+        assert(scenario_data.packetized == decoded + 1);
+    }
+    vlc_mutex_unlock(&scenario_data.packetized_lock);
+
+    vlc_tick_sleep(THROUGHPUT_WORK);
+
+    if (++scenario_data.decoder_image_sent != THROUGHPUT_FRAMES)
+        return;
+
+    /* Not asserted, as timings depend on the load of the machine */
+    const vlc_tick_t elapsed = vlc_tick_now() - scenario_data.start;
+    msg_Info(dec, "%d frames decoded in %"PRId64" ms, %s packetizer thread",
+             THROUGHPUT_FRAMES, MS_FROM_VLC_TICK(elapsed),
+             threaded ? "with" : "without");
+    vlc_sem_post(&scenario_data.wait_stop);
+}
+
+static int decoder_decode_throughput(decoder_t *dec, picture_t *pic)
+{
+    decoder_decode_throughput_common(dec, pic, false);
+    return VLC_SUCCESS;
+}
+
+static int decoder_decode_throughput_threaded(decoder_t *dec, picture_t *pic)
+{
+    decoder_decode_throughput_common(dec, pic, true);
+    return VLC_SUCCESS;
+}
+
+static int decoder_decode_request_flush(decoder_t *dec, picture_t *pic)
+{
+    (void)dec;
+    picture_Release(pic);
+
+    if (!scenario_data.flush_requested)
+    {
+        scenario_data.flush_requested = true;
+        vlc_sem_post(&scenario_data.wait_ready_to_flush);
+    }
+    return VLC_SUCCESS;
+}
+
+static void packetizer_packetize_record_thread(decoder_t *dec, vlc_frame_t *frame)
+{
+    (void)dec; (void)frame;
+    scenario_data.packetizer_thread = vlc_thread_id();
+}
+
+static void packetizer_flush_check_thread(decoder_t *dec)
+{
+    (void)dec;
+    /* The packetizer is only called from its own thread */
+    assert(scenario_data.packetizer_thread == vlc_thread_id());
+    vlc_sem_post(&scenario_data.wait_stop);
+}
+
 static void decoder_flush_signal(decoder_t *dec)
 {
     (void)dec;
@@ -759,6 +865,32 @@ struct input_decoder_scenario input_decoder_scenarios[] =
     .display_prepare = display_prepare_noop,
     .text_renderer_render = cc_text_renderer_render_608_02,
 },
+{
+    /* Reference for the next scenario */
+    .name = "packetizing in the decoder thread",
+    .source = source_800_600 ";video_packetized=false",
+    .packetizer_packetize = packetizer_packetize_work,
+    .decoder_setup = decoder_i420_800_600,
+    .decoder_decode = decoder_decode_throughput,
+},
+{
+    .name = "the packetizer thread packetizes ahead of the decoder",
+    .source = source_800_600 ";video_packetized=false",
+    .item_option = ":packetizer-thread",
+    .packetizer_packetize = packetizer_packetize_work,
+    .decoder_setup = decoder_i420_800_600,
+    .decoder_decode = decoder_decode_throughput_threaded,
+},
+{
+    .name = "packetizer thread is flushed",
+    .source = source_800_600 ";video_packetized=false",
+    .item_option = ":packetizer-thread",
+    .packetizer_packetize = packetizer_packetize_record_thread,
+    .packetizer_flush = packetizer_flush_check_thread,
+    .decoder_setup = decoder_i420_800_600,
+    .decoder_decode = decoder_decode_request_flush,
+    .interface_setup = interface_setup_check_flush,
+},
 };
 
 size_t input_decoder_scenarios_count = ARRAY_SIZE(input_decoder_scenarios);
@@ -771,6 +903,12 @@ void input_decoder_scenario_init(void)
     scenario_data.stream_out_sent = false;
     scenario_data.decoder_image_sent = 0;
     scenario_data.cc_track_idx = 1;
+    scenario_data.flush_requested = false;
+    scenario_data.packetizer_thread = 0;
+    vlc_mutex_init(&scenario_data.packetized_lock);
+    vlc_cond_init(&scenario_data.packetized_wait);
+    scenario_data.packetized = 0;
+    scenario_data.last_date = VLC_TICK_INVALID;
     vlc_sem_init(&scenario_data.wait_stop, 0);
     vlc_sem_init(&scenario_data.wait_ready_to_flush, 0);
 }
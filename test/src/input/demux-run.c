@@ -302,6 +302,7 @@ static int demux_process_stream(const struct vlc_run_args *args, stream_t *s)
 
     uintmax_t i = 0;
     int val;
+    const vlc_tick_t start = vlc_tick_now();
 
     while ((val = demux_Demux(demux)) == VLC_DEMUXER_SUCCESS)
     {
@@ -327,6 +328,16 @@ static int demux_process_stream(const struct vlc_run_args *args, stream_t *s)
         i++;
     }
 
+    if (args->verbose > 0)
+    {
+        /* demuxer throughput, e.g. V=1 VLC_TARGET=ps vlc-demux-run file */
+        const vlc_tick_t elapsed = vlc_tick_now() - start;
+        const uint64_t bytes = vlc_stream_Tell(s);
+        fprintf(stderr, "Demuxed %" PRIu64 " bytes in %" PRId64 " ms "
+                "(%.1f MiB/s)\n", bytes, MS_FROM_VLC_TICK(elapsed),
+                bytes / 1048576. * CLOCK_FREQ / (elapsed > 0 ? elapsed : 1));
+    }
+
     demux_Delete(demux);
     es_out_Delete(out);
 
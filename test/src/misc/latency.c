@@ -0,0 +1,238 @@
+/*****************************************************************************
+ * latency.c: test for the latency trails
+ *****************************************************************************
+ * Copyright (C) 2024 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_frame.h>
+#include <vlc_picture.h>
+#include <vlc_tracer.h>
+
+#include "../../../src/misc/latency.h"
+
+#include <vlc/vlc.h>
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#define MODULE_NAME test_src_misc_latency
+#undef VLC_DYNAMIC_PLUGIN
+#include <vlc_plugin.h>
+
+/* Last LATENCY trace */
+static struct
+{
+    unsigned count;
+    int64_t frame;
+    const char *stage;
+    int64_t delay;
+    int64_t total;
+} traced;
+
+static void TracerTrace(void *opaque, vlc_tick_t ts,
+                        const struct vlc_tracer_trace *trace)
+{
+    (void) opaque; (void) ts;
+
+    for (const struct vlc_tracer_entry *entry = trace->entries;
+         entry->key != NULL; entry++)
+    {
+        if (strcmp(entry->key, "frame") == 0)
+            traced.frame = entry->value.integer;
+        else if (strcmp(entry->key, "stage") == 0)
+            traced.stage = entry->value.string;
+        else if (strcmp(entry->key, "delay") == 0)
+            traced.delay = entry->value.integer;
+        else if (strcmp(entry->key, "total") == 0)
+            traced.total = entry->value.integer;
+        else if (strcmp(entry->key, "type") == 0)
+            assert(strcmp(entry->value.string, "LATENCY") == 0);
+    }
+    traced.count++;
+}
+
+static const struct vlc_tracer_operations *
+OpenTracer(vlc_object_t *obj, void **restrict sysp)
+{
+    static const struct vlc_tracer_operations ops =
+    {
+        .trace = TracerTrace,
+    };
+
+    (void) obj;
+    *sysp = NULL;
+    return &ops;
+}
+
+vlc_module_begin()
+    set_callback(OpenTracer)
+    set_capability("tracer", 0)
+vlc_module_end()
+
+VLC_EXPORT const vlc_plugin_cb vlc_static_modules[] = {
+    VLC_SYMBOL(vlc_entry),
+    NULL
+};
+
+static vlc_frame_t *NewFrame(struct vlc_tracer *tracer, vlc_tick_t pts)
+{
+    vlc_frame_t *frame = vlc_frame_Alloc(1);
+    assert(frame != NULL);
+    frame->i_pts = frame->i_dts = pts;
+    if (tracer != NULL)
+        vlc_latency_Start(tracer, "video/0", frame);
+    return frame;
+}
+
+static void test_stamp(struct vlc_tracer *tracer)
+{
+    traced.count = 0;
+    vlc_frame_t *frame = NewFrame(tracer, VLC_TICK_0);
+    struct vlc_ancillary *trail =
+        vlc_frame_GetAncillary(frame, VLC_ANCILLARY_ID_LATENCY);
+    assert(trail != NULL);
+    assert(traced.count == 1);
+    assert(strcmp(traced.stage, "demux") == 0);
+    assert(traced.delay == 0 && traced.total == 0);
+    const int64_t id = traced.frame;
+
+    /* Every frame gets its own trail */
+    vlc_frame_t *other = NewFrame(tracer, VLC_TICK_0);
+    assert(vlc_frame_GetAncillary(other, VLC_ANCILLARY_ID_LATENCY) != trail);
+    assert(traced.count == 2 && traced.frame != id);
+    vlc_frame_Release(other);
+
+    /* No tracer, no trace */
+    vlc_latency_StampFrame(NULL, "video/0", frame, VLC_LATENCY_QUEUE);
+    assert(traced.count == 2);
+
+    vlc_tick_sleep(VLC_TICK_FROM_MS(1));
+    vlc_latency_StampFrame(tracer, "video/0", frame, VLC_LATENCY_QUEUE);
+    assert(traced.count == 3 && traced.frame == id);
+    assert(strcmp(traced.stage, "queue") == 0);
+    assert(traced.delay > 0 && traced.total == traced.delay);
+
+    /* A stage is only traced once, even if stamped again */
+    vlc_latency_StampFrame(tracer, "video/0", frame, VLC_LATENCY_QUEUE);
+    assert(traced.count == 3);
+
+    /* The trail follows the decoded picture. Without packetizer, the decode
+     * delay is counted from the queue. */
+    picture_t *pic = picture_New(VLC_CODEC_I420, 16, 16, 1, 1);
+    assert(pic != NULL);
+    int ret = picture_AttachAncillary(pic, trail);
+    assert(ret == VLC_SUCCESS);
+
+    vlc_tick_sleep(VLC_TICK_FROM_MS(1));
+    vlc_latency_StampPicture(tracer, "video/0", pic, VLC_LATENCY_DECODE);
+    assert(traced.count == 4 && traced.frame == id);
+    assert(strcmp(traced.stage, "decode") == 0);
+    assert(traced.delay > 0 && traced.total > traced.delay);
+
+    /* Stamped from the frame, already traced from the picture */
+    vlc_latency_StampFrame(tracer, "video/0", frame, VLC_LATENCY_DECODE);
+    assert(traced.count == 4);
+
+    picture_Release(pic);
+    vlc_frame_Release(frame);
+}
+
+static void test_queue(struct vlc_tracer *tracer)
+{
+    struct vlc_latency_queue queue;
+    vlc_latency_queue_Init(&queue);
+
+    /* Frames without trail, or without timestamp, are not kept */
+    vlc_frame_t *frame = NewFrame(NULL, VLC_TICK_0);
+    vlc_latency_queue_Push(&queue, frame);
+    assert(vlc_latency_queue_Pop(&queue, VLC_TICK_0) == NULL);
+    vlc_frame_Release(frame);
+
+    frame = NewFrame(tracer, VLC_TICK_INVALID);
+    vlc_latency_queue_Push(&queue, frame);
+    assert(vlc_latency_queue_Pop(&queue, VLC_TICK_INVALID) == NULL);
+    vlc_frame_Release(frame);
+
+    /* The trails are found by timestamp, in any order */
+    struct vlc_ancillary *trails[3];
+    for (size_t i = 0; i < ARRAY_SIZE(trails); i++)
+    {
+        frame = NewFrame(tracer, VLC_TICK_0 + i);
+        trails[i] = vlc_frame_GetAncillary(frame, VLC_ANCILLARY_ID_LATENCY);
+        vlc_latency_queue_Push(&queue, frame);
+        /* The queue holds its own reference */
+        vlc_frame_Release(frame);
+    }
+
+    struct vlc_ancillary *trail = vlc_latency_queue_Pop(&queue, VLC_TICK_0 + 1);
+    assert(trail == trails[1]);
+    vlc_ancillary_Release(trail);
+    assert(vlc_latency_queue_Pop(&queue, VLC_TICK_0 + 1) == NULL);
+
+    trail = vlc_latency_queue_Pop(&queue, VLC_TICK_0 + 2);
+    assert(trail == trails[2]);
+    vlc_ancillary_Release(trail);
+    trail = vlc_latency_queue_Pop(&queue, VLC_TICK_0);
+    assert(trail == trails[0]);
+    vlc_ancillary_Release(trail);
+
+    /* The oldest trails are overwritten once the queue is full */
+    for (size_t i = 0; i < VLC_LATENCY_QUEUE_SIZE + 2; i++)
+    {
+        frame = NewFrame(tracer, VLC_TICK_0 + i);
+        vlc_latency_queue_Push(&queue, frame);
+        vlc_frame_Release(frame);
+    }
+    assert(vlc_latency_queue_Pop(&queue, VLC_TICK_0) == NULL);
+    assert(vlc_latency_queue_Pop(&queue, VLC_TICK_0 + 1) == NULL);
+    trail = vlc_latency_queue_Pop(&queue, VLC_TICK_0 + 2);
+    assert(trail != NULL);
+    vlc_ancillary_Release(trail);
+
+    /* Clearing releases the remaining trails */
+    vlc_latency_queue_Clear(&queue);
+    assert(vlc_latency_queue_Pop(&queue, VLC_TICK_0 + 3) == NULL);
+
+    /* and the queue can be used again */
+    frame = NewFrame(tracer, VLC_TICK_0);
+    vlc_latency_queue_Push(&queue, frame);
+    vlc_frame_Release(frame);
+    vlc_latency_queue_Clear(&queue);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    struct vlc_tracer *tracer =
+        vlc_tracer_Create(VLC_OBJECT(vlc->p_libvlc_int), MODULE_STRING);
+    assert(tracer != NULL);
+
+    test_stamp(tracer);
+    test_queue(tracer);
+
+    vlc_tracer_Destroy(tracer);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -28,6 +28,7 @@
 #include <vlc_vector.h>
 #include <vlc_modules.h>
 #include <vlc_filter.h>
+#include <vlc_vout_display.h>
 
 #if defined(ZVBI_COMPILED)
 # define TELETEXT_DECODER "zvbi,"
@@ -215,6 +216,8 @@ struct media_params
 
     bool can_seek;
     bool can_pause;
+    bool can_control_rate;
+    bool can_control_pace;
     bool error;
     bool null_names;
     vlc_tick_t pts_delay;
@@ -239,6 +242,8 @@ struct media_params
     .attachment_count = 0, \
     .can_seek = true, \
     .can_pause = true, \
+    .can_control_rate = true, \
+    .can_control_pace = true, \
     .error = false, \
     .null_names = false, \
     .pts_delay = DEFAULT_PTS_DELAY, \
@@ -785,16 +790,18 @@ create_mock_media(const char *name, const struct media_params *params)
         "sub_packetized=%d;length=%"PRId64";audio_sample_length=%"PRId64";"
         "video_frame_rate=%u;video_frame_rate_base=%u;"
         "title_count=%zu;chapter_count=%zu;"
-        "can_seek=%d;can_pause=%d;error=%d;null_names=%d;pts_delay=%"PRId64";"
-        "config=%s;attachment_count=%zu",
+        "can_seek=%d;can_pause=%d;can_control_rate=%d;can_control_pace=%d;"
+        "error=%d;null_names=%d;"
+        "pts_delay=%"PRId64";config=%s;attachment_count=%zu",
         params->track_count[VIDEO_ES], params->track_count[AUDIO_ES],
         params->track_count[SPU_ES], params->program_count,
         params->video_packetized, params->audio_packetized,
         params->sub_packetized, params->length, params->audio_sample_length,
         params->video_frame_rate, params->video_frame_rate_base,
         params->title_count, params->chapter_count,
-        params->can_seek, params->can_pause, params->error, params->null_names,
-        params->pts_delay,
+        params->can_seek, params->can_pause, params->can_control_rate,
+        params->can_control_pace,
+        params->error, params->null_names, params->pts_delay,
         params->config ? params->config : "", params->attachment_count);
     assert(ret != -1);
     input_item_t *item = input_item_New(url, name);
@@ -1954,6 +1961,340 @@ test_seeks(struct ctx *ctx)
     test_end(ctx);
 }
 
+static void
+test_trickplay(struct ctx *ctx)
+{
+    test_log("trickplay\n");
+    vlc_player_t *player = ctx->player;
+    vlc_object_t *obj = VLC_OBJECT(ctx->vlc->p_libvlc_int);
+
+    var_Create(obj, "trickplay-rate", VLC_VAR_FLOAT);
+    var_SetFloat(obj, "trickplay-rate", 8.f);
+
+    /* The input rescales the timestamps itself */
+    struct media_params params = DEFAULT_MEDIA_PARAMS(VLC_TICK_FROM_SEC(10));
+    params.can_control_rate = false;
+    player_set_current_mock_media(ctx, "media1", &params, false);
+
+    vlc_player_SetTimeFast(player, VLC_TICK_FROM_SEC(2));
+    player_start(ctx);
+    wait_state(ctx, VLC_PLAYER_STATE_PLAYING);
+
+    /* Scan the keyframes backward, until the start where the playback goes
+     * back to the nominal rate */
+    player_set_rate(ctx, -8.f);
+    {
+        vec_on_rate_changed *vec = &ctx->report.on_rate_changed;
+        while (vec->size < 2)
+            vlc_player_CondWait(player, &ctx->wait);
+        assert(vec->data[0] == -8.f);
+        assert(VEC_LAST(vec) == 1.f);
+        ctx->rate = 1.f;
+    }
+
+    {
+        vec_on_statistics_changed *vec = &ctx->report.on_statistics_changed;
+        while (vec->size == 0 || VEC_LAST(vec).i_trickplay_keyframes == 0)
+            vlc_player_CondWait(player, &ctx->wait);
+        /* The other frames were demuxed and dropped without decoding */
+        assert(VEC_LAST(vec).i_trickplay_skipped > 0);
+    }
+
+    var_SetFloat(obj, "trickplay-rate", 0.f);
+
+    test_prestop(ctx);
+    test_end(ctx);
+}
+
+static void
+test_trickplay_unpacketized(struct ctx *ctx)
+{
+    test_log("trickplay_unpacketized\n");
+    vlc_player_t *player = ctx->player;
+    vlc_object_t *obj = VLC_OBJECT(ctx->vlc->p_libvlc_int);
+
+    var_Create(obj, "trickplay-rate", VLC_VAR_FLOAT);
+    var_SetFloat(obj, "trickplay-rate", 8.f);
+
+    /* As the TS demuxer, the video is not packetized: its keyframes could
+     * not be decoded alone, so that the rates are handled without
+     * trick-play */
+    struct media_params params = DEFAULT_MEDIA_PARAMS(VLC_TICK_FROM_SEC(10));
+    params.can_control_rate = false;
+    params.video_packetized = false;
+    player_set_current_mock_media(ctx, "media1", &params, false);
+
+    player_start(ctx);
+    wait_state(ctx, VLC_PLAYER_STATE_PLAYING);
+
+    /* The negative rate is refused, and the fast one is not a trick-play
+     * rate anymore */
+    player_set_rate(ctx, -8.f);
+    player_set_rate(ctx, 16.f);
+    {
+        vec_on_rate_changed *vec = &ctx->report.on_rate_changed;
+        while (vec->size == 0)
+            vlc_player_CondWait(player, &ctx->wait);
+        assert(vec->data[0] == 16.f);
+    }
+
+    {
+        vec_on_statistics_changed *vec = &ctx->report.on_statistics_changed;
+        while (vec->size == 0 || VEC_LAST(vec).i_decoded_video == 0)
+            vlc_player_CondWait(player, &ctx->wait);
+        /* Every frame is still decoded */
+        assert(VEC_LAST(vec).i_trickplay_keyframes == 0);
+        assert(VEC_LAST(vec).i_trickplay_skipped == 0);
+    }
+
+    var_SetFloat(obj, "trickplay-rate", 0.f);
+
+    test_prestop(ctx);
+    test_end(ctx);
+}
+
+static void
+test_frame_previous(struct ctx *ctx)
+{
+    test_log("frame_previous\n");
+    vlc_player_t *player = ctx->player;
+    vlc_object_t *obj = VLC_OBJECT(ctx->vlc->p_libvlc_int);
+
+    var_Create(obj, "vout-frame-cache", VLC_VAR_INTEGER);
+    var_SetInteger(obj, "vout-frame-cache", 16);
+
+    struct media_params params = DEFAULT_MEDIA_PARAMS(VLC_TICK_FROM_SEC(10));
+    player_set_current_mock_media(ctx, "media1", &params, false);
+    player_start(ctx);
+
+    /* Let the video output cache some pictures */
+    {
+        vec_on_position_changed *vec = &ctx->report.on_position_changed;
+        while (vec->size < 10)
+            vlc_player_CondWait(player, &ctx->wait);
+    }
+
+    vlc_player_Pause(player);
+    wait_state(ctx, VLC_PLAYER_STATE_PAUSED);
+
+    vlc_player_NextVideoFrame(player);
+    vlc_player_PreviousVideoFrame(player);
+    vlc_player_PreviousVideoFrame(player);
+
+    /* The statistics are only updated while playing */
+    vlc_player_Resume(player);
+    {
+        vec_on_statistics_changed *vec = &ctx->report.on_statistics_changed;
+        while (vec->size == 0 || VEC_LAST(vec).i_frame_cache_hits
+                               + VEC_LAST(vec).i_frame_cache_misses < 2)
+            vlc_player_CondWait(player, &ctx->wait);
+        assert(VEC_LAST(vec).i_frame_cache_hits
+             + VEC_LAST(vec).i_frame_cache_misses == 2);
+        assert(VEC_LAST(vec).i_frame_cache_hits > 0);
+    }
+
+    test_prestop(ctx);
+    test_end(ctx);
+
+    var_SetInteger(obj, "vout-frame-cache", 0);
+}
+
+/* Pictures displayed by the test_src_player display, the redisplays of the
+ * same picture are not counted */
+static struct
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    size_t count;
+    vlc_tick_t last;
+    bool ordered;
+} display_report = {
+    .lock = VLC_STATIC_MUTEX,
+    .wait = VLC_STATIC_COND,
+};
+
+/* Wait until no new picture was displayed for a while, and return the count
+ * of displayed pictures */
+static size_t
+wait_display_idle(struct ctx *ctx)
+{
+    vlc_player_Unlock(ctx->player);
+    vlc_mutex_lock(&display_report.lock);
+    size_t count;
+    do
+    {
+        count = display_report.count;
+        vlc_tick_t deadline = vlc_tick_now() + VLC_TICK_FROM_MS(200);
+        while (display_report.count == count
+            && vlc_cond_timedwait(&display_report.wait, &display_report.lock,
+                                  deadline) == 0);
+    } while (display_report.count != count);
+    vlc_mutex_unlock(&display_report.lock);
+    vlc_player_Lock(ctx->player);
+    return count;
+}
+
+static void
+test_render_ahead(struct ctx *ctx)
+{
+    test_log("render_ahead\n");
+    vlc_player_t *player = ctx->player;
+    vlc_object_t *obj = VLC_OBJECT(ctx->vlc->p_libvlc_int);
+
+    var_Create(obj, "vout-render-ahead", VLC_VAR_INTEGER);
+    var_SetInteger(obj, "vout-render-ahead", 3);
+
+    /* Record the displayed pictures, and filter them with a slow
+     * deinterlacer so that the static filter stage is timed */
+    var_SetString(obj, "vout", "test_src_player");
+    var_Create(obj, "deinterlace", VLC_VAR_INTEGER);
+    var_SetInteger(obj, "deinterlace", 1);
+    var_Create(obj, "deinterlace-filter", VLC_VAR_STRING);
+    var_SetString(obj, "deinterlace-filter", "test_src_player");
+
+    struct media_params params = DEFAULT_MEDIA_PARAMS(VLC_TICK_FROM_SEC(10));
+    player_set_current_mock_media(ctx, "media1", &params, false);
+    player_start(ctx);
+
+    vec_on_statistics_changed *vec = &ctx->report.on_statistics_changed;
+    while (vec->size == 0 || VEC_LAST(vec).i_displayed_pictures < 10)
+        vlc_player_CondWait(player, &ctx->wait);
+
+    /* Flush the pictures filtered ahead */
+    vlc_player_SetTime(player, VLC_TICK_FROM_SEC(5));
+    const uint64_t displayed = VEC_LAST(vec).i_displayed_pictures;
+    while (VEC_LAST(vec).i_displayed_pictures < displayed + 10)
+        vlc_player_CondWait(player, &ctx->wait);
+
+    /* The rendering stages are timed in the statistics */
+    const struct input_stats_histogram *h =
+        &VEC_LAST(vec).histograms[INPUT_STATS_STATIC_FILTER_TIME];
+    assert(h->i_count > 0 && h->i_total / h->i_count > 0);
+    assert(VEC_LAST(vec).histograms[INPUT_STATS_DISPLAY_TIME].i_count > 0);
+
+    /* The pictures filtered ahead are displayed in order, and the ones
+     * queued before the flush are not displayed */
+    vlc_mutex_lock(&display_report.lock);
+    assert(display_report.ordered);
+    assert(display_report.last >= VLC_TICK_FROM_SEC(5));
+    vlc_mutex_unlock(&display_report.lock);
+
+    /* Step from the queue of pictures filtered ahead, one picture each */
+    vlc_player_Pause(player);
+    wait_state(ctx, VLC_PLAYER_STATE_PAUSED);
+    size_t count = wait_display_idle(ctx);
+    for (int i = 0; i < 2; ++i)
+    {
+        vlc_player_NextVideoFrame(player);
+        size_t stepped = wait_display_idle(ctx);
+        assert(stepped == count + 1);
+        count = stepped;
+    }
+
+    vlc_mutex_lock(&display_report.lock);
+    assert(display_report.ordered);
+    vlc_mutex_unlock(&display_report.lock);
+
+    test_prestop(ctx);
+    test_end(ctx);
+
+    var_Destroy(obj, "deinterlace-filter");
+    var_Destroy(obj, "deinterlace");
+    var_SetString(obj, "vout", "dummy,none");
+    var_SetInteger(obj, "vout-render-ahead", 0);
+}
+
+static void
+test_histograms(struct ctx *ctx)
+{
+    test_log("histograms\n");
+    vlc_player_t *player = ctx->player;
+
+    struct media_params params = DEFAULT_MEDIA_PARAMS(VLC_TICK_FROM_SEC(10));
+    player_set_current_mock_media(ctx, "media1", &params, false);
+    player_start(ctx);
+
+    vec_on_statistics_changed *vec = &ctx->report.on_statistics_changed;
+    while (vec->size == 0
+        || VEC_LAST(vec).histograms[INPUT_STATS_DECODE_TIME].i_count < 10
+        || VEC_LAST(vec).histograms[INPUT_STATS_RENDER_TIME].i_count < 10)
+        vlc_player_CondWait(player, &ctx->wait);
+
+    const struct input_stats_histogram *h =
+        &VEC_LAST(vec).histograms[INPUT_STATS_RENDER_TIME];
+    uint64_t count = 0;
+    for (size_t i = 0; i < INPUT_STATS_HISTOGRAM_BUCKETS; i++)
+        count += h->buckets[i];
+    /* the samples are not recorded atomically */
+    assert(count >= h->i_count);
+    assert(input_stats_histogram_Percentile(h, 50)
+        <= input_stats_histogram_Percentile(h, 99));
+
+    test_prestop(ctx);
+    test_end(ctx);
+}
+
+static void
+test_timeshift(struct ctx *ctx)
+{
+    test_log("timeshift\n");
+    vlc_player_t *player = ctx->player;
+
+    /* Live stream, that can only be paused and seeked via the timeshift */
+    struct media_params params = DEFAULT_MEDIA_PARAMS(VLC_TICK_FROM_SEC(100));
+    params.can_seek = false;
+    params.can_pause = false;
+    params.can_control_pace = false;
+    player_set_current_mock_media(ctx, "media1", &params, false);
+    player_start(ctx);
+
+    vec_on_position_changed *vec = &ctx->report.on_position_changed;
+    while (vec->size == 0)
+        vlc_player_CondWait(player, &ctx->wait);
+
+    vlc_player_Pause(player);
+    wait_state(ctx, VLC_PLAYER_STATE_PAUSED);
+
+    /* Let the live stream be buffered */
+    const vlc_tick_t buffered = VLC_TICK_FROM_SEC(4);
+    vlc_player_Unlock(player);
+    vlc_tick_sleep(buffered);
+    vlc_player_Lock(player);
+
+    /* Pause/resume latency: until the first frame after resuming */
+    size_t count = vec->size;
+    vlc_tick_t start = vlc_tick_now();
+    vlc_player_Resume(player);
+    while (vec->size == count)
+        vlc_player_CondWait(player, &ctx->wait);
+    const vlc_tick_t resume_latency = vlc_tick_now() - start;
+
+    /* Scrub latency: until a frame near the target is displayed */
+    const vlc_tick_t from = VEC_LAST(vec).time;
+    const vlc_tick_t target = from + buffered * 3 / 4;
+    const vlc_tick_t reached = target - VLC_TICK_FROM_MS(500);
+    count = vec->size;
+    start = vlc_tick_now();
+    vlc_player_SeekByTime(player, target, VLC_PLAYER_SEEK_PRECISE,
+                          VLC_PLAYER_WHENCE_ABSOLUTE);
+    while (VEC_LAST(vec).time < reached)
+        vlc_player_CondWait(player, &ctx->wait);
+    const vlc_tick_t scrub_latency = vlc_tick_now() - start;
+
+    test_log("timeshift: resume latency %"PRId64" ms, scrub latency %"PRId64
+             " ms\n", MS_FROM_VLC_TICK(resume_latency),
+             MS_FROM_VLC_TICK(scrub_latency));
+
+    /* The playback jumped ahead instead of playing the buffer: no position
+     * was displayed within the skipped range */
+    for (size_t i = count; i < vec->size; ++i)
+        assert(vec->data[i].time <= from + VLC_TICK_FROM_SEC(1)
+            || vec->data[i].time >= reached);
+
+    test_prestop(ctx);
+    test_end(ctx);
+}
+
 #define assert_media_name(media, name) do { \
     assert(media); \
     char *media_name = input_item_GetName(media); \
@@ -3103,6 +3444,12 @@ main(void)
     test_set_current_media(&ctx);
     test_next_media(&ctx);
     test_seeks(&ctx);
+    test_trickplay(&ctx);
+    test_trickplay_unpacketized(&ctx);
+    test_frame_previous(&ctx);
+    test_timeshift(&ctx);
+    test_render_ahead(&ctx);
+    test_histograms(&ctx);
     test_pause(&ctx);
     test_capabilities_pause(&ctx);
     test_capabilities_seek(&ctx);
@@ -3216,6 +3563,61 @@ static int resampler_Open(vlc_object_t *obj)
     return VLC_SUCCESS;
 }
 
+static picture_t *deinterlace_Filter(filter_t *filter, picture_t *pic)
+{
+    VLC_UNUSED(filter);
+    vlc_tick_sleep(VLC_TICK_FROM_MS(1));
+    return pic;
+}
+
+static int deinterlace_Open(filter_t *filter)
+{
+    static const struct vlc_filter_operations filter_ops =
+    { .filter_video = deinterlace_Filter, };
+    filter->ops = &filter_ops;
+    return VLC_SUCCESS;
+}
+
+static void display_Display(vout_display_t *vd, picture_t *pic)
+{
+    VLC_UNUSED(vd);
+    vlc_mutex_lock(&display_report.lock);
+    if (pic->date != display_report.last)
+    {
+        if (display_report.last != VLC_TICK_INVALID
+         && pic->date < display_report.last)
+            display_report.ordered = false;
+        display_report.last = pic->date;
+        display_report.count++;
+        vlc_cond_signal(&display_report.wait);
+    }
+    vlc_mutex_unlock(&display_report.lock);
+}
+
+static int display_Control(vout_display_t *vd, int query)
+{
+    VLC_UNUSED(vd); VLC_UNUSED(query);
+    return VLC_SUCCESS;
+}
+
+static int display_Open(vout_display_t *vd, video_format_t *fmtp,
+                        vlc_video_context *context)
+{
+    VLC_UNUSED(fmtp); VLC_UNUSED(context);
+    static const struct vlc_display_operations ops = {
+        .display = display_Display,
+        .control = display_Control,
+    };
+    vd->ops = &ops;
+
+    vlc_mutex_lock(&display_report.lock);
+    display_report.count = 0;
+    display_report.last = VLC_TICK_INVALID;
+    display_report.ordered = true;
+    vlc_mutex_unlock(&display_report.lock);
+    return VLC_SUCCESS;
+}
+
 vlc_module_begin()
     /* This aout module will report audio timings perfectly, but without any
      * delay, in order to be usable for player tests. Indeed, this aout will
@@ -3228,6 +3630,12 @@ vlc_module_begin()
      * Insert our own resampler that keeps blocks and pts untouched. */
         set_capability ("audio resampler", 9999)
         set_callback (resampler_Open)
+    add_submodule ()
+    /* Slow static filter and display recording the displayed pictures,
+     * only used when selected by name (render_ahead test) */
+        set_callback_video_filter (deinterlace_Open)
+    add_submodule ()
+        set_callback_display (display_Open, 0)
 vlc_module_end()
 
 VLC_EXPORT const vlc_plugin_cb vlc_static_modules[] = {